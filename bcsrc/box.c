@@ -32,6 +32,8 @@ static int top_fric = 0;
 
 void generate_dirichlet_bcs(job_t *job);
 void generate_node_number_override(job_t *job);
+void bc_momentum_threaded(threadtask_t *task);
+void bc_force_threaded(threadtask_t *task);
 
 void bc_init(job_t *job)
 {
@@ -69,8 +71,9 @@ int bc_validate(job_t *job)
     printf("%s:%s: friction on (left, bottom, right, top): (%d, %d, %d, %d)\n",
         __FILE__, __func__ , left_fric, bottom_fric, right_fric, top_fric);
 
-    if (x0 < 0 || y0 < 0 || x0 > 1.0 || y0 > 1.0) {
-        fprintf(stderr, "%s:%s: Box must start in [(0,0),(1,1)]\n", __FILE__, __func__);
+    if (x0 < job->x0 || y0 < job->y0 || x0 > job->x1 || y0 > job->y1) {
+        fprintf(stderr, "%s:%s: Box must start in [(%g,%g),(%g,%g)]\n", __FILE__, __func__,
+            job->x0, job->y0, job->x1, job->y1);
         return 0;
     }
 
@@ -79,15 +82,16 @@ int bc_validate(job_t *job)
         return 0;
     }
 
-    if ((x0 + w) > 1.0 || (y0 + h) > 1.0) {
-        fprintf(stderr, "%s:%s: Box must be contained in [(0,0), (1,1)] .\n", __FILE__, __func__);
+    if ((x0 + w) > job->x1 || (y0 + h) > job->y1) {
+        fprintf(stderr, "%s:%s: Box must be contained in [(%g,%g), (%g,%g)] .\n", __FILE__, __func__,
+            job->x0, job->y0, job->x1, job->y1);
         return 0;
     }
 
-    left_col = x0 * (job->N - 1);
-    right_col = (x0 + w) * (job->N - 1);
-    bottom_row = y0 * (job->N - 1);
-    top_row = (y0 + h) * (job->N - 1);
+    left_col = (x0 - job->x0) / (job->x1 - job->x0) * (job->Nx - 1);
+    right_col = (x0 + w - job->x0) / (job->x1 - job->x0) * (job->Nx - 1);
+    bottom_row = (y0 - job->y0) / (job->y1 - job->y0) * (job->Ny - 1);
+    top_row = (y0 + h - job->y0) / (job->y1 - job->y0) * (job->Ny - 1);
 
     printf("%s:%s: (left_col, bottom_row): (%zu, %zu), (right_col, top_row): (%zu, %zu)\n",
         __FILE__, __func__ , left_col, bottom_row, right_col, top_row);
@@ -95,10 +99,23 @@ int bc_validate(job_t *job)
     return 1;
 }
 
+/* The box never changes, so the constraint lists are built once. */
 void bc_time_varying(job_t *job)
 {
+    if (job->bc_constraints.published) {
+        return;
+    }
+
     generate_dirichlet_bcs(job);
     generate_node_number_override(job);
+    if (bc_constraints_build(&(job->bc_constraints), job->u_dirichlet,
+            job->u_dirichlet_mask, job->node_number_override,
+            job->num_nodes) != 0) {
+        fprintf(stderr, "%s:%s: Unable to allocate constraint lists.\n",
+            __FILE__, __func__);
+        exit(-1);
+    }
+
     return;
 }
 
@@ -113,8 +130,8 @@ void generate_dirichlet_bcs(job_t *job)
 
     /* Floor and ceiling. */
     for (size_t n = left_col; n <= right_col; n++) {
-        size_t b = n + bottom_row * job->N;
-        size_t t = n + top_row * job->N;
+        size_t b = n + bottom_row * job->Nx;
+        size_t t = n + top_row * job->Nx;
 
         /* bottom */
         if (bottom_fric & XFRICTION) {
@@ -139,8 +156,8 @@ void generate_dirichlet_bcs(job_t *job)
 
     /* Side walls. */
     for (size_t n = bottom_row; n <= top_row; n++) {
-        size_t l = n*job->N + left_col;
-        size_t r = n*job->N + right_col;
+        size_t l = n*job->Nx + left_col;
+        size_t r = n*job->Nx + right_col;
 
         /* left */
         if (left_fric & XFRICTION) {
@@ -182,43 +199,35 @@ void generate_node_number_override(job_t *job)
 /* Only zeros out entries for now... */
 void bc_momentum(job_t *job)
 {
-    for (size_t i = 0; i < job->num_nodes; i++) {
-        for (size_t j = 0; j < NODAL_DOF; j++) {
-            size_t n = NODAL_DOF * i + j;
-            size_t m = job->node_number_override[n];
-            if (job->u_dirichlet_mask[m] != 0) {
-                /* only handle 0 displacement right now. */
-                if (job->u_dirichlet[m] == 0) {
-                    if (j == XDOF_IDX) {
-                        job->nodes[i].mx_t = 0;
-                    } else if (j == YDOF_IDX) {
-                        job->nodes[i].my_t = 0;
-                    }
-                }
-            }
-        }
-    }
+    bc_constraints_apply(&(job->bc_constraints),
+        job->nodes.mx_t, job->nodes.my_t, 0, 1);
     return;
 }
 
 /* Only zero out entries for now... */
 void bc_force(job_t *job)
 {
-    for (size_t i = 0; i < job->num_nodes; i++) {
-        for (size_t j = 0; j < NODAL_DOF; j++) {
-            size_t n = NODAL_DOF * i + j;
-            size_t m = job->node_number_override[n];
-            if (job->u_dirichlet_mask[m] != 0) {
-                /* only handle 0 displacement right now. */
-                if (job->u_dirichlet[m] == 0) {
-                    if (j == XDOF_IDX) {
-                        job->nodes[i].fx = 0;
-                    } else if (j == YDOF_IDX) {
-                        job->nodes[i].fy = 0;
-                    }
-                }
-            }
-        }
-    }
+    bc_constraints_apply(&(job->bc_constraints),
+        job->nodes.fx, job->nodes.fy, 0, 1);
+    return;
+}
+
+/* Same as bc_momentum, each thread zeroes its share of the constraints. */
+void bc_momentum_threaded(threadtask_t *task)
+{
+    job_t *job = task->job;
+
+    bc_constraints_apply(&(job->bc_constraints),
+        job->nodes.mx_t, job->nodes.my_t, task->id, job->num_threads);
+    return;
+}
+
+/* Same as bc_force, each thread zeroes its share of the constraints. */
+void bc_force_threaded(threadtask_t *task)
+{
+    job_t *job = task->job;
+
+    bc_constraints_apply(&(job->bc_constraints),
+        job->nodes.fx, job->nodes.fy, task->id, job->num_threads);
     return;
 }
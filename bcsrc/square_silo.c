@@ -20,8 +20,13 @@ static double hole_radius = 0;
 static double open_time = 0;
 static size_t wall_col = 0;
 
+/* trapdoor state the constraint lists were built for. */
+static int door_open = 0;
+
 void generate_dirichlet_bcs(job_t *job);
 void generate_node_number_override(job_t *job);
+void bc_momentum_threaded(threadtask_t *task);
+void bc_force_threaded(threadtask_t *task);
 
 void bc_init(job_t *job)
 {
@@ -39,7 +44,7 @@ int bc_validate(job_t *job)
 
     hole_radius = job->boundary.fp64_props[0];
     open_time = job->boundary.fp64_props[1];
-    wall_col = (int)((job->N - 1) * job->boundary.fp64_props[2]);
+    wall_col = (int)((job->Nx - 1) * job->boundary.fp64_props[2]);
 
     printf("%s:%s: (Hole radius, Open time, Wall Column): (%g, %g, %zu)\n",
         __FILE__, __func__, hole_radius, open_time, wall_col);
@@ -47,10 +52,26 @@ int bc_validate(job_t *job)
     return 1;
 }
 
+/* Constraints only change when the trapdoor opens. */
 void bc_time_varying(job_t *job)
 {
+    int open = (job->t > open_time);
+
+    if (job->bc_constraints.published && open == door_open) {
+        return;
+    }
+
+    door_open = open;
     generate_dirichlet_bcs(job);
     generate_node_number_override(job);
+    if (bc_constraints_build(&(job->bc_constraints), job->u_dirichlet,
+            job->u_dirichlet_mask, job->node_number_override,
+            job->num_nodes) != 0) {
+        fprintf(stderr, "%s:%s: Unable to allocate constraint lists.\n",
+            __FILE__, __func__);
+        exit(-1);
+    }
+
     return;
 }
 
@@ -64,10 +85,10 @@ void generate_dirichlet_bcs(job_t *job)
     }
 
     /* Floor (and ceiling commented out). */
-    for (size_t n = 0; n < job->N; n++) {
+    for (size_t n = 0; n < job->Nx; n++) {
 
-        /* trapdoor */
-        if (job->nodes[n].x <= hole_radius && job->t > open_time) {
+        /* trapdoor (measured from the left wall). */
+        if (n * job->h <= hole_radius && job->t > open_time) {
             continue;
         }
 
@@ -79,12 +100,12 @@ void generate_dirichlet_bcs(job_t *job)
     }
 
     /* Frictionless side walls. */
-    for (size_t n = 0; n < job->N; n++) {
-        job->u_dirichlet[NODAL_DOF * (0 + n*job->N) + XDOF_IDX] = 0;
-        job->u_dirichlet_mask[NODAL_DOF * (0 + n*job->N) + XDOF_IDX] = 1;
+    for (size_t n = 0; n < job->Ny; n++) {
+        job->u_dirichlet[NODAL_DOF * (0 + n*job->Nx) + XDOF_IDX] = 0;
+        job->u_dirichlet_mask[NODAL_DOF * (0 + n*job->Nx) + XDOF_IDX] = 1;
 
-        job->u_dirichlet[NODAL_DOF * (wall_col + n*job->N) + XDOF_IDX] = 0;
-        job->u_dirichlet_mask[NODAL_DOF * (wall_col + n*job->N) + XDOF_IDX] = 1;
+        job->u_dirichlet[NODAL_DOF * (wall_col + n*job->Nx) + XDOF_IDX] = 0;
+        job->u_dirichlet_mask[NODAL_DOF * (wall_col + n*job->Nx) + XDOF_IDX] = 1;
     }
 
     return;
@@ -105,45 +126,35 @@ void generate_node_number_override(job_t *job)
 /* Only zeros out entries for now... */
 void bc_momentum(job_t *job)
 {
-    for (size_t i = 0; i < job->num_nodes; i++) {
-        for (size_t j = 0; j < NODAL_DOF; j++) {
-            size_t n = NODAL_DOF * i + j;
-            size_t m = job->node_number_override[n];
-            if (job->u_dirichlet_mask[m] != 0) {
-                /* only handle 0 displacement right now. */
-                if (job->u_dirichlet[m] == 0) {
-                    if (j == XDOF_IDX) {
-                        job->nodes[i].mx_t = 0;
-                    } else if (j == YDOF_IDX) {
-                        job->nodes[i].my_t = 0;
-                    }
-                }
-            }
-        }
-    }
-
+    bc_constraints_apply(&(job->bc_constraints),
+        job->nodes.mx_t, job->nodes.my_t, 0, 1);
     return;
 }
 
 /* Only zero out entries for now... */
 void bc_force(job_t *job)
 {
-    for (size_t i = 0; i < job->num_nodes; i++) {
-        for (size_t j = 0; j < NODAL_DOF; j++) {
-            size_t n = NODAL_DOF * i + j;
-            size_t m = job->node_number_override[n];
-            if (job->u_dirichlet_mask[m] != 0) {
-                /* only handle 0 displacement right now. */
-                if (job->u_dirichlet[m] == 0) {
-                    if (j == XDOF_IDX) {
-                        job->nodes[i].fx = 0;
-                    } else if (j == YDOF_IDX) {
-                        job->nodes[i].fy = 0;
-                    }
-                }
-            }
-        }
-    }
+    bc_constraints_apply(&(job->bc_constraints),
+        job->nodes.fx, job->nodes.fy, 0, 1);
+    return;
+}
+
+/* Same as bc_momentum, each thread zeroes its share of the constraints. */
+void bc_momentum_threaded(threadtask_t *task)
+{
+    job_t *job = task->job;
+
+    bc_constraints_apply(&(job->bc_constraints),
+        job->nodes.mx_t, job->nodes.my_t, task->id, job->num_threads);
+    return;
+}
+
+/* Same as bc_force, each thread zeroes its share of the constraints. */
+void bc_force_threaded(threadtask_t *task)
+{
+    job_t *job = task->job;
 
+    bc_constraints_apply(&(job->bc_constraints),
+        job->nodes.fx, job->nodes.fy, task->id, job->num_threads);
     return;
 }
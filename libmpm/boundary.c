@@ -0,0 +1,99 @@
+/**
+    \file boundary.c
+    \author Sachith Dunatunga
+    \date 17.10.2026
+
+    mpm_2d -- An implementation of the Material Point Method in 2D.
+*/
+#include <stdlib.h>
+#include <string.h>
+#include "boundary.h"
+
+/*---bc_constraints_build-----------------------------------------------------*/
+int bc_constraints_build(bc_constraints_t *c, const double *u_dirichlet,
+    const int *u_dirichlet_mask, const int *node_number_override,
+    size_t num_nodes)
+{
+    size_t i, d, m, count[NODAL_DOF];
+    size_t *nodes;
+
+    memset(count, 0, sizeof(count));
+    for (i = 0; i < num_nodes; i++) {
+        for (d = 0; d < NODAL_DOF; d++) {
+            m = node_number_override[NODAL_DOF * i + d];
+            if (u_dirichlet_mask[m] != 0 && u_dirichlet[m] == 0) {
+                count[d]++;
+            }
+        }
+    }
+
+    for (d = 0; d < NODAL_DOF; d++) {
+        c->num_nodes[d] = 0;
+        if (count[d] > c->capacity[d]) {
+            nodes = (size_t *)realloc(c->nodes[d], count[d] * sizeof(size_t));
+            if (nodes == NULL) {
+                bc_constraints_free(c);
+                return -1;
+            }
+            c->nodes[d] = nodes;
+            c->capacity[d] = count[d];
+        }
+    }
+
+    for (i = 0; i < num_nodes; i++) {
+        for (d = 0; d < NODAL_DOF; d++) {
+            m = node_number_override[NODAL_DOF * i + d];
+            if (u_dirichlet_mask[m] != 0 && u_dirichlet[m] == 0) {
+                c->nodes[d][c->num_nodes[d]++] = i;
+            }
+        }
+    }
+
+    c->published = 1;
+    c->version++;
+
+    return 0;
+}
+/*----------------------------------------------------------------------------*/
+
+/*---bc_constraints_free------------------------------------------------------*/
+void bc_constraints_free(bc_constraints_t *c)
+{
+    size_t d;
+
+    for (d = 0; d < NODAL_DOF; d++) {
+        free(c->nodes[d]);
+        c->nodes[d] = NULL;
+        c->num_nodes[d] = 0;
+        c->capacity[d] = 0;
+    }
+    c->published = 0;
+
+    return;
+}
+/*----------------------------------------------------------------------------*/
+
+/*---bc_constraints_apply-----------------------------------------------------*/
+void bc_constraints_apply(const bc_constraints_t *c, double *x, double *y,
+    size_t thread_id, size_t num_threads)
+{
+    const size_t *xn = c->nodes[XDOF_IDX];
+    const size_t *yn = c->nodes[YDOF_IDX];
+    const size_t nx = c->num_nodes[XDOF_IDX];
+    const size_t ny = c->num_nodes[YDOF_IDX];
+    size_t k;
+
+    for (k = (thread_id * nx) / num_threads;
+        k < ((thread_id + 1) * nx) / num_threads; k++) {
+        x[xn[k]] = 0;
+    }
+
+    for (k = (thread_id * ny) / num_threads;
+        k < ((thread_id + 1) * ny) / num_threads; k++) {
+        y[yn[k]] = 0;
+    }
+
+    return;
+}
+/*----------------------------------------------------------------------------*/
+
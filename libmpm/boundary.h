@@ -0,0 +1,53 @@
+/**
+    \file boundary.h
+    \author Sachith Dunatunga
+    \date 17.10.2026
+
+    Sparse lists of constrained nodal degrees of freedom.
+
+    A boundary condition plugin fills u_dirichlet, u_dirichlet_mask and
+    node_number_override as before, but only when the conditions change, and
+    then calls bc_constraints_build to publish them as one ascending list of
+    nodes per degree of freedom. Once a plugin has published a list the
+    threaded stepper applies it with every thread instead of calling the
+    plugin's serial bc_momentum and bc_force.
+
+    Only zero (fixed) values are supported, like the plugins themselves.
+*/
+#ifndef __BOUNDARY_H__
+#define __BOUNDARY_H__
+#include <stddef.h>
+#include "element.h"
+
+typedef struct bc_constraints_s {
+    /* nodes whose dof d is held at zero, in ascending order. */
+    size_t *nodes[NODAL_DOF];
+    size_t num_nodes[NODAL_DOF];
+    size_t capacity[NODAL_DOF];
+
+    /* set by the first bc_constraints_build. */
+    int published;
+
+    /* number of times the lists have been built. */
+    size_t version;
+} bc_constraints_t;
+
+/*
+    Rebuild the lists from the dirichlet arrays of a grid with num_nodes
+    nodes (one scan of the grid). Returns 0 on success, -1 if an allocation
+    failed, in which case the lists are left empty and unpublished.
+*/
+int bc_constraints_build(bc_constraints_t *c, const double *u_dirichlet,
+    const int *u_dirichlet_mask, const int *node_number_override,
+    size_t num_nodes);
+void bc_constraints_free(bc_constraints_t *c);
+
+/*
+    Zero the x and y components of the constrained nodes in this thread's
+    share of the lists. Threads write disjoint nodes of each list, so all
+    threads can call this at once.
+*/
+void bc_constraints_apply(const bc_constraints_t *c, double *x, double *y,
+    size_t thread_id, size_t num_threads);
+
+#endif //__BOUNDARY_H__
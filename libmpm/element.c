@@ -7,13 +7,28 @@
 */
 
 /*---node_number_to_coords----------------------------------------------------*/
-void node_number_to_coords(double *x, double *y, int num, int N, double h)
+void node_number_to_coords(double *x, double *y, int num, int Nx,
+    double x0, double y0, double h)
 {
-    const int i = num % N;
-    const int j = num / N;
+    const int i = num % Nx;
+    const int j = num / Nx;
 
-    *x = i*h;
-    *y = j*h;
+    *x = x0 + i*h;
+    *y = y0 + j*h;
+
+    return;
+}
+/*----------------------------------------------------------------------------*/
+
+/*---element_node_numbers-----------------------------------------------------*/
+void element_node_numbers(int *nodes, int num, int Nx)
+{
+    const int n = (num / (Nx - 1)) * Nx + (num % (Nx - 1));
+
+    nodes[0] = n;
+    nodes[1] = n + 1;
+    nodes[2] = n + 1 + Nx;
+    nodes[3] = n + Nx;
 
     return;
 }
@@ -26,16 +26,24 @@
     8 -> left edge
     9 -> center
 */
+/*
+    Element data the explicit solver reads or writes every step. Everything
+    else about an element is kept in the cold records below, which are only
+    allocated when something uses them.
+*/
 typedef struct element_s {
 //    int id;
+    int nodes[NODES_PER_ELEMENT];
     int color;
     int color_idx;
 
-    int nodes[NODES_PER_ELEMENT];
     int n;
-    double m;
     int filled;
-    int neighbors[8];
+    double m;
+} element_t;
+
+/* Element averages of particle fields (allocated on request). */
+typedef struct element_fields_s {
     double grad_x;
     double grad_y;
     double grad_mag;
@@ -59,15 +67,26 @@ typedef struct element_s {
 
     double p;
     double tau;
+} element_fields_t;
 
+/* Element stiffness and force for the implicit solver (allocated on request). */
+typedef struct element_implicit_s {
     double kku_element[NODAL_DOF * NODES_PER_ELEMENT][NODAL_DOF * NODES_PER_ELEMENT]; /* dof order: x1, y1, x2, y2 ... x4 , y4 ... c1, c2, ... c4 */
     double f_element[NODAL_DOF * NODES_PER_ELEMENT];
 
     double jacobian[2][2];
-} element_t;
+} element_implicit_t;
+
+/*
+    Convert the node number into coordinates (x,y) on a grid with Nx nodes
+    per row, spacing h and bottom left node at (x0, y0).
+*/
+void node_number_to_coords(double *x, double *y, int num, int Nx,
+    double x0, double y0, double h);
 
 /*
-    Convert the node number into coordinates (x,y).
+    Node numbers (counterclockwise from the bottom left) of element num on a
+    grid with Nx nodes per row.
 */
-void node_number_to_coords(double *x, double *y, int num, int N, double h);
+void element_node_numbers(int *nodes, int num, int Nx);
 #endif
@@ -6,8 +6,17 @@
     mpm_2d -- An implementation of the Material Point Method in 2D.
 */
 #include <stdio.h>
+#include <math.h>
 #include "interpolate.h"
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TENT_BATCH_X86
+#include <immintrin.h>
+#endif
+
+/* same snapping tolerance as global_to_local_coords. */
+#define TOL 1e-10
+
 #define SF_WARNING4(tok,xl,yl) \
     if (*tok > 1 || *tok < 0) { \
         fprintf(stderr, "warning, " #tok " = %g", *tok); \
@@ -65,3 +74,291 @@ void grad_tent(double * restrict b11, double * restrict b12, double * restrict b
 }
 /*----------------------------------------------------------------------------*/
 
+/*
+    The batch kernels compute entries [k, n) of the output. Each follows the
+    operation order of global_to_local_coords, tent and grad_tent exactly,
+    so every kernel gives bitwise identical results.
+*/
+typedef void (*tent_batch_fn)(const double * restrict x,
+    const double * restrict y,
+    const double * restrict x_ref, const double * restrict y_ref,
+    double h, size_t k, size_t n, const tent_batch_out_t *out);
+
+/*---tent_batch_scalar--------------------------------------------------------*/
+static void tent_batch_scalar(const double * restrict x,
+    const double * restrict y,
+    const double * restrict x_ref, const double * restrict y_ref,
+    double h, size_t k, size_t n, const tent_batch_out_t *out)
+{
+    const double dxl_dx = (1.0 / h);
+    const double dyl_dy = (1.0 / h);
+
+    for (; k < n; k++) {
+        double xl = (x[k] - x_ref[k]) / h;
+        const double xl_sgn = copysign(1.0, xl);
+        if ((xl_sgn * xl) > 1.0 && ((xl_sgn * xl) - 1.0) < TOL) {
+            xl = xl_sgn;
+        }
+
+        double yl = (y[k] - y_ref[k]) / h;
+        const double yl_sgn = copysign(1.0, yl);
+        if ((yl_sgn * yl) > 1.0 && ((yl_sgn * yl) - 1.0) < TOL) {
+            yl = yl_sgn;
+        }
+
+        out->xl[k] = xl;
+        out->yl[k] = yl;
+
+        out->h1[k] = (1 - xl) * (1 - yl);
+        out->h2[k] = (xl) * (1 - yl);
+        out->h3[k] = (xl) * (yl);
+        out->h4[k] = (1 - xl) * (yl);
+
+        out->b11[k] = -(1 - yl) * dxl_dx;
+        out->b12[k] = (1 - yl) * dxl_dx;
+        out->b13[k] = (yl) * dxl_dx;
+        out->b14[k] = -(yl) * dxl_dx;
+
+        out->b21[k] = -(1 - xl) * dyl_dy;
+        out->b22[k] = -(xl) * dyl_dy;
+        out->b23[k] = (xl) * dyl_dy;
+        out->b24[k] = (1 - xl) * dyl_dy;
+    }
+
+    return;
+}
+/*----------------------------------------------------------------------------*/
+
+#ifdef TENT_BATCH_X86
+/*---tent_batch_avx2----------------------------------------------------------*/
+/* Snap coordinates just past +/-1 back onto the element edge. */
+__attribute__((target("avx2")))
+static inline __m256d snap_local_avx2(__m256d v)
+{
+    const __m256d one = _mm256_set1_pd(1.0);
+    const __m256d tol = _mm256_set1_pd(TOL);
+    const __m256d sign = _mm256_set1_pd(-0.0);
+
+    const __m256d a = _mm256_andnot_pd(sign, v);
+    const __m256d v_sgn = _mm256_or_pd(_mm256_and_pd(sign, v), one);
+    const __m256d m = _mm256_and_pd(
+        _mm256_cmp_pd(a, one, _CMP_GT_OQ),
+        _mm256_cmp_pd(_mm256_sub_pd(a, one), tol, _CMP_LT_OQ));
+
+    return _mm256_blendv_pd(v, v_sgn, m);
+}
+
+__attribute__((target("avx2")))
+static void tent_batch_avx2(const double * restrict x,
+    const double * restrict y,
+    const double * restrict x_ref, const double * restrict y_ref,
+    double h, size_t k, size_t n, const tent_batch_out_t *out)
+{
+    const __m256d one = _mm256_set1_pd(1.0);
+    const __m256d sign = _mm256_set1_pd(-0.0);
+    const __m256d hv = _mm256_set1_pd(h);
+    const __m256d d = _mm256_set1_pd(1.0 / h);
+
+    for (; k + 4 <= n; k += 4) {
+        const __m256d xl = snap_local_avx2(_mm256_div_pd(
+            _mm256_sub_pd(_mm256_loadu_pd(x + k), _mm256_loadu_pd(x_ref + k)),
+            hv));
+        const __m256d yl = snap_local_avx2(_mm256_div_pd(
+            _mm256_sub_pd(_mm256_loadu_pd(y + k), _mm256_loadu_pd(y_ref + k)),
+            hv));
+        const __m256d xr = _mm256_sub_pd(one, xl);
+        const __m256d yr = _mm256_sub_pd(one, yl);
+
+        _mm256_storeu_pd(out->xl + k, xl);
+        _mm256_storeu_pd(out->yl + k, yl);
+
+        _mm256_storeu_pd(out->h1 + k, _mm256_mul_pd(xr, yr));
+        _mm256_storeu_pd(out->h2 + k, _mm256_mul_pd(xl, yr));
+        _mm256_storeu_pd(out->h3 + k, _mm256_mul_pd(xl, yl));
+        _mm256_storeu_pd(out->h4 + k, _mm256_mul_pd(xr, yl));
+
+        const __m256d yr_d = _mm256_mul_pd(yr, d);
+        const __m256d yl_d = _mm256_mul_pd(yl, d);
+        const __m256d xr_d = _mm256_mul_pd(xr, d);
+        const __m256d xl_d = _mm256_mul_pd(xl, d);
+
+        _mm256_storeu_pd(out->b11 + k, _mm256_xor_pd(yr_d, sign));
+        _mm256_storeu_pd(out->b12 + k, yr_d);
+        _mm256_storeu_pd(out->b13 + k, yl_d);
+        _mm256_storeu_pd(out->b14 + k, _mm256_xor_pd(yl_d, sign));
+
+        _mm256_storeu_pd(out->b21 + k, _mm256_xor_pd(xr_d, sign));
+        _mm256_storeu_pd(out->b22 + k, _mm256_xor_pd(xl_d, sign));
+        _mm256_storeu_pd(out->b23 + k, xl_d);
+        _mm256_storeu_pd(out->b24 + k, xr_d);
+    }
+
+    tent_batch_scalar(x, y, x_ref, y_ref, h, k, n, out);
+
+    return;
+}
+/*----------------------------------------------------------------------------*/
+
+/*---tent_batch_avx512--------------------------------------------------------*/
+/* AVX-512F only has bitwise ops on integer vectors. */
+#define PD_AND(a,b) _mm512_castsi512_pd(_mm512_and_si512( \
+    _mm512_castpd_si512(a), _mm512_castpd_si512(b)))
+#define PD_OR(a,b) _mm512_castsi512_pd(_mm512_or_si512( \
+    _mm512_castpd_si512(a), _mm512_castpd_si512(b)))
+#define PD_XOR(a,b) _mm512_castsi512_pd(_mm512_xor_si512( \
+    _mm512_castpd_si512(a), _mm512_castpd_si512(b)))
+
+__attribute__((target("avx512f")))
+static inline __m512d snap_local_avx512(__m512d v)
+{
+    const __m512d one = _mm512_set1_pd(1.0);
+    const __m512d tol = _mm512_set1_pd(TOL);
+    const __m512d sign = _mm512_set1_pd(-0.0);
+
+    const __m512d a = _mm512_abs_pd(v);
+    const __m512d v_sgn = PD_OR(PD_AND(sign, v), one);
+    const __mmask8 m = _mm512_cmp_pd_mask(a, one, _CMP_GT_OQ)
+        & _mm512_cmp_pd_mask(_mm512_sub_pd(a, one), tol, _CMP_LT_OQ);
+
+    return _mm512_mask_blend_pd(m, v, v_sgn);
+}
+
+__attribute__((target("avx512f")))
+static void tent_batch_avx512(const double * restrict x,
+    const double * restrict y,
+    const double * restrict x_ref, const double * restrict y_ref,
+    double h, size_t k, size_t n, const tent_batch_out_t *out)
+{
+    const __m512d one = _mm512_set1_pd(1.0);
+    const __m512d sign = _mm512_set1_pd(-0.0);
+    const __m512d hv = _mm512_set1_pd(h);
+    const __m512d d = _mm512_set1_pd(1.0 / h);
+
+    for (; k + 8 <= n; k += 8) {
+        const __m512d xl = snap_local_avx512(_mm512_div_pd(
+            _mm512_sub_pd(_mm512_loadu_pd(x + k), _mm512_loadu_pd(x_ref + k)),
+            hv));
+        const __m512d yl = snap_local_avx512(_mm512_div_pd(
+            _mm512_sub_pd(_mm512_loadu_pd(y + k), _mm512_loadu_pd(y_ref + k)),
+            hv));
+        const __m512d xr = _mm512_sub_pd(one, xl);
+        const __m512d yr = _mm512_sub_pd(one, yl);
+
+        _mm512_storeu_pd(out->xl + k, xl);
+        _mm512_storeu_pd(out->yl + k, yl);
+
+        _mm512_storeu_pd(out->h1 + k, _mm512_mul_pd(xr, yr));
+        _mm512_storeu_pd(out->h2 + k, _mm512_mul_pd(xl, yr));
+        _mm512_storeu_pd(out->h3 + k, _mm512_mul_pd(xl, yl));
+        _mm512_storeu_pd(out->h4 + k, _mm512_mul_pd(xr, yl));
+
+        const __m512d yr_d = _mm512_mul_pd(yr, d);
+        const __m512d yl_d = _mm512_mul_pd(yl, d);
+        const __m512d xr_d = _mm512_mul_pd(xr, d);
+        const __m512d xl_d = _mm512_mul_pd(xl, d);
+
+        _mm512_storeu_pd(out->b11 + k, PD_XOR(yr_d, sign));
+        _mm512_storeu_pd(out->b12 + k, yr_d);
+        _mm512_storeu_pd(out->b13 + k, yl_d);
+        _mm512_storeu_pd(out->b14 + k, PD_XOR(yl_d, sign));
+
+        _mm512_storeu_pd(out->b21 + k, PD_XOR(xr_d, sign));
+        _mm512_storeu_pd(out->b22 + k, PD_XOR(xl_d, sign));
+        _mm512_storeu_pd(out->b23 + k, xl_d);
+        _mm512_storeu_pd(out->b24 + k, xr_d);
+    }
+
+    tent_batch_scalar(x, y, x_ref, y_ref, h, k, n, out);
+
+    return;
+}
+
+#undef PD_AND
+#undef PD_OR
+#undef PD_XOR
+/*----------------------------------------------------------------------------*/
+#endif
+
+static tent_batch_fn tent_batch_kernel = NULL;
+static enum tent_batch_isa_e tent_batch_isa = TENT_BATCH_SCALAR;
+
+static const char *tent_batch_isa_names[TENT_BATCH_NUM_ISA] = {
+    "auto", "scalar", "avx2", "avx512"
+};
+
+/*---tent_batch_set_isa-------------------------------------------------------*/
+int tent_batch_set_isa(enum tent_batch_isa_e isa)
+{
+    int have_avx2 = 0;
+    int have_avx512 = 0;
+
+#ifdef TENT_BATCH_X86
+    __builtin_cpu_init();
+    have_avx2 = __builtin_cpu_supports("avx2");
+    have_avx512 = __builtin_cpu_supports("avx512f");
+#endif
+
+    if (isa == TENT_BATCH_AUTO) {
+        if (have_avx512) {
+            isa = TENT_BATCH_AVX512;
+        } else if (have_avx2) {
+            isa = TENT_BATCH_AVX2;
+        } else {
+            isa = TENT_BATCH_SCALAR;
+        }
+    }
+
+    switch (isa) {
+        case TENT_BATCH_SCALAR:
+            tent_batch_kernel = &tent_batch_scalar;
+            break;
+#ifdef TENT_BATCH_X86
+        case TENT_BATCH_AVX2:
+            if (!have_avx2) {
+                return -1;
+            }
+            tent_batch_kernel = &tent_batch_avx2;
+            break;
+        case TENT_BATCH_AVX512:
+            if (!have_avx512) {
+                return -1;
+            }
+            tent_batch_kernel = &tent_batch_avx512;
+            break;
+#endif
+        default:
+            return -1;
+    }
+    tent_batch_isa = isa;
+
+    return 0;
+}
+/*----------------------------------------------------------------------------*/
+
+/*---tent_batch_isa_name------------------------------------------------------*/
+const char *tent_batch_isa_name(void)
+{
+    if (tent_batch_kernel == NULL) {
+        tent_batch_set_isa(TENT_BATCH_AUTO);
+    }
+
+    return tent_batch_isa_names[tent_batch_isa];
+}
+/*----------------------------------------------------------------------------*/
+
+/*---tent_batch---------------------------------------------------------------*/
+void tent_batch(const double * restrict x, const double * restrict y,
+    const double * restrict x_ref, const double * restrict y_ref,
+    double h, size_t n, const tent_batch_out_t *out)
+{
+    /* every thread picks the same kernel, so racing here is harmless. */
+    if (tent_batch_kernel == NULL) {
+        tent_batch_set_isa(TENT_BATCH_AUTO);
+    }
+
+    (*tent_batch_kernel)(x, y, x_ref, y_ref, h, 0, n, out);
+
+    return;
+}
+/*----------------------------------------------------------------------------*/
+
@@ -7,6 +7,7 @@
 */
 #ifndef __INTERPOLATE_H__
 #define __INTERPOLATE_H__
+#include <stddef.h>
 
 void tent(double * restrict h1, double * restrict h2, double * restrict h3, double * restrict h4,
     double x_local, double y_local);
@@ -15,5 +16,57 @@ void grad_tent(double * restrict b11, double * restrict b12, double * restrict b
     double * restrict b21, double * restrict b22, double * restrict b23, double * restrict b24,
     double x_local, double y_local, double h);
 
+/*
+    Output arrays for tent_batch. Each pointer refers to the first of n
+    entries; entry k belongs to input k.
+*/
+typedef struct tent_batch_out_s {
+    double *xl;
+    double *yl;
+
+    double *h1;
+    double *h2;
+    double *h3;
+    double *h4;
+
+    double *b11;
+    double *b12;
+    double *b13;
+    double *b14;
+
+    double *b21;
+    double *b22;
+    double *b23;
+    double *b24;
+} tent_batch_out_t;
+
+enum tent_batch_isa_e {
+    TENT_BATCH_AUTO=0,
+    TENT_BATCH_SCALAR,
+    TENT_BATCH_AVX2,
+    TENT_BATCH_AVX512,
+    TENT_BATCH_NUM_ISA
+};
+
+/*
+    Local coordinates, shape functions and gradients of shape functions for n
+    points at (x[k], y[k]) in elements of size h with bottom left node at
+    (x_ref[k], y_ref[k]). Gives the same results as global_to_local_coords,
+    tent and grad_tent, without the range warnings.
+
+    The vector width is picked once at runtime from the cpu features, 4
+    points at a time with AVX2, 8 with AVX-512, otherwise one at a time.
+*/
+void tent_batch(const double * restrict x, const double * restrict y,
+    const double * restrict x_ref, const double * restrict y_ref,
+    double h, size_t n, const tent_batch_out_t *out);
+
+/*
+    Force the kernel used by tent_batch (TENT_BATCH_AUTO picks the widest
+    supported one). Returns 0 on success, -1 if the cpu can't run it.
+*/
+int tent_batch_set_isa(enum tent_batch_isa_e isa);
+const char *tent_batch_isa_name(void);
+
 #endif
 
@@ -21,9 +21,9 @@
 void initial_loads(job_t *job)
 {
     for (size_t i = 0; i < job->num_particles; i++) {
-        job->particles[i].bx = 0;
-        job->particles[i].by = 0;
-        job->particles[i].material = M_DRUCKER_PRAGER;
+        job->particles.bx[i] = 0;
+        job->particles.by[i] = 0;
+        job->particles.material[i] = M_DRUCKER_PRAGER;
     }
 
     return;
@@ -44,8 +44,8 @@ void time_varying_loads(job_t *job)
             }
 
             for (size_t i = 0; i < job->num_particles; i++) {
-                job->particles[i].bx = 0;
-                job->particles[i].by = gravity;
+                job->particles.bx[i] = 0;
+                job->particles.by[i] = gravity;
             }
         break;
     }
@@ -11,24 +11,13 @@
 /* IMPORTANT: Does not clear nodal quantites before accumulating! */
 /*---Maps scalars of type double to nodes. Uses shape functions.--------------*/
 void map_particles_to_nodes_doublescalar(job_t *job,
-    const size_t node_field_offset, const size_t particle_field_offset)
+    double * restrict node_field, const double * restrict particle_field)
 {
     size_t i, j;
-    double * restrict ndata;
-    double * restrict pdata;
     int * restrict n_idx;
     double s[NODES_PER_ELEMENT];
 
-    for (i = 0; i < job->num_particles; i++) {
-        if (job->active[i] == 0) {
-            continue;
-        }
-
-        /* 
-            Bit of a hack, but should work. If C had reflection, this wouldn't be
-            an issue.
-        */
-        pdata = (double *)((char *)&(job->particles[i]) + particle_field_offset);
+    for (i = 0; i < job->num_active; i++) {
         n_idx = job->elements[job->in_element[i]].nodes;
 
         /* Really gotta clean the organization up, but use this for now. */
@@ -38,8 +27,7 @@ void map_particles_to_nodes_doublescalar(job_t *job,
         s[3] = job->h4[i];
 
         for (j = 0; j < NODES_PER_ELEMENT; j++) {
-            ndata = (double *)((char *)&(job->nodes[n_idx[j]]) + node_field_offset);
-            *ndata += s[j] * (*pdata);
+            node_field[n_idx[j]] += s[j] * particle_field[i];
         }
     }
 
@@ -47,35 +35,29 @@ void map_particles_to_nodes_doublescalar(job_t *job,
 }
 /*----------------------------------------------------------------------------*/
 /*---Accumulates scalars of type double to nodes. Inner loop of the map.------*/
-void accumulate_p_to_n_doublescalar(node_t *nodes,
-    const size_t node_field_offset, const int * restrict nodelist, const double * restrict sfvalues, 
+void accumulate_p_to_n_doublescalar(double * restrict node_field,
+    const int * restrict nodelist, const double * restrict sfvalues,
     const size_t nodelist_len, const double pdata)
 {
     size_t i;
-    double * restrict ndata;
 
     for (i = 0; i < nodelist_len; i++) {
-        ndata = (double *)((char *)&(nodes[nodelist[i]]) + node_field_offset);
-        *ndata += sfvalues[i] * pdata;
+        node_field[nodelist[i]] += sfvalues[i] * pdata;
     }
 
     return;
 }
 /*----------------------------------------------------------------------------*/
 /*---Accumulates a list of scalars of type double to nodes.  -----------------*/
-void accumulate_p_to_n_ds_list(node_t *nodes,
-    const size_t * restrict node_field_offset, const int * restrict nodelist, const double * restrict sfvalues, 
+void accumulate_p_to_n_ds_list(double * const * node_fields,
+    const int * restrict nodelist, const double * restrict sfvalues,
     const size_t nodelist_len, const double * restrict pdata, const size_t pdata_len)
 {
     size_t i, j;
-    double * restrict ndata;
-    char * restrict nodeoff;
 
     for (i = 0; i < nodelist_len; i++) {
-        nodeoff = (char *)&(nodes[nodelist[i]]);
         for (j = 0; j < pdata_len; j++) {
-            ndata = (double *)(nodeoff + node_field_offset[j]);
-            *ndata += sfvalues[i] * pdata[j];
+            node_fields[j][nodelist[i]] += sfvalues[i] * pdata[j];
         }
     }
 
@@ -83,24 +65,23 @@ void accumulate_p_to_n_ds_list(node_t *nodes,
 }
 
 #define FIXED_ACCUMULATE_DOUBLE_LIST(Nn,Np) \
-void accumulate_p_to_n_ds_list##Nn##Np(node_t *nodes, \
-    const size_t * restrict node_field_offset, const int * restrict nodelist, const double * restrict sfvalues, \
+void accumulate_p_to_n_ds_list##Nn##Np(double * const * node_fields, \
+    const int * restrict nodelist, const double * restrict sfvalues, \
     const double * restrict pdata) \
 { \
     size_t i, j; \
-    double * restrict ndata; \
-    char * restrict nodeoff; \
     for (i = 0; i < Nn; i++) { \
-        nodeoff = (char *)&(nodes[nodelist[i]]); \
         for (j = 0; j < Np; j++) { \
-            ndata = (double *)(nodeoff + node_field_offset[j]); \
-            *ndata += sfvalues[i] * pdata[j]; \
+            node_fields[j][nodelist[i]] += sfvalues[i] * pdata[j]; \
         } \
     } \
     return; \
 }
 
+FIXED_ACCUMULATE_DOUBLE_LIST(4,1)
 FIXED_ACCUMULATE_DOUBLE_LIST(4,2)
+FIXED_ACCUMULATE_DOUBLE_LIST(4,3)
+FIXED_ACCUMULATE_DOUBLE_LIST(4,4)
 FIXED_ACCUMULATE_DOUBLE_LIST(4,7)
 
 /*----------------------------------------------------------------------------*/
@@ -11,19 +11,32 @@
 #include <stddef.h>
 
 /* double scalar arguments */
+/*
+    particle_field is a per-particle array from the particle store and
+    node_field(s) are per-node arrays from the node store.
+*/
 void map_particles_to_nodes_doublescalar(job_t *job,
-    const size_t node_field_offset, const size_t particle_field_offset);
-void accumulate_p_to_n_doublescalar(node_t *nodes,
-    const size_t node_field_offset, const int * restrict nodelist, const double * restrict sfvalues, 
+    double * restrict node_field, const double * restrict particle_field);
+void accumulate_p_to_n_doublescalar(double * restrict node_field,
+    const int * restrict nodelist, const double * restrict sfvalues,
     const size_t nodelist_len, const double pdata);
-void accumulate_p_to_n_ds_list(node_t *nodes,
-    const size_t * restrict node_field_offset, const int * restrict nodelist, const double * restrict sfvalues, 
+void accumulate_p_to_n_ds_list(double * const * node_fields,
+    const int * restrict nodelist, const double * restrict sfvalues,
     const size_t nodelist_len, const double * restrict pdata, const size_t pdata_len);
-void accumulate_p_to_n_ds_list47(node_t *nodes,
-    const size_t * restrict node_field_offset, const int * restrict nodelist, const double * restrict sfvalues,
+void accumulate_p_to_n_ds_list47(double * const * node_fields,
+    const int * restrict nodelist, const double * restrict sfvalues,
+    const double * restrict pdata);
+void accumulate_p_to_n_ds_list41(double * const * node_fields,
+    const int * restrict nodelist, const double * restrict sfvalues,
+    const double * restrict pdata);
+void accumulate_p_to_n_ds_list42(double * const * node_fields,
+    const int * restrict nodelist, const double * restrict sfvalues,
+    const double * restrict pdata);
+void accumulate_p_to_n_ds_list43(double * const * node_fields,
+    const int * restrict nodelist, const double * restrict sfvalues,
     const double * restrict pdata);
-void accumulate_p_to_n_ds_list42(node_t *nodes,
-    const size_t * restrict node_field_offset, const int * restrict nodelist, const double * restrict sfvalues, 
+void accumulate_p_to_n_ds_list44(double * const * node_fields,
+    const int * restrict nodelist, const double * restrict sfvalues,
     const double * restrict pdata);
 #endif
 
@@ -20,7 +20,7 @@ void material_init_linear_elastic(job_t *job)
     // clear state variables
     for (size_t i = 0; i < job->num_particles; i++) {
         for (size_t j = 0; j < DEPVAR; j++) {
-            job->particles[i].state[j] = 0;
+            job->particles.state[i][j] = 0;
         }
     }
 
@@ -35,22 +35,18 @@ void calculate_stress_linear_elastic(job_t *job)
     double dsjxy;
     double dsjyy;
 
-    for (size_t i = 0; i < job->num_particles; i++) {
-        if (job->active[i] == 0) {
-            continue;
-        }
-
-        dsjxx = job->dt * (EMOD / (1 - NUMOD*NUMOD)) * ((job->particles[i].exx_t) + NUMOD * (job->particles[i].eyy_t));
-        dsjxy = job->dt * (EMOD / (2 *(1 + NUMOD))) * (job->particles[i].exy_t);
-        dsjyy = job->dt * (EMOD / (1 - NUMOD*NUMOD)) * ((job->particles[i].eyy_t) + NUMOD * (job->particles[i].exx_t));
+    for (size_t i = 0; i < job->num_active; i++) {
+        dsjxx = job->dt * (EMOD / (1 - NUMOD*NUMOD)) * ((job->particles.exx_t[i]) + NUMOD * (job->particles.eyy_t[i]));
+        dsjxy = job->dt * (EMOD / (2 *(1 + NUMOD))) * (job->particles.exy_t[i]);
+        dsjyy = job->dt * (EMOD / (1 - NUMOD*NUMOD)) * ((job->particles.eyy_t[i]) + NUMOD * (job->particles.exx_t[i]));
 
-        dsjxx += 2 * job->dt * job->particles[i].wxy_t * job->particles[i].sxy;
-        dsjxy -= job->dt * job->particles[i].wxy_t * (job->particles[i].sxx - job->particles[i].syy);
-        dsjyy -= 2 * job->dt * job->particles[i].wxy_t * job->particles[i].sxy;
+        dsjxx += 2 * job->dt * job->particles.wxy_t[i] * job->particles.sxy[i];
+        dsjxy -= job->dt * job->particles.wxy_t[i] * (job->particles.sxx[i] - job->particles.syy[i]);
+        dsjyy -= 2 * job->dt * job->particles.wxy_t[i] * job->particles.sxy[i];
 
-        job->particles[i].sxx = job->particles[i].sxx + dsjxx;
-        job->particles[i].sxy = job->particles[i].sxy + dsjxy;
-        job->particles[i].syy = job->particles[i].syy + dsjyy;
+        job->particles.sxx[i] = job->particles.sxx[i] + dsjxx;
+        job->particles.sxy[i] = job->particles.sxy[i] + dsjxy;
+        job->particles.syy[i] = job->particles.syy[i] + dsjyy;
     }
 
     return;
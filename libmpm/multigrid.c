@@ -0,0 +1,431 @@
+/**
+    \file multigrid.c
+    \author Sachith Dunatunga
+    \date 17.10.2026
+
+    mpm_2d -- An implementation of the Material Point Method in 2D.
+*/
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "multigrid.h"
+
+/*
+    Coarse nodes fine index i interpolates from, and their weights. The last
+    fine node of an even length row has only one coarse neighbor.
+*/
+static int parents(size_t i, size_t nc, size_t *c, double *w)
+{
+    if (i % 2 == 0) {
+        c[0] = i / 2;
+        w[0] = 1;
+        return 1;
+    }
+
+    if ((i + 1) / 2 < nc) {
+        c[0] = (i - 1) / 2;
+        w[0] = 0.5;
+        c[1] = (i + 1) / 2;
+        w[1] = 0.5;
+        return 2;
+    }
+
+    c[0] = (i - 1) / 2;
+    w[0] = 1;
+    return 1;
+}
+
+static size_t coarse_size(size_t n)
+{
+    return (n - 1) / 2 + 1;
+}
+
+/* sum of the off diagonal stencil entries times x around node (i, j). */
+static double off_diagonal(const mg_level_t *l, size_t i, size_t j)
+{
+    const double *a = l->a + 9 * (j * l->nx + i);
+    double s = 0;
+    int dx, dy;
+
+    for (dy = -1; dy <= 1; dy++) {
+        if ((dy < 0 && j == 0) || (dy > 0 && j + 1 == l->ny)) {
+            continue;
+        }
+        for (dx = -1; dx <= 1; dx++) {
+            if ((dx < 0 && i == 0) || (dx > 0 && i + 1 == l->nx)
+                || (dx == 0 && dy == 0)) {
+                continue;
+            }
+            s += a[MG_STENCIL(dx, dy)] * l->x[(j + dy) * l->nx + (i + dx)];
+        }
+    }
+
+    return s;
+}
+
+/* Four color Gauss-Seidel, colors in reverse order if reverse is set. */
+static void smooth(mg_level_t *l, int reverse)
+{
+    size_t i, j, k;
+    int color, c;
+
+    for (c = 0; c < 4; c++) {
+        color = reverse ? (3 - c) : c;
+        for (j = color / 2; j < l->ny; j += 2) {
+            for (i = color % 2; i < l->nx; i += 2) {
+                k = j * l->nx + i;
+                if (l->active[k]) {
+                    l->x[k] = (l->b[k] - off_diagonal(l, i, j))
+                        / l->a[9 * k + MG_STENCIL(0, 0)];
+                }
+            }
+        }
+    }
+
+    return;
+}
+
+static void residual(mg_level_t *l)
+{
+    size_t i, j, k;
+
+    for (j = 0; j < l->ny; j++) {
+        for (i = 0; i < l->nx; i++) {
+            k = j * l->nx + i;
+            if (l->active[k]) {
+                l->r[k] = l->b[k] - off_diagonal(l, i, j)
+                    - l->a[9 * k + MG_STENCIL(0, 0)] * l->x[k];
+            } else {
+                l->r[k] = 0;
+            }
+        }
+    }
+
+    return;
+}
+
+/* Galerkin operator of coarse level c from fine level f. */
+static void coarsen(const mg_level_t *f, mg_level_t *c)
+{
+    size_t i, j, k, gi, gj, pi, pj, qi, qj;
+    size_t ci[2], cj[2], di[2], dj[2];
+    double wi[2], wj[2], vi[2], vj[2];
+    int ni, nj, mi, mj, dx, dy;
+    double a;
+
+    memset(c->a, 0, 9 * c->n * sizeof(double));
+
+    for (j = 0; j < f->ny; j++) {
+        nj = parents(j, c->ny, cj, wj);
+        for (i = 0; i < f->nx; i++) {
+            k = j * f->nx + i;
+            if (!f->active[k]) {
+                continue;
+            }
+            ni = parents(i, c->nx, ci, wi);
+
+            for (dy = -1; dy <= 1; dy++) {
+                if ((dy < 0 && j == 0) || (dy > 0 && j + 1 == f->ny)) {
+                    continue;
+                }
+                gj = j + dy;
+                mj = parents(gj, c->ny, dj, vj);
+                for (dx = -1; dx <= 1; dx++) {
+                    if ((dx < 0 && i == 0) || (dx > 0 && i + 1 == f->nx)) {
+                        continue;
+                    }
+                    gi = i + dx;
+                    a = f->a[9 * k + MG_STENCIL(dx, dy)];
+                    if (a == 0 || !f->active[gj * f->nx + gi]) {
+                        continue;
+                    }
+                    mi = parents(gi, c->nx, di, vi);
+
+                    /* bilinear weights keep the coarse offsets in [-1, 1]. */
+                    for (pj = 0; pj < (size_t)nj; pj++) {
+                    for (pi = 0; pi < (size_t)ni; pi++) {
+                        for (qj = 0; qj < (size_t)mj; qj++) {
+                        for (qi = 0; qi < (size_t)mi; qi++) {
+                            c->a[9 * (cj[pj] * c->nx + ci[pi])
+                                + MG_STENCIL((int)di[qi] - (int)ci[pi],
+                                    (int)dj[qj] - (int)cj[pj])]
+                                += wj[pj] * wi[pi] * a * vj[qj] * vi[qi];
+                        }
+                        }
+                    }
+                    }
+                }
+            }
+        }
+    }
+
+    for (k = 0; k < c->n; k++) {
+        c->active[k] = (c->a[9 * k + MG_STENCIL(0, 0)] > 0);
+    }
+
+    return;
+}
+
+/* b_c = P^T r_f. */
+static void restrict_residual(const mg_level_t *f, mg_level_t *c)
+{
+    size_t i, j, k, pi, pj;
+    size_t ci[2], cj[2];
+    double wi[2], wj[2];
+    int ni, nj;
+
+    memset(c->b, 0, c->n * sizeof(double));
+
+    for (j = 0; j < f->ny; j++) {
+        nj = parents(j, c->ny, cj, wj);
+        for (i = 0; i < f->nx; i++) {
+            k = j * f->nx + i;
+            if (!f->active[k]) {
+                continue;
+            }
+            ni = parents(i, c->nx, ci, wi);
+            for (pj = 0; pj < (size_t)nj; pj++) {
+                for (pi = 0; pi < (size_t)ni; pi++) {
+                    c->b[cj[pj] * c->nx + ci[pi]] += wj[pj] * wi[pi] * f->r[k];
+                }
+            }
+        }
+    }
+
+    return;
+}
+
+/* x_f += P x_c. */
+static void prolong_correction(mg_level_t *f, const mg_level_t *c)
+{
+    size_t i, j, k, pi, pj;
+    size_t ci[2], cj[2];
+    double wi[2], wj[2];
+    int ni, nj;
+
+    for (j = 0; j < f->ny; j++) {
+        nj = parents(j, c->ny, cj, wj);
+        for (i = 0; i < f->nx; i++) {
+            k = j * f->nx + i;
+            if (!f->active[k]) {
+                continue;
+            }
+            ni = parents(i, c->nx, ci, wi);
+            for (pj = 0; pj < (size_t)nj; pj++) {
+                for (pi = 0; pi < (size_t)ni; pi++) {
+                    f->x[k] += wj[pj] * wi[pi] * c->x[cj[pj] * c->nx + ci[pi]];
+                }
+            }
+        }
+    }
+
+    return;
+}
+
+static void coarse_solve(mg_t *mg)
+{
+    mg_level_t *l = &(mg->levels[mg->num_levels - 1]);
+    const size_t n = mg->num_coarse;
+    const double *L = mg->coarse_factor;
+    double *y = l->r;
+    size_t p, q;
+    double s;
+
+    memset(l->x, 0, l->n * sizeof(double));
+
+    for (p = 0; p < n; p++) {
+        s = l->b[mg->coarse_nodes[p]];
+        for (q = 0; q < p; q++) {
+            s -= L[p * n + q] * y[q];
+        }
+        y[p] = s / L[p * n + p];
+    }
+    for (p = n; p-- > 0; ) {
+        s = y[p];
+        for (q = p + 1; q < n; q++) {
+            s -= L[q * n + p] * y[q];
+        }
+        y[p] = s / L[p * n + p];
+    }
+
+    for (p = 0; p < n; p++) {
+        l->x[mg->coarse_nodes[p]] = y[p];
+    }
+
+    return;
+}
+
+static void vcycle(mg_t *mg, size_t level)
+{
+    mg_level_t *l = &(mg->levels[level]);
+    int s;
+
+    if (level + 1 == mg->num_levels) {
+        coarse_solve(mg);
+        return;
+    }
+
+    memset(l->x, 0, l->n * sizeof(double));
+    for (s = 0; s < mg->pre_sweeps; s++) {
+        smooth(l, 0);
+    }
+
+    residual(l);
+    restrict_residual(l, &(mg->levels[level + 1]));
+    vcycle(mg, level + 1);
+    prolong_correction(l, &(mg->levels[level + 1]));
+
+    for (s = 0; s < mg->post_sweeps; s++) {
+        smooth(l, 1);
+    }
+
+    return;
+}
+
+/*---mg_init------------------------------------------------------------------*/
+int mg_init(mg_t *mg, size_t nx, size_t ny)
+{
+    size_t k, lx, ly;
+    mg_level_t *l;
+
+    memset(mg, 0, sizeof(mg_t));
+    mg->pre_sweeps = 2;
+    mg->post_sweeps = 2;
+
+    mg->num_levels = 1;
+    lx = nx;
+    ly = ny;
+    while (lx * ly > MG_COARSE_NODES && (lx > 1 || ly > 1)) {
+        lx = coarse_size(lx);
+        ly = coarse_size(ly);
+        mg->num_levels++;
+    }
+
+    mg->levels = (mg_level_t *)calloc(mg->num_levels, sizeof(mg_level_t));
+    if (mg->levels == NULL) {
+        return -1;
+    }
+
+    lx = nx;
+    ly = ny;
+    for (k = 0; k < mg->num_levels; k++) {
+        l = &(mg->levels[k]);
+        l->nx = lx;
+        l->ny = ly;
+        l->n = lx * ly;
+        l->a = (double *)calloc(9 * l->n, sizeof(double));
+        l->active = (unsigned char *)calloc(l->n, sizeof(unsigned char));
+        l->x = (double *)calloc(l->n, sizeof(double));
+        l->b = (double *)calloc(l->n, sizeof(double));
+        l->r = (double *)calloc(l->n, sizeof(double));
+        if (l->a == NULL || l->active == NULL || l->x == NULL
+            || l->b == NULL || l->r == NULL) {
+            mg_free(mg);
+            return -1;
+        }
+        lx = coarse_size(lx);
+        ly = coarse_size(ly);
+    }
+
+    l = &(mg->levels[mg->num_levels - 1]);
+    mg->coarse_nodes = (size_t *)malloc(l->n * sizeof(size_t));
+    mg->coarse_factor = (double *)malloc(l->n * l->n * sizeof(double));
+    if (mg->coarse_nodes == NULL || mg->coarse_factor == NULL) {
+        mg_free(mg);
+        return -1;
+    }
+
+    return 0;
+}
+/*----------------------------------------------------------------------------*/
+
+/*---mg_free------------------------------------------------------------------*/
+void mg_free(mg_t *mg)
+{
+    size_t k;
+
+    for (k = 0; mg->levels != NULL && k < mg->num_levels; k++) {
+        free(mg->levels[k].a);
+        free(mg->levels[k].active);
+        free(mg->levels[k].x);
+        free(mg->levels[k].b);
+        free(mg->levels[k].r);
+    }
+    free(mg->levels);
+    free(mg->coarse_nodes);
+    free(mg->coarse_factor);
+
+    memset(mg, 0, sizeof(mg_t));
+
+    return;
+}
+/*----------------------------------------------------------------------------*/
+
+/*---mg_setup-----------------------------------------------------------------*/
+int mg_setup(mg_t *mg)
+{
+    mg_level_t *l;
+    size_t k, p, q, n;
+    long dx, dy;
+    double *L;
+    double s;
+
+    for (k = 0; k + 1 < mg->num_levels; k++) {
+        coarsen(&(mg->levels[k]), &(mg->levels[k + 1]));
+    }
+
+    l = &(mg->levels[mg->num_levels - 1]);
+    n = 0;
+    for (k = 0; k < l->n; k++) {
+        if (l->active[k]) {
+            mg->coarse_nodes[n++] = k;
+        }
+    }
+    mg->num_coarse = n;
+
+    L = mg->coarse_factor;
+    for (p = 0; p < n; p++) {
+        for (q = 0; q < n; q++) {
+            dx = (long)(mg->coarse_nodes[q] % l->nx)
+                - (long)(mg->coarse_nodes[p] % l->nx);
+            dy = (long)(mg->coarse_nodes[q] / l->nx)
+                - (long)(mg->coarse_nodes[p] / l->nx);
+            if (labs(dx) <= 1 && labs(dy) <= 1) {
+                L[p * n + q] = l->a[9 * mg->coarse_nodes[p]
+                    + MG_STENCIL((int)dx, (int)dy)];
+            } else {
+                L[p * n + q] = 0;
+            }
+        }
+    }
+
+    /* in place, lower triangle. */
+    for (p = 0; p < n; p++) {
+        for (q = 0; q <= p; q++) {
+            s = L[p * n + q];
+            for (k = 0; k < q; k++) {
+                s -= L[p * n + k] * L[q * n + k];
+            }
+            if (p == q) {
+                if (!(s > 0)) {
+                    return -1;
+                }
+                L[p * n + p] = sqrt(s);
+            } else {
+                L[p * n + q] = s / L[q * n + q];
+            }
+        }
+    }
+
+    return 0;
+}
+/*----------------------------------------------------------------------------*/
+
+/*---mg_vcycle----------------------------------------------------------------*/
+void mg_vcycle(mg_t *mg)
+{
+    vcycle(mg, 0);
+    return;
+}
+/*----------------------------------------------------------------------------*/
+
@@ -0,0 +1,82 @@
+/**
+    \file multigrid.h
+    \author Sachith Dunatunga
+    \date 17.10.2026
+
+    Geometric multigrid for 9 point stencils on the nodes of the background
+    grid.
+
+    Every level stores the stencil of each node (no sparse matrices) and a
+    mask of the nodes that take part in the solve. Coarse level node (I, J)
+    sits on fine node (2I, 2J) and the interpolation is bilinear, so the
+    Galerkin coarse operator R A P is again a 9 point stencil; a coarse node
+    is active if its stencil diagonal is positive, i.e. if it interpolates to
+    any active fine node. Smoothing is four color Gauss-Seidel (nodes of the
+    same (i % 2, j % 2) color do not see each other), forward before and in
+    reverse after the coarse correction, so a V-cycle is a symmetric
+    operator and can precondition CG. The coarsest level is solved with a
+    dense Cholesky factor.
+
+    Use:
+
+        mg_init(mg, nx, ny);            once per grid size
+        levels[0].a, levels[0].active   filled by the caller
+        mg_setup(mg);                   coarse operators, after every change
+        levels[0].b                     filled by the caller
+        mg_vcycle(mg);                  approximate solution in levels[0].x
+*/
+#ifndef __MULTIGRID_H__
+#define __MULTIGRID_H__
+#include <stddef.h>
+
+/* stop coarsening at this many nodes. */
+#define MG_COARSE_NODES 64
+
+/* entry of offset (dx, dy) in a 9 point stencil. */
+#define MG_STENCIL(dx, dy) (3 * ((dy) + 1) + ((dx) + 1))
+
+typedef struct mg_level_s {
+    /* nodes per row and column, node (i, j) is number j * nx + i. */
+    size_t nx;
+    size_t ny;
+    size_t n;
+
+    /* stencil of node k is a[9 * k + MG_STENCIL(dx, dy)]. */
+    double *a;
+    unsigned char *active;
+
+    /* solution, right hand side and residual. */
+    double *x;
+    double *b;
+    double *r;
+} mg_level_t;
+
+typedef struct mg_s {
+    mg_level_t *levels;
+    size_t num_levels;
+
+    /* Gauss-Seidel sweeps before and after the coarse correction. */
+    int pre_sweeps;
+    int post_sweeps;
+
+    /* dense Cholesky factor of the coarsest level over its active nodes. */
+    size_t *coarse_nodes;
+    size_t num_coarse;
+    double *coarse_factor;
+} mg_t;
+
+/* Returns 0 on success, -1 if an allocation failed. */
+int mg_init(mg_t *mg, size_t nx, size_t ny);
+void mg_free(mg_t *mg);
+
+/*
+    Build the coarse operators and the coarsest factor from the finest
+    stencils. Returns 0 on success, -1 if the coarsest level is not positive
+    definite.
+*/
+int mg_setup(mg_t *mg);
+
+/* One V-cycle from a zero guess for levels[0].b, the result is levels[0].x. */
+void mg_vcycle(mg_t *mg);
+
+#endif //__MULTIGRID_H__
@@ -0,0 +1,232 @@
+/**
+    \file nodal_field.c
+    \author Sachith Dunatunga
+    \date 17.10.2026
+
+    mpm_2d -- An implementation of the Material Point Method in 2D.
+*/
+#include <stdlib.h>
+#include <string.h>
+#include "process.h"
+#include "map.h"
+#include "nodal_field.h"
+
+/* the fixed arity kernel for n fields, or NULL. */
+static nodal_field_accumulate_t fixed_kernel(size_t n)
+{
+    switch (n) {
+        case 1:
+            return accumulate_p_to_n_ds_list41;
+        case 2:
+            return accumulate_p_to_n_ds_list42;
+        case 3:
+            return accumulate_p_to_n_ds_list43;
+        case 4:
+            return accumulate_p_to_n_ds_list44;
+        default:
+            return NULL;
+    }
+}
+
+static void group_add(nodal_field_group_t *g, int idx, double *values)
+{
+    g->field[g->num_fields] = idx;
+    g->values[g->num_fields] = values;
+    g->num_fields++;
+    g->accumulate = fixed_kernel(g->num_fields);
+
+    return;
+}
+
+/* weighted particle values of the fields of g. */
+static void group_pdata(const nodal_field_registry_t *r,
+    const nodal_field_group_t *g, const particle_store_t *ps, size_t i,
+    double *pdata)
+{
+    const nodal_field_t *f;
+    double w;
+    size_t k;
+
+    for (k = 0; k < g->num_fields; k++) {
+        f = &(r->fields[g->field[k]]);
+        w = f->scale;
+        if (f->weight == NODAL_FIELD_WEIGHT_MASS) {
+            w *= ps->m[i];
+        } else if (f->weight == NODAL_FIELD_WEIGHT_VOLUME) {
+            w *= ps->v[i];
+        }
+        pdata[k] = w * ps->state[i][f->state_idx];
+    }
+
+    return;
+}
+
+static void group_accumulate(const nodal_field_registry_t *r,
+    const nodal_field_group_t *g, const particle_store_t *ps, size_t i,
+    const int *nodelist, const double *sfvalues)
+{
+    double pdata[NODAL_FIELD_MAX];
+
+    if (g->num_fields == 0) {
+        return;
+    }
+
+    group_pdata(r, g, ps, i, pdata);
+    if (g->accumulate != NULL) {
+        (*(g->accumulate))(g->values, nodelist, sfvalues, pdata);
+    } else {
+        accumulate_p_to_n_ds_list(g->values, nodelist, sfvalues,
+            NODES_PER_ELEMENT, pdata, g->num_fields);
+    }
+
+    return;
+}
+
+/*---nodal_field_register-----------------------------------------------------*/
+int nodal_field_register(nodal_field_registry_t *r, size_t num_nodes,
+    const char *name, enum nodal_field_kernel_e kernel,
+    enum nodal_field_weight_e weight, int state_idx, double scale,
+    int g2p_state_idx)
+{
+    nodal_field_t *f;
+    int idx;
+
+    if (r->num_fields >= NODAL_FIELD_MAX) {
+        return -1;
+    }
+    if (r->num_fields != 0 && r->num_nodes != num_nodes) {
+        return -1;
+    }
+    if (state_idx < 0 || state_idx >= DEPVAR
+        || g2p_state_idx < -1 || g2p_state_idx >= DEPVAR) {
+        return -1;
+    }
+
+    idx = r->num_fields;
+    f = &(r->fields[idx]);
+    f->values = (double *)calloc(num_nodes, sizeof(double));
+    if (f->values == NULL) {
+        return -1;
+    }
+
+    f->name = name;
+    f->kernel = kernel;
+    f->weight = weight;
+    f->state_idx = state_idx;
+    f->scale = scale;
+    f->g2p_state_idx = g2p_state_idx;
+
+    r->num_nodes = num_nodes;
+    r->num_fields++;
+
+    if (kernel == NODAL_FIELD_GRAD_SQ) {
+        group_add(&(r->grad_sq), idx, f->values);
+    } else {
+        group_add(&(r->shape), idx, f->values);
+    }
+
+    if (g2p_state_idx >= 0) {
+        r->g2p[r->num_g2p++] = idx;
+    }
+
+    return idx;
+}
+/*----------------------------------------------------------------------------*/
+
+/*---nodal_field_find---------------------------------------------------------*/
+int nodal_field_find(const nodal_field_registry_t *r, const char *name)
+{
+    size_t k;
+
+    for (k = 0; k < r->num_fields; k++) {
+        if (r->fields[k].name != NULL && strcmp(r->fields[k].name, name) == 0) {
+            return k;
+        }
+    }
+
+    return -1;
+}
+/*----------------------------------------------------------------------------*/
+
+/*---nodal_field_clear--------------------------------------------------------*/
+void nodal_field_clear(nodal_field_registry_t *r, size_t n_start,
+    size_t n_stop)
+{
+    size_t k;
+
+    if (n_stop <= n_start) {
+        return;
+    }
+
+    for (k = 0; k < r->num_fields; k++) {
+        memset(r->fields[k].values + n_start, 0,
+            (n_stop - n_start) * sizeof(double));
+    }
+
+    return;
+}
+/*----------------------------------------------------------------------------*/
+
+/*---nodal_field_accumulate---------------------------------------------------*/
+void nodal_field_accumulate(const nodal_field_registry_t *r,
+    const particle_store_t *ps, size_t i, const int *nodelist,
+    const double *s, const double *b1, const double *b2)
+{
+    double gsq[NODES_PER_ELEMENT];
+    size_t j;
+
+    group_accumulate(r, &(r->shape), ps, i, nodelist, s);
+
+    if (r->grad_sq.num_fields != 0) {
+        for (j = 0; j < NODES_PER_ELEMENT; j++) {
+            gsq[j] = b1[j] * b1[j] + b2[j] * b2[j];
+        }
+        group_accumulate(r, &(r->grad_sq), ps, i, nodelist, gsq);
+    }
+
+    return;
+}
+/*----------------------------------------------------------------------------*/
+
+/*---nodal_field_interpolate--------------------------------------------------*/
+void nodal_field_interpolate(const nodal_field_registry_t *r,
+    particle_store_t *ps, size_t i, const int *nodelist, const double *s,
+    const double *inv_m)
+{
+    const nodal_field_t *f;
+    double q;
+    size_t j, k;
+
+    for (k = 0; k < r->num_g2p; k++) {
+        f = &(r->fields[r->g2p[k]]);
+        q = 0;
+        if (f->weight == NODAL_FIELD_WEIGHT_MASS) {
+            for (j = 0; j < NODES_PER_ELEMENT; j++) {
+                q += s[j] * inv_m[nodelist[j]] * f->values[nodelist[j]];
+            }
+        } else {
+            for (j = 0; j < NODES_PER_ELEMENT; j++) {
+                q += s[j] * f->values[nodelist[j]];
+            }
+        }
+        ps->state[i][f->g2p_state_idx] = q;
+    }
+
+    return;
+}
+/*----------------------------------------------------------------------------*/
+
+/*---nodal_field_free---------------------------------------------------------*/
+void nodal_field_free(nodal_field_registry_t *r)
+{
+    size_t k;
+
+    for (k = 0; k < r->num_fields; k++) {
+        free(r->fields[k].values);
+    }
+    memset(r, 0, sizeof(nodal_field_registry_t));
+
+    return;
+}
+/*----------------------------------------------------------------------------*/
+
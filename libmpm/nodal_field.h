@@ -0,0 +1,127 @@
+/**
+    \file nodal_field.h
+    \author Sachith Dunatunga
+    \date 17.10.2026
+
+    Extra nodal fields registered by materials and boundary conditions.
+
+    A registered field is a per-node array that the stepper clears with the
+    rest of the grid, accumulates from a particle state column in the same
+    colored (or banded) pass that maps mass and momentum, and optionally maps
+    back to a particle state column in the grid to particle pass. Fields are
+    registered once (usually in material_init) and live until mpm_cleanup.
+
+    A zeroed registry is empty and valid.
+*/
+#ifndef __NODAL_FIELD_H__
+#define __NODAL_FIELD_H__
+#include <stddef.h>
+#include "particle.h"
+
+/* most fields that can be registered. */
+#define NODAL_FIELD_MAX 8
+
+/* fields per kernel with a fixed arity kernel; more use the generic one. */
+#define NODAL_FIELD_MAX_FIXED 4
+
+enum nodal_field_kernel_e {
+    /* sum of w q N_n over particles. */
+    NODAL_FIELD_SHAPE = 0,
+    /* sum of w q |grad N_n|^2 over particles (lumped laplacian). */
+    NODAL_FIELD_GRAD_SQ
+};
+
+/* particle weight w multiplying the state value q. */
+enum nodal_field_weight_e {
+    NODAL_FIELD_WEIGHT_ONE = 0,
+    NODAL_FIELD_WEIGHT_MASS,
+    NODAL_FIELD_WEIGHT_VOLUME
+};
+
+typedef void (*nodal_field_accumulate_t)(double * const * node_fields,
+    const int * restrict nodelist, const double * restrict sfvalues,
+    const double * restrict pdata);
+
+typedef struct nodal_field_s {
+    const char *name;
+    enum nodal_field_kernel_e kernel;
+    enum nodal_field_weight_e weight;
+
+    /* source state column and scale of the particle value. */
+    int state_idx;
+    double scale;
+
+    /*
+        State column that gets sum N_n values[n] in the grid to particle pass,
+        divided by the nodal mass for mass weighted fields, or -1.
+    */
+    int g2p_state_idx;
+
+    double *values;
+} nodal_field_t;
+
+/* fields and values of one kernel, in registration order. */
+typedef struct nodal_field_group_s {
+    size_t num_fields;
+    int field[NODAL_FIELD_MAX];
+    double *values[NODAL_FIELD_MAX];
+
+    /* specialized for num_fields, NULL if there is none. */
+    nodal_field_accumulate_t accumulate;
+} nodal_field_group_t;
+
+typedef struct nodal_field_registry_s {
+    size_t num_nodes;
+    size_t num_fields;
+    nodal_field_t fields[NODAL_FIELD_MAX];
+
+    nodal_field_group_t shape;
+    nodal_field_group_t grad_sq;
+
+    /* fields with a g2p_state_idx. */
+    size_t num_g2p;
+    int g2p[NODAL_FIELD_MAX];
+} nodal_field_registry_t;
+
+/*
+    Register a field of num_nodes zeroed values. Returns the index of the
+    field (see nodal_field_values), or -1 if the registry is full, the state
+    columns are out of range or the allocation failed. Not thread safe, call
+    from material_init or another serial section.
+*/
+int nodal_field_register(nodal_field_registry_t *r, size_t num_nodes,
+    const char *name, enum nodal_field_kernel_e kernel,
+    enum nodal_field_weight_e weight, int state_idx, double scale,
+    int g2p_state_idx);
+
+/* Index of the field with the given name, or -1. */
+int nodal_field_find(const nodal_field_registry_t *r, const char *name);
+
+static inline double *nodal_field_values(const nodal_field_registry_t *r,
+    int idx)
+{
+    return r->fields[idx].values;
+}
+
+/* Zero every field at nodes [n_start, n_stop). */
+void nodal_field_clear(nodal_field_registry_t *r, size_t n_start,
+    size_t n_stop);
+
+/*
+    Accumulate particle i of the store to the 4 nodes in nodelist with shape
+    function values s and gradients b1 (x) and b2 (y). The caller makes sure
+    no other thread writes to those nodes.
+*/
+void nodal_field_accumulate(const nodal_field_registry_t *r,
+    const particle_store_t *ps, size_t i, const int *nodelist,
+    const double *s, const double *b1, const double *b2);
+
+/* Map the fields back to particle i, inv_m is the nodal 1/m. */
+void nodal_field_interpolate(const nodal_field_registry_t *r,
+    particle_store_t *ps, size_t i, const int *nodelist, const double *s,
+    const double *inv_m);
+
+void nodal_field_free(nodal_field_registry_t *r);
+
+#endif
+
@@ -0,0 +1,105 @@
+/**
+    \file node.c
+    \author Sachith Dunatunga
+    \date 17.10.2026
+
+    mpm_2d -- An implementation of the Material Point Method in 2D.
+*/
+#include "node.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Allocate a zeroed per-node array, jumping to 'gotolabel' on failure. */
+#define STORE_ALLOC(ns, field, gotolabel) \
+    do { \
+        (ns)->field = calloc((ns)->num_nodes, sizeof(*((ns)->field))); \
+        if ((ns)->field == NULL) { goto gotolabel; } \
+    } while(0)
+
+#define STORE_FREE(ns, field) \
+    do { free((ns)->field); (ns)->field = NULL; } while(0)
+
+/*---node_store_alloc---------------------------------------------------------*/
+int node_store_alloc(node_store_t *ns, size_t num_nodes)
+{
+    memset(ns, 0, sizeof(node_store_t));
+    ns->num_nodes = num_nodes;
+
+    STORE_ALLOC(ns, m, _alloc_error);
+    STORE_ALLOC(ns, inv_m, _alloc_error);
+    STORE_ALLOC(ns, x, _alloc_error);
+    STORE_ALLOC(ns, y, _alloc_error);
+    STORE_ALLOC(ns, ux, _alloc_error);
+    STORE_ALLOC(ns, uy, _alloc_error);
+    STORE_ALLOC(ns, x_t, _alloc_error);
+    STORE_ALLOC(ns, y_t, _alloc_error);
+    STORE_ALLOC(ns, x_tt, _alloc_error);
+    STORE_ALLOC(ns, y_tt, _alloc_error);
+    STORE_ALLOC(ns, mx_t, _alloc_error);
+    STORE_ALLOC(ns, my_t, _alloc_error);
+    STORE_ALLOC(ns, mx_tt, _alloc_error);
+    STORE_ALLOC(ns, my_tt, _alloc_error);
+    STORE_ALLOC(ns, fx, _alloc_error);
+    STORE_ALLOC(ns, fy, _alloc_error);
+
+    return 0;
+
+_alloc_error:
+    node_store_free(ns);
+    return -1;
+}
+/*----------------------------------------------------------------------------*/
+
+/*---node_store_free----------------------------------------------------------*/
+void node_store_free(node_store_t *ns)
+{
+    STORE_FREE(ns, m);
+    STORE_FREE(ns, inv_m);
+    STORE_FREE(ns, x);
+    STORE_FREE(ns, y);
+    STORE_FREE(ns, ux);
+    STORE_FREE(ns, uy);
+    STORE_FREE(ns, x_t);
+    STORE_FREE(ns, y_t);
+    STORE_FREE(ns, x_tt);
+    STORE_FREE(ns, y_tt);
+    STORE_FREE(ns, mx_t);
+    STORE_FREE(ns, my_t);
+    STORE_FREE(ns, mx_tt);
+    STORE_FREE(ns, my_tt);
+    STORE_FREE(ns, fx);
+    STORE_FREE(ns, fy);
+
+    ns->num_nodes = 0;
+
+    return;
+}
+/*----------------------------------------------------------------------------*/
+
+/*---node_store_clear---------------------------------------------------------*/
+void node_store_clear(node_store_t *ns, size_t n_start, size_t n_stop)
+{
+    const size_t len = (n_stop - n_start) * sizeof(double);
+
+    if (n_stop <= n_start) {
+        return;
+    }
+
+    memset(ns->m + n_start, 0, len);
+    memset(ns->mx_t + n_start, 0, len);
+    memset(ns->my_t + n_start, 0, len);
+    memset(ns->mx_tt + n_start, 0, len);
+    memset(ns->my_tt + n_start, 0, len);
+    memset(ns->x_t + n_start, 0, len);
+    memset(ns->y_t + n_start, 0, len);
+    memset(ns->x_tt + n_start, 0, len);
+    memset(ns->y_tt + n_start, 0, len);
+    memset(ns->fx + n_start, 0, len);
+    memset(ns->fy + n_start, 0, len);
+    memset(ns->ux + n_start, 0, len);
+    memset(ns->uy + n_start, 0, len);
+
+    return;
+}
+/*----------------------------------------------------------------------------*/
+
@@ -4,54 +4,60 @@
     \date 28.07.12
 
     Contains the structure for nodes in MPM.
+
+    Nodes are stored as a structure of arrays: each field is a separate
+    contiguous array indexed by node number, so field X of node i is
+    nodes->X[i]. The arrays are zeroed when allocated and pages of nodes
+    that are never used (see tiles.h) are never written.
 */
+#include <stddef.h>
+
 #ifndef __NODE_H__
 #define __NODE_H__
 
-typedef struct node_s {
-    /* Filled element neighbors. */
-    /* int element_neighbors[4];
-    int filled_element_neighbors[4]; */
-    int num_filled_element_neighbors;
-    double mass_filled_element_neighbors;
+typedef struct node_store_s {
+    size_t num_nodes;
 
     /* Mass */
-    double m;
+    double *m;
+
+    /* 1/m, or 0 if the node has (almost) no mass. Set by move_grid. */
+    double *inv_m;
 
     /* Position */
-    double x;
-    double y;
+    double *x;
+    double *y;
 
     /* Displacemnent */
-    double ux;
-    double uy;
+    double *ux;
+    double *uy;
 
     /* Velocity */
-    double x_t;
-    double y_t;
+    double *x_t;
+    double *y_t;
 
     /* Acceleration */
-    double x_tt;
-    double y_tt;
+    double *x_tt;
+    double *y_tt;
 
     /* Momentum */
-    double mx_t;
-    double my_t;
+    double *mx_t;
+    double *my_t;
 
     /* "pseudoforce" */
-    double mx_tt;
-    double my_tt;
+    double *mx_tt;
+    double *my_tt;
 
     /* Force */
-    double fx;
-    double fy;
+    double *fx;
+    double *fy;
+} node_store_t;
 
-    /* Density */
-    double rho;
+/* Returns 0 on success, -1 if an allocation failed. */
+int node_store_alloc(node_store_t *ns, size_t num_nodes);
+void node_store_free(node_store_t *ns);
 
-    /* marker for displacment/velocity update */
-    int velocity_update_flag;
-} node_t;
+/* Zero the per step fields (everything but position) of nodes [n_start, n_stop). */
+void node_store_clear(node_store_t *ns, size_t n_start, size_t n_stop);
 
 #endif
-
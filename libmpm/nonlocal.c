@@ -0,0 +1,977 @@
+/**
+    \file nonlocal.c
+    \author Sachith Dunatunga
+    \date 17.10.2026
+
+    mpm_2d -- An implementation of the Material Point Method in 2D.
+*/
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "element.h"
+#include "process.h"
+#include "nonlocal.h"
+
+static size_t override_node(const job_t *job, size_t n)
+{
+    return (job->node_number_override[NODAL_DOF * n + 0] - 0) / NODAL_DOF;
+}
+
+/* Position of row i in column j of a matrix with sorted columns. */
+static size_t find_entry(const cs *A, size_t i, size_t j)
+{
+    size_t lo = A->p[j];
+    size_t hi = A->p[j + 1];
+    size_t mid;
+
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if ((size_t)A->i[mid] < i) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+/*---nonlocal_ws_init---------------------------------------------------------*/
+int nonlocal_ws_init(nonlocal_ws_t *ws, size_t num_nodes, size_t num_elements)
+{
+    memset(ws, 0, sizeof(nonlocal_ws_t));
+    ws->num_nodes = num_nodes;
+    ws->num_elements = num_elements;
+
+    ws->node_map = (size_t *)malloc(num_nodes * sizeof(size_t));
+    ws->inv_node_map = (size_t *)malloc(num_nodes * sizeof(size_t));
+    ws->prev_inv_node_map = (size_t *)malloc(num_nodes * sizeof(size_t));
+    ws->diag = (size_t *)malloc(num_nodes * sizeof(size_t));
+    ws->f = (double *)malloc(num_nodes * sizeof(double));
+    ws->work = (double *)malloc(num_nodes * sizeof(double));
+    ws->gf_nodes = (double *)calloc(num_nodes, sizeof(double));
+    ws->r = (double *)malloc(num_nodes * sizeof(double));
+    ws->z = (double *)malloc(num_nodes * sizeof(double));
+    ws->p = (double *)malloc(num_nodes * sizeof(double));
+    ws->q = (double *)malloc(num_nodes * sizeof(double));
+
+    ws->element_used = (unsigned char *)calloc(num_elements, sizeof(unsigned char));
+    ws->used_list = (size_t *)malloc(num_elements * sizeof(size_t));
+    ws->element_list = (size_t *)malloc(num_elements * sizeof(size_t));
+    ws->element_slot = (size_t *)malloc(num_elements * sizeof(size_t));
+    ws->element_source = (unsigned char *)calloc(num_elements, sizeof(unsigned char));
+    ws->source_list = (size_t *)malloc(num_elements * sizeof(size_t));
+    ws->node_layer = (size_t *)malloc(num_nodes * sizeof(size_t));
+    ws->load_nodes = (double *)calloc(num_nodes, sizeof(double));
+
+    if (ws->node_map == NULL || ws->inv_node_map == NULL
+        || ws->prev_inv_node_map == NULL || ws->diag == NULL
+        || ws->f == NULL || ws->work == NULL || ws->gf_nodes == NULL
+        || ws->r == NULL || ws->z == NULL || ws->p == NULL || ws->q == NULL
+        || ws->element_used == NULL || ws->used_list == NULL
+        || ws->element_list == NULL || ws->element_slot == NULL
+        || ws->element_source == NULL || ws->source_list == NULL
+        || ws->node_layer == NULL || ws->load_nodes == NULL) {
+        nonlocal_ws_free(ws);
+        return -1;
+    }
+
+    for (size_t i = 0; i < num_elements; i++) {
+        ws->element_slot[i] = NONLOCAL_UNMAPPED;
+    }
+
+    return 0;
+}
+/*----------------------------------------------------------------------------*/
+
+/*---nonlocal_ws_free---------------------------------------------------------*/
+void nonlocal_ws_free(nonlocal_ws_t *ws)
+{
+    free(ws->node_map);
+    free(ws->inv_node_map);
+    free(ws->prev_inv_node_map);
+    free(ws->diag);
+    free(ws->f);
+    free(ws->work);
+    free(ws->gf_nodes);
+    free(ws->r);
+    free(ws->z);
+    free(ws->p);
+    free(ws->q);
+    free(ws->element_used);
+    free(ws->used_list);
+    free(ws->element_list);
+    free(ws->element_slot);
+    free(ws->element_source);
+    free(ws->source_list);
+    free(ws->node_layer);
+    free(ws->load_nodes);
+    free(ws->scatter);
+    cs_spfree(ws->A);
+    cs_sfree(ws->S);
+    cs_spfree(ws->L);
+    mg_free(&(ws->mg));
+    free(ws->partial);
+
+    memset(ws, 0, sizeof(nonlocal_ws_t));
+
+    return;
+}
+/*----------------------------------------------------------------------------*/
+
+/*---nonlocal_ws_begin--------------------------------------------------------*/
+size_t nonlocal_ws_begin(nonlocal_ws_t *ws, job_t *job, double tol)
+{
+    size_t i, i_new, k;
+    size_t *tmp;
+
+    if (ws->num_nodes != job->num_nodes
+        || ws->num_elements != job->num_elements) {
+        nonlocal_ws_free(ws);
+        if (nonlocal_ws_init(ws, job->num_nodes, job->num_elements) != 0) {
+            fprintf(stderr, "%s:%s: Unable to allocate nonlocal workspace.\n",
+                __FILE__, __func__);
+            exit(-1);
+        }
+    }
+
+    /* keep the old map to compare against. */
+    tmp = ws->prev_inv_node_map;
+    ws->prev_inv_node_map = ws->inv_node_map;
+    ws->inv_node_map = tmp;
+    ws->prev_slda = ws->slda;
+
+    for (i = 0; i < job->num_nodes; i++) {
+        ws->node_map[i] = NONLOCAL_UNMAPPED;
+    }
+
+    ws->slda = 0;
+    for (i = 0; i < job->num_nodes; i++) {
+        i_new = override_node(job, i);
+
+        if (ws->node_map[i_new] != NONLOCAL_UNMAPPED) {
+            continue;
+        }
+
+        if (job->nodes.m[i_new] > tol) {
+            ws->node_map[i_new] = ws->slda;
+            ws->inv_node_map[ws->slda] = i_new;
+            ws->slda++;
+        }
+    }
+
+    if (ws->slda == 0) {
+        fprintf(stderr, "%s:%s: Invalid size, slda = %zu.\n",
+            __FILE__, __func__, ws->slda);
+        exit(-1);
+    }
+
+    for (i = 0; i < ws->slda; i++) {
+        ws->f[i] = 0;
+    }
+
+    for (k = 0; k < ws->num_used; k++) {
+        ws->element_used[ws->used_list[k]] = 0;
+    }
+    ws->num_used = 0;
+
+    for (k = 0; k < ws->num_sources; k++) {
+        ws->element_source[ws->source_list[k]] = 0;
+    }
+    ws->num_sources = 0;
+
+    ws->num_steps++;
+
+    return ws->slda;
+}
+/*----------------------------------------------------------------------------*/
+
+/*---nonlocal_ws_solve_due----------------------------------------------------*/
+int nonlocal_ws_solve_due(nonlocal_ws_t *ws, job_t *job)
+{
+    const nonlocal_control_t *ctl = &(job->material.nonlocal);
+    size_t i, k;
+    size_t *tmp;
+    double b, d;
+    double b_norm = 0;
+    double d_norm = 0;
+
+    ws->due = 1;
+    if (ctl->solve_interval <= 1) {
+        return ws->due;
+    }
+
+    ws->steps_since_solve++;
+    ws->due = !ws->have_solution
+        || ws->steps_since_solve >= (size_t)ctl->solve_interval;
+
+    if (!ws->due && ctl->solve_tolerance > 0) {
+        for (i = 0; i < ws->num_nodes; i++) {
+            k = ws->node_map[i];
+            b = (k != NONLOCAL_UNMAPPED) ? ws->f[k] : 0;
+            d = b - ws->load_nodes[i];
+            b_norm += ws->load_nodes[i] * ws->load_nodes[i];
+            d_norm += d * d;
+        }
+        if (d_norm > ctl->solve_tolerance * ctl->solve_tolerance * b_norm) {
+            ws->due = 1;
+            ws->num_early_solves++;
+        }
+    }
+
+    if (ws->due) {
+        for (i = 0; i < ws->num_nodes; i++) {
+            k = ws->node_map[i];
+            ws->load_nodes[i] = (k != NONLOCAL_UNMAPPED) ? ws->f[k] : 0;
+        }
+        ws->have_solution = 1;
+        ws->steps_since_solve = 0;
+        return ws->due;
+    }
+
+    /* undo nonlocal_ws_begin, the pattern stays built for the old map. */
+    for (k = 0; k < ws->slda; k++) {
+        ws->node_map[ws->inv_node_map[k]] = NONLOCAL_UNMAPPED;
+    }
+    tmp = ws->inv_node_map;
+    ws->inv_node_map = ws->prev_inv_node_map;
+    ws->prev_inv_node_map = tmp;
+    ws->slda = ws->prev_slda;
+    for (k = 0; k < ws->slda; k++) {
+        ws->node_map[ws->inv_node_map[k]] = k;
+    }
+    ws->num_reused_steps++;
+
+    return ws->due;
+}
+/*----------------------------------------------------------------------------*/
+
+/*
+    Keep only the dofs within support_radius of a source element, counted in
+    layers of contributing elements, or none if there are no sources. The
+    kept dofs keep their order, so the maps and f are compacted in place.
+*/
+static void restrict_support(nonlocal_ws_t *ws, const job_t *job)
+{
+    const double radius = job->material.nonlocal.support_radius;
+    size_t i, k, d, e, n, layers, slda;
+    size_t dofs[NODES_PER_ELEMENT];
+    int front;
+
+    if (ws->num_sources == 0) {
+        for (i = 0; i < ws->slda; i++) {
+            ws->node_map[ws->inv_node_map[i]] = NONLOCAL_UNMAPPED;
+        }
+        ws->num_dropped_dofs += ws->slda;
+        ws->num_skipped_solves++;
+        ws->slda = 0;
+        return;
+    }
+
+    if (!(radius > 0)) {
+        return;
+    }
+
+    layers = (size_t)ceil(radius / job->h);
+
+    for (i = 0; i < ws->slda; i++) {
+        ws->node_layer[i] = NONLOCAL_UNMAPPED;
+    }
+    for (k = 0; k < ws->num_sources; k++) {
+        for (n = 0; n < NODES_PER_ELEMENT; n++) {
+            i = ws->node_map[override_node(job,
+                job->elements[ws->source_list[k]].nodes[n])];
+            if (i != NONLOCAL_UNMAPPED) {
+                ws->node_layer[i] = 0;
+            }
+        }
+    }
+
+    /* grow by one element layer per pass. */
+    for (d = 0; d < layers; d++) {
+        for (k = 0; k < ws->num_used; k++) {
+            e = ws->used_list[k];
+            front = 0;
+            for (n = 0; n < NODES_PER_ELEMENT; n++) {
+                dofs[n] = ws->node_map[override_node(job, job->elements[e].nodes[n])];
+                if (dofs[n] != NONLOCAL_UNMAPPED && ws->node_layer[dofs[n]] == d) {
+                    front = 1;
+                }
+            }
+            for (n = 0; front && n < NODES_PER_ELEMENT; n++) {
+                if (dofs[n] != NONLOCAL_UNMAPPED
+                    && ws->node_layer[dofs[n]] == NONLOCAL_UNMAPPED) {
+                    ws->node_layer[dofs[n]] = d + 1;
+                }
+            }
+        }
+    }
+
+    slda = 0;
+    for (i = 0; i < ws->slda; i++) {
+        n = ws->inv_node_map[i];
+        if (ws->node_layer[i] == NONLOCAL_UNMAPPED) {
+            ws->node_map[n] = NONLOCAL_UNMAPPED;
+            continue;
+        }
+        ws->node_map[n] = slda;
+        ws->inv_node_map[slda] = n;
+        ws->f[slda] = ws->f[i];
+        slda++;
+    }
+
+    if (slda < ws->slda) {
+        ws->num_restricted_solves++;
+        ws->num_dropped_dofs += ws->slda - slda;
+    }
+    ws->slda = slda;
+
+    return;
+}
+
+/*---nonlocal_ws_pattern------------------------------------------------------*/
+int nonlocal_ws_pattern(nonlocal_ws_t *ws, job_t *job)
+{
+    size_t i, k, e, ei, ej, gi, gj;
+    size_t *scatter;
+    int *nn;
+    cs *triplets;
+    cs *smat;
+    cs *smat_t;
+    int same;
+
+    restrict_support(ws, job);
+
+    if (job->material.nonlocal.log_iterations && job->output.log_fd != NULL) {
+        fprintf(job->output.log_fd,
+            "nonlocal support: step %d, %zu dofs, %zu sources; "
+            "skipped %zu, restricted %zu of %zu steps.\n",
+            job->step_number, ws->slda, ws->num_sources,
+            ws->num_skipped_solves, ws->num_restricted_solves, ws->num_steps);
+    }
+
+    ws->node_map_changed = (ws->slda != ws->prev_slda)
+        || memcmp(ws->inv_node_map, ws->prev_inv_node_map,
+            ws->slda * sizeof(size_t)) != 0;
+
+    /* nothing above yield, the caller skips the solve. */
+    if (ws->slda == 0) {
+        return 0;
+    }
+
+    same = ws->pattern_valid && !ws->node_map_changed
+        && ws->num_used == ws->num_element_list;
+    for (k = 0; same && k < ws->num_used; k++) {
+        same = (ws->element_slot[ws->used_list[k]] != NONLOCAL_UNMAPPED);
+    }
+
+    if (same) {
+        memset(ws->A->x, 0, ws->A->p[ws->slda] * sizeof(double));
+        return 0;
+    }
+
+    /* rebuild: new element list and slots. */
+    ws->pattern_valid = 0;
+    cs_spfree(ws->L);
+    ws->L = NULL;
+    for (k = 0; k < ws->num_element_list; k++) {
+        ws->element_slot[ws->element_list[k]] = NONLOCAL_UNMAPPED;
+    }
+    for (k = 0; k < ws->num_used; k++) {
+        ws->element_list[k] = ws->used_list[k];
+        ws->element_slot[ws->used_list[k]] = k;
+    }
+    ws->num_element_list = ws->num_used;
+
+    if (16 * ws->num_element_list > ws->scatter_capacity) {
+        scatter = (size_t *)realloc(ws->scatter,
+            16 * ws->num_element_list * sizeof(size_t));
+        if (scatter == NULL) {
+            return -1;
+        }
+        ws->scatter = scatter;
+        ws->scatter_capacity = 16 * ws->num_element_list;
+    }
+
+    triplets = cs_spalloc(ws->slda, ws->slda,
+        16 * ws->num_element_list + ws->slda, 1, 1);
+    if (triplets == NULL) {
+        return -1;
+    }
+    for (k = 0; k < ws->num_element_list; k++) {
+        nn = job->elements[ws->element_list[k]].nodes;
+        for (ei = 0; ei < NODES_PER_ELEMENT; ei++) {
+            gi = ws->node_map[override_node(job, nn[ei])];
+            for (ej = 0; ej < NODES_PER_ELEMENT; ej++) {
+                gj = ws->node_map[override_node(job, nn[ej])];
+                if (gi != NONLOCAL_UNMAPPED && gj != NONLOCAL_UNMAPPED) {
+                    cs_entry(triplets, gi, gj, 0);
+                }
+            }
+        }
+    }
+    for (i = 0; i < ws->slda; i++) {
+        cs_entry(triplets, i, i, 0);
+    }
+
+    /* compress, drop duplicates, then sort each column (transpose twice). */
+    smat = cs_compress(triplets);
+    cs_spfree(triplets);
+    if (smat == NULL || !cs_dupl(smat)) {
+        cs_spfree(smat);
+        return -1;
+    }
+    smat_t = cs_transpose(smat, 1);
+    cs_spfree(smat);
+    if (smat_t == NULL) {
+        return -1;
+    }
+    cs_spfree(ws->A);
+    ws->A = cs_transpose(smat_t, 1);
+    cs_spfree(smat_t);
+    if (ws->A == NULL) {
+        return -1;
+    }
+
+    for (k = 0; k < ws->num_element_list; k++) {
+        e = ws->element_list[k];
+        nn = job->elements[e].nodes;
+        for (ei = 0; ei < NODES_PER_ELEMENT; ei++) {
+            gi = ws->node_map[override_node(job, nn[ei])];
+            for (ej = 0; ej < NODES_PER_ELEMENT; ej++) {
+                gj = ws->node_map[override_node(job, nn[ej])];
+                if (gi != NONLOCAL_UNMAPPED && gj != NONLOCAL_UNMAPPED) {
+                    ws->scatter[16 * k + 4 * ei + ej] = find_entry(ws->A, gi, gj);
+                } else {
+                    ws->scatter[16 * k + 4 * ei + ej] = NONLOCAL_UNMAPPED;
+                }
+            }
+        }
+    }
+    for (i = 0; i < ws->slda; i++) {
+        ws->diag[i] = find_entry(ws->A, i, i);
+    }
+
+    /* the symbolic LU analysis is redone on the next LU solve. */
+    cs_sfree(ws->S);
+    ws->S = NULL;
+
+    memset(ws->A->x, 0, ws->A->p[ws->slda] * sizeof(double));
+    ws->pattern_valid = 1;
+    ws->num_pattern_builds++;
+
+    return 0;
+}
+/*----------------------------------------------------------------------------*/
+
+/*---nonlocal_ws_add_diagonal-------------------------------------------------*/
+void nonlocal_ws_add_diagonal(nonlocal_ws_t *ws, double v)
+{
+    for (size_t i = 0; i < ws->slda; i++) {
+        ws->A->x[ws->diag[i]] += v;
+    }
+
+    return;
+}
+/*----------------------------------------------------------------------------*/
+
+/*
+    Lower triangle of A. Columns of A are sorted, so the entries of column j
+    from diag[j] on are the lower part, diagonal first.
+*/
+static cs *lower_pattern(const nonlocal_ws_t *ws)
+{
+    size_t j, nz;
+    cs *L;
+
+    nz = 0;
+    for (j = 0; j < ws->slda; j++) {
+        nz += ws->A->p[j + 1] - ws->diag[j];
+    }
+
+    L = cs_spalloc(ws->slda, ws->slda, nz, 1, 0);
+    if (L == NULL) {
+        return NULL;
+    }
+
+    nz = 0;
+    for (j = 0; j < ws->slda; j++) {
+        L->p[j] = nz;
+        memcpy(L->i + nz, ws->A->i + ws->diag[j],
+            (ws->A->p[j + 1] - ws->diag[j]) * sizeof(*L->i));
+        nz += ws->A->p[j + 1] - ws->diag[j];
+    }
+    L->p[ws->slda] = nz;
+
+    return L;
+}
+
+/*
+    Incomplete Cholesky with no fill, right looking. Returns -1 on a non
+    positive pivot.
+*/
+static int ic0_factor(nonlocal_ws_t *ws)
+{
+    cs *L = ws->L;
+    size_t j, k, p, q, pos;
+    double d;
+
+    for (j = 0; j < ws->slda; j++) {
+        memcpy(L->x + L->p[j], ws->A->x + ws->diag[j],
+            (L->p[j + 1] - L->p[j]) * sizeof(double));
+    }
+
+    for (k = 0; k < ws->slda; k++) {
+        d = L->x[L->p[k]];
+        if (!(d > 0)) {
+            return -1;
+        }
+        d = sqrt(d);
+        L->x[L->p[k]] = d;
+
+        for (p = L->p[k] + 1; p < (size_t)L->p[k + 1]; p++) {
+            L->x[p] /= d;
+        }
+
+        /* update the columns to the right, only where the pattern has room. */
+        for (p = L->p[k] + 1; p < (size_t)L->p[k + 1]; p++) {
+            j = L->i[p];
+            for (q = p; q < (size_t)L->p[k + 1]; q++) {
+                pos = find_entry(L, L->i[q], j);
+                if (pos < (size_t)L->p[j + 1] && (size_t)L->i[pos] == (size_t)L->i[q]) {
+                    L->x[pos] -= L->x[q] * L->x[p];
+                }
+            }
+        }
+    }
+
+    return 0;
+}
+
+/*
+    Stencils of the finest multigrid level from A and the coarse levels.
+    Returns -1 if a dof couples to a node that is not its grid neighbor
+    (periodic node overrides) or the coarse setup failed.
+*/
+static int mg_operator(nonlocal_ws_t *ws, const job_t *job)
+{
+    mg_level_t *l;
+    size_t j, p, gi, gj;
+    long dx, dy;
+
+    if (ws->mg.levels == NULL || ws->mg.levels[0].nx != (size_t)job->Nx
+        || ws->mg.levels[0].ny != (size_t)job->Ny) {
+        mg_free(&(ws->mg));
+        if (mg_init(&(ws->mg), job->Nx, job->Ny) != 0) {
+            return -1;
+        }
+    }
+
+    l = &(ws->mg.levels[0]);
+    memset(l->a, 0, 9 * l->n * sizeof(double));
+    memset(l->active, 0, l->n * sizeof(unsigned char));
+
+    /* A is symmetric, so column j is the stencil of dof j. */
+    for (j = 0; j < ws->slda; j++) {
+        gj = ws->inv_node_map[j];
+        l->active[gj] = 1;
+        for (p = ws->A->p[j]; p < (size_t)ws->A->p[j + 1]; p++) {
+            gi = ws->inv_node_map[ws->A->i[p]];
+            dx = (long)(gi % l->nx) - (long)(gj % l->nx);
+            dy = (long)(gi / l->nx) - (long)(gj / l->nx);
+            if (labs(dx) > 1 || labs(dy) > 1) {
+                return -1;
+            }
+            l->a[9 * gj + MG_STENCIL((int)dx, (int)dy)] += ws->A->x[p];
+        }
+    }
+
+    return mg_setup(&(ws->mg));
+}
+
+/*---nonlocal_sync_threads----------------------------------------------------*/
+int nonlocal_sync_threads(const job_t *job, size_t num_threads)
+{
+    if (num_threads == 1) {
+        return 1;
+    }
+
+    return (pthread_barrier_wait(job->serialize_barrier)
+        == PTHREAD_BARRIER_SERIAL_THREAD);
+}
+/*----------------------------------------------------------------------------*/
+
+/* z = M^-1 r with the IC(0) factor or a V-cycle, serial. */
+static void apply_preconditioner(nonlocal_ws_t *ws,
+    enum nonlocal_precond_e precond, const double *r, double *z)
+{
+    const cs *L = ws->L;
+    size_t j, p;
+
+    if (precond == NONLOCAL_PRECOND_MG) {
+        for (j = 0; j < ws->slda; j++) {
+            ws->mg.levels[0].b[ws->inv_node_map[j]] = r[j];
+        }
+        mg_vcycle(&(ws->mg));
+        for (j = 0; j < ws->slda; j++) {
+            z[j] = ws->mg.levels[0].x[ws->inv_node_map[j]];
+        }
+        return;
+    }
+
+    /* L y = r, then L^T z = y. */
+    memcpy(z, r, ws->slda * sizeof(double));
+    for (j = 0; j < ws->slda; j++) {
+        z[j] /= L->x[L->p[j]];
+        for (p = L->p[j] + 1; p < (size_t)L->p[j + 1]; p++) {
+            z[L->i[p]] -= L->x[p] * z[j];
+        }
+    }
+    for (j = ws->slda; j-- > 0; ) {
+        for (p = L->p[j] + 1; p < (size_t)L->p[j + 1]; p++) {
+            z[j] -= L->x[p] * z[L->i[p]];
+        }
+        z[j] /= L->x[L->p[j]];
+    }
+
+    return;
+}
+
+/*
+    z = M^-1 r. Jacobi only needs the dofs [j0, j1) of this thread, the
+    other preconditioners need all of r and run on one thread.
+*/
+static void precondition(nonlocal_ws_t *ws, const job_t *job,
+    enum nonlocal_precond_e precond, size_t num_threads, size_t j0, size_t j1)
+{
+    size_t j;
+    double d;
+
+    if (precond == NONLOCAL_PRECOND_JACOBI) {
+        for (j = j0; j < j1; j++) {
+            d = ws->A->x[ws->diag[j]];
+            ws->z[j] = (d > 0) ? (ws->r[j] / d) : ws->r[j];
+        }
+        return;
+    }
+
+    if (nonlocal_sync_threads(job, num_threads)) {
+        apply_preconditioner(ws, precond, ws->r, ws->z);
+    }
+    nonlocal_sync_threads(job, num_threads);
+
+    return;
+}
+
+/* y = A x for dofs [j0, j1). A is symmetric, so column j is also row j. */
+static void spmv(const cs *A, const double *x, double *y, size_t j0, size_t j1)
+{
+    size_t j, p;
+    double s;
+
+    for (j = j0; j < j1; j++) {
+        s = 0;
+        for (p = A->p[j]; p < (size_t)A->p[j + 1]; p++) {
+            s += A->x[p] * x[A->i[p]];
+        }
+        y[j] = s;
+    }
+
+    return;
+}
+
+static double dot(const double *a, const double *b, size_t n)
+{
+    double s = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        s += a[i] * b[i];
+    }
+
+    return s;
+}
+
+/*
+    Sum the nv partial values v of every thread into v. All threads add
+    them in the same order and get the same result. The two halves of the
+    buffer alternate, so with the barrier in between a half is only
+    rewritten after every thread has read it.
+*/
+static void reduce(nonlocal_ws_t *ws, const job_t *job, size_t thread_id,
+    size_t num_threads, int *half, double *v, size_t nv)
+{
+    double *buf = ws->partial + (*half) * 2 * num_threads;
+    size_t t, k;
+
+    for (k = 0; k < nv; k++) {
+        buf[2 * thread_id + k] = v[k];
+    }
+    nonlocal_sync_threads(job, num_threads);
+    for (k = 0; k < nv; k++) {
+        v[k] = 0;
+        for (t = 0; t < num_threads; t++) {
+            v[k] += buf[2 * t + k];
+        }
+    }
+    *half = !(*half);
+
+    return;
+}
+
+/* Set up the configured preconditioner, or the next one down if it fails. */
+static enum nonlocal_precond_e setup_preconditioner(nonlocal_ws_t *ws,
+    const job_t *job)
+{
+    enum nonlocal_precond_e precond = job->material.nonlocal.preconditioner;
+
+    if (precond == NONLOCAL_PRECOND_MG && mg_operator(ws, job) != 0) {
+        ws->num_mg_unavailable++;
+        precond = NONLOCAL_PRECOND_IC0;
+    }
+    if (precond == NONLOCAL_PRECOND_IC0) {
+        if (ws->L == NULL) {
+            ws->L = lower_pattern(ws);
+        }
+        if (ws->L == NULL || ic0_factor(ws) != 0) {
+            ws->num_ic0_breakdowns++;
+            precond = NONLOCAL_PRECOND_JACOBI;
+        }
+    }
+
+    return precond;
+}
+
+/*
+    Preconditioned CG from the previous nodal solution, run by every thread
+    on its dofs [j0, j1). The iterate is kept in work and f is left
+    untouched until it converges. Returns 0 if it converged, -1 otherwise;
+    the same on every thread.
+*/
+static int pcg_solve(nonlocal_ws_t *ws, const job_t *job, size_t thread_id,
+    size_t num_threads, size_t *iterations, double *residual)
+{
+    const nonlocal_control_t *ctl = &(job->material.nonlocal);
+    const size_t n = ws->slda;
+    const size_t j0 = (thread_id * n) / num_threads;
+    const size_t j1 = ((thread_id + 1) * n) / num_threads;
+    const size_t len = j1 - j0;
+    double *x = ws->work;
+    double *r = ws->r;
+    double *z = ws->z;
+    double *p = ws->p;
+    double *q = ws->q;
+    double b_norm, r_norm, rz, pq, alpha, beta;
+    double v[2];
+    size_t j;
+    enum nonlocal_precond_e precond;
+    int k, half = 0;
+
+    *iterations = 0;
+    *residual = 0;
+
+    v[0] = dot(ws->f + j0, ws->f + j0, len);
+    reduce(ws, job, thread_id, num_threads, &half, v, 1);
+    b_norm = sqrt(v[0]);
+    if (b_norm == 0) {
+        for (j = j0; j < j1; j++) {
+            ws->f[j] = 0;
+        }
+        return 0;
+    }
+
+    for (j = j0; j < j1; j++) {
+        x[j] = ws->gf_nodes[ws->inv_node_map[j]];
+    }
+    nonlocal_sync_threads(job, num_threads);
+
+    spmv(ws->A, x, r, j0, j1);
+    for (j = j0; j < j1; j++) {
+        r[j] = ws->f[j] - r[j];
+    }
+    v[0] = dot(r + j0, r + j0, len);
+    reduce(ws, job, thread_id, num_threads, &half, v, 1);
+    r_norm = sqrt(v[0]);
+
+    /* nothing to set up if the old solution is still good enough. */
+    precond = NONLOCAL_PRECOND_JACOBI;
+    if (r_norm > ctl->tolerance * b_norm) {
+        if (nonlocal_sync_threads(job, num_threads)) {
+            ws->precond = setup_preconditioner(ws, job);
+        }
+        nonlocal_sync_threads(job, num_threads);
+        precond = ws->precond;
+    }
+    precondition(ws, job, precond, num_threads, j0, j1);
+    memcpy(p + j0, z + j0, len * sizeof(double));
+    v[0] = dot(r + j0, z + j0, len);
+    reduce(ws, job, thread_id, num_threads, &half, v, 1);
+    rz = v[0];
+
+    for (k = 0; k < ctl->max_iterations && r_norm > ctl->tolerance * b_norm; k++) {
+        /* every thread reads all of p. */
+        nonlocal_sync_threads(job, num_threads);
+        spmv(ws->A, p, q, j0, j1);
+        v[0] = dot(p + j0, q + j0, len);
+        reduce(ws, job, thread_id, num_threads, &half, v, 1);
+        pq = v[0];
+        if (!(pq > 0)) {
+            break;
+        }
+
+        alpha = rz / pq;
+        for (j = j0; j < j1; j++) {
+            x[j] += alpha * p[j];
+            r[j] -= alpha * q[j];
+        }
+        precondition(ws, job, precond, num_threads, j0, j1);
+
+        v[0] = dot(r + j0, z + j0, len);
+        v[1] = dot(r + j0, r + j0, len);
+        reduce(ws, job, thread_id, num_threads, &half, v, 2);
+        beta = v[0] / rz;
+        rz = v[0];
+        r_norm = sqrt(v[1]);
+
+        for (j = j0; j < j1; j++) {
+            p[j] = z[j] + beta * p[j];
+        }
+    }
+
+    *iterations = k;
+    *residual = r_norm / b_norm;
+
+    if (!(r_norm <= ctl->tolerance * b_norm)) {
+        return -1;
+    }
+
+    memcpy(ws->f + j0, x + j0, len * sizeof(double));
+
+    return 0;
+}
+
+/* Cached LU, QR if that fails. Serial. */
+static int direct_solve(nonlocal_ws_t *ws)
+{
+    csn *N;
+
+    /* same ordering as cs_lusol(1, ...). */
+    if (ws->S == NULL) {
+        ws->S = cs_sqr(1, ws->A, 0);
+    }
+
+    N = (ws->S != NULL) ? cs_lu(ws->A, ws->S, 1e-12) : NULL;
+    if (N != NULL) {
+        cs_ipvec(N->pinv, ws->f, ws->work, ws->slda);
+        cs_lsolve(N->L, ws->work);
+        cs_usolve(N->U, ws->work);
+        cs_ipvec(ws->S->q, ws->work, ws->f, ws->slda);
+        cs_nfree(N);
+        return 0;
+    }
+
+    fprintf(stderr, "lusol error!\n");
+    ws->num_qr_fallbacks++;
+    if (!cs_qrsol(1, ws->A, ws->f)) {
+        fprintf(stderr, "qrsol error!\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+/*---nonlocal_ws_solve--------------------------------------------------------*/
+int nonlocal_ws_solve(nonlocal_ws_t *ws, job_t *job)
+{
+    return nonlocal_ws_solve_threaded(ws, job, 0, 1);
+}
+/*----------------------------------------------------------------------------*/
+
+/*---nonlocal_ws_solve_threaded-----------------------------------------------*/
+int nonlocal_ws_solve_threaded(nonlocal_ws_t *ws, job_t *job,
+    size_t thread_id, size_t num_threads)
+{
+    const nonlocal_control_t *ctl = &(job->material.nonlocal);
+    double *partial;
+    double residual = 0;
+    size_t iterations = 0;
+    int converged = 0;
+
+    if (nonlocal_sync_threads(job, num_threads)) {
+        ws->num_solves++;
+        if (ws->partial_capacity < 4 * num_threads) {
+            partial = (double *)realloc(ws->partial,
+                4 * num_threads * sizeof(double));
+            if (partial == NULL) {
+                fprintf(stderr, "%s:%s: Unable to allocate reduction buffer.\n",
+                    __FILE__, __func__);
+                exit(-1);
+            }
+            ws->partial = partial;
+            ws->partial_capacity = 4 * num_threads;
+        }
+    }
+    nonlocal_sync_threads(job, num_threads);
+
+    if (ctl->solver == NONLOCAL_SOLVER_PCG) {
+        converged = (pcg_solve(ws, job, thread_id, num_threads,
+            &iterations, &residual) == 0);
+    }
+
+    if (nonlocal_sync_threads(job, num_threads)) {
+        ws->status = 0;
+        if (ctl->solver == NONLOCAL_SOLVER_PCG) {
+            ws->last_iterations = iterations;
+            ws->last_residual = residual;
+            ws->num_pcg_iterations += iterations;
+            if (iterations > ws->max_pcg_iterations) {
+                ws->max_pcg_iterations = iterations;
+            }
+            if (converged && ctl->log_iterations && job->output.log_fd != NULL) {
+                fprintf(job->output.log_fd,
+                    "nonlocal pcg: step %d, %zu iterations, residual %g.\n",
+                    job->step_number, iterations, residual);
+            }
+            if (!converged) {
+                fprintf(stderr, "%s:%s: PCG did not converge (%zu iterations, "
+                    "residual %g), using LU.\n", __FILE__, __func__,
+                    iterations, residual);
+                ws->num_pcg_fallbacks++;
+            }
+        }
+        if (!converged) {
+            ws->status = direct_solve(ws);
+        }
+    }
+    nonlocal_sync_threads(job, num_threads);
+
+    return ws->status;
+}
+/*----------------------------------------------------------------------------*/
+
+/*---nonlocal_ws_report-------------------------------------------------------*/
+void nonlocal_ws_report(const nonlocal_ws_t *ws, FILE *fd)
+{
+    fprintf(fd, "nonlocal solves: %zu, pattern builds: %zu, qr fallbacks: %zu.\n",
+        ws->num_solves, ws->num_pattern_builds, ws->num_qr_fallbacks);
+    if (ws->num_pcg_iterations > 0 || ws->num_pcg_fallbacks > 0) {
+        fprintf(fd, "nonlocal pcg iterations: %zu (%.1f per solve, max %zu), "
+            "lu fallbacks: %zu, ic0 breakdowns: %zu, mg unavailable: %zu.\n",
+            ws->num_pcg_iterations,
+            (double)ws->num_pcg_iterations / (double)ws->num_solves,
+            ws->max_pcg_iterations, ws->num_pcg_fallbacks,
+            ws->num_ic0_breakdowns, ws->num_mg_unavailable);
+    }
+    fprintf(fd, "nonlocal steps: %zu, skipped: %zu, restricted: %zu, "
+        "dropped dofs: %zu.\n", ws->num_steps, ws->num_skipped_solves,
+        ws->num_restricted_solves, ws->num_dropped_dofs);
+    if (ws->num_reused_steps > 0) {
+        fprintf(fd, "nonlocal reused steps: %zu, early solves: %zu.\n",
+            ws->num_reused_steps, ws->num_early_solves);
+    }
+
+    return;
+}
+/*----------------------------------------------------------------------------*/
+
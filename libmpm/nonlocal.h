@@ -0,0 +1,266 @@
+/**
+    \file nonlocal.h
+    \author Sachith Dunatunga
+    \date 17.10.2026
+
+    Persistent workspace for the nodal fluidity solve of the nonlocal
+    granular fluidity materials.
+
+    The diffusion matrix is the sum of 4x4 element blocks over the elements
+    that hold (contributing) particles, plus the diagonal. Between explicit
+    steps the nodes with mass and the contributing elements rarely change,
+    so the workspace keeps the node map, the compressed column pattern, the
+    position of every element block entry in it (the scatter map) and the
+    symbolic LU analysis (made on the first LU solve with a pattern), and
+    only rebuilds them when either set changes.
+    Otherwise a step only refills the values and refactors numerically.
+
+    The matrix is symmetric positive definite, so it can also be solved with
+    conjugate gradients preconditioned by its diagonal (Jacobi) or by an
+    incomplete Cholesky factor with the pattern of its lower triangle (IC(0)).
+    CG starts from the nodal solution of the previous step, which is usually
+    close since the fluidity changes slowly.
+
+    The third preconditioner is a geometric multigrid V-cycle (multigrid.h)
+    on the 9 point stencils the matrix has on the background grid. It needs
+    no factorization, so its cost grows linearly with the number of nodes.
+    It is not available when node_number_override couples nodes that are
+    not grid neighbors (periodic boundaries); IC(0) is used then.
+
+    The fluidity only comes from particles above yield (the sources, with a
+    nonzero load) and decays over a few cooperative lengths away from them.
+    With no sources the solution is zero and nonlocal_ws_pattern drops every
+    dof (slda becomes 0, the caller skips assembly and solve). With a
+    positive job->material.nonlocal.support_radius it only keeps the dofs
+    within that distance of a source element, counted in layers of
+    contributing elements, and the fluidity is zero on the dropped nodes.
+
+    The fluidity also changes much more slowly than the explicit time step
+    resolves. With job->material.nonlocal.solve_interval K > 1 the solve
+    only runs every K steps, or earlier once the nodal load has moved by
+    more than solve_tolerance (relative, in the 2-norm) from the load of the
+    last solve; the steps in between keep gf_nodes of the last solve.
+
+    Use from a material:
+
+        nonlocal_ws_begin(ws, job, tol);       node map, clears f
+        nonlocal_ws_use_element(ws, e);        for every contributing element
+        nonlocal_ws_mark_source(ws, e);        for elements with a nonzero load
+        (load into f)
+        if nonlocal_ws_solve_due(ws, job):
+            nonlocal_ws_pattern(ws, job);          restrict, reuse or rebuild
+            if slda is not 0:
+                nonlocal_ws_add(ws, e, ei, ej, v);     element block entries
+                nonlocal_ws_add_diagonal(ws, v);       optional
+                nonlocal_ws_solve(ws, job);            solution overwrites f
+            (copy f to gf_nodes)
+
+    Load entries (f) of the dropped dofs are discarded; loads added after
+    nonlocal_ws_pattern must skip nodes with node_map NONLOCAL_UNMAPPED.
+*/
+#ifndef __NONLOCAL_H__
+#define __NONLOCAL_H__
+#include <stdio.h>
+#include <stddef.h>
+#include <suitesparse/cs.h>
+#include "multigrid.h"
+
+#define NONLOCAL_UNMAPPED ((size_t)-1)
+
+struct job_s;
+
+typedef struct nonlocal_ws_s {
+    size_t num_nodes;
+    size_t num_elements;
+
+    /* dof of each node (after node_number_override) or NONLOCAL_UNMAPPED. */
+    size_t *node_map;
+    size_t *inv_node_map;
+    size_t slda;
+
+    /* map from the previous step, to detect changes. */
+    size_t *prev_inv_node_map;
+    size_t prev_slda;
+    int node_map_changed;
+
+    /* contributing elements of this step, in the order they were marked. */
+    unsigned char *element_used;
+    size_t *used_list;
+    size_t num_used;
+
+    /* elements with a nonzero load this step. */
+    unsigned char *element_source;
+    size_t *source_list;
+    size_t num_sources;
+
+    /* element layers between each dof and the nearest source. */
+    size_t *node_layer;
+
+    /* elements the pattern was built from, and their slot in that list. */
+    size_t *element_list;
+    size_t num_element_list;
+    size_t *element_slot;
+
+    /*
+        Matrix with the cached pattern. A->x[scatter[16 * slot + 4 * ei + ej]]
+        is entry (ei, ej) of the block of element element_list[slot] and
+        A->x[diag[k]] is diagonal entry k. Entries coupling to a dropped dof
+        have scatter NONLOCAL_UNMAPPED.
+    */
+    cs *A;
+    size_t *scatter;
+    size_t scatter_capacity;
+    size_t *diag;
+    css *S;
+    int pattern_valid;
+
+    /* load vector, overwritten by the solution (slda entries). */
+    double *f;
+    double *work;
+
+    /* nodal solution of the last solve, by node number. */
+    double *gf_nodes;
+
+    /*
+        load of the last solve by node number (0 on nodes without a dof),
+        steps since then and whether this step solves.
+    */
+    double *load_nodes;
+    int have_solution;
+    size_t steps_since_solve;
+    int due;
+
+    /*
+        IC(0) factor, lower triangle of the pattern of A with the diagonal
+        first in each column. Rebuilt with the pattern.
+    */
+    cs *L;
+
+    /* multigrid levels on the nodes of the background grid. */
+    mg_t mg;
+
+    /* CG vectors (slda entries). */
+    double *r;
+    double *z;
+    double *p;
+    double *q;
+
+    /* shared state of a threaded solve. */
+    double *partial;
+    size_t partial_capacity;
+    int precond;
+    int status;
+
+    /* counters since the workspace was created. */
+    size_t num_solves;
+    size_t num_pattern_builds;
+    size_t num_qr_fallbacks;
+    size_t num_pcg_iterations;
+    size_t max_pcg_iterations;
+    size_t num_pcg_fallbacks;
+    size_t num_ic0_breakdowns;
+    size_t num_mg_unavailable;
+    size_t num_steps;
+    size_t num_skipped_solves;
+    size_t num_restricted_solves;
+    size_t num_dropped_dofs;
+    size_t num_reused_steps;
+    size_t num_early_solves;
+
+    /* last PCG solve. */
+    size_t last_iterations;
+    double last_residual;
+} nonlocal_ws_t;
+
+/* Returns 0 on success, -1 if an allocation failed. */
+int nonlocal_ws_init(nonlocal_ws_t *ws, size_t num_nodes, size_t num_elements);
+void nonlocal_ws_free(nonlocal_ws_t *ws);
+
+/*
+    Start a step: map nodes with more than tol mass to dofs and clear f and
+    the element marks. Allocates the workspace on first use. Returns the
+    number of dofs; exits if the grid holds no mass.
+*/
+size_t nonlocal_ws_begin(nonlocal_ws_t *ws, struct job_s *job, double tol);
+
+static inline void nonlocal_ws_use_element(nonlocal_ws_t *ws, size_t e)
+{
+    if (!ws->element_used[e]) {
+        ws->element_used[e] = 1;
+        ws->used_list[ws->num_used++] = e;
+    }
+    return;
+}
+
+static inline void nonlocal_ws_mark_source(nonlocal_ws_t *ws, size_t e)
+{
+    if (!ws->element_source[e]) {
+        ws->element_source[e] = 1;
+        ws->source_list[ws->num_sources++] = e;
+    }
+    return;
+}
+
+/*
+    Call with the load in f, before nonlocal_ws_pattern. Returns 1 (also
+    kept in due) if this step solves: on the first step, every
+    solve_interval steps and when the load changed by more than
+    solve_tolerance since the last solve. Returns 0 if the caller should
+    keep gf_nodes; the dof map of the last pattern is restored then and the
+    rest of the step must not touch the workspace.
+*/
+int nonlocal_ws_solve_due(nonlocal_ws_t *ws, struct job_s *job);
+
+/*
+    Restrict the dofs to the support of the sources (none without sources).
+    Then reuse the pattern if the dofs and the marked elements are the same
+    as when it was built, otherwise rebuild it. Zeroes the matrix values.
+    Returns 0 on success, -1 if an allocation failed.
+*/
+int nonlocal_ws_pattern(nonlocal_ws_t *ws, struct job_s *job);
+
+/*
+    Add v to entry (ei, ej) of the block of marked element e, nothing if it
+    couples to a dropped dof.
+*/
+static inline void nonlocal_ws_add(nonlocal_ws_t *ws, size_t e, size_t ei,
+    size_t ej, double v)
+{
+    size_t k = ws->scatter[16 * ws->element_slot[e] + 4 * ei + ej];
+
+    if (k != NONLOCAL_UNMAPPED) {
+        ws->A->x[k] += v;
+    }
+    return;
+}
+
+void nonlocal_ws_add_diagonal(nonlocal_ws_t *ws, double v);
+
+/*
+    Solve in place in f with the solver in job->material.nonlocal. LU uses
+    the cached symbolic analysis (QR if that fails). PCG falls back to LU if
+    it does not converge in max_iterations. Returns 0 on success, -1 if no
+    solver succeeded.
+*/
+int nonlocal_ws_solve(nonlocal_ws_t *ws, struct job_s *job);
+
+/*
+    Same, called by all num_threads threads of the step (synchronized with
+    job->serialize_barrier). CG splits the dofs among the threads; the IC(0)
+    and multigrid preconditioners and the LU solve run on one of them.
+    Returns the same value on every thread.
+*/
+int nonlocal_ws_solve_threaded(nonlocal_ws_t *ws, struct job_s *job,
+    size_t thread_id, size_t num_threads);
+
+/*
+    Wait for the other threads of a threaded step at job->serialize_barrier.
+    Returns nonzero on exactly one thread, which runs the serial sections
+    (always with one thread, which doesn't wait).
+*/
+int nonlocal_sync_threads(const struct job_s *job, size_t num_threads);
+
+/* Summary of the counters. */
+void nonlocal_ws_report(const nonlocal_ws_t *ws, FILE *fd);
+
+#endif //__NONLOCAL_H__
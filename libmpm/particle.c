@@ -7,9 +7,533 @@
 */
 #include "particle.h"
 #include <math.h>
+#include <stdlib.h>
+#include <string.h>
 #define TOL 1e-10
 #define SGN(x) (((x) > 0) - ((x) < 0))
 
+/* Allocate a zeroed per-particle array, jumping to 'gotolabel' on failure. */
+#define STORE_ALLOC(ps, field, gotolabel) \
+    do { \
+        (ps)->field = calloc((ps)->num_particles, sizeof(*((ps)->field))); \
+        if ((ps)->field == NULL) { goto gotolabel; } \
+    } while(0)
+
+#define STORE_FREE(ps, field) \
+    do { free((ps)->field); (ps)->field = NULL; } while(0)
+
+/*---particle_store_alloc-----------------------------------------------------*/
+int particle_store_alloc(particle_store_t *ps, size_t num_particles)
+{
+    memset(ps, 0, sizeof(particle_store_t));
+    ps->num_particles = num_particles;
+
+    STORE_ALLOC(ps, x, _alloc_error);
+    STORE_ALLOC(ps, y, _alloc_error);
+    STORE_ALLOC(ps, xl, _alloc_error);
+    STORE_ALLOC(ps, yl, _alloc_error);
+    STORE_ALLOC(ps, x_t, _alloc_error);
+    STORE_ALLOC(ps, y_t, _alloc_error);
+    STORE_ALLOC(ps, x_tt, _alloc_error);
+    STORE_ALLOC(ps, y_tt, _alloc_error);
+    STORE_ALLOC(ps, ux, _alloc_error);
+    STORE_ALLOC(ps, uy, _alloc_error);
+    STORE_ALLOC(ps, bx, _alloc_error);
+    STORE_ALLOC(ps, by, _alloc_error);
+    STORE_ALLOC(ps, m, _alloc_error);
+    STORE_ALLOC(ps, v, _alloc_error);
+    STORE_ALLOC(ps, v0, _alloc_error);
+
+    STORE_ALLOC(ps, sxx, _alloc_error);
+    STORE_ALLOC(ps, sxy, _alloc_error);
+    STORE_ALLOC(ps, syy, _alloc_error);
+
+    STORE_ALLOC(ps, exx_t, _alloc_error);
+    STORE_ALLOC(ps, exy_t, _alloc_error);
+    STORE_ALLOC(ps, eyy_t, _alloc_error);
+    STORE_ALLOC(ps, wxy_t, _alloc_error);
+
+    STORE_ALLOC(ps, Fxx, _alloc_error);
+    STORE_ALLOC(ps, Fxy, _alloc_error);
+    STORE_ALLOC(ps, Fyx, _alloc_error);
+    STORE_ALLOC(ps, Fyy, _alloc_error);
+
+    STORE_ALLOC(ps, color, _alloc_error);
+
+    STORE_ALLOC(ps, T, _alloc_error);
+    STORE_ALLOC(ps, L, _alloc_error);
+    STORE_ALLOC(ps, state, _alloc_error);
+
+    STORE_ALLOC(ps, material, _alloc_error);
+    STORE_ALLOC(ps, material_data, _alloc_error);
+    STORE_ALLOC(ps, id, _alloc_error);
+
+    return 0;
+
+_alloc_error:
+    particle_store_free(ps);
+    return -1;
+}
+/*----------------------------------------------------------------------------*/
+
+/*---particle_store_alloc_cpdi------------------------------------------------*/
+int particle_store_alloc_cpdi(particle_store_t *ps)
+{
+    if (ps->corners != NULL) {
+        return 0;
+    }
+
+    STORE_ALLOC(ps, r1_initial, _alloc_error);
+    STORE_ALLOC(ps, r2_initial, _alloc_error);
+    STORE_ALLOC(ps, r1, _alloc_error);
+    STORE_ALLOC(ps, r2, _alloc_error);
+    STORE_ALLOC(ps, corners, _alloc_error);
+    STORE_ALLOC(ps, cornersl, _alloc_error);
+    STORE_ALLOC(ps, sc, _alloc_error);
+    STORE_ALLOC(ps, grad_sc, _alloc_error);
+    STORE_ALLOC(ps, corner_elements, _alloc_error);
+
+    /* set particle domains from the initial volume */
+    for (size_t i = 0; i < ps->num_particles; i++) {
+        ps->r1_initial[i][0] = 0.5 * sqrt(ps->v0[i]);
+        ps->r1_initial[i][1] = 0;
+        ps->r2_initial[i][0] = 0;
+        ps->r2_initial[i][1] = 0.5 * sqrt(ps->v0[i]);
+    }
+
+    return 0;
+
+_alloc_error:
+    STORE_FREE(ps, r1_initial);
+    STORE_FREE(ps, r2_initial);
+    STORE_FREE(ps, r1);
+    STORE_FREE(ps, r2);
+    STORE_FREE(ps, corners);
+    STORE_FREE(ps, cornersl);
+    STORE_FREE(ps, sc);
+    STORE_FREE(ps, grad_sc);
+    STORE_FREE(ps, corner_elements);
+    return -1;
+}
+/*----------------------------------------------------------------------------*/
+
+/*---particle_store_alloc_implicit--------------------------------------------*/
+int particle_store_alloc_implicit(particle_store_t *ps)
+{
+    if (ps->real_sxx != NULL) {
+        return 0;
+    }
+
+    STORE_ALLOC(ps, real_sxx, _alloc_error);
+    STORE_ALLOC(ps, real_sxy, _alloc_error);
+    STORE_ALLOC(ps, real_syy, _alloc_error);
+    STORE_ALLOC(ps, real_state, _alloc_error);
+
+    /* held values start at the current stress state. */
+    memcpy(ps->real_sxx, ps->sxx, ps->num_particles * sizeof(double));
+    memcpy(ps->real_sxy, ps->sxy, ps->num_particles * sizeof(double));
+    memcpy(ps->real_syy, ps->syy, ps->num_particles * sizeof(double));
+    memcpy(ps->real_state, ps->state, ps->num_particles * sizeof(*(ps->state)));
+
+    return 0;
+
+_alloc_error:
+    STORE_FREE(ps, real_sxx);
+    STORE_FREE(ps, real_sxy);
+    STORE_FREE(ps, real_syy);
+    STORE_FREE(ps, real_state);
+    return -1;
+}
+/*----------------------------------------------------------------------------*/
+
+/*---particle_store_free------------------------------------------------------*/
+void particle_store_free(particle_store_t *ps)
+{
+    STORE_FREE(ps, x);
+    STORE_FREE(ps, y);
+    STORE_FREE(ps, xl);
+    STORE_FREE(ps, yl);
+    STORE_FREE(ps, x_t);
+    STORE_FREE(ps, y_t);
+    STORE_FREE(ps, x_tt);
+    STORE_FREE(ps, y_tt);
+    STORE_FREE(ps, ux);
+    STORE_FREE(ps, uy);
+    STORE_FREE(ps, bx);
+    STORE_FREE(ps, by);
+    STORE_FREE(ps, m);
+    STORE_FREE(ps, v);
+    STORE_FREE(ps, v0);
+
+    STORE_FREE(ps, sxx);
+    STORE_FREE(ps, sxy);
+    STORE_FREE(ps, syy);
+
+    STORE_FREE(ps, exx_t);
+    STORE_FREE(ps, exy_t);
+    STORE_FREE(ps, eyy_t);
+    STORE_FREE(ps, wxy_t);
+
+    STORE_FREE(ps, Fxx);
+    STORE_FREE(ps, Fxy);
+    STORE_FREE(ps, Fyx);
+    STORE_FREE(ps, Fyy);
+
+    STORE_FREE(ps, color);
+
+    STORE_FREE(ps, T);
+    STORE_FREE(ps, L);
+    STORE_FREE(ps, state);
+
+    STORE_FREE(ps, material);
+    STORE_FREE(ps, material_data);
+    STORE_FREE(ps, id);
+
+    STORE_FREE(ps, r1_initial);
+    STORE_FREE(ps, r2_initial);
+    STORE_FREE(ps, r1);
+    STORE_FREE(ps, r2);
+    STORE_FREE(ps, corners);
+    STORE_FREE(ps, cornersl);
+    STORE_FREE(ps, sc);
+    STORE_FREE(ps, grad_sc);
+    STORE_FREE(ps, corner_elements);
+
+    STORE_FREE(ps, real_sxx);
+    STORE_FREE(ps, real_sxy);
+    STORE_FREE(ps, real_syy);
+    STORE_FREE(ps, real_state);
+
+    ps->num_particles = 0;
+
+    return;
+}
+/*----------------------------------------------------------------------------*/
+
+/* Gather field[perm[k]] into scratch[k], then copy back. */
+#define STORE_PERMUTE(ps, field, perm, scratch) \
+    do { \
+        if ((ps)->field != NULL) { \
+            permute_block((ps)->field, sizeof(*((ps)->field)), \
+                (ps)->num_particles, (perm), (scratch)); \
+        } \
+    } while(0)
+
+static void permute_block(void *field, size_t size, size_t n,
+    const size_t *perm, void *scratch)
+{
+    char *src = (char *)field;
+    char *dst = (char *)scratch;
+
+    for (size_t k = 0; k < n; k++) {
+        memcpy(dst + k * size, src + perm[k] * size, size);
+    }
+    memcpy(src, dst, n * size);
+
+    return;
+}
+
+/*---particle_store_permute---------------------------------------------------*/
+int particle_store_permute(particle_store_t *ps, const size_t *perm)
+{
+    void *scratch;
+    size_t block = sizeof(*(ps->state));
+
+    /* largest per-particle block (CPDI shape function gradients). */
+    if (sizeof(*(ps->grad_sc)) > block) {
+        block = sizeof(*(ps->grad_sc));
+    }
+
+    scratch = malloc(ps->num_particles * block);
+    if (scratch == NULL) {
+        return -1;
+    }
+
+    STORE_PERMUTE(ps, x, perm, scratch);
+    STORE_PERMUTE(ps, y, perm, scratch);
+    STORE_PERMUTE(ps, xl, perm, scratch);
+    STORE_PERMUTE(ps, yl, perm, scratch);
+    STORE_PERMUTE(ps, x_t, perm, scratch);
+    STORE_PERMUTE(ps, y_t, perm, scratch);
+    STORE_PERMUTE(ps, x_tt, perm, scratch);
+    STORE_PERMUTE(ps, y_tt, perm, scratch);
+    STORE_PERMUTE(ps, ux, perm, scratch);
+    STORE_PERMUTE(ps, uy, perm, scratch);
+    STORE_PERMUTE(ps, bx, perm, scratch);
+    STORE_PERMUTE(ps, by, perm, scratch);
+    STORE_PERMUTE(ps, m, perm, scratch);
+    STORE_PERMUTE(ps, v, perm, scratch);
+    STORE_PERMUTE(ps, v0, perm, scratch);
+
+    STORE_PERMUTE(ps, sxx, perm, scratch);
+    STORE_PERMUTE(ps, sxy, perm, scratch);
+    STORE_PERMUTE(ps, syy, perm, scratch);
+
+    STORE_PERMUTE(ps, exx_t, perm, scratch);
+    STORE_PERMUTE(ps, exy_t, perm, scratch);
+    STORE_PERMUTE(ps, eyy_t, perm, scratch);
+    STORE_PERMUTE(ps, wxy_t, perm, scratch);
+
+    STORE_PERMUTE(ps, Fxx, perm, scratch);
+    STORE_PERMUTE(ps, Fxy, perm, scratch);
+    STORE_PERMUTE(ps, Fyx, perm, scratch);
+    STORE_PERMUTE(ps, Fyy, perm, scratch);
+
+    STORE_PERMUTE(ps, color, perm, scratch);
+
+    STORE_PERMUTE(ps, T, perm, scratch);
+    STORE_PERMUTE(ps, L, perm, scratch);
+    STORE_PERMUTE(ps, state, perm, scratch);
+
+    STORE_PERMUTE(ps, material, perm, scratch);
+    STORE_PERMUTE(ps, material_data, perm, scratch);
+    STORE_PERMUTE(ps, id, perm, scratch);
+
+    STORE_PERMUTE(ps, r1_initial, perm, scratch);
+    STORE_PERMUTE(ps, r2_initial, perm, scratch);
+    STORE_PERMUTE(ps, r1, perm, scratch);
+    STORE_PERMUTE(ps, r2, perm, scratch);
+    STORE_PERMUTE(ps, corners, perm, scratch);
+    STORE_PERMUTE(ps, cornersl, perm, scratch);
+    STORE_PERMUTE(ps, sc, perm, scratch);
+    STORE_PERMUTE(ps, grad_sc, perm, scratch);
+    STORE_PERMUTE(ps, corner_elements, perm, scratch);
+
+    STORE_PERMUTE(ps, real_sxx, perm, scratch);
+    STORE_PERMUTE(ps, real_sxy, perm, scratch);
+    STORE_PERMUTE(ps, real_syy, perm, scratch);
+    STORE_PERMUTE(ps, real_state, perm, scratch);
+
+    free(scratch);
+
+    return 0;
+}
+/*----------------------------------------------------------------------------*/
+
+/* Exchange entries i and j of a field (if allocated). */
+#define STORE_SWAP(ps, field, i, j) \
+    do { \
+        if ((ps)->field != NULL) { \
+            swap_block(&((ps)->field[i]), &((ps)->field[j]), \
+                sizeof(*((ps)->field))); \
+        } \
+    } while(0)
+
+static void swap_block(void *a, void *b, size_t size)
+{
+    char tmp[256];
+    char *pa = (char *)a;
+    char *pb = (char *)b;
+
+    while (size > 0) {
+        size_t len = (size < sizeof(tmp)) ? size : sizeof(tmp);
+        memcpy(tmp, pa, len);
+        memcpy(pa, pb, len);
+        memcpy(pb, tmp, len);
+        pa += len;
+        pb += len;
+        size -= len;
+    }
+
+    return;
+}
+
+/*---particle_store_swap------------------------------------------------------*/
+void particle_store_swap(particle_store_t *ps, size_t i, size_t j)
+{
+    STORE_SWAP(ps, x, i, j);
+    STORE_SWAP(ps, y, i, j);
+    STORE_SWAP(ps, xl, i, j);
+    STORE_SWAP(ps, yl, i, j);
+    STORE_SWAP(ps, x_t, i, j);
+    STORE_SWAP(ps, y_t, i, j);
+    STORE_SWAP(ps, x_tt, i, j);
+    STORE_SWAP(ps, y_tt, i, j);
+    STORE_SWAP(ps, ux, i, j);
+    STORE_SWAP(ps, uy, i, j);
+    STORE_SWAP(ps, bx, i, j);
+    STORE_SWAP(ps, by, i, j);
+    STORE_SWAP(ps, m, i, j);
+    STORE_SWAP(ps, v, i, j);
+    STORE_SWAP(ps, v0, i, j);
+
+    STORE_SWAP(ps, sxx, i, j);
+    STORE_SWAP(ps, sxy, i, j);
+    STORE_SWAP(ps, syy, i, j);
+
+    STORE_SWAP(ps, exx_t, i, j);
+    STORE_SWAP(ps, exy_t, i, j);
+    STORE_SWAP(ps, eyy_t, i, j);
+    STORE_SWAP(ps, wxy_t, i, j);
+
+    STORE_SWAP(ps, Fxx, i, j);
+    STORE_SWAP(ps, Fxy, i, j);
+    STORE_SWAP(ps, Fyx, i, j);
+    STORE_SWAP(ps, Fyy, i, j);
+
+    STORE_SWAP(ps, color, i, j);
+
+    STORE_SWAP(ps, T, i, j);
+    STORE_SWAP(ps, L, i, j);
+    STORE_SWAP(ps, state, i, j);
+
+    STORE_SWAP(ps, material, i, j);
+    STORE_SWAP(ps, material_data, i, j);
+    STORE_SWAP(ps, id, i, j);
+
+    STORE_SWAP(ps, r1_initial, i, j);
+    STORE_SWAP(ps, r2_initial, i, j);
+    STORE_SWAP(ps, r1, i, j);
+    STORE_SWAP(ps, r2, i, j);
+    STORE_SWAP(ps, corners, i, j);
+    STORE_SWAP(ps, cornersl, i, j);
+    STORE_SWAP(ps, sc, i, j);
+    STORE_SWAP(ps, grad_sc, i, j);
+    STORE_SWAP(ps, corner_elements, i, j);
+
+    STORE_SWAP(ps, real_sxx, i, j);
+    STORE_SWAP(ps, real_sxy, i, j);
+    STORE_SWAP(ps, real_syy, i, j);
+    STORE_SWAP(ps, real_state, i, j);
+
+    return;
+}
+/*----------------------------------------------------------------------------*/
+
+/*---particle_store_set-------------------------------------------------------*/
+void particle_store_set(particle_store_t *ps, size_t i, const particle_t *p)
+{
+    ps->x[i] = p->x;
+    ps->y[i] = p->y;
+    ps->xl[i] = p->xl;
+    ps->yl[i] = p->yl;
+    ps->x_t[i] = p->x_t;
+    ps->y_t[i] = p->y_t;
+    ps->x_tt[i] = p->x_tt;
+    ps->y_tt[i] = p->y_tt;
+    ps->ux[i] = p->ux;
+    ps->uy[i] = p->uy;
+    ps->bx[i] = p->bx;
+    ps->by[i] = p->by;
+    ps->m[i] = p->m;
+    ps->v[i] = p->v;
+    ps->v0[i] = p->v0;
+
+    ps->sxx[i] = p->sxx;
+    ps->sxy[i] = p->sxy;
+    ps->syy[i] = p->syy;
+
+    ps->exx_t[i] = p->exx_t;
+    ps->exy_t[i] = p->exy_t;
+    ps->eyy_t[i] = p->eyy_t;
+    ps->wxy_t[i] = p->wxy_t;
+
+    ps->Fxx[i] = p->Fxx;
+    ps->Fxy[i] = p->Fxy;
+    ps->Fyx[i] = p->Fyx;
+    ps->Fyy[i] = p->Fyy;
+
+    ps->color[i] = p->color;
+
+    memcpy(ps->T[i], p->T, sizeof(p->T));
+    memcpy(ps->L[i], p->L, sizeof(p->L));
+    memcpy(ps->state[i], p->state, sizeof(p->state));
+
+    ps->material[i] = p->material;
+    ps->material_data[i] = p->material_data;
+    ps->id[i] = p->id;
+
+    if (ps->corners != NULL) {
+        memcpy(ps->r1_initial[i], p->r1_initial, sizeof(p->r1_initial));
+        memcpy(ps->r2_initial[i], p->r2_initial, sizeof(p->r2_initial));
+        memcpy(ps->r1[i], p->r1, sizeof(p->r1));
+        memcpy(ps->r2[i], p->r2, sizeof(p->r2));
+        memcpy(ps->corners[i], p->corners, sizeof(p->corners));
+        memcpy(ps->cornersl[i], p->cornersl, sizeof(p->cornersl));
+        memcpy(ps->sc[i], p->sc, sizeof(p->sc));
+        memcpy(ps->grad_sc[i], p->grad_sc, sizeof(p->grad_sc));
+        memcpy(ps->corner_elements[i], p->corner_elements, sizeof(p->corner_elements));
+    }
+
+    if (ps->real_sxx != NULL) {
+        ps->real_sxx[i] = p->real_sxx;
+        ps->real_sxy[i] = p->real_sxy;
+        ps->real_syy[i] = p->real_syy;
+        memcpy(ps->real_state[i], p->real_state, sizeof(p->real_state));
+    }
+
+    return;
+}
+/*----------------------------------------------------------------------------*/
+
+/*---particle_store_get-------------------------------------------------------*/
+void particle_store_get(const particle_store_t *ps, size_t i, particle_t *p)
+{
+    memset(p, 0, sizeof(particle_t));
+
+    p->x = ps->x[i];
+    p->y = ps->y[i];
+    p->xl = ps->xl[i];
+    p->yl = ps->yl[i];
+    p->x_t = ps->x_t[i];
+    p->y_t = ps->y_t[i];
+    p->x_tt = ps->x_tt[i];
+    p->y_tt = ps->y_tt[i];
+    p->ux = ps->ux[i];
+    p->uy = ps->uy[i];
+    p->bx = ps->bx[i];
+    p->by = ps->by[i];
+    p->m = ps->m[i];
+    p->v = ps->v[i];
+    p->v0 = ps->v0[i];
+
+    p->sxx = ps->sxx[i];
+    p->sxy = ps->sxy[i];
+    p->syy = ps->syy[i];
+
+    p->exx_t = ps->exx_t[i];
+    p->exy_t = ps->exy_t[i];
+    p->eyy_t = ps->eyy_t[i];
+    p->wxy_t = ps->wxy_t[i];
+
+    p->Fxx = ps->Fxx[i];
+    p->Fxy = ps->Fxy[i];
+    p->Fyx = ps->Fyx[i];
+    p->Fyy = ps->Fyy[i];
+
+    p->color = ps->color[i];
+
+    memcpy(p->T, ps->T[i], sizeof(p->T));
+    memcpy(p->L, ps->L[i], sizeof(p->L));
+    memcpy(p->state, ps->state[i], sizeof(p->state));
+
+    p->material = ps->material[i];
+    p->material_data = ps->material_data[i];
+    p->id = ps->id[i];
+
+    if (ps->corners != NULL) {
+        memcpy(p->r1_initial, ps->r1_initial[i], sizeof(p->r1_initial));
+        memcpy(p->r2_initial, ps->r2_initial[i], sizeof(p->r2_initial));
+        memcpy(p->r1, ps->r1[i], sizeof(p->r1));
+        memcpy(p->r2, ps->r2[i], sizeof(p->r2));
+        memcpy(p->corners, ps->corners[i], sizeof(p->corners));
+        memcpy(p->cornersl, ps->cornersl[i], sizeof(p->cornersl));
+        memcpy(p->sc, ps->sc[i], sizeof(p->sc));
+        memcpy(p->grad_sc, ps->grad_sc[i], sizeof(p->grad_sc));
+        memcpy(p->corner_elements, ps->corner_elements[i], sizeof(p->corner_elements));
+    }
+
+    if (ps->real_sxx != NULL) {
+        p->real_sxx = ps->real_sxx[i];
+        p->real_sxy = ps->real_sxy[i];
+        p->real_syy = ps->real_syy[i];
+        memcpy(p->real_state, ps->real_state[i], sizeof(p->real_state));
+    }
+
+    return;
+}
+/*----------------------------------------------------------------------------*/
+
 /*---global_to_local_coords---------------------------------------------------*/
 void global_to_local_coords(double *x_local, double *y_local,
     double x, double y, 
@@ -4,6 +4,11 @@
     \date 04.06.12
 
     Contains the structure for particles in MPM.
+
+    particle_t is the record for a single particle and is only used for
+    input/output. During a simulation, particle data lives in a
+    particle_store_t, where each field is a separate contiguous array indexed
+    by particle number.
 */
 #include <stddef.h>
 
@@ -146,6 +151,126 @@ typedef struct particle_s {
     size_t id;
 } particle_t;
 
+/*
+    Structure-of-arrays particle storage. Each field is allocated as its own
+    array of num_particles entries, so field X of particle i is ps->X[i]. Small
+    fixed size per-particle quantities (tensors, state variables, CPDI corner
+    data) are stored as arrays of blocks, e.g. ps->state[i][k].
+
+    The CPDI and implicit solver fields are not needed by the explicit solver
+    and are left NULL unless allocated with particle_store_alloc_cpdi or
+    particle_store_alloc_implicit.
+*/
+typedef struct particle_store_s {
+    size_t num_particles;
+
+    /* Position */
+    double *x;
+    double *y;
+
+    /* Local Coordinates */
+    double *xl;
+    double *yl;
+
+    /* Velocity */
+    double *x_t;
+    double *y_t;
+
+    /* Acceleration */
+    double *x_tt;
+    double *y_tt;
+
+    /* Displacements */
+    double *ux;
+    double *uy;
+
+    /* Body forces */
+    double *bx;
+    double *by;
+
+    /* Mass */
+    double *m;
+
+    /* Volume and initial volume */
+    double *v;
+    double *v0;
+
+    /* Stress */
+    double *sxx;
+    double *sxy;
+    double *syy;
+
+    /* Strain rate */
+    double *exx_t;
+    double *exy_t;
+    double *eyy_t;
+    double *wxy_t;
+
+    /* Deformation gradient tensor */
+    double *Fxx;
+    double *Fxy;
+    double *Fyx;
+    double *Fyy;
+
+    /* Color used by splot visualization */
+    double *color;
+
+    /* full 3D stress tensor */
+    double (*T)[NDIM*NDIM];
+
+    /* full 3D velocity gradient tensor */
+    double (*L)[NDIM*NDIM];
+
+    /* State Variables (for constitutive law) */
+    double (*state)[DEPVAR];
+
+    /* Material Type */
+    int *material;
+
+    /* material specific data structure, can be defined in material_init */
+    void **material_data;
+
+    /* unique id, so particles can be tracked between frames */
+    size_t *id;
+
+    /* CPDI domain data (NULL unless CPDI is enabled). */
+    double (*r1_initial)[2];
+    double (*r2_initial)[2];
+    double (*r1)[2];
+    double (*r2)[2];
+    double (*corners)[4][2];
+    double (*cornersl)[4][2];
+    double (*sc)[4][4];
+    double (*grad_sc)[4][4][2];
+    int (*corner_elements)[4];
+
+    /* held stress for each implicit step (NULL unless implicit is used). */
+    double *real_sxx;
+    double *real_sxy;
+    double *real_syy;
+    double (*real_state)[DEPVAR];
+} particle_store_t;
+
+/* Returns 0 on success, -1 if an allocation failed. */
+int particle_store_alloc(particle_store_t *ps, size_t num_particles);
+int particle_store_alloc_cpdi(particle_store_t *ps);
+int particle_store_alloc_implicit(particle_store_t *ps);
+void particle_store_free(particle_store_t *ps);
+
+/* Copy a single particle record into or out of the store at index i. */
+void particle_store_set(particle_store_t *ps, size_t i, const particle_t *p);
+void particle_store_get(const particle_store_t *ps, size_t i, particle_t *p);
+
+/*
+    Reorder every allocated field so that new particle k is old particle
+    perm[k]. Returns 0 on success, -1 if the scratch buffer can't be allocated
+    (the store is left unchanged).
+*/
+int particle_store_permute(particle_store_t *ps, const size_t *perm);
+
+/* Exchange particles i and j in every allocated field. */
+void particle_store_swap(particle_store_t *ps, size_t i, size_t j);
+
 /*
     Convert global coordinates to local coordinates of a square element with
     size h by h and bottom left corner at (x_ref, y_ref).
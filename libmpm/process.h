@@ -10,6 +10,11 @@
 #include "particle.h"
 #include "node.h"
 #include "element.h"
+#include "scheduler.h"
+#include "profile.h"
+#include "tiles.h"
+#include "nodal_field.h"
+#include "boundary.h"
 #include <stdio.h>
 #include <pthread.h>
 
@@ -22,6 +27,34 @@ enum solver_e {
     NUM_SOLVERS
 };
 
+/* how particle data is mapped to the grid in the explicit solvers. */
+enum p2g_engine_e {
+    P2G_COLORED=0,
+    P2G_BANDED,
+    NUM_P2G_ENGINES
+};
+
+/* how grid data is mapped back to particles in the explicit USL solver. */
+enum g2p_engine_e {
+    G2P_SPLIT=0,
+    G2P_FUSED,
+    NUM_G2P_ENGINES
+};
+
+/* how the nonlocal materials solve for the nodal fluidity. */
+enum nonlocal_solver_e {
+    NONLOCAL_SOLVER_LU=0,
+    NONLOCAL_SOLVER_PCG,
+    NUM_NONLOCAL_SOLVERS
+};
+
+enum nonlocal_precond_e {
+    NONLOCAL_PRECOND_JACOBI=0,
+    NONLOCAL_PRECOND_IC0,
+    NONLOCAL_PRECOND_MG,
+    NUM_NONLOCAL_PRECONDS
+};
+
 typedef struct material_s {
     double E;
     double nu;
@@ -55,17 +88,37 @@ typedef struct op_control_s {
     char *element_filename;
     char *state_filename;
     char *log_filename;
+    char *retired_filename;
 
     char *particle_filename_fullpath;
     char *element_filename_fullpath;
     char *state_filename_fullpath;
     char *log_filename_fullpath;
+    char *retired_filename_fullpath;
 
     FILE *particle_fd;
     FILE *element_fd;
     FILE *state_fd;
     FILE *log_fd;
 
+    /*
+        If retire_inactive is set, particles that left the grid are appended
+        to retired_fd once and are no longer written to the particle frames.
+        Particles [num_active, retired_mark) have not been written yet.
+    */
+    int retire_inactive;
+    FILE *retired_fd;
+    size_t retired_mark;
+
+    /*
+        Step profiling: totals are written to profile.csv and profile.json at
+        the end of the run, and to profile_fd every frame if per frame
+        profiling is on.
+    */
+    int profile;
+    int profile_per_frame;
+    FILE *profile_fd;
+
     FILE *info_fd;
 
     char *job_name;
@@ -82,9 +135,70 @@ typedef struct op_control_s {
     double sample_rate_hz;
 } output_control_t;
 
+typedef struct nl_control_s {
+    enum nonlocal_solver_e solver;
+    enum nonlocal_precond_e preconditioner;
+
+    /* PCG stops at |r| <= tolerance * |b|, or falls back to LU. */
+    double tolerance;
+    int max_iterations;
+
+    /*
+        only solve within this distance of particles above yield, 0 solves
+        on every node with mass.
+    */
+    double support_radius;
+
+    /*
+        solve every solve_interval steps, or earlier once the nodal load
+        changed by more than solve_tolerance (relative, 0 never).
+    */
+    int solve_interval;
+    double solve_tolerance;
+
+    /* write support size, iterations and residual of every step to the log. */
+    int log_iterations;
+} nonlocal_control_t;
+
 // forward declare the job structure
 struct job_s;
 
+/*
+    A contiguous block of particles for the batch material entry point. Each
+    array points at the first particle of the block and has n entries, so
+    entry i is particle (first + i) of the particle store.
+*/
+typedef struct material_batch_s {
+    size_t n;
+    double dt;
+
+    /* strain rate and spin. */
+    const double *exx_t;
+    const double *exy_t;
+    const double *eyy_t;
+    const double *wxy_t;
+
+    /* stress, updated in place (T is the 3x3 stress of 3D materials). */
+    double *sxx;
+    double *sxy;
+    double *syy;
+    double (*T)[NDIM*NDIM];
+
+    /* velocity gradient of 3D materials (set by the material). */
+    double (*L)[NDIM*NDIM];
+
+    double (*state)[DEPVAR];
+
+    /* mass and volume, the density is m / v. */
+    const double *m;
+    const double *v;
+
+    const double *fp64_props;
+    const int *int_props;
+    size_t num_fp64_props;
+    size_t num_int_props;
+} material_batch_t;
+
 typedef struct mat_control_s {
     const char *material_filename;
     int use_builtin;
@@ -92,10 +206,25 @@ typedef struct mat_control_s {
     void (*calculate_stress)(struct job_s *);
     void (*calculate_stress_threaded)(void *);
 
+    /*
+        Optional. Local materials (no barriers, each particle only touches
+        its own data) can export calculate_stress_batch; the explicit USL
+        stepper then updates the stress of each G2P chunk right after its
+        strain rate, in blocks of MATERIAL_BATCH_SIZE particles. NULL if the
+        material doesn't have one.
+    */
+    void (*calculate_stress_batch)(material_batch_t *);
+
     double *fp64_props;
     int *int_props;
     size_t num_fp64_props;
     size_t num_int_props;
+
+    /* set nonzero by material_init if it could not set up the material. */
+    int init_error;
+
+    /* only used by the nonlocal materials. */
+    nonlocal_control_t nonlocal;
 } material_control_t;
 
 typedef struct bc_control_s {
@@ -106,6 +235,13 @@ typedef struct bc_control_s {
     void (*bc_time_varying)(void *);
     void (*bc_momentum)(void *);
     void (*bc_force)(void *);
+
+    /*
+        Optional, called by every thread with its threadtask_t. NULL if the
+        plugin only has the serial versions above.
+    */
+    void (*bc_momentum_threaded)(void *);
+    void (*bc_force_threaded)(void *);
     
     double *fp64_props;
     int *int_props;
@@ -121,6 +257,15 @@ typedef struct job_s {
     int stepcount;
 
     size_t num_particles;
+
+    /*
+        Particles [0, num_active) are active, the rest have left the grid.
+        num_deactivated counts particles marked inactive since the last
+        compaction.
+    */
+    size_t num_active;
+    size_t num_deactivated;
+
     size_t num_nodes;
     size_t num_elements;
     size_t num_colors;
@@ -128,23 +273,80 @@ typedef struct job_s {
 //    size_t *color_list_lengths;
 //    size_t **element_id_by_color;
 
-    /* offsets are arranged [t0c0, t0c1 ... t1c0, t1c1]. */
-//    size_t *particle_by_element_color_offsets;
-//    size_t *particle_by_element_color_lengths;
-//    size_t *particle_by_element_color_list;
-    size_t *particle_by_element_color_lengths;
-    size_t **particle_by_element_color_lists;
+    /*
+        Active particles bucketed by (thread, element color). Offsets are
+        arranged [t0c0, t0c1 ... t1c0, t1c1 ...] with one extra entry at the
+        end, and bucket tc is particle_by_element_color_list[offsets[tc]] up
+        to (not including) particle_by_element_color_list[offsets[tc+1]].
+    */
+    size_t *particle_by_element_color_offsets;
+    size_t *particle_by_element_color_list;
 
-    size_t N;
+    /*
+        Scratch counts used by find_filled_elements_threaded, arranged
+        [thread][color] and [thread][thread list][color] respectively.
+    */
+    size_t *element_color_counts;
+    size_t *particle_color_counts;
+
+    /*
+        Used by the banded particle to grid map. The active particles in
+        element e are element_particle_list[element_particle_offsets[e]] up to
+        (not including) element_particle_list[element_particle_offsets[e+1]].
+        Offsets are only set for elements of active tiles. Thread t maps
+        element rows [p2g_row_bounds[t], p2g_row_bounds[t+1]).
+    */
+    enum p2g_engine_e p2g_engine;
+    size_t *element_particle_offsets;
+    size_t *element_particle_list;
+    size_t *p2g_row_bounds;
+
+    /*
+        G2P_SPLIT updates particle velocity/position, strain rate and volume
+        in separate passes. G2P_FUSED does all of it in one pass over each
+        particle's nodes (with CPDI the split passes are always used).
+    */
+    enum g2p_engine_e g2p_engine;
+
+    /*
+        The grid has Nx by Ny nodes with spacing h (elements are square). It
+        covers [x0, x1) by [y0, y1), particles outside are deactivated.
+    */
+    size_t Nx;
+    size_t Ny;
     double h;
+    double x0;
+    double y0;
+    double x1;
+    double y1;
 
     int use_cpdi;
     struct timespec tic, toc;
 
-    node_t *nodes;
-    particle_t *particles;
+    node_store_t nodes;
+    particle_store_t particles;
     element_t *elements;
 
+    /*
+        Nodal fields registered by the material and boundary conditions,
+        cleared and mapped along with the node store (see nodal_field.h).
+    */
+    nodal_field_registry_t nodal_fields;
+
+    /*
+        Cold per element data, NULL unless allocated with element_fields_alloc
+        or element_implicit_alloc.
+    */
+    element_fields_t *element_fields;
+    element_implicit_t *element_implicit;
+
+    /*
+        Tiles of the grid that hold particles (plus a one tile halo). The
+        explicit solver only clears and updates nodes and elements of active
+        tiles, and sets up their geometry the first time they are activated.
+    */
+    grid_tiles_t tiles;
+
     int *in_element;
     int *active;
 
@@ -181,6 +383,9 @@ typedef struct job_s {
     */
     int *node_number_override;
 
+    /* constrained dofs published by the boundary condition plugin. */
+    bc_constraints_t bc_constraints;
+
     int vec_len;
 
     /* solver type */
@@ -210,6 +415,22 @@ typedef struct job_s {
 
     int *update_elementlists;
     int *update_elementlists_flag;
+
+    /*
+        Particles are reordered by element when the element lists are rebuilt
+        and at least reorder_interval steps have passed since the last
+        reordering (0 disables). particle_index[id] is the current index of
+        the particle with that id.
+    */
+    int reorder_interval;
+    int steps_since_reorder;
+    size_t *particle_index;
+
+    /* dynamic scheduling of particle loops in the explicit solver. */
+    particle_sched_t sched;
+
+    /* per phase timing of the explicit solver (disabled by default). */
+    step_profile_t profile;
 } job_t;
 
 typedef struct s_threadtask {
@@ -248,7 +469,8 @@ typedef struct s_threadtask {
     job_t *job;
 } threadtask_t;
 
-job_t *mpm_init(int N, double h, particle_t *particles, size_t num_particles, double t);
+job_t *mpm_init(int Nx, int Ny, double x0, double y0, double lx, double ly,
+    particle_t *particles, size_t num_particles, double t);
 void explicit_mpm_step_usl_threaded(void *_task);
 void mpm_cleanup(job_t *job);
 
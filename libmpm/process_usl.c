@@ -19,6 +19,8 @@
 #include "material.h"
 #include "exitcodes.h"
 #include "map.h"
+#include "scheduler.h"
+#include "profile.h"
 #include <suitesparse/cs.h>
 
 #include <assert.h>
@@ -39,36 +41,39 @@
 #define __N(j,p,n) j->elements[__E(j,p)].nodes[n]
 #define __NE(j,e,n) j->elements[e].nodes[n]
 
-/* XXX: ugly, fix soon */
-#define WHICH_ELEMENT4(xp,yp,N,h) \
-    ((int)(((xp)<1.0 && (xp)>=0.0 && (yp)<1.0 && (yp)>=0.0)?((floor((xp)/(h)) + floor((yp)/(h))*((N)-1))):(-1)))
+/* Element holding (xp, yp) on the grid of job j, -1 if it's off the grid. */
+#define WHICH_ELEMENT4(xp,yp,j) \
+    ((int)(((xp)<(j)->x1 && (xp)>=(j)->x0 && (yp)<(j)->y1 && (yp)>=(j)->y0)? \
+        ((floor(((xp)-(j)->x0)/(j)->h) + floor(((yp)-(j)->y0)/(j)->h)*((j)->Nx-1))):(-1)))
 
 #define ACCUMULATE4(acc_tok,j,tok,i,n,s) \
-    j->nodes[__N(j,i,0)].acc_tok += j->s ## 1[i] * j->particles[i].tok; \
-    j->nodes[__N(j,i,1)].acc_tok += j->s ## 2[i] * j->particles[i].tok; \
-    j->nodes[__N(j,i,2)].acc_tok += j->s ## 3[i] * j->particles[i].tok; \
-    j->nodes[__N(j,i,3)].acc_tok += j->s ## 4[i] * j->particles[i].tok;
+    j->nodes.acc_tok[__N(j,i,0)] += j->s ## 1[i] * j->particles.tok[i]; \
+    j->nodes.acc_tok[__N(j,i,1)] += j->s ## 2[i] * j->particles.tok[i]; \
+    j->nodes.acc_tok[__N(j,i,2)] += j->s ## 3[i] * j->particles.tok[i]; \
+    j->nodes.acc_tok[__N(j,i,3)] += j->s ## 4[i] * j->particles.tok[i];
 
 #define ACCUMULATE_WITH_MUL4(acc_tok,j,tok,i,n,s,c) \
-    j->nodes[__N(j,i,0)].acc_tok += j->s ## 1[i] * j->particles[i].tok * (c); \
-    j->nodes[__N(j,i,1)].acc_tok += j->s ## 2[i] * j->particles[i].tok * (c); \
-    j->nodes[__N(j,i,2)].acc_tok += j->s ## 3[i] * j->particles[i].tok * (c); \
-    j->nodes[__N(j,i,3)].acc_tok += j->s ## 4[i] * j->particles[i].tok * (c);
+    j->nodes.acc_tok[__N(j,i,0)] += j->s ## 1[i] * j->particles.tok[i] * (c); \
+    j->nodes.acc_tok[__N(j,i,1)] += j->s ## 2[i] * j->particles.tok[i] * (c); \
+    j->nodes.acc_tok[__N(j,i,2)] += j->s ## 3[i] * j->particles.tok[i] * (c); \
+    j->nodes.acc_tok[__N(j,i,3)] += j->s ## 4[i] * j->particles.tok[i] * (c);
 
 #define SMEAR4(j,tok,i,s) ( \
-    j->s ## 1[i] * j->nodes[__N(j,i,0)].tok + \
-    j->s ## 2[i] * j->nodes[__N(j,i,1)].tok + \
-    j->s ## 3[i] * j->nodes[__N(j,i,2)].tok + \
-    j->s ## 4[i] * j->nodes[__N(j,i,3)].tok \
+    j->s ## 1[i] * j->nodes.tok[__N(j,i,0)] + \
+    j->s ## 2[i] * j->nodes.tok[__N(j,i,1)] + \
+    j->s ## 3[i] * j->nodes.tok[__N(j,i,2)] + \
+    j->s ## 4[i] * j->nodes.tok[__N(j,i,3)] \
 )
 
 #define CHECK_ACTIVE(j,i) if (j->active[i] == 0) { continue; }
 
+/* particles per call to the shape function batch kernel. */
+#define SF_BLOCK 256
+
 /*----------------------------------------------------------------------------*/
-job_t *mpm_init(int N, double h, particle_t *particles, size_t num_particles, double t)
+job_t *mpm_init(int Nx, int Ny, double x0, double y0, double lx, double ly,
+    particle_t *particles, size_t num_particles, double t)
 {
-    int n;
-
     job_t *job;
 
     job = (job_t *)malloc(sizeof(job_t));
@@ -77,126 +82,88 @@ job_t *mpm_init(int N, double h, particle_t *particles, size_t num_particles, do
     job->t_stop = t;
     job->frame = 0;
 
-    job->N = N;
-    job->h = h;
-    job->num_nodes = N*N;
+    /* elements are square, so ly / (Ny - 1) is the same spacing. */
+    job->Nx = Nx;
+    job->Ny = Ny;
+    job->h = lx / (Nx - 1);
+    job->x0 = x0;
+    job->y0 = y0;
+    job->x1 = x0 + lx;
+    job->y1 = y0 + ly;
+    job->num_nodes = Nx*Ny;
     job->num_particles = num_particles;
 
-    job->num_elements = (N - 1) * (N - 1);
+    job->num_elements = (Nx - 1) * (Ny - 1);
 
     /* Copy particles from given ICs. */
-    job->particles = (particle_t *)calloc(num_particles, sizeof(particle_t));
-    memcpy(job->particles, particles, num_particles * sizeof(particle_t));
+    if (particle_store_alloc(&(job->particles), num_particles) != 0) {
+        fprintf(stderr, "%s:%s: Unable to allocate particle storage.\n",
+            __FILE__, __func__);
+        free(job);
+        return NULL;
+    }
+    for (size_t i = 0; i < job->num_particles; i++) {
+        particle_store_set(&(job->particles), i, &(particles[i]));
+    }
 
     /* Set stress, strain to zero. */
     for (size_t i = 0; i < job->num_particles; i++) {
-        job->particles[i].real_sxx = job->particles[i].sxx;
-        job->particles[i].real_sxy = job->particles[i].sxy;
-        job->particles[i].real_syy = job->particles[i].syy;
-
-        job->particles[i].exx_t = 0;
-        job->particles[i].exy_t = 0;
-        job->particles[i].eyy_t = 0;
-        job->particles[i].wxy_t = 0;
+        job->particles.exx_t[i] = 0;
+        job->particles.exy_t[i] = 0;
+        job->particles.eyy_t[i] = 0;
+        job->particles.wxy_t[i] = 0;
 
-        job->particles[i].Fxx = 1;
-        job->particles[i].Fxy = 0;
-        job->particles[i].Fyx = 0;
-        job->particles[i].Fyy = 1;
+        job->particles.Fxx[i] = 1;
+        job->particles.Fxy[i] = 0;
+        job->particles.Fyx[i] = 0;
+        job->particles.Fyy[i] = 1;
 
-        job->particles[i].ux = 0;
-        job->particles[i].uy = 0;
+        job->particles.ux[i] = 0;
+        job->particles.uy[i] = 0;
 
-        job->particles[i].material_data = NULL;
+        job->particles.material_data[i] = NULL;
 
-        job->particles[i].id = i;
+        job->particles.id[i] = i;
 
-        job->particles[i].state[9] = 0;
-        job->particles[i].state[10] = 0;
+        job->particles.state[i][9] = 0;
+        job->particles.state[i][10] = 0;
 
-        job->particles[i].corners[0][0] = 0;
-        job->particles[i].corners[0][1] = 0;
-        job->particles[i].corners[1][0] = 0;
-        job->particles[i].corners[1][1] = 0;
-        job->particles[i].corners[2][0] = 0;
-        job->particles[i].corners[2][1] = 0;
-        job->particles[i].corners[3][0] = 0;
-        job->particles[i].corners[3][1] = 0;
-        job->particles[i].color = 0;
+        job->particles.color[i] = 0;
     }
 
-    /* Get node coordinates. */
-    job->nodes = (node_t *)calloc(job->num_nodes, sizeof(node_t));
-    for (size_t i = 0; i < job->num_nodes; i++) {
-        node_number_to_coords(&(job->nodes[i].x), &(job->nodes[i].y), i, N, h);
-        /* printf("preprocessing: xn=%g yn=%g\n", job->nodes[i].x, job->nodes[i].y); */
+    /*
+        Node coordinates, element connectivity and colors are set
+        up tile by tile as tiles become active (see init_tile_geometry).
+    */
+    if (node_store_alloc(&(job->nodes), job->num_nodes) != 0) {
+        fprintf(stderr, "%s:%s: Unable to allocate node storage.\n",
+            __FILE__, __func__);
+        particle_store_free(&(job->particles));
+        free(job);
+        return NULL;
     }
-
-    /* Get node numbering for elements. */
+    memset(&(job->nodal_fields), 0, sizeof(nodal_field_registry_t));
     job->elements = (element_t *)calloc(job->num_elements, sizeof(element_t));
-    for (size_t i = 0; i < job->num_elements; i++) {
-        n = ijton(i % (job->N - 1), i / (job->N - 1), job->N);
-
-        job->elements[i].nodes[0] = n + ijton(0,0,job->N);
-        job->elements[i].nodes[1] = n + ijton(1,0,job->N);
-        job->elements[i].nodes[2] = n + ijton(1,1,job->N);
-        job->elements[i].nodes[3] = n + ijton(0,1,job->N);
+    job->element_fields = NULL;
+    job->element_implicit = NULL;
+    if (grid_tiles_init(&(job->tiles), job->Nx - 1, job->Ny - 1,
+            GRID_TILE_SIZE) != 0) {
+        fprintf(stderr, "%s:%s: Unable to allocate grid tiles.\n",
+            __FILE__, __func__);
+        node_store_free(&(job->nodes));
+        free(job->elements);
+        particle_store_free(&(job->particles));
+        free(job);
+        return NULL;
     }
 
-    /* Find element neighbors and color element -- cartesian grid only! */
+    /* Color elements -- cartesian grid only! */
     job->num_colors = 4;
     job->color_indices = (size_t *)malloc(job->num_colors * sizeof(size_t));
 /*    job->color_list_lengths = (size_t *)malloc(job->num_colors * sizeof(size_t));*/
 /*    for (i = 0; i < job->num_colors; i++) {*/
 /*        job->color_list_lengths[i] = 0;*/
 /*    }*/
-    const size_t Ne = job->N - 1;
-    for (size_t i = 0; i < job->num_elements; i++) {
-        size_t r = i / (job->N - 1);
-        size_t c = i % (job->N - 1);
-
-        job->elements[i].color = 2 * (r % 2)  + ((c % 2) + 1) - 1;
-/*        job->color_list_lengths[job->elements[i].color % job->num_colors]++;*/
-/*        fprintf(stderr, "job->elements[%d].color = %d\n", i, job->elements[i].color);*/
-
-        /*
-            Fill neighbor array starting with element to the right and
-            moving in a postive direction (ccw). If there is no neighbor,
-            set that neighbor to (-1).
-        */
-        for (size_t j = 0; j < 8; j++) {
-            job->elements[i].neighbors[j] = -1;
-        }
-
-        if (r != Ne) {
-            job->elements[i].neighbors[2] = ijton(r+1, c, Ne);
-            if (c != Ne) {
-                job->elements[i].neighbors[1] = ijton(r+1, c+1, Ne);
-            }
-            if (c != 0) {
-                job->elements[i].neighbors[3] = ijton(r+1, c-1, Ne);
-            }
-        }
-
-        if (r != 0) {
-            job->elements[i].neighbors[6] = ijton(r-1, c, Ne);
-            if (c != Ne) {
-                job->elements[i].neighbors[7] = ijton(r-1, c+1, Ne);
-            }
-            if (c != 0) {
-                job->elements[i].neighbors[5] = ijton(r-1, c-1, Ne);
-            }
-        }
-
-        if (c != Ne) {
-            job->elements[i].neighbors[0] = ijton(r, c+1, Ne);
-        }
-
-        if (c != 0) {
-            job->elements[i].neighbors[4] = ijton(r, c-1, Ne);
-        }
-
-    }
     for (size_t i = 0; i < job->num_colors; i++) {
         job->color_indices[i] = 0;
     }
@@ -207,6 +174,20 @@ job_t *mpm_init(int N, double h, particle_t *particles, size_t num_particles, do
     /* Allocate space for map of active particles. */
     job->active = (int *)malloc(job->num_particles * sizeof(int));
 
+    /* Particle loops are scheduled once the number of threads is known. */
+    memset(&(job->sched), 0, sizeof(particle_sched_t));
+
+    /* Step profiling is off unless prof_init enables it. */
+    memset(&(job->profile), 0, sizeof(step_profile_t));
+
+    /* Particles start in input order; reordering is off by default. */
+    job->particle_index = (size_t *)malloc(job->num_particles * sizeof(size_t));
+    for (size_t i = 0; i < job->num_particles; i++) {
+        job->particle_index[i] = i;
+    }
+    job->reorder_interval = 0;
+    job->steps_since_reorder = 0;
+
     /* Allocate space for interpolation functions. */
     job->h1 = (double *)malloc(job->num_particles * sizeof(double));
     job->h2 = (double *)malloc(job->num_particles * sizeof(double));
@@ -233,9 +214,16 @@ job_t *mpm_init(int N, double h, particle_t *particles, size_t num_particles, do
     /* for periodic BCs */
     job->node_number_override = (int *)malloc(job->vec_len * sizeof(int));
 
+    /* serial boundary conditions unless the plugin provides threaded ones. */
+    job->boundary.bc_momentum_threaded = NULL;
+    job->boundary.bc_force_threaded = NULL;
+
+    /* empty until the boundary condition plugin publishes them. */
+    memset(&(job->bc_constraints), 0, sizeof(bc_constraints_t));
+
     for (size_t i = 0; i < job->num_particles; i++) {
         job->in_element[i] = WHICH_ELEMENT(
-            job->particles[i].x, job->particles[i].y, job->N, job->h);
+            job->particles.x[i], job->particles.y[i], job);
         if (job->in_element[i] < 0 || (size_t)job->in_element[i] > job->num_elements) {
             job->active[i] = 0;
         } else {
@@ -243,22 +231,38 @@ job_t *mpm_init(int N, double h, particle_t *particles, size_t num_particles, do
         }
     }
 
-    /* set particle domains */
+    /* Move particles that start off the grid out of the active range. */
+    job->num_active = job->num_particles;
+    job->num_deactivated = 0;
+    compact_active_particles(job);
+
+    /* Activate the tiles holding particles. */
+    activate_particle_tiles(job);
+
+    /*
+        Set initial volume. Seems backwards, but only because loader contains
+        current particle volume only. CPDI is off in this solver; a caller
+        that enables it sets up particle domains from v0 with
+        particle_store_alloc_cpdi.
+    */
     for (size_t i = 0; i < job->num_particles; i++) {
-        /* seems backwards, but only because loader contains
-        current particle volume only. */
-        job->particles[i].v0 = job->particles[i].v;
-        job->particles[i].r1_initial[0] = 0.5 * sqrt(job->particles[i].v0);
-        job->particles[i].r1_initial[1] = 0;
-        job->particles[i].r2_initial[0] = 0;
-        job->particles[i].r2_initial[1] = 0.5 * sqrt(job->particles[i].v0);
+        job->particles.v0[i] = job->particles.v[i];
     }
 
     /* intialize state variables */
 /*    material_init(job);*/
 
     /* Set default timestep. */
-    job->dt = 0.4 * job->h * sqrt(job->particles[0].m/(job->particles[0].v * EMOD));
+    job->dt = 0.4 * job->h * sqrt(job->particles.m[0]/(job->particles.v[0] * EMOD));
+
+    /* Map particles to grid with the colored element lists by default. */
+    job->p2g_engine = P2G_COLORED;
+    job->element_particle_offsets = NULL;
+    job->element_particle_list = NULL;
+    job->p2g_row_bounds = NULL;
+
+    /* Update particles from the grid in separate passes by default. */
+    job->g2p_engine = G2P_SPLIT;
 
     /* Don't use cpdi here. */
     job->use_cpdi = 0;
@@ -271,6 +275,17 @@ job_t *mpm_init(int N, double h, particle_t *particles, size_t num_particles, do
     job->material.material_filename = NULL;
     job->material.material_init = &material_init_linear_elastic;
     job->material.calculate_stress = &calculate_stress_linear_elastic;
+    job->material.calculate_stress_batch = NULL;
+    job->material.init_error = 0;
+
+    job->material.nonlocal.solver = NONLOCAL_SOLVER_LU;
+    job->material.nonlocal.preconditioner = NONLOCAL_PRECOND_IC0;
+    job->material.nonlocal.tolerance = 1e-8;
+    job->material.nonlocal.max_iterations = 1000;
+    job->material.nonlocal.support_radius = 0;
+    job->material.nonlocal.solve_interval = 1;
+    job->material.nonlocal.solve_tolerance = 0;
+    job->material.nonlocal.log_iterations = 0;
 
     /* used to vary loads/bcs */
     job->step_number = 0;
@@ -280,16 +295,52 @@ job_t *mpm_init(int N, double h, particle_t *particles, size_t num_particles, do
 }
 /*----------------------------------------------------------------------------*/
 
+/*----------------------------------------------------------------------------*/
+/*
+    Zero constrained nodal momentum (and force, if with_force is set). Every
+    thread calls this right after a barrier that returned rc. The plugin's
+    threaded routines run on every thread if it has them, then published
+    constraint lists are split over all threads; otherwise the serial thread
+    runs the plugin's serial routines.
+*/
+static void apply_bcs_split(threadtask_t *task, int rc, int with_force)
+{
+    job_t *job = task->job;
+
+    if (job->boundary.bc_momentum_threaded != NULL
+        && job->boundary.bc_force_threaded != NULL) {
+        (*(job->boundary.bc_momentum_threaded))(task);
+        if (with_force) {
+            (*(job->boundary.bc_force_threaded))(task);
+        }
+    } else if (job->bc_constraints.published) {
+        bc_constraints_apply(&(job->bc_constraints),
+            job->nodes.mx_t, job->nodes.my_t, task->id, job->num_threads);
+        if (with_force) {
+            bc_constraints_apply(&(job->bc_constraints),
+                job->nodes.fx, job->nodes.fy, task->id, job->num_threads);
+        }
+    } else if (rc == PTHREAD_BARRIER_SERIAL_THREAD) {
+        (*(job->boundary.bc_momentum))(job);
+        if (with_force) {
+            (*(job->boundary.bc_force))(job);
+        }
+    }
+
+    return;
+}
+/*----------------------------------------------------------------------------*/
+
 /*----------------------------------------------------------------------------*/
 void explicit_mpm_step_musl_threaded(void *_task)
 {
     threadtask_t *task = (threadtask_t *)_task;
     job_t *job = task->job;
+    threadtask_t mtask = *task;
     int rc;
     size_t i;
 
-    size_t p_start = task->offset;
-    size_t p_stop = task->offset + task->blocksize;
+    size_t p_start, p_stop;
 
     size_t n_start = task->n_offset;
     size_t n_stop = task->n_offset + task->n_blocksize;
@@ -297,24 +348,17 @@ void explicit_mpm_step_musl_threaded(void *_task)
     size_t e_start = task->e_offset;
     size_t e_stop = task->e_offset + task->e_blocksize;
 
+    /* only the element lists and P2G are profiled in this solver. */
+    prof_start(&(job->profile), task->id);
+
     pthread_barrier_wait(job->serialize_barrier);
 
+    /* Particles only leave the active range in the serial section. */
+    active_particle_range(job, task->id, &p_start, &p_stop);
+
     /* Clear grid quantites. */
-    for (i = n_start; i < n_stop; i++) {
-        job->nodes[i].m = 0;
-        job->nodes[i].mx_t = 0;
-        job->nodes[i].my_t = 0;
-        job->nodes[i].mx_tt = 0;
-        job->nodes[i].my_tt = 0;
-        job->nodes[i].x_t = 0;
-        job->nodes[i].y_t = 0;
-        job->nodes[i].x_tt = 0;
-        job->nodes[i].y_tt = 0;
-        job->nodes[i].fx = 0;
-        job->nodes[i].fy = 0;
-        job->nodes[i].ux = 0;
-        job->nodes[i].uy = 0;
-    }
+    node_store_clear(&(job->nodes), n_start, n_stop);
+    nodal_field_clear(&(job->nodal_fields), n_start, n_stop);
 
     for (i = e_start; i < e_stop; i++) {
         job->elements[i].filled = 0;
@@ -351,13 +395,20 @@ void explicit_mpm_step_musl_threaded(void *_task)
         /* update_corner_domains(job); */
 
         /* find which elements are filled */
+        job->steps_since_reorder++;
         job->update_elementlists_flag = 0;
         for (i = 0; i < job->num_threads; i++) {
             job->update_elementlists_flag += job->update_elementlists[i];
         }
 
+        /*
+            Lists are rebuilt below, so this is the time to drop particles
+            that left the grid and to reorder.
+        */
         if (job->update_elementlists_flag != 0) {
-            find_filled_elements(job);
+            update_active_particles(job);
+            update_active_tiles(job);
+            reorder_particles_if_needed(job);
         }
 
         /* Create dirichlet and periodic boundary conditions. */
@@ -365,25 +416,19 @@ void explicit_mpm_step_musl_threaded(void *_task)
     }
 
     pthread_barrier_wait(job->serialize_barrier);
-    /* Map particle state to grid quantites. */
-    map_to_grid_explicit_split(job, task->id);
+    active_particle_range(job, task->id, &p_start, &p_stop);
 
-    rc = pthread_barrier_wait(job->serialize_barrier);
-    if (rc == PTHREAD_BARRIER_SERIAL_THREAD) {
-        /* Zero perpendicular momentum at edge nodes. */
-        (*(job->boundary.bc_momentum))(job);
-
-        /*
-            This is poorly named -- it actually calculates diverence of stress to
-            get nodal force.
-        */
-        /* XXX: moved to map_to_grid_explicit_split. */
-/*        update_stress(job);*/
+    /* Rebuild element occupancy and color lists with all threads. */
+    if (job->update_elementlists_flag != 0) {
+        find_filled_elements_threaded(task);
+    }
 
-        /* Zero perpendicular forces at edge nodes. */
-        (*(job->boundary.bc_force))(job);
+    /* Map particle state to grid quantites. */
+    map_to_grid_threaded(task);
 
-    }
+    /* Zero perpendicular momentum and forces at edge nodes. */
+    rc = pthread_barrier_wait(job->serialize_barrier);
+    apply_bcs_split(task, rc, 1);
 
     pthread_barrier_wait(job->serialize_barrier);
 
@@ -402,61 +447,55 @@ void explicit_mpm_step_musl_threaded(void *_task)
   
     /* 
     for (i = n_start; i < n_stop; i++) {
-        if (job->nodes[i].m > TOL)
-            printf("before %zu: %g, %g\n", i, job->nodes[i].x_t, job->nodes[i].y_t);
+        if (job->nodes.m[i] > TOL)
+            printf("before %zu: %g, %g\n", i, job->nodes.x_t[i], job->nodes.y_t[i]);
     }
     */
 
     pthread_barrier_wait(job->serialize_barrier);
-    for (i = n_start; i < n_stop; i++) {
-        job->nodes[i].m = 0;
-        job->nodes[i].mx_t = 0;
-        job->nodes[i].my_t = 0;
-        job->nodes[i].mx_tt = 0;
-        job->nodes[i].my_tt = 0;
-        job->nodes[i].x_t = 0;
-        job->nodes[i].y_t = 0;
-        job->nodes[i].x_tt = 0;
-        job->nodes[i].y_tt = 0;
-        job->nodes[i].fx = 0;
-        job->nodes[i].fy = 0;
-        job->nodes[i].ux = 0;
-        job->nodes[i].uy = 0;
-    }
+    node_store_clear(&(job->nodes), n_start, n_stop);
+    nodal_field_clear(&(job->nodal_fields), n_start, n_stop);
     pthread_barrier_wait(job->serialize_barrier);
-    map_to_grid_explicit_split(job, task->id);
+    map_to_grid_threaded(task);
     pthread_barrier_wait(job->serialize_barrier);
     for (i = n_start; i < n_stop; i++) {
-        if(job->nodes[i].m > TOL) {
-            job->nodes[i].x_t = job->nodes[i].mx_t / job->nodes[i].m;
-            job->nodes[i].y_t = job->nodes[i].my_t / job->nodes[i].m;
+        if(job->nodes.m[i] > TOL) {
+            job->nodes.x_t[i] = job->nodes.mx_t[i] / job->nodes.m[i];
+            job->nodes.y_t[i] = job->nodes.my_t[i] / job->nodes.m[i];
         } else {
-            job->nodes[i].x_t = 0;
-            job->nodes[i].y_t = 0;
+            job->nodes.x_t[i] = 0;
+            job->nodes.y_t[i] = 0;
         }
     }
+    /* Zero perpendicular momentum at edge nodes. */
     rc = pthread_barrier_wait(job->serialize_barrier);
-    if (rc == PTHREAD_BARRIER_SERIAL_THREAD) {
-        /* Zero perpendicular momentum at edge nodes. */
-        (*(job->boundary.bc_momentum))(job);
-    }
+    apply_bcs_split(task, rc, 0);
     pthread_barrier_wait(job->serialize_barrier);
 
     /*
     for (i = n_start; i < n_stop; i++) {
-        if (job->nodes[i].m > TOL)
-            printf("after %zu: %g, %g\n", i, job->nodes[i].x_t, job->nodes[i].y_t);
+        if (job->nodes.m[i] > TOL)
+            printf("after %zu: %g, %g\n", i, job->nodes.x_t[i], job->nodes.y_t[i]);
     }
     */
 
+    /* Map registered nodal fields back to the particles. */
+    map_nodal_fields_to_particles_split(job, p_start, p_stop);
+
     /* Calculate strain rate. */
     calculate_strainrate_split(job, p_start, p_stop);
 
     /* update volume */
     update_particle_densities_split(job, p_start, p_stop);
 
-    /* Calculate stress. */
-    (*(job->material.calculate_stress_threaded))(task);
+    /* Calculate stress, materials see only the active particles. */
+    if (job->material.calculate_stress_batch != NULL) {
+        calculate_stress_batched_split(job, p_start, p_stop);
+        return;
+    }
+    mtask.offset = p_start;
+    mtask.blocksize = p_stop - p_start;
+    (*(job->material.calculate_stress_threaded))(&mtask);
 
     return;
 }
@@ -466,46 +505,39 @@ void explicit_mpm_step_usl_threaded(void *_task)
 {
     threadtask_t *task = (threadtask_t *)_task;
     job_t *job = task->job;
+    threadtask_t mtask = *task;
     int rc;
+    int changed;
     size_t i;
 
-    size_t p_start = task->offset;
-    size_t p_stop = task->offset + task->blocksize;
-
-    size_t n_start = task->n_offset;
-    size_t n_stop = task->n_offset + task->n_blocksize;
+    /* particle loops are scheduled in chunks of [c_start, c_stop). */
+    size_t c_start, c_stop;
+    size_t p_stop;
 
-    size_t e_start = task->e_offset;
-    size_t e_stop = task->e_offset + task->e_blocksize;
+    step_profile_t *prof = &(job->profile);
+    const size_t id = task->id;
 
-    pthread_barrier_wait(job->serialize_barrier);
+    prof_start(prof, id);
+    prof_barrier_wait(prof, id, PROF_GRID_CLEAR, job->serialize_barrier);
 
-    /* Clear grid quantites. */
-    for (i = n_start; i < n_stop; i++) {
-        job->nodes[i].m = 0;
-        job->nodes[i].mx_t = 0;
-        job->nodes[i].my_t = 0;
-        job->nodes[i].mx_tt = 0;
-        job->nodes[i].my_tt = 0;
-        job->nodes[i].x_t = 0;
-        job->nodes[i].y_t = 0;
-        job->nodes[i].x_tt = 0;
-        job->nodes[i].y_tt = 0;
-        job->nodes[i].fx = 0;
-        job->nodes[i].fy = 0;
-        job->nodes[i].ux = 0;
-        job->nodes[i].uy = 0;
-    }
+    /* Clear grid quantites (nodes outside active tiles are already zero). */
+    clear_grid_tiles_split(job, id);
+    prof_stop(prof, id, PROF_GRID_CLEAR);
 
-    for (i = e_start; i < e_stop; i++) {
-        job->elements[i].filled = 0;
-        job->elements[i].n = 0;
-        job->elements[i].m = 0;
+    /*
+        Figure out which element each material point is in and calculate
+        shape and gradient of shape functions, in chunks shared between
+        threads.
+    */
+    changed = 0;
+    while (particle_sched_next(&(job->sched), SCHED_PHASE_PRE_P2G,
+            task->id, &c_start, &c_stop)) {
+        changed |= create_particle_to_element_map_split(job, c_start, c_stop);
+        prof_stop(prof, id, PROF_ELEMENT_MAP);
+        calculate_shapefunctions_split(job, c_start, c_stop);
+        prof_stop(prof, id, PROF_SHAPEFUNCTIONS);
     }
-
-    /* Figure out which element each material point is in. */
-/*    create_particle_to_element_map_split(job, p_start, p_stop);*/
-    create_particle_to_element_map_threaded(task);
+    job->update_elementlists[task->id] = changed;
 
     /*
         XXX Normally we find which elements are filled here, but we defer
@@ -513,13 +545,11 @@ void explicit_mpm_step_usl_threaded(void *_task)
         sections together after one barrier call.
     */
 
-    /* Calculate shape and gradient of shape functions. */
-    calculate_shapefunctions_split(job, p_start, p_stop);
-
-    rc = pthread_barrier_wait(job->serialize_barrier);
+    rc = prof_barrier_wait(prof, id, PROF_ELEMENT_MAP, job->serialize_barrier);
     if (rc == PTHREAD_BARRIER_SERIAL_THREAD) {
         /* Increment time. (We do this first to avoid more barrier calls.) */
         job->t += job->dt;
+        prof->steps++;
 
 /*    }*/
 /*    pthread_barrier_wait(job->serialize_barrier);*/
@@ -532,93 +562,144 @@ void explicit_mpm_step_usl_threaded(void *_task)
         /* update_corner_domains(job); */
 
         /* find which elements are filled */
+        job->steps_since_reorder++;
         job->update_elementlists_flag = 0;
         for (i = 0; i < job->num_threads; i++) {
             job->update_elementlists_flag += job->update_elementlists[i];
         }
 
+        /*
+            Lists are rebuilt below, so this is the time to drop particles
+            that left the grid and to reorder.
+        */
         if (job->update_elementlists_flag != 0) {
-            find_filled_elements(job);
+            update_active_particles(job);
+            update_active_tiles(job);
+            reorder_particles_if_needed(job);
+        }
+
+        /* The active range is fixed now, refill the G2P queues. */
+        for (i = 0; i < job->num_threads; i++) {
+            particle_sched_reset(&(job->sched), SCHED_PHASE_G2P, i);
         }
 
         /* Create dirichlet and periodic boundary conditions. */
         (*(job->boundary.bc_time_varying))(job);
     }
 
-    pthread_barrier_wait(job->serialize_barrier);
-    /* Map particle state to grid quantites. */
-    map_to_grid_explicit_split(job, task->id);
-
-    rc = pthread_barrier_wait(job->serialize_barrier);
-    if (rc == PTHREAD_BARRIER_SERIAL_THREAD) {
-        /* Zero perpendicular momentum at edge nodes. */
-        (*(job->boundary.bc_momentum))(job);
+    prof_barrier_wait(prof, id, PROF_SERIAL, job->serialize_barrier);
 
-        /*
-            This is poorly named -- it actually calculates diverence of stress to
-            get nodal force.
-        */
-        /* XXX: moved to map_to_grid_explicit_split. */
-/*        update_stress(job);*/
+    /* Rebuild element occupancy and color lists with all threads. */
+    if (job->update_elementlists_flag != 0) {
+        find_filled_elements_threaded(task);
+        prof_stop(prof, id, PROF_ELEMENT_LISTS);
+    }
 
-        /* Zero perpendicular forces at edge nodes. */
-        (*(job->boundary.bc_force))(job);
+    /* Map particle state to grid quantites. */
+    map_to_grid_threaded(task);
 
-    }
+    /* Zero perpendicular momentum and forces at edge nodes. */
+    rc = prof_barrier_wait(prof, id, PROF_P2G, job->serialize_barrier);
+    apply_bcs_split(task, rc, 1);
 
-    pthread_barrier_wait(job->serialize_barrier);
+    prof_barrier_wait(prof, id, PROF_BC, job->serialize_barrier);
 
     /*
         Update momentum and velocity at nodes.
         Wait for all threads to finish updating nodes before calculating
         strainrates.
     */
-    move_grid_split(job, n_start, n_stop); 
-    pthread_barrier_wait(job->serialize_barrier);
+    move_grid_tiles_split(job, id);
+    prof_barrier_wait(prof, id, PROF_GRID_UPDATE, job->serialize_barrier);
 
-    /* Update particle position and velocity. */
-    move_particles_explicit_usl_split(job, p_start, p_stop);
+    while (particle_sched_next(&(job->sched), SCHED_PHASE_G2P,
+            task->id, &c_start, &c_stop)) {
+        map_nodal_fields_to_particles_split(job, c_start, c_stop);
 
-    /* Calculate strain rate. */
-    calculate_strainrate_split(job, p_start, p_stop);
+        if (job->g2p_engine == G2P_FUSED && !job->use_cpdi) {
+            g2p_fused_usl_split(job, c_start, c_stop);
+            prof_stop(prof, id, PROF_G2P);
+        } else {
+            /* Update particle position and velocity. */
+            move_particles_explicit_usl_split(job, c_start, c_stop);
+            prof_stop(prof, id, PROF_G2P);
 
-    /* update volume */
-    update_particle_densities_split(job, p_start, p_stop);
+            /* Calculate strain rate. */
+            calculate_strainrate_split(job, c_start, c_stop);
+
+            /* update volume */
+            update_particle_densities_split(job, c_start, c_stop);
+            prof_stop(prof, id, PROF_STRAINRATE);
+        }
+
+        /* A batch material only needs the strain rate of this chunk. */
+        if (job->material.calculate_stress_batch != NULL) {
+            calculate_stress_batched_split(job, c_start, c_stop);
+            prof_stop(prof, id, PROF_STRESS);
+        }
+    }
 
-    /* Calculate stress. */
-    (*(job->material.calculate_stress_threaded))(task);
+    /* Element lookup for the next step can't start before a barrier. */
+    particle_sched_reset(&(job->sched), SCHED_PHASE_PRE_P2G, task->id);
+
+    /*
+        Materials split particles statically (or synchronize internally), so
+        every chunk of the strain rate must be done first.
+    */
+    prof_barrier_wait(prof, id, PROF_G2P, job->serialize_barrier);
+
+    /* Calculate stress, materials see only the active particles. */
+    if (job->material.calculate_stress_batch == NULL) {
+        active_particle_range(job, task->id, &(mtask.offset), &p_stop);
+        mtask.blocksize = p_stop - mtask.offset;
+        (*(job->material.calculate_stress_threaded))(&mtask);
+        prof_stop(prof, id, PROF_STRESS);
+    }
 
     return;
 }
 /*----------------------------------------------------------------------------*/
 
 /*----------------------------------------------------------------------------*/
+/*
+    Every store is unconditional so the loop vectorizes; nodes without mass
+    get zero inverse mass, acceleration and velocity and keep their momentum
+    and displacement, as before. The quotients computed for those nodes are
+    thrown away by the selects.
+*/
 void move_grid_split(job_t *job, size_t n_start, size_t n_stop)
 {
-    double m;
+    const double dt = job->dt;
+    const double * restrict m = job->nodes.m;
+    const double * restrict fx = job->nodes.fx;
+    const double * restrict fy = job->nodes.fy;
+    double * restrict inv_m = job->nodes.inv_m;
+    double * restrict x_tt = job->nodes.x_tt;
+    double * restrict y_tt = job->nodes.y_tt;
+    double * restrict mx_t = job->nodes.mx_t;
+    double * restrict my_t = job->nodes.my_t;
+    double * restrict x_t = job->nodes.x_t;
+    double * restrict y_t = job->nodes.y_t;
+    double * restrict ux = job->nodes.ux;
+    double * restrict uy = job->nodes.uy;
     size_t i;
 
     for (i = n_start; i < n_stop; i++) {
-        m = job->nodes[i].m;
-
-        if (m > TOL) {
-            job->nodes[i].x_tt = job->nodes[i].fx / m;
-            job->nodes[i].y_tt = job->nodes[i].fy / m;
-
-            job->nodes[i].mx_t += job->dt * job->nodes[i].fx;
-            job->nodes[i].my_t += job->dt * job->nodes[i].fy;
-
-            job->nodes[i].x_t = job->nodes[i].mx_t / m;
-            job->nodes[i].y_t = job->nodes[i].my_t / m;
-
-            job->nodes[i].ux = job->dt * job->nodes[i].x_t;
-            job->nodes[i].uy = job->dt * job->nodes[i].y_t;
-        } else {
-            job->nodes[i].x_tt = 0;
-            job->nodes[i].y_tt = 0;
-            job->nodes[i].x_t = 0;
-            job->nodes[i].y_t = 0;
-        }
+        const int has_mass = (m[i] > TOL);
+        const double mx = has_mass ? (mx_t[i] + dt * fx[i]) : mx_t[i];
+        const double my = has_mass ? (my_t[i] + dt * fy[i]) : my_t[i];
+        const double vx = has_mass ? (mx / m[i]) : 0;
+        const double vy = has_mass ? (my / m[i]) : 0;
+
+        inv_m[i] = has_mass ? (1.0 / m[i]) : 0;
+        x_tt[i] = has_mass ? (fx[i] / m[i]) : 0;
+        y_tt[i] = has_mass ? (fy[i] / m[i]) : 0;
+        mx_t[i] = mx;
+        my_t[i] = my;
+        x_t[i] = vx;
+        y_t[i] = vy;
+        ux[i] = has_mass ? (dt * vx) : ux[i];
+        uy[i] = has_mass ? (dt * vy) : uy[i];
     }
 
     return;
@@ -631,26 +712,42 @@ void move_grid_split(job_t *job, size_t n_start, size_t n_stop)
 void create_particle_to_element_map_threaded(threadtask_t *task)
 {
     job_t *job = task->job;
-    size_t p_start = task->offset;
-    size_t p_stop = task->offset + task->blocksize;
+    size_t p_start, p_stop;
+
+    active_particle_range(job, task->id, &p_start, &p_stop);
+
+    /* set elementlist flag */
+    job->update_elementlists[task->id] =
+        create_particle_to_element_map_split(job, p_start, p_stop);
+
+    return;
+}
+/*----------------------------------------------------------------------------*/
 
+/*----------------------------------------------------------------------------*/
+/* Returns 1 if any particle in the range changed element, 0 otherwise. */
+int create_particle_to_element_map_split(job_t *job, size_t p_start, size_t p_stop)
+{
     size_t i;
     int p;
-    unsigned int changed = 0;
+    int changed = 0;
 
-    /* All elements must be cleared before entering this routine! */
+    /*
+        All elements must be cleared before entering this routine! Particles
+        in [0, num_active) are all active here, the ones leaving the grid are
+        compacted away in the next serial section.
+    */
 
 
     for (i = p_start; i < p_stop; i++) {
-        CHECK_ACTIVE(job, i);
         p = WHICH_ELEMENT(
-            job->particles[i].x, job->particles[i].y, job->N, job->h);
+            job->particles.x[i], job->particles.y[i], job);
 
         if (p != job->in_element[i]) {
             changed = 1;
             fprintf(job->output.log_fd, 
                 "[%g] Particle %zu @(%g, %g) left element %d, now in element %d.\n",
-                job->t, i, job->particles[i].x, job->particles[i].y,
+                job->t, job->particles.id[i], job->particles.x[i], job->particles.y[i],
                 job->in_element[i], p);
         }
 
@@ -660,100 +757,135 @@ void create_particle_to_element_map_threaded(threadtask_t *task)
         if (p == -1) {
             fprintf(job->output.log_fd,
                 "[%g] Particle %zu outside of grid (%g, %g), marking as inactive.\n",
-                job->t, i, job->particles[i].x, job->particles[i].y);
+                job->t, job->particles.id[i], job->particles.x[i], job->particles.y[i]);
             job->active[i] = 0;
+            __atomic_fetch_add(&(job->num_deactivated), 1, __ATOMIC_RELAXED);
             continue;
         }
 
+        grid_tiles_touch(&(job->tiles), p);
+
     }
 
-    /* set elementlist flag */
-    job->update_elementlists[task->id] = changed;
+    return changed;
+}
+
+
+/*----------------------------------------------------------------------------*/
+void reorder_particles_if_needed(job_t *job)
+{
+    if (job->reorder_interval > 0
+        && job->steps_since_reorder >= job->reorder_interval) {
+        reorder_particles_by_element(job);
+    }
 
     return;
 }
+/*----------------------------------------------------------------------------*/
 
+/*----------------------------------------------------------------------------*/
+static void swap_double(double *a, size_t i, size_t j)
+{
+    double tmp = a[i];
+    a[i] = a[j];
+    a[j] = tmp;
 
-void find_filled_elements(job_t *job)
+    return;
+}
+
+static void swap_int(int *a, size_t i, size_t j)
 {
-    size_t i, p, c_idx, t_idx, tc_idx, curr_len;
+    int tmp = a[i];
+    a[i] = a[j];
+    a[j] = tmp;
 
-    /* This function should be called ONCE per step (serial function). */
+    return;
+}
 
-    for (i = 0; i < job->num_colors; i++) {
-        job->color_indices[i] = 0;
-    }
+/*
+    Move inactive particles out of [0, num_active) by swapping each one with
+    the last active particle, so particle loops can run over [0, num_active)
+    without checking job->active. Particles that were deactivated since the
+    last call end up in [num_active, old num_active). Returns the number of
+    particles removed. Must be called from a serial section, before the
+    element color lists are built.
+*/
+size_t compact_active_particles(job_t *job)
+{
+    size_t i, last;
+    size_t removed = 0;
 
-    for (i = 0; i < job->num_particles; i++) {
-        CHECK_ACTIVE(job, i);
-        p = job->in_element[i];
+    i = 0;
+    while (i < job->num_active) {
+        if (job->active[i] != 0) {
+            i++;
+            continue;
+        }
 
-        /* Mark element as occupied. */
-        job->elements[p].filled = 1;
-        job->elements[p].n++;
-        job->elements[p].m += job->particles[i].m;
-    }
+        last = job->num_active - 1;
+        job->num_active--;
+        removed++;
 
-    for (i = 0; i < job->num_elements; i++) {
-        if (job->elements[i].filled) {
-            /* set color-based element id */
-            job->elements[i].color_idx = job->color_indices[job->elements[i].color];
-            job->color_indices[job->elements[i].color]++;
+        if (i == last) {
+            break;
         }
-    }
 
-    /* Sort the particle IDs for easier element coloring. */
-    for (i = 0; i < (job->num_threads * job->num_colors); i++) {
-        job->particle_by_element_color_lengths[i] = 0;
-    }
+        particle_store_swap(&(job->particles), i, last);
+        job->particle_index[job->particles.id[i]] = i;
+        job->particle_index[job->particles.id[last]] = last;
 
-    for (i = 0; i < job->num_particles; i++) {
-        CHECK_ACTIVE(job, i);
+        swap_int(job->in_element, i, last);
+        swap_int(job->active, i, last);
 
-        p = job->in_element[i];
-        c_idx = job->elements[p].color;
-        t_idx = job->elements[p].color_idx % job->num_threads;
-        tc_idx = t_idx * job->num_colors + c_idx;
-        curr_len = job->particle_by_element_color_lengths[tc_idx];
-        job->particle_by_element_color_lists[tc_idx][curr_len] = i;
-        job->particle_by_element_color_lengths[tc_idx]++;
+        swap_double(job->h1, i, last);
+        swap_double(job->h2, i, last);
+        swap_double(job->h3, i, last);
+        swap_double(job->h4, i, last);
+
+        swap_double(job->b11, i, last);
+        swap_double(job->b12, i, last);
+        swap_double(job->b13, i, last);
+        swap_double(job->b14, i, last);
+
+        swap_double(job->b21, i, last);
+        swap_double(job->b22, i, last);
+        swap_double(job->b23, i, last);
+        swap_double(job->b24, i, last);
     }
 
+    job->num_deactivated = 0;
+
+    return removed;
+}
+/*----------------------------------------------------------------------------*/
+
+/*----------------------------------------------------------------------------*/
+/* Static split of the active particles, used where ranges must not move. */
+void active_particle_range(job_t *job, size_t thread_id,
+    size_t *p_start, size_t *p_stop)
+{
+    *p_start = (thread_id * job->num_active) / job->num_threads;
+    *p_stop = ((thread_id + 1) * job->num_active) / job->num_threads;
+
     return;
 }
 /*----------------------------------------------------------------------------*/
 
 /*----------------------------------------------------------------------------*/
-void calculate_shapefunctions_split(job_t *job, size_t p_start, size_t p_stop)
+/*
+    Called from the serial section of a step: drop particles that left the
+    grid from the active range and resize the particle scheduler to match.
+*/
+void update_active_particles(job_t *job)
 {
-    size_t i, p, n;
+    if (job->num_deactivated == 0) {
+        return;
+    }
 
-    double xn;
-    double yn;
-    double xl;
-    double yl;
+    compact_active_particles(job);
 
-    for (i = p_start; i < p_stop; i++) {
-        CHECK_ACTIVE(job, i);
-        p = job->in_element[i];
-        n = job->elements[p].nodes[0];
-        xn = job->nodes[n].x;
-        yn = job->nodes[n].y;
-        global_to_local_coords(&xl, &yl,
-            job->particles[i].x, job->particles[i].y, 
-            xn, yn, job->h);
-        tent(&(job->h1[i]), &(job->h2[i]), &(job->h3[i]), &(job->h4[i]),
-            xl, yl);
-        grad_tent(
-            &(job->b11[i]), &(job->b12[i]), &(job->b13[i]), &(job->b14[i]),
-            &(job->b21[i]), &(job->b22[i]), &(job->b23[i]), &(job->b24[i]),
-            xl, yl, job->h);
-        if (xl < 0.0f || xl > 1.0f || yl < 0.0f || yl > 1.0f) {
-            fprintf(stderr, "Particle %zu outside of element %zu (%g, %g).\n", i,
-                p, xl, yl);
-        }
-        job->particles[i].xl = xl;
-        job->particles[i].yl = yl;
+    if (job->sched.queues != NULL) {
+        particle_sched_resize(&(job->sched), job->num_active);
     }
 
     return;
@@ -761,160 +893,986 @@ void calculate_shapefunctions_split(job_t *job, size_t p_start, size_t p_stop)
 /*----------------------------------------------------------------------------*/
 
 /*----------------------------------------------------------------------------*/
-void calculate_strainrate_split(job_t *job, size_t p_start, size_t p_stop)
+/* Returns 0 on success, -1 if the allocation failed. */
+int element_fields_alloc(job_t *job)
 {
-    int ce, nn[4];
-    double dx_tdy;
-    double dy_tdx;
+    if (job->element_fields == NULL) {
+        job->element_fields = (element_fields_t *)calloc(job->num_elements,
+            sizeof(element_fields_t));
+    }
 
-    for (size_t i = p_start; i < p_stop; i++) {
-        CHECK_ACTIVE(job, i);
-        job->particles[i].exx_t = 0;
-        job->particles[i].exy_t = 0;
-        job->particles[i].eyy_t = 0;
-        job->particles[i].wxy_t = 0;
+    return ((job->element_fields == NULL) ? -1 : 0);
+}
+/*----------------------------------------------------------------------------*/
 
-        if (job->use_cpdi) {
-            /* loop over corners */
-            for (size_t j = 0; j < 4; j++) {
-                ce = job->particles[i].corner_elements[j];
-                /* corner is outside of particle domain. should probably deal with this better... */
-                if (ce == -1) {
-                    continue;
-                }
-                for (size_t k = 0; k < 4; k++) {
-                    nn[k] = job->elements[ce].nodes[k];
+/*----------------------------------------------------------------------------*/
+/* Returns 0 on success, -1 if the allocation failed. */
+int element_implicit_alloc(job_t *job)
+{
+    if (job->element_implicit == NULL) {
+        job->element_implicit = (element_implicit_t *)calloc(job->num_elements,
+            sizeof(element_implicit_t));
+    }
 
-                    /* actual volume of particle here (not averaging volume) */
-                    job->particles[i].exx_t += job->nodes[nn[k]].x_t * job->particles[i].grad_sc[j][k][S_XIDX];
-                    job->particles[i].exy_t += 0.5 * (job->nodes[nn[k]].x_t * job->particles[i].grad_sc[j][k][S_YIDX] + job->nodes[nn[k]].y_t * job->particles[i].grad_sc[j][k][S_XIDX]);
-                    job->particles[i].eyy_t += job->nodes[nn[k]].y_t * job->particles[i].grad_sc[j][k][S_YIDX];
-                    job->particles[i].wxy_t += 0.5 * (job->nodes[nn[k]].x_t * job->particles[i].grad_sc[j][k][S_YIDX] - job->nodes[nn[k]].y_t * job->particles[i].grad_sc[j][k][S_XIDX]);
-                }
-            }
-        } else {
-            job->particles[i].exx_t = DX_N_TO_P(job, x_t, 1.0, i);
-            job->particles[i].eyy_t = DY_N_TO_P(job, y_t, 1.0, i);
+    return ((job->element_implicit == NULL) ? -1 : 0);
+}
+/*----------------------------------------------------------------------------*/
 
-            dx_tdy = DY_N_TO_P(job, x_t, 1.0, i);
-            dy_tdx = DX_N_TO_P(job, y_t, 1.0, i);
+/*----------------------------------------------------------------------------*/
+/*
+    Print the size of the element records and how much was saved by keeping
+    the cold data out of element_t (counting cold arrays that are allocated).
+*/
+void report_element_storage(job_t *job, FILE *fd)
+{
+    const double mb = 1024.0 * 1024.0;
+    const size_t cold = sizeof(element_fields_t) + sizeof(element_implicit_t)
+        + 8 * sizeof(int);
+    size_t used = sizeof(element_t);
 
-            job->particles[i].exy_t = 0.5 * (dx_tdy + dy_tdx);
-            job->particles[i].wxy_t = 0.5 * (dx_tdy - dy_tdx);
-        }
+    if (job->element_fields != NULL) {
+        used += sizeof(element_fields_t);
     }
+    if (job->element_implicit != NULL) {
+        used += sizeof(element_implicit_t);
+    }
+
+    fprintf(fd, "Element storage: %zu elements, %zu bytes each "
+        "(%zu hot), %.1f MB; %.1f MB less than with cold data inline.\n",
+        job->num_elements, used, sizeof(element_t),
+        used * job->num_elements / mb,
+        (sizeof(element_t) + cold - used) * job->num_elements / mb);
 
     return;
 }
 /*----------------------------------------------------------------------------*/
 
 /*----------------------------------------------------------------------------*/
-void map_to_grid_explicit_split(job_t *job, size_t thread_id)
+/* Connectivity and color of element (c, r). */
+static void init_element_geometry(job_t *job, size_t c, size_t r)
 {
-    size_t c, i, p_idx, tc_idx;
-    double s[NODES_PER_ELEMENT];
-    double ds[NODES_PER_ELEMENT];
+    const size_t i = ijton(c, r, job->Nx - 1);
 
-    /* Kinda a hack, but used this because C doesn't have reflection. */
-    const int pdata_len = 7;
-    size_t node_field_offsets[pdata_len];
-    double pdata[pdata_len];
-
-    /* also accumulate stress using gradients of shapefunctions. */
-    const int stress_len = 3;
-    size_t node_d_offsets[stress_len];
-    double stressdata[stress_len];
+    element_node_numbers(job->elements[i].nodes, i, job->Nx);
 
-    int p;
+    job->elements[i].color = 2 * (r % 2)  + ((c % 2) + 1) - 1;
 
-    /* Be sure to replicate this order in the particle data array! */
-    node_field_offsets[0] = offsetof(node_t, m);
-    node_field_offsets[1] = offsetof(node_t, mx_t);
-    node_field_offsets[2] = offsetof(node_t, my_t);
-    node_field_offsets[3] = offsetof(node_t, mx_tt);
-    node_field_offsets[4] = offsetof(node_t, my_tt);
-    node_field_offsets[5] = offsetof(node_t, fx);
-    node_field_offsets[6] = offsetof(node_t, fy);
+    return;
+}
+/*----------------------------------------------------------------------------*/
 
-    node_d_offsets[0] = offsetof(node_t, fx);
-    node_d_offsets[1] = offsetof(node_t, fy);
+/*----------------------------------------------------------------------------*/
+/* Set up the nodes and elements of a tile activated for the first time. */
+static void init_tile_geometry(job_t *job, size_t tile)
+{
+    size_t i, j, i0, i1, j0, j1;
+    size_t n;
+
+    grid_tile_nodes(&(job->tiles), tile, &i0, &i1, &j0, &j1);
+    for (j = j0; j < j1; j++) {
+        for (i = i0; i < i1; i++) {
+            n = ijton(i, j, job->Nx);
+            node_number_to_coords(&(job->nodes.x[n]), &(job->nodes.y[n]),
+                n, job->Nx, job->x0, job->y0, job->h);
+        }
+    }
 
-    for (c = 0; c < job->num_colors; c++) {
-        tc_idx = thread_id * job->num_colors + c;
-        for (i = 0; i < job->particle_by_element_color_lengths[tc_idx]; i++) {
-            p_idx = job->particle_by_element_color_lists[tc_idx][i];
+    grid_tile_elements(&(job->tiles), tile, &i0, &i1, &j0, &j1);
+    for (j = j0; j < j1; j++) {
+        for (i = i0; i < i1; i++) {
+            init_element_geometry(job, i, j);
+        }
+    }
+
+    return;
+}
+/*----------------------------------------------------------------------------*/
+
+/*----------------------------------------------------------------------------*/
+/*
+    Called from the serial section of a step after the element map has
+    touched the tiles of every active particle. Nodes and elements of tiles
+    that are retired here were cleared at the start of the step and aren't
+    written again while the tile is inactive.
+*/
+void update_active_tiles(job_t *job)
+{
+    size_t k;
+
+    grid_tiles_update(&(job->tiles));
+    for (k = 0; k < job->tiles.num_fresh; k++) {
+        init_tile_geometry(job, job->tiles.fresh_list[k]);
+    }
+
+    return;
+}
+/*----------------------------------------------------------------------------*/
+
+/*----------------------------------------------------------------------------*/
+/*
+    Activate the tiles of all active particles (serial, used at startup).
+    Elements are found from particle positions since in_element isn't set
+    when loading a saved state.
+*/
+void activate_particle_tiles(job_t *job)
+{
+    size_t i;
+    int e;
+
+    for (i = 0; i < job->num_active; i++) {
+        e = WHICH_ELEMENT(
+            job->particles.x[i], job->particles.y[i], job);
+        if (e >= 0) {
+            grid_tiles_touch(&(job->tiles), e);
+        }
+    }
+    update_active_tiles(job);
+
+    return;
+}
+/*----------------------------------------------------------------------------*/
+
+/*----------------------------------------------------------------------------*/
+/* Clear nodes and elements of this thread's share of the active tiles. */
+void clear_grid_tiles_split(job_t *job, size_t thread_id)
+{
+    const size_t N = job->Nx;
+    const size_t Nex = job->Nx - 1;
+    size_t k, t_start, t_stop, first, last, c, i, j, i0, i1, j0, j1;
+
+    grid_tiles_range(&(job->tiles), thread_id, job->num_threads,
+        &t_start, &t_stop);
+
+    for (k = t_start; k < t_stop; ) {
+        grid_tiles_run(&(job->tiles), &k, t_stop, &first, &last);
+
+        grid_tile_nodes(&(job->tiles), first, &i0, &c, &j0, &j1);
+        grid_tile_nodes(&(job->tiles), last, &c, &i1, &j0, &j1);
+        for (j = j0; j < j1; j++) {
+            node_store_clear(&(job->nodes), ijton(i0, j, N), ijton(i1, j, N));
+            nodal_field_clear(&(job->nodal_fields),
+                ijton(i0, j, N), ijton(i1, j, N));
+        }
 
+        grid_tile_elements(&(job->tiles), first, &i0, &c, &j0, &j1);
+        grid_tile_elements(&(job->tiles), last, &c, &i1, &j0, &j1);
+        for (j = j0; j < j1; j++) {
+            for (i = ijton(i0, j, Nex); i < ijton(i1, j, Nex); i++) {
+                job->elements[i].filled = 0;
+                job->elements[i].n = 0;
+                job->elements[i].m = 0;
+            }
+        }
+    }
+
+    return;
+}
+/*----------------------------------------------------------------------------*/
+
+/*----------------------------------------------------------------------------*/
+/* move_grid_split over the nodes of this thread's share of the active tiles. */
+void move_grid_tiles_split(job_t *job, size_t thread_id)
+{
+    const size_t N = job->Nx;
+    size_t k, t_start, t_stop, first, last, c, j, i0, i1, j0, j1;
+
+    grid_tiles_range(&(job->tiles), thread_id, job->num_threads,
+        &t_start, &t_stop);
+
+    for (k = t_start; k < t_stop; ) {
+        grid_tiles_run(&(job->tiles), &k, t_stop, &first, &last);
+        grid_tile_nodes(&(job->tiles), first, &i0, &c, &j0, &j1);
+        grid_tile_nodes(&(job->tiles), last, &c, &i1, &j0, &j1);
+        for (j = j0; j < j1; j++) {
+            move_grid_split(job, ijton(i0, j, N), ijton(i1, j, N));
+        }
+    }
+
+    return;
+}
+/*----------------------------------------------------------------------------*/
+
+/*----------------------------------------------------------------------------*/
+/*
+    Parallel version of find_filled_elements, called by every thread. Produces
+    exactly the same color_idx values and particle lists as the serial
+    version:
+
+    1. Mark filled elements (particle range).
+    2. Count filled elements of each color (range of active tiles).
+    3. Assign color_idx from an exclusive prefix sum of the counts over
+       threads (range of active tiles).
+    4. Count particles going into each thread/color list (particle range).
+    5. Scatter particles into the lists at an offset given by a prefix sum of
+       the counts over threads. Particle ranges are contiguous and ascending,
+       so each bucket stays in particle index order (particle range).
+    6. Every element's particles land in a single list, so the thread owning
+       that list accumulates the element particle count and mass.
+
+    Particle reordering must be done beforehand in a serial section.
+*/
+void find_filled_elements_threaded(threadtask_t *task)
+{
+    job_t *job = task->job;
+    const size_t T = job->num_threads;
+    const size_t C = job->num_colors;
+    const size_t id = task->id;
+
+    const size_t Nex = job->Nx - 1;
+
+    size_t p_start, p_stop;
+    size_t t_start, t_stop, k, c0, c1, r0, r1, r;
+
+    size_t * restrict ecounts = job->element_color_counts;
+    size_t * restrict pcounts = job->particle_color_counts;
+    size_t color_next[C];
+    size_t list_next[T * C];
+    size_t i, t, c, p, tc_idx, base, len, offset;
+    int rc;
+
+    /* Particle ranges must be static and ascending (see 5). */
+    active_particle_range(job, id, &p_start, &p_stop);
+
+    /* Elements are visited tile by tile, in the order of the active list. */
+    grid_tiles_range(&(job->tiles), id, T, &t_start, &t_stop);
+
+    /* 1. Elements are cleared at the start of the step. */
+    for (i = p_start; i < p_stop; i++) {
+        __atomic_store_n(&(job->elements[job->in_element[i]].filled), 1,
+            __ATOMIC_RELAXED);
+    }
+
+    for (c = 0; c < C; c++) {
+        ecounts[id * C + c] = 0;
+    }
+    for (tc_idx = 0; tc_idx < T * C; tc_idx++) {
+        pcounts[id * T * C + tc_idx] = 0;
+    }
+
+    prof_barrier_wait(&(job->profile), id, PROF_ELEMENT_LISTS,
+        job->serialize_barrier);
+
+    /* 2. */
+    for (k = t_start; k < t_stop; k++) {
+        grid_tile_elements(&(job->tiles), job->tiles.active_list[k],
+            &c0, &c1, &r0, &r1);
+        for (r = r0; r < r1; r++) {
+            for (i = ijton(c0, r, Nex); i < ijton(c1, r, Nex); i++) {
+                if (job->elements[i].filled) {
+                    ecounts[id * C + job->elements[i].color]++;
+                }
+            }
+        }
+    }
+
+    prof_barrier_wait(&(job->profile), id, PROF_ELEMENT_LISTS,
+        job->serialize_barrier);
+
+    /*
+        3. Other threads are still reading the counts, so starting indices go
+        in a local array.
+    */
+    for (c = 0; c < C; c++) {
+        base = 0;
+        for (t = 0; t < id; t++) {
+            base += ecounts[t * C + c];
+        }
+        if (id == T - 1) {
+            job->color_indices[c] = base + ecounts[id * C + c];
+        }
+        color_next[c] = base;
+    }
+
+    for (k = t_start; k < t_stop; k++) {
+        grid_tile_elements(&(job->tiles), job->tiles.active_list[k],
+            &c0, &c1, &r0, &r1);
+        for (r = r0; r < r1; r++) {
+            for (i = ijton(c0, r, Nex); i < ijton(c1, r, Nex); i++) {
+                if (job->elements[i].filled) {
+                    c = job->elements[i].color;
+                    job->elements[i].color_idx = color_next[c];
+                    color_next[c]++;
+                }
+            }
+        }
+    }
+
+    prof_barrier_wait(&(job->profile), id, PROF_ELEMENT_LISTS,
+        job->serialize_barrier);
+
+    /* 4. */
+    for (i = p_start; i < p_stop; i++) {
+        p = job->in_element[i];
+        tc_idx = (job->elements[p].color_idx % T) * C + job->elements[p].color;
+        pcounts[id * T * C + tc_idx]++;
+    }
+
+    prof_barrier_wait(&(job->profile), id, PROF_ELEMENT_LISTS,
+        job->serialize_barrier);
+
+    /*
+        5. Bucket tc starts after all particles in buckets before it, and this
+        thread writes after the particles of lower numbered threads.
+    */
+    offset = 0;
+    for (tc_idx = 0; tc_idx < T * C; tc_idx++) {
+        base = 0;
+        len = 0;
+        for (t = 0; t < T; t++) {
+            if (t < id) {
+                base += pcounts[t * T * C + tc_idx];
+            }
+            len += pcounts[t * T * C + tc_idx];
+        }
+        if (id == 0) {
+            job->particle_by_element_color_offsets[tc_idx] = offset;
+        }
+        list_next[tc_idx] = offset + base;
+        offset += len;
+    }
+    if (id == 0) {
+        job->particle_by_element_color_offsets[T * C] = offset;
+    }
+
+    for (i = p_start; i < p_stop; i++) {
+        p = job->in_element[i];
+        tc_idx = (job->elements[p].color_idx % T) * C + job->elements[p].color;
+        job->particle_by_element_color_list[list_next[tc_idx]] = i;
+        list_next[tc_idx]++;
+    }
+
+    rc = prof_barrier_wait(&(job->profile), id, PROF_ELEMENT_LISTS,
+        job->serialize_barrier);
+
+    /* 6. This thread's buckets are contiguous. */
+    for (i = job->particle_by_element_color_offsets[id * C];
+        i < job->particle_by_element_color_offsets[(id + 1) * C]; i++) {
+        p = job->particle_by_element_color_list[i];
+        job->elements[job->in_element[p]].n++;
+        job->elements[job->in_element[p]].m += job->particles.m[p];
+    }
+
+    if (rc == PTHREAD_BARRIER_SERIAL_THREAD && job->p2g_engine == P2G_BANDED) {
+        build_element_particle_lists(job);
+    }
+
+    prof_barrier_wait(&(job->profile), id, PROF_ELEMENT_LISTS,
+        job->serialize_barrier);
+
+    return;
+}
+/*----------------------------------------------------------------------------*/
+
+/*----------------------------------------------------------------------------*/
+void find_filled_elements(job_t *job)
+{
+    const size_t num_buckets = job->num_threads * job->num_colors;
+    const size_t Nex = job->Nx - 1;
+    size_t *offsets;
+    size_t i, p, c_idx, t_idx, tc_idx;
+    size_t k, c0, c1, r0, r1, r;
+
+    /* This function should be called ONCE per step (serial function). */
+
+    /* Lists are rebuilt below, so this is the time to reorder particles. */
+    reorder_particles_if_needed(job);
+
+    for (i = 0; i < job->num_colors; i++) {
+        job->color_indices[i] = 0;
+    }
+
+    for (i = 0; i < job->num_active; i++) {
+        p = job->in_element[i];
+
+        /* Mark element as occupied. */
+        job->elements[p].filled = 1;
+        job->elements[p].n++;
+        job->elements[p].m += job->particles.m[i];
+    }
+
+    /* Only active tiles hold particles. */
+    for (k = 0; k < job->tiles.num_active; k++) {
+        grid_tile_elements(&(job->tiles), job->tiles.active_list[k],
+            &c0, &c1, &r0, &r1);
+        for (r = r0; r < r1; r++) {
+            for (i = ijton(c0, r, Nex); i < ijton(c1, r, Nex); i++) {
+                if (job->elements[i].filled) {
+                    /* set color-based element id */
+                    job->elements[i].color_idx = job->color_indices[job->elements[i].color];
+                    job->color_indices[job->elements[i].color]++;
+                }
+            }
+        }
+    }
+
+    /*
+        Sort the particle IDs for easier element coloring. Count each bucket
+        at offsets[tc+1], prefix sum, then use offsets[tc] as the insertion
+        point and shift back once all particles are placed.
+    */
+    offsets = job->particle_by_element_color_offsets;
+    for (i = 0; i <= num_buckets; i++) {
+        offsets[i] = 0;
+    }
+
+    for (i = 0; i < job->num_active; i++) {
+
+        p = job->in_element[i];
+        c_idx = job->elements[p].color;
+        t_idx = job->elements[p].color_idx % job->num_threads;
+        tc_idx = t_idx * job->num_colors + c_idx;
+        offsets[tc_idx + 1]++;
+    }
+
+    for (i = 0; i < num_buckets; i++) {
+        offsets[i + 1] += offsets[i];
+    }
+
+    for (i = 0; i < job->num_active; i++) {
+
+        p = job->in_element[i];
+        c_idx = job->elements[p].color;
+        t_idx = job->elements[p].color_idx % job->num_threads;
+        tc_idx = t_idx * job->num_colors + c_idx;
+        job->particle_by_element_color_list[offsets[tc_idx]] = i;
+        offsets[tc_idx]++;
+    }
+
+    for (i = num_buckets; i > 0; i--) {
+        offsets[i] = offsets[i - 1];
+    }
+    offsets[0] = 0;
+
+    if (job->p2g_engine == P2G_BANDED) {
+        build_element_particle_lists(job);
+    }
+
+    return;
+}
+/*----------------------------------------------------------------------------*/
+
+/*----------------------------------------------------------------------------*/
+/*
+    Bucket active particles by element (in particle index order) and split the
+    element rows among threads so each gets about the same number of particles.
+    Used by the banded particle to grid map. Only elements of active tiles are
+    visited (in row major order, with the counts from find_filled_elements),
+    and the row bounds cover only the rows of active tiles.
+*/
+void build_element_particle_lists(job_t *job)
+{
+    const size_t Nex = job->Nx - 1;
+    const size_t total = job->num_active;
+    const grid_tiles_t *tiles = &(job->tiles);
+    size_t *offsets = job->element_particle_offsets;
+    size_t *bounds = job->p2g_row_bounds;
+    size_t i, e, r, r_stop, t, acc;
+    size_t k, k_row, k_stop, first, last, c, c0, c1, r0, r1, j0, j1;
+
+    /*
+        Set offsets[e] to the end of element e. The end of the last element
+        of a run is also written to the element after it, which is either
+        outside the active tiles or the first element of the next row.
+    */
+    acc = 0;
+    t = 1;
+    r_stop = 0;
+    for (k_row = 0; k_row < tiles->num_active; k_row = k_stop) {
+        grid_tiles_row(tiles, tiles->active_list[k_row] / tiles->nx,
+            &k_row, &k_stop);
+        grid_tile_elements(tiles, tiles->active_list[k_row],
+            &c0, &c1, &r0, &r1);
+        if (k_row == 0) {
+            bounds[0] = r0;
+        }
+
+        for (r = r0; r < r1; r++) {
+            for (k = k_row; k < k_stop; ) {
+                grid_tiles_run(tiles, &k, k_stop, &first, &last);
+                grid_tile_elements(tiles, first, &c0, &c, &j0, &j1);
+                grid_tile_elements(tiles, last, &c, &c1, &j0, &j1);
+                for (e = ijton(c0, r, Nex); e < ijton(c1, r, Nex); e++) {
+                    acc += job->elements[e].n;
+                    offsets[e] = acc;
+                }
+                offsets[e] = acc;
+            }
+
+            /* Thread t starts at the row that takes the count past t/T. */
+            while (t < job->num_threads
+                && acc > (t * total) / job->num_threads) {
+                bounds[t] = r;
+                t++;
+            }
+        }
+        r_stop = r1;
+    }
+
+    if (tiles->num_active == 0) {
+        bounds[0] = 0;
+    }
+    for (; t <= job->num_threads; t++) {
+        bounds[t] = r_stop;
+    }
+
+    /* Fill backwards so offsets[e] ends at the start of element e. */
+    for (i = job->num_active; i > 0; i--) {
+        e = job->in_element[i - 1];
+        offsets[e]--;
+        job->element_particle_list[offsets[e]] = i - 1;
+    }
+
+    return;
+}
+/*----------------------------------------------------------------------------*/
+static void permute_double_array(double *a, double *scratch,
+    const size_t *perm, size_t n)
+{
+    for (size_t k = 0; k < n; k++) {
+        scratch[k] = a[perm[k]];
+    }
+    memcpy(a, scratch, n * sizeof(double));
+
+    return;
+}
+
+static void permute_int_array(int *a, int *scratch,
+    const size_t *perm, size_t n)
+{
+    for (size_t k = 0; k < n; k++) {
+        scratch[k] = a[perm[k]];
+    }
+    memcpy(a, scratch, n * sizeof(int));
+
+    return;
+}
+
+/* Bucket of element e, or the stray bucket if its tile isn't active. */
+static inline size_t reorder_bucket(const grid_tiles_t *tiles, size_t e,
+    size_t Nex)
+{
+    const size_t k = grid_tiles_index(tiles, grid_tile_of_element(tiles, e));
+    const size_t local = ((e / Nex) % tiles->size) * tiles->size
+        + (e % Nex) % tiles->size;
+
+    if (k == tiles->num_active) {
+        return k * tiles->size * tiles->size;
+    }
+
+    return k * tiles->size * tiles->size + local;
+}
+
+/*
+    Counting sort of the active particles by the element they occupy, so that
+    particles mapping to the same nodes are adjacent in memory. Only elements
+    of active tiles get a bucket: tiles in active_list order, and elements
+    row by row within a tile. The sort is stable and inactive particles stay
+    at the end. All per-particle arrays are permuted; particle ids are
+    carried along and particle_index is rebuilt so output can still be
+    written in id order. Must be called from a serial section, after the
+    active tiles are updated and before the element lists are built.
+*/
+int reorder_particles_by_element(job_t *job)
+{
+    const size_t np = job->num_particles;
+    const size_t Nex = job->Nx - 1;
+    const grid_tiles_t *tiles = &(job->tiles);
+    const size_t tile_elements = tiles->size * tiles->size;
+    /* one bucket per element of an active tile, then one for strays. */
+    const size_t nb = tiles->num_active * tile_elements + 1;
+    size_t *bucket_start = NULL;
+    size_t *perm = NULL;
+    double *scratch = NULL;
+    size_t i, b, sorted;
+    int rc = -1;
+
+    bucket_start = (size_t *)calloc(nb + 1, sizeof(size_t));
+    perm = (size_t *)malloc(np * sizeof(size_t));
+    scratch = (double *)malloc(np * sizeof(double));
+    if (bucket_start == NULL || perm == NULL || scratch == NULL) {
+        fprintf(stderr, "%s:%s: Unable to allocate reordering buffers.\n",
+            __FILE__, __func__);
+        goto _reorder_done;
+    }
+
+/* active particles outside the active tiles (shouldn't happen) go last. */
+#define REORDER_KEY(j,i) ( \
+    ((j)->in_element[i] >= 0 && (size_t)(j)->in_element[i] < (j)->num_elements) \
+        ? reorder_bucket(tiles, (j)->in_element[i], Nex) : nb - 1)
+
+    for (i = 0; i < job->num_active; i++) {
+        bucket_start[REORDER_KEY(job, i) + 1]++;
+    }
+    for (b = 0; b < nb; b++) {
+        bucket_start[b + 1] += bucket_start[b];
+    }
+
+    sorted = 1;
+    for (i = 0; i < job->num_active; i++) {
+        b = REORDER_KEY(job, i);
+        perm[bucket_start[b]] = i;
+        if (bucket_start[b] != i) {
+            sorted = 0;
+        }
+        bucket_start[b]++;
+    }
+
+#undef REORDER_KEY
+
+    /* inactive particles are already past num_active. */
+    for (i = job->num_active; i < np; i++) {
+        perm[i] = i;
+    }
+
+    job->steps_since_reorder = 0;
+
+    if (sorted) {
+        rc = 0;
+        goto _reorder_done;
+    }
+
+    if (particle_store_permute(&(job->particles), perm) != 0) {
+        fprintf(stderr, "%s:%s: Unable to permute particle storage.\n",
+            __FILE__, __func__);
+        goto _reorder_done;
+    }
+
+    permute_int_array(job->in_element, (int *)scratch, perm, np);
+    permute_int_array(job->active, (int *)scratch, perm, np);
+
+    permute_double_array(job->h1, scratch, perm, np);
+    permute_double_array(job->h2, scratch, perm, np);
+    permute_double_array(job->h3, scratch, perm, np);
+    permute_double_array(job->h4, scratch, perm, np);
+
+    permute_double_array(job->b11, scratch, perm, np);
+    permute_double_array(job->b12, scratch, perm, np);
+    permute_double_array(job->b13, scratch, perm, np);
+    permute_double_array(job->b14, scratch, perm, np);
+
+    permute_double_array(job->b21, scratch, perm, np);
+    permute_double_array(job->b22, scratch, perm, np);
+    permute_double_array(job->b23, scratch, perm, np);
+    permute_double_array(job->b24, scratch, perm, np);
+
+    for (i = 0; i < np; i++) {
+        job->particle_index[job->particles.id[i]] = i;
+    }
+
+    rc = 0;
+
+_reorder_done:
+    free(bucket_start);
+    free(perm);
+    free(scratch);
+
+    return rc;
+}
+/*----------------------------------------------------------------------------*/
+
+/*----------------------------------------------------------------------------*/
+void calculate_shapefunctions_split(job_t *job, size_t p_start, size_t p_stop)
+{
+    size_t i, b, len, p, n;
+
+    /* reference node of each particle's element, SF_BLOCK at a time. */
+    double xn[SF_BLOCK];
+    double yn[SF_BLOCK];
+    tent_batch_out_t out;
+
+    for (b = p_start; b < p_stop; b += SF_BLOCK) {
+        len = (p_stop - b < SF_BLOCK) ? (p_stop - b) : SF_BLOCK;
+
+        for (i = 0; i < len; i++) {
             /*
-                Note: We don't need to check if the particle is active since
-                the list assembly already checks for this condition.
+                particles can leave the grid in the same chunk they are
+                mapped, give them a harmless reference point.
             */
+            if (job->active[b + i] == 0) {
+                xn[i] = job->particles.x[b + i];
+                yn[i] = job->particles.y[b + i];
+                continue;
+            }
+            p = job->in_element[b + i];
+            n = job->elements[p].nodes[0];
+            xn[i] = job->nodes.x[n];
+            yn[i] = job->nodes.y[n];
+        }
+
+        out.xl = &(job->particles.xl[b]);
+        out.yl = &(job->particles.yl[b]);
+        out.h1 = &(job->h1[b]);
+        out.h2 = &(job->h2[b]);
+        out.h3 = &(job->h3[b]);
+        out.h4 = &(job->h4[b]);
+        out.b11 = &(job->b11[b]);
+        out.b12 = &(job->b12[b]);
+        out.b13 = &(job->b13[b]);
+        out.b14 = &(job->b14[b]);
+        out.b21 = &(job->b21[b]);
+        out.b22 = &(job->b22[b]);
+        out.b23 = &(job->b23[b]);
+        out.b24 = &(job->b24[b]);
+
+        tent_batch(&(job->particles.x[b]), &(job->particles.y[b]), xn, yn,
+            job->h, len, &out);
+
+        /* range check is kept out of the kernel so it can vectorize. */
+        for (i = b; i < b + len; i++) {
+            const double xl = job->particles.xl[i];
+            const double yl = job->particles.yl[i];
+            if (xl < 0.0f || xl > 1.0f || yl < 0.0f || yl > 1.0f) {
+                CHECK_ACTIVE(job, i);
+                fprintf(stderr, "Particle %zu outside of element %d (%g, %g).\n",
+                    i, job->in_element[i], xl, yl);
+            }
+        }
+    }
 
-            p = job->in_element[p_idx];
+    return;
+}
+/*----------------------------------------------------------------------------*/
 
-            s[0] = job->h1[p_idx];
-            s[1] = job->h2[p_idx];
-            s[2] = job->h3[p_idx];
-            s[3] = job->h4[p_idx];
+/*----------------------------------------------------------------------------*/
+void calculate_strainrate_split(job_t *job, size_t p_start, size_t p_stop)
+{
+    int ce, nn[4];
+    double dx_tdy;
+    double dy_tdx;
+
+    for (size_t i = p_start; i < p_stop; i++) {
+        job->particles.exx_t[i] = 0;
+        job->particles.exy_t[i] = 0;
+        job->particles.eyy_t[i] = 0;
+        job->particles.wxy_t[i] = 0;
 
-            /* Mass. */
-            pdata[0] = job->particles[p_idx].m;
+        if (job->use_cpdi) {
+            /* loop over corners */
+            for (size_t j = 0; j < 4; j++) {
+                ce = job->particles.corner_elements[i][j];
+                /* corner is outside of particle domain. should probably deal with this better... */
+                if (ce == -1) {
+                    continue;
+                }
+                for (size_t k = 0; k < 4; k++) {
+                    nn[k] = job->elements[ce].nodes[k];
 
-            /* Momentum. */
-            pdata[1] = job->particles[p_idx].x_t * job->particles[p_idx].m;
-            pdata[2] = job->particles[p_idx].y_t * job->particles[p_idx].m;
+                    /* actual volume of particle here (not averaging volume) */
+                    job->particles.exx_t[i] += job->nodes.x_t[nn[k]] * job->particles.grad_sc[i][j][k][S_XIDX];
+                    job->particles.exy_t[i] += 0.5 * (job->nodes.x_t[nn[k]] * job->particles.grad_sc[i][j][k][S_YIDX] + job->nodes.y_t[nn[k]] * job->particles.grad_sc[i][j][k][S_XIDX]);
+                    job->particles.eyy_t[i] += job->nodes.y_t[nn[k]] * job->particles.grad_sc[i][j][k][S_YIDX];
+                    job->particles.wxy_t[i] += 0.5 * (job->nodes.x_t[nn[k]] * job->particles.grad_sc[i][j][k][S_YIDX] - job->nodes.y_t[nn[k]] * job->particles.grad_sc[i][j][k][S_XIDX]);
+                }
+            }
+        } else {
+            job->particles.exx_t[i] = DX_N_TO_P(job, x_t, 1.0, i);
+            job->particles.eyy_t[i] = DY_N_TO_P(job, y_t, 1.0, i);
 
-            /* Inertia. */
-            pdata[3] = job->particles[p_idx].x_tt * job->particles[p_idx].m;
-            pdata[4] = job->particles[p_idx].y_tt * job->particles[p_idx].m;
+            dx_tdy = DY_N_TO_P(job, x_t, 1.0, i);
+            dy_tdx = DX_N_TO_P(job, y_t, 1.0, i);
+
+            job->particles.exy_t[i] = 0.5 * (dx_tdy + dy_tdx);
+            job->particles.wxy_t[i] = 0.5 * (dx_tdy - dy_tdx);
+        }
+    }
+
+    return;
+}
+/*----------------------------------------------------------------------------*/
+
+/*----------------------------------------------------------------------------*/
+/*
+    Accumulate mass, momentum, inertia, body force and stress divergence of a
+    single particle to the nodes of its element. The caller is responsible for
+    making sure no other thread is writing to those nodes.
+*/
+static inline void map_particle_to_grid(job_t *job, size_t p_idx)
+{
+    double s[NODES_PER_ELEMENT];
+    double ds[NODES_PER_ELEMENT];
+    double ds_y[NODES_PER_ELEMENT];
+
+    const int pdata_len = 7;
+    double *node_fields[pdata_len];
+    double pdata[pdata_len];
+
+    /* also accumulate stress using gradients of shapefunctions. */
+    const int stress_len = 3;
+    double *node_d_fields[stress_len];
+    double stressdata[stress_len];
+
+    int p;
+
+    /* Be sure to replicate this order in the particle data array! */
+    node_fields[0] = job->nodes.m;
+    node_fields[1] = job->nodes.mx_t;
+    node_fields[2] = job->nodes.my_t;
+    node_fields[3] = job->nodes.mx_tt;
+    node_fields[4] = job->nodes.my_tt;
+    node_fields[5] = job->nodes.fx;
+    node_fields[6] = job->nodes.fy;
+
+    node_d_fields[0] = job->nodes.fx;
+    node_d_fields[1] = job->nodes.fy;
+
+    p = job->in_element[p_idx];
+
+    s[0] = job->h1[p_idx];
+    s[1] = job->h2[p_idx];
+    s[2] = job->h3[p_idx];
+    s[3] = job->h4[p_idx];
+
+    /* Mass. */
+    pdata[0] = job->particles.m[p_idx];
+
+    /* Momentum. */
+    pdata[1] = job->particles.x_t[p_idx] * job->particles.m[p_idx];
+    pdata[2] = job->particles.y_t[p_idx] * job->particles.m[p_idx];
+
+    /* Inertia. */
+    pdata[3] = job->particles.x_tt[p_idx] * job->particles.m[p_idx];
+    pdata[4] = job->particles.y_tt[p_idx] * job->particles.m[p_idx];
+
+    /* Body forces. */
+    pdata[5] = job->particles.bx[p_idx] * job->particles.m[p_idx];
+    pdata[6] = job->particles.by[p_idx] * job->particles.m[p_idx];
+
+    /* Stress. */
+    stressdata[0] = -job->particles.sxx[p_idx] * job->particles.v[p_idx];
+    stressdata[1] = -job->particles.sxy[p_idx] * job->particles.v[p_idx];
+    stressdata[2] = -job->particles.syy[p_idx] * job->particles.v[p_idx];
+
+    accumulate_p_to_n_ds_list47(node_fields,
+        job->elements[p].nodes, s,
+        pdata);
+
+    ds[0] = job->b11[p_idx];
+    ds[1] = job->b12[p_idx];
+    ds[2] = job->b13[p_idx];
+    ds[3] = job->b14[p_idx];
+
+    accumulate_p_to_n_ds_list42(node_d_fields,
+        job->elements[p].nodes, ds,
+        &(stressdata[0]));
+
+    ds_y[0] = job->b21[p_idx];
+    ds_y[1] = job->b22[p_idx];
+    ds_y[2] = job->b23[p_idx];
+    ds_y[3] = job->b24[p_idx];
+
+    accumulate_p_to_n_ds_list42(node_d_fields,
+        job->elements[p].nodes, ds_y,
+        &(stressdata[1]));
+
+    /* Fields registered by the material and boundary conditions. */
+    if (job->nodal_fields.num_fields != 0) {
+        nodal_field_accumulate(&(job->nodal_fields), &(job->particles), p_idx,
+            job->elements[p].nodes, s, ds, ds_y);
+    }
 
-            /* Body forces. */
-            pdata[5] = job->particles[p_idx].bx * job->particles[p_idx].m;
-            pdata[6] = job->particles[p_idx].by * job->particles[p_idx].m;
+    return;
+}
+/*----------------------------------------------------------------------------*/
 
-            /* Stress. */
-            stressdata[0] = -job->particles[p_idx].sxx * job->particles[p_idx].v;
-            stressdata[1] = -job->particles[p_idx].sxy * job->particles[p_idx].v;
-            stressdata[2] = -job->particles[p_idx].syy * job->particles[p_idx].v;
+/*----------------------------------------------------------------------------*/
+void map_to_grid_threaded(threadtask_t *task)
+{
+    job_t *job = task->job;
 
-            accumulate_p_to_n_ds_list47(job->nodes,
-                node_field_offsets, job->elements[p].nodes, s, 
-                pdata);
+    if (job->p2g_engine == P2G_BANDED) {
+        map_to_grid_banded_split(job, task->id);
+    } else {
+        map_to_grid_explicit_split(job, task->id);
+    }
 
-            ds[0] = job->b11[p_idx];
-            ds[1] = job->b12[p_idx];
-            ds[2] = job->b13[p_idx];
-            ds[3] = job->b14[p_idx];
+    return;
+}
+/*----------------------------------------------------------------------------*/
 
-            accumulate_p_to_n_ds_list42(job->nodes,
-                node_d_offsets, job->elements[p].nodes, ds, 
-                &(stressdata[0]));
+/*----------------------------------------------------------------------------*/
+void map_to_grid_explicit_split(job_t *job, size_t thread_id)
+{
+    size_t c, i, p_idx, tc_idx;
 
-            ds[0] = job->b21[p_idx];
-            ds[1] = job->b22[p_idx];
-            ds[2] = job->b23[p_idx];
-            ds[3] = job->b24[p_idx];
+    for (c = 0; c < job->num_colors; c++) {
+        tc_idx = thread_id * job->num_colors + c;
+        for (i = job->particle_by_element_color_offsets[tc_idx];
+            i < job->particle_by_element_color_offsets[tc_idx + 1]; i++) {
+            p_idx = job->particle_by_element_color_list[i];
 
-            accumulate_p_to_n_ds_list42(job->nodes,
-                node_d_offsets, job->elements[p].nodes, ds, 
-                &(stressdata[1]));
+            /*
+                Note: We don't need to check if the particle is active since
+                the list assembly already checks for this condition.
+            */
+            map_particle_to_grid(job, p_idx);
         }
+        prof_stop_color(&(job->profile), thread_id, c);
 
         /*
             Each color can be done simultaneously, but we have to sync between
             colors.
         */
-        pthread_barrier_wait(job->serialize_barrier);
+        prof_barrier_wait(&(job->profile), thread_id, PROF_P2G,
+            job->serialize_barrier);
     }
 
     return;
 }
 /*----------------------------------------------------------------------------*/
 
+/*----------------------------------------------------------------------------*/
+/*
+    Elements in an even row only share nodes with elements in the odd rows
+    directly above and below it, so all even rows can be mapped at once, then
+    all odd rows. Each thread maps the rows in [p2g_row_bounds[id],
+    p2g_row_bounds[id+1]) (balanced by particle count in find_filled_elements),
+    walking the elements of the active tiles in each row and their particles
+    in index order. Every node therefore receives its contributions in the
+    same order regardless of the number of threads or scheduling, and only
+    one barrier is needed instead of one per color.
+*/
+void map_to_grid_banded_split(job_t *job, size_t thread_id)
+{
+    const size_t Nex = job->Nx - 1;
+    const size_t r_start = job->p2g_row_bounds[thread_id];
+    const size_t r_stop = job->p2g_row_bounds[thread_id + 1];
+    size_t parity, r, e, j, k, k_stop, first, last, c, c0, c1, r0, r1;
+
+    for (parity = 0; parity < 2; parity++) {
+        r = r_start + ((r_start % 2) != parity);
+        for (; r < r_stop; r += 2) {
+            /* elements outside the active tiles hold no particles. */
+            grid_tiles_row(&(job->tiles), r / job->tiles.size, &k, &k_stop);
+            while (k < k_stop) {
+                grid_tiles_run(&(job->tiles), &k, k_stop, &first, &last);
+                grid_tile_elements(&(job->tiles), first, &c0, &c, &r0, &r1);
+                grid_tile_elements(&(job->tiles), last, &c, &c1, &r0, &r1);
+                for (e = ijton(c0, r, Nex); e < ijton(c1, r, Nex); e++) {
+                    for (j = job->element_particle_offsets[e];
+                        j < job->element_particle_offsets[e + 1]; j++) {
+                        map_particle_to_grid(job, job->element_particle_list[j]);
+                    }
+                }
+            }
+        }
+        prof_stop_color(&(job->profile), thread_id, parity);
+
+        /* odd rows touch the same nodes as the even rows next to them. */
+        if (parity == 0) {
+            prof_barrier_wait(&(job->profile), thread_id, PROF_P2G,
+                job->serialize_barrier);
+        }
+    }
+
+    return;
+}
 /*----------------------------------------------------------------------------*/
 void move_particles_explicit_usl_split(job_t *job, size_t p_start, size_t p_stop)
 {
+    /* inv_m is zero for nodes without mass, so those drop out. */
+    const double * restrict inv_m = job->nodes.inv_m;
+
     for (size_t i = p_start; i < p_stop; i++) {
-        CHECK_ACTIVE(job, i);
 
         double s[4];
         s[0] = job->h1[i];
@@ -923,36 +1881,193 @@ void move_particles_explicit_usl_split(job_t *job, size_t p_start, size_t p_stop
         s[3] = job->h4[i];
 
         size_t el = job->in_element[i];
-        job->particles[i].x_tt = 0;
-        job->particles[i].y_tt = 0;
-        for (size_t j = 0; j < 4; j++) {
-            size_t n = job->elements[el].nodes[j];
-            double m = job->nodes[n].m;
-            if (m < TOL) { continue; }
-            job->particles[i].x_tt += ((s[j] * job->nodes[n].fx) / m);
-            job->particles[i].y_tt += ((s[j] * job->nodes[n].fy) / m);
-        }
-
-        job->particles[i].x_t += job->dt * job->particles[i].x_tt;
-        job->particles[i].y_t += job->dt * job->particles[i].y_tt;
-
+        double ax = 0;
+        double ay = 0;
         double dux = 0;
         double duy = 0;
         for (size_t j = 0; j < 4; j++) {
             size_t n = job->elements[el].nodes[j];
-            double m = job->nodes[n].m;
-            if (m < TOL) { continue; }
-            dux += ((s[j] * job->nodes[n].mx_t) / m);
-            duy += ((s[j] * job->nodes[n].my_t) / m);
+            double w = s[j] * inv_m[n];
+            ax += w * job->nodes.fx[n];
+            ay += w * job->nodes.fy[n];
+            dux += w * job->nodes.mx_t[n];
+            duy += w * job->nodes.my_t[n];
         }
+
+        job->particles.x_tt[i] = ax;
+        job->particles.y_tt[i] = ay;
+        job->particles.x_t[i] += job->dt * ax;
+        job->particles.y_t[i] += job->dt * ay;
+
         dux *= job->dt;
         duy *= job->dt;
-        job->particles[i].x += dux;
-        job->particles[i].y += duy;
-        job->particles[i].ux += dux;
-        job->particles[i].uy += duy;
+        job->particles.x[i] += dux;
+        job->particles.y[i] += duy;
+        job->particles.ux[i] += dux;
+        job->particles.uy[i] += duy;
+
+    }
+    return;
+}
+/*----------------------------------------------------------------------------*/
+
+/*----------------------------------------------------------------------------*/
+/*
+    Same update as move_particles_explicit_usl_split, calculate_strainrate_split
+    and update_particle_densities_split (without CPDI), but the four nodes of
+    each particle are read once. Acceleration uses the nodal 1/m from
+    move_grid; displacement and strain rate use the nodal velocity, which
+    move_grid has already set to mx_t / m. Results differ from the split
+    passes by roundoff only.
+*/
+void g2p_fused_usl_split(job_t *job, size_t p_start, size_t p_stop)
+{
+    const double dt = job->dt;
+
+    for (size_t i = p_start; i < p_stop; i++) {
+        const int *nn = job->elements[job->in_element[i]].nodes;
+        const double s[4] = {
+            job->h1[i], job->h2[i], job->h3[i], job->h4[i]
+        };
+        const double b1[4] = {
+            job->b11[i], job->b12[i], job->b13[i], job->b14[i]
+        };
+        const double b2[4] = {
+            job->b21[i], job->b22[i], job->b23[i], job->b24[i]
+        };
+
+        double ax = 0, ay = 0;
+        double vx = 0, vy = 0;
+        double dx_tdx = 0, dx_tdy = 0;
+        double dy_tdx = 0, dy_tdy = 0;
 
+        for (size_t j = 0; j < 4; j++) {
+            const size_t n = nn[j];
+            const double w = s[j] * job->nodes.inv_m[n];
+            const double nx_t = job->nodes.x_t[n];
+            const double ny_t = job->nodes.y_t[n];
+
+            ax += w * job->nodes.fx[n];
+            ay += w * job->nodes.fy[n];
+
+            vx += s[j] * nx_t;
+            vy += s[j] * ny_t;
+
+            dx_tdx += b1[j] * nx_t;
+            dx_tdy += b2[j] * nx_t;
+            dy_tdx += b1[j] * ny_t;
+            dy_tdy += b2[j] * ny_t;
+        }
+
+        /* Update particle position and velocity. */
+        job->particles.x_tt[i] = ax;
+        job->particles.y_tt[i] = ay;
+        job->particles.x_t[i] += dt * ax;
+        job->particles.y_t[i] += dt * ay;
+
+        job->particles.x[i] += dt * vx;
+        job->particles.y[i] += dt * vy;
+        job->particles.ux[i] += dt * vx;
+        job->particles.uy[i] += dt * vy;
+
+        /* Calculate strain rate. */
+        job->particles.exx_t[i] = dx_tdx;
+        job->particles.eyy_t[i] = dy_tdy;
+        job->particles.exy_t[i] = 0.5 * (dx_tdy + dy_tdx);
+        job->particles.wxy_t[i] = 0.5 * (dx_tdy - dy_tdx);
+
+        /* update volume */
+        job->particles.v[i] = job->particles.v[i] *
+            exp(dt * (dx_tdx + dy_tdy));
+    }
+
+    return;
+}
+/*----------------------------------------------------------------------------*/
+
+/*----------------------------------------------------------------------------*/
+/*
+    Map the registered nodal fields that have a destination state column
+    back to particles [p_start, p_stop). Reads the nodal 1/m from move_grid.
+*/
+void map_nodal_fields_to_particles_split(job_t *job, size_t p_start,
+    size_t p_stop)
+{
+    double s[NODES_PER_ELEMENT];
+    size_t i;
+
+    if (job->nodal_fields.num_g2p == 0) {
+        return;
+    }
+
+    for (i = p_start; i < p_stop; i++) {
+        s[0] = job->h1[i];
+        s[1] = job->h2[i];
+        s[2] = job->h3[i];
+        s[3] = job->h4[i];
+
+        nodal_field_interpolate(&(job->nodal_fields), &(job->particles), i,
+            job->elements[job->in_element[i]].nodes, s, job->nodes.inv_m);
     }
+
+    return;
+}
+/*----------------------------------------------------------------------------*/
+
+/*----------------------------------------------------------------------------*/
+/* Point b at particles [p_start, p_stop) of the particle store. */
+void material_batch_range(job_t *job, material_batch_t *b,
+    size_t p_start, size_t p_stop)
+{
+    particle_store_t *ps = &(job->particles);
+
+    b->n = p_stop - p_start;
+    b->dt = job->dt;
+
+    b->exx_t = ps->exx_t + p_start;
+    b->exy_t = ps->exy_t + p_start;
+    b->eyy_t = ps->eyy_t + p_start;
+    b->wxy_t = ps->wxy_t + p_start;
+
+    b->sxx = ps->sxx + p_start;
+    b->sxy = ps->sxy + p_start;
+    b->syy = ps->syy + p_start;
+    b->T = ps->T + p_start;
+    b->L = ps->L + p_start;
+
+    b->state = ps->state + p_start;
+
+    b->m = ps->m + p_start;
+    b->v = ps->v + p_start;
+
+    b->fp64_props = job->material.fp64_props;
+    b->int_props = job->material.int_props;
+    b->num_fp64_props = job->material.num_fp64_props;
+    b->num_int_props = job->material.num_int_props;
+
+    return;
+}
+/*----------------------------------------------------------------------------*/
+
+/*----------------------------------------------------------------------------*/
+/*
+    Update the stress of particles [p_start, p_stop) with the material's
+    calculate_stress_batch, MATERIAL_BATCH_SIZE particles at a time.
+*/
+void calculate_stress_batched_split(job_t *job, size_t p_start, size_t p_stop)
+{
+    material_batch_t b;
+    size_t i, i_stop;
+
+    for (i = p_start; i < p_stop; i = i_stop) {
+        i_stop = i + MATERIAL_BATCH_SIZE;
+        if (i_stop > p_stop) {
+            i_stop = p_stop;
+        }
+        material_batch_range(job, &b, i, i_stop);
+        (*(job->material.calculate_stress_batch))(&b);
+    }
+
     return;
 }
 /*----------------------------------------------------------------------------*/
@@ -961,9 +2076,8 @@ void move_particles_explicit_usl_split(job_t *job, size_t p_start, size_t p_stop
 void update_particle_densities_split(job_t *job, size_t p_start, size_t p_stop)
 {
     for (size_t i = p_start; i < p_stop; i++) {
-        CHECK_ACTIVE(job, i);
-        job->particles[i].v = job->particles[i].v *
-            exp(job->dt * (job->particles[i].exx_t + job->particles[i].eyy_t));
+        job->particles.v[i] = job->particles.v[i] *
+            exp(job->dt * (job->particles.exx_t[i] + job->particles.eyy_t[i]));
     }
 
     return;
@@ -973,12 +2087,17 @@ void update_particle_densities_split(job_t *job, size_t p_start, size_t p_stop)
 /*----------------------------------------------------------------------------*/
 void mpm_cleanup(job_t *job)
 {
-    free(job->nodes);
-    free(job->particles);
+    node_store_free(&(job->nodes));
+    nodal_field_free(&(job->nodal_fields));
+    particle_store_free(&(job->particles));
     free(job->elements);
+    free(job->element_fields);
+    free(job->element_implicit);
+    grid_tiles_free(&(job->tiles));
     
     free(job->in_element);
     free(job->active);
+    free(job->particle_index);
 
     free(job->h1);
     free(job->h2);
@@ -998,6 +2117,7 @@ void mpm_cleanup(job_t *job)
     free(job->u_dirichlet);
     free(job->u_dirichlet_mask);
     free(job->node_number_override);
+    bc_constraints_free(&(job->bc_constraints));
     free(job->color_indices);
 
     return;
@@ -9,17 +9,48 @@
 #define __PROCESS_USL_H__
 #include "process.h"
 
-job_t *mpm_init(int N, double h, particle_t *particles, size_t num_particles, double t);
+/*
+    particles per call to a material's calculate_stress_batch, about 40KB of
+    particle data (less than most L2 caches) for the 3D materials.
+*/
+#define MATERIAL_BATCH_SIZE 128
+
+job_t *mpm_init(int Nx, int Ny, double x0, double y0, double lx, double ly,
+    particle_t *particles, size_t num_particles, double t);
 void explicit_mpm_step_musl_threaded(void *_task);
 void explicit_mpm_step_usl_threaded(void *_task);
 void move_grid_split(job_t *job, size_t n_start, size_t n_stop);
 void create_particle_to_element_map_threaded(threadtask_t *task);
+int create_particle_to_element_map_split(job_t *job, size_t p_start, size_t p_stop);
 void find_filled_elements(job_t *job);
+void find_filled_elements_threaded(threadtask_t *task);
+void reorder_particles_if_needed(job_t *job);
+size_t compact_active_particles(job_t *job);
+void active_particle_range(job_t *job, size_t thread_id,
+    size_t *p_start, size_t *p_stop);
+void update_active_particles(job_t *job);
+void update_active_tiles(job_t *job);
+int element_fields_alloc(job_t *job);
+int element_implicit_alloc(job_t *job);
+void report_element_storage(job_t *job, FILE *fd);
+void activate_particle_tiles(job_t *job);
+void clear_grid_tiles_split(job_t *job, size_t thread_id);
+void move_grid_tiles_split(job_t *job, size_t thread_id);
+int reorder_particles_by_element(job_t *job);
+void build_element_particle_lists(job_t *job);
 void calculate_shapefunctions_split(job_t *job, size_t p_start, size_t p_stop);
 void calculate_strainrate_split(job_t *job, size_t p_start, size_t p_stop);
+void map_to_grid_threaded(threadtask_t *task);
 void map_to_grid_explicit_split(job_t *job, size_t thread_id);
+void map_to_grid_banded_split(job_t *job, size_t thread_id);
 void move_particles_explicit_usl_split(job_t *job, size_t p_start, size_t p_stop);
+void g2p_fused_usl_split(job_t *job, size_t p_start, size_t p_stop);
+void map_nodal_fields_to_particles_split(job_t *job, size_t p_start,
+    size_t p_stop);
 void update_particle_densities_split(job_t *job, size_t p_start, size_t p_stop);
+void material_batch_range(job_t *job, material_batch_t *b,
+    size_t p_start, size_t p_stop);
+void calculate_stress_batched_split(job_t *job, size_t p_start, size_t p_stop);
 void mpm_cleanup(job_t *job);
 
 #endif //__PROCESS_USL_H__
@@ -0,0 +1,228 @@
+/**
+    \file profile.c
+    \author Sachith Dunatunga
+    \date 17.10.2026
+
+    mpm_2d -- An implementation of the Material Point Method in 2D.
+*/
+#include <stdlib.h>
+#include <string.h>
+#include "profile.h"
+
+static const char *prof_phase_names[PROF_NUM_PHASES] = {
+    "grid_clear",
+    "element_map",
+    "shapefunctions",
+    "serial_section",
+    "element_lists",
+    "p2g",
+    "boundary_conditions",
+    "grid_update",
+    "g2p",
+    "strainrate",
+    "stress"
+};
+
+/*---prof_init----------------------------------------------------------------*/
+int prof_init(step_profile_t *p, size_t num_threads, size_t num_colors,
+    int enabled, int per_frame)
+{
+    void *threads = NULL;
+    void *frame_start = NULL;
+
+    memset(p, 0, sizeof(step_profile_t));
+    p->num_threads = num_threads;
+    p->num_colors = (num_colors < PROF_MAX_COLORS) ? num_colors : PROF_MAX_COLORS;
+
+    if (!enabled) {
+        return 0;
+    }
+
+    if (posix_memalign(&threads, PROF_CACHE_LINE,
+            sizeof(prof_thread_t) * num_threads) != 0) {
+        return -1;
+    }
+    memset(threads, 0, sizeof(prof_thread_t) * num_threads);
+
+    if (per_frame) {
+        frame_start = calloc(num_threads, sizeof(prof_thread_t));
+        if (frame_start == NULL) {
+            free(threads);
+            return -1;
+        }
+    }
+
+    p->threads = (prof_thread_t *)threads;
+    p->frame_start = (prof_thread_t *)frame_start;
+    p->enabled = 1;
+
+    return 0;
+}
+/*----------------------------------------------------------------------------*/
+
+/*---prof_free----------------------------------------------------------------*/
+void prof_free(step_profile_t *p)
+{
+    free(p->threads);
+    free(p->frame_start);
+    p->threads = NULL;
+    p->frame_start = NULL;
+    p->enabled = 0;
+
+    return;
+}
+/*----------------------------------------------------------------------------*/
+
+/*---prof_write_csv-----------------------------------------------------------*/
+void prof_write_csv(const step_profile_t *p, FILE *fd, double elapsed)
+{
+    size_t t, c;
+    int k;
+
+    if (!p->enabled) {
+        return;
+    }
+
+    fprintf(fd, "thread,phase,seconds,percent\n");
+    for (t = 0; t < p->num_threads; t++) {
+        const prof_thread_t *pt = &(p->threads[t]);
+        for (k = 0; k < PROF_NUM_PHASES; k++) {
+            fprintf(fd, "%zu,%s,%.9f,%.3f\n", t, prof_phase_names[k],
+                pt->phase_time[k],
+                (elapsed > 0) ? (100.0 * pt->phase_time[k] / elapsed) : 0.0);
+        }
+        for (c = 0; c < p->num_colors; c++) {
+            fprintf(fd, "%zu,p2g_color_%zu,%.9f,%.3f\n", t, c,
+                pt->p2g_color_time[c],
+                (elapsed > 0) ? (100.0 * pt->p2g_color_time[c] / elapsed) : 0.0);
+        }
+        fprintf(fd, "%zu,barrier_wait,%.9f,%.3f\n", t, pt->barrier_time,
+            (elapsed > 0) ? (100.0 * pt->barrier_time / elapsed) : 0.0);
+    }
+
+    return;
+}
+/*----------------------------------------------------------------------------*/
+
+/*---prof_write_json----------------------------------------------------------*/
+void prof_write_json(const step_profile_t *p, FILE *fd, double elapsed)
+{
+    size_t t, c;
+    int k;
+
+    if (!p->enabled) {
+        return;
+    }
+
+    fprintf(fd, "{\n  \"steps\": %zu,\n  \"elapsed\": %.9f,\n", p->steps, elapsed);
+    fprintf(fd, "  \"threads\": [\n");
+    for (t = 0; t < p->num_threads; t++) {
+        const prof_thread_t *pt = &(p->threads[t]);
+        fprintf(fd, "    {\n      \"id\": %zu,\n      \"phases\": {", t);
+        for (k = 0; k < PROF_NUM_PHASES; k++) {
+            fprintf(fd, "%s\n        \"%s\": %.9f", (k == 0) ? "" : ",",
+                prof_phase_names[k], pt->phase_time[k]);
+        }
+        fprintf(fd, "\n      },\n      \"p2g_colors\": [");
+        for (c = 0; c < p->num_colors; c++) {
+            fprintf(fd, "%s%.9f", (c == 0) ? "" : ", ", pt->p2g_color_time[c]);
+        }
+        fprintf(fd, "],\n      \"barrier_wait\": %.9f,\n", pt->barrier_time);
+        fprintf(fd, "      \"barrier_count\": %zu\n    }%s\n", pt->barrier_count,
+            (t + 1 < p->num_threads) ? "," : "");
+    }
+    fprintf(fd, "  ]\n}\n");
+
+    return;
+}
+/*----------------------------------------------------------------------------*/
+
+/*---prof_report--------------------------------------------------------------*/
+void prof_report(const step_profile_t *p, FILE *fd, double elapsed)
+{
+    size_t t;
+    int k;
+    double sum, max, barrier;
+
+    if (!p->enabled) {
+        return;
+    }
+
+    fprintf(fd, "Step profile (%zu steps, average and max over threads):\n",
+        p->steps);
+    for (k = 0; k < PROF_NUM_PHASES; k++) {
+        sum = 0;
+        max = 0;
+        for (t = 0; t < p->num_threads; t++) {
+            sum += p->threads[t].phase_time[k];
+            if (p->threads[t].phase_time[k] > max) {
+                max = p->threads[t].phase_time[k];
+            }
+        }
+        fprintf(fd, "%20s: %9.3fs %9.3fs (%5.1f%%)\n", prof_phase_names[k],
+            sum / p->num_threads, max,
+            (elapsed > 0) ? (100.0 * max / elapsed) : 0.0);
+    }
+
+    barrier = 0;
+    for (t = 0; t < p->num_threads; t++) {
+        barrier += p->threads[t].barrier_time;
+    }
+    fprintf(fd, "%20s: %9.3fs\n", "barrier_wait", barrier / p->num_threads);
+
+    return;
+}
+/*----------------------------------------------------------------------------*/
+
+/*---prof_write_frame_header--------------------------------------------------*/
+void prof_write_frame_header(const step_profile_t *p, FILE *fd)
+{
+    int k;
+
+    if (!p->enabled || p->frame_start == NULL) {
+        return;
+    }
+
+    fprintf(fd, "frame,t,steps");
+    for (k = 0; k < PROF_NUM_PHASES; k++) {
+        fprintf(fd, ",%s", prof_phase_names[k]);
+    }
+    fprintf(fd, ",barrier_wait\n");
+
+    return;
+}
+/*----------------------------------------------------------------------------*/
+
+/*---prof_write_frame---------------------------------------------------------*/
+void prof_write_frame(step_profile_t *p, FILE *fd, size_t frame, double t)
+{
+    size_t i;
+    int k;
+    double sum;
+
+    if (!p->enabled || p->frame_start == NULL) {
+        return;
+    }
+
+    fprintf(fd, "%zu,%.9g,%zu", frame, t, p->steps - p->frame_start_steps);
+    for (k = 0; k < PROF_NUM_PHASES; k++) {
+        sum = 0;
+        for (i = 0; i < p->num_threads; i++) {
+            sum += p->threads[i].phase_time[k]
+                - p->frame_start[i].phase_time[k];
+        }
+        fprintf(fd, ",%.9f", sum);
+    }
+    sum = 0;
+    for (i = 0; i < p->num_threads; i++) {
+        sum += p->threads[i].barrier_time - p->frame_start[i].barrier_time;
+    }
+    fprintf(fd, ",%.9f\n", sum);
+
+    memcpy(p->frame_start, p->threads, sizeof(prof_thread_t) * p->num_threads);
+    p->frame_start_steps = p->steps;
+
+    return;
+}
+/*----------------------------------------------------------------------------*/
+
@@ -0,0 +1,169 @@
+/**
+    \file profile.h
+    \author Sachith Dunatunga
+    \date 17.10.2026
+
+    Per thread timing of the phases of the threaded explicit solver.
+
+    Each thread keeps a mark (the end of its last timed span). prof_stop
+    charges the time since the mark to a phase and moves the mark, so the
+    spans of a step are back to back and cost one clock read each.
+    prof_barrier_wait closes the current span and charges the time spent
+    waiting at the barrier separately. When profiling is disabled every call
+    returns after checking a flag.
+*/
+#ifndef __PROFILE_H__
+#define __PROFILE_H__
+#include <stdio.h>
+#include <time.h>
+#include <pthread.h>
+
+#define PROF_CACHE_LINE 64
+#define PROF_MAX_COLORS 8
+
+enum prof_phase_e {
+    PROF_GRID_CLEAR=0,
+    PROF_ELEMENT_MAP,
+    PROF_SHAPEFUNCTIONS,
+    PROF_SERIAL,
+    PROF_ELEMENT_LISTS,
+    PROF_P2G,
+    PROF_BC,
+    PROF_GRID_UPDATE,
+    PROF_G2P,
+    PROF_STRAINRATE,
+    PROF_STRESS,
+    PROF_NUM_PHASES
+};
+
+typedef struct prof_thread_s {
+    struct timespec mark;
+    double phase_time[PROF_NUM_PHASES];
+
+    /* P2G time by element color (or row parity for the banded map). */
+    double p2g_color_time[PROF_MAX_COLORS];
+
+    double barrier_time;
+    size_t barrier_count;
+} __attribute__((aligned(PROF_CACHE_LINE))) prof_thread_t;
+
+typedef struct step_profile_s {
+    int enabled;
+    size_t num_threads;
+    size_t num_colors;
+    size_t steps;
+
+    prof_thread_t *threads;
+
+    /* totals when the last frame row was written (NULL unless per frame). */
+    prof_thread_t *frame_start;
+    size_t frame_start_steps;
+} step_profile_t;
+
+/*
+    Allocate per thread counters. A disabled profile allocates nothing.
+    Returns 0 on success, -1 if an allocation failed.
+*/
+int prof_init(step_profile_t *p, size_t num_threads, size_t num_colors,
+    int enabled, int per_frame);
+void prof_free(step_profile_t *p);
+
+static inline double prof_elapsed(const struct timespec *tic,
+    const struct timespec *toc)
+{
+    return (toc->tv_sec - tic->tv_sec) + 1e-9 * (toc->tv_nsec - tic->tv_nsec);
+}
+
+/* Start timing for this thread (at the top of a step). */
+static inline void prof_start(step_profile_t *p, size_t thread_id)
+{
+    if (!p->enabled) {
+        return;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &(p->threads[thread_id].mark));
+
+    return;
+}
+
+/* Charge the time since the last mark to phase. */
+static inline void prof_stop(step_profile_t *p, size_t thread_id,
+    enum prof_phase_e phase)
+{
+    struct timespec now;
+    prof_thread_t *pt;
+
+    if (!p->enabled) {
+        return;
+    }
+    pt = &(p->threads[thread_id]);
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    pt->phase_time[phase] += prof_elapsed(&(pt->mark), &now);
+    pt->mark = now;
+
+    return;
+}
+
+/* Charge the time since the last mark to P2G and to one color. */
+static inline void prof_stop_color(step_profile_t *p, size_t thread_id,
+    size_t color)
+{
+    struct timespec now;
+    prof_thread_t *pt;
+    double dt;
+
+    if (!p->enabled) {
+        return;
+    }
+    pt = &(p->threads[thread_id]);
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    dt = prof_elapsed(&(pt->mark), &now);
+    pt->phase_time[PROF_P2G] += dt;
+    if (color < PROF_MAX_COLORS) {
+        pt->p2g_color_time[color] += dt;
+    }
+    pt->mark = now;
+
+    return;
+}
+
+/*
+    Close the current span as phase, then wait at the barrier and charge the
+    wait separately. Returns what pthread_barrier_wait returned.
+*/
+static inline int prof_barrier_wait(step_profile_t *p, size_t thread_id,
+    enum prof_phase_e phase, pthread_barrier_t *barrier)
+{
+    struct timespec now;
+    prof_thread_t *pt;
+    int rc;
+
+    if (!p->enabled) {
+        return pthread_barrier_wait(barrier);
+    }
+
+    prof_stop(p, thread_id, phase);
+    rc = pthread_barrier_wait(barrier);
+
+    pt = &(p->threads[thread_id]);
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    pt->barrier_time += prof_elapsed(&(pt->mark), &now);
+    pt->barrier_count++;
+    pt->mark = now;
+
+    return rc;
+}
+
+/* Totals for the whole run. */
+void prof_write_csv(const step_profile_t *p, FILE *fd, double elapsed);
+void prof_write_json(const step_profile_t *p, FILE *fd, double elapsed);
+void prof_report(const step_profile_t *p, FILE *fd, double elapsed);
+
+/*
+    Per frame rows: time spent in each phase (summed over threads) since the
+    previous row. Must be called from a serial section.
+*/
+void prof_write_frame_header(const step_profile_t *p, FILE *fd);
+void prof_write_frame(step_profile_t *p, FILE *fd, size_t frame, double t);
+
+#endif //__PROFILE_H__
+
@@ -0,0 +1,163 @@
+/**
+    \file scheduler.c
+    \author Sachith Dunatunga
+    \date 17.10.2026
+
+    mpm_2d -- An implementation of the Material Point Method in 2D.
+*/
+#include <stdlib.h>
+#include <string.h>
+#include "scheduler.h"
+
+#define SCHED_QUEUE(s,phase,t) (&((s)->queues[(phase) * (s)->num_threads + (t)]))
+
+/*---particle_sched_init------------------------------------------------------*/
+int particle_sched_init(particle_sched_t *s, size_t num_particles,
+    size_t num_threads, size_t grain)
+{
+    void *queues = NULL;
+    void *stats = NULL;
+
+    memset(s, 0, sizeof(particle_sched_t));
+
+    if (num_threads == 0) {
+        return -1;
+    }
+
+    if (posix_memalign(&queues, SCHED_CACHE_LINE,
+            sizeof(sched_queue_t) * SCHED_NUM_PHASES * num_threads) != 0) {
+        return -1;
+    }
+    if (posix_memalign(&stats, SCHED_CACHE_LINE,
+            sizeof(sched_stats_t) * num_threads) != 0) {
+        free(queues);
+        return -1;
+    }
+
+    s->num_threads = num_threads;
+    s->requested_grain = grain;
+    particle_sched_resize(s, num_particles);
+    s->queues = (sched_queue_t *)queues;
+    s->stats = (sched_stats_t *)stats;
+    memset(s->stats, 0, sizeof(sched_stats_t) * num_threads);
+
+    for (size_t t = 0; t < num_threads; t++) {
+        for (int phase = 0; phase < SCHED_NUM_PHASES; phase++) {
+            particle_sched_reset(s, phase, t);
+        }
+    }
+
+    return 0;
+}
+/*----------------------------------------------------------------------------*/
+
+/*---particle_sched_free------------------------------------------------------*/
+void particle_sched_free(particle_sched_t *s)
+{
+    free(s->queues);
+    free(s->stats);
+    s->queues = NULL;
+    s->stats = NULL;
+
+    return;
+}
+/*----------------------------------------------------------------------------*/
+
+/*---particle_sched_resize----------------------------------------------------*/
+void particle_sched_resize(particle_sched_t *s, size_t num_particles)
+{
+    size_t grain = s->requested_grain;
+
+    if (grain == 0) {
+        grain = (num_particles + s->num_threads - 1) / s->num_threads;
+        if (grain == 0) {
+            grain = 1;
+        }
+    }
+
+    s->num_particles = num_particles;
+    s->grain = grain;
+    s->num_chunks = (num_particles + grain - 1) / grain;
+
+    return;
+}
+/*----------------------------------------------------------------------------*/
+
+/*---particle_sched_reset-----------------------------------------------------*/
+void particle_sched_reset(particle_sched_t *s, enum sched_phase_e phase,
+    size_t thread_id)
+{
+    sched_queue_t *q = SCHED_QUEUE(s, phase, thread_id);
+
+    /* each thread starts with a contiguous block of chunks. */
+    q->next = (thread_id * s->num_chunks) / s->num_threads;
+    q->stop = ((thread_id + 1) * s->num_chunks) / s->num_threads;
+
+    return;
+}
+/*----------------------------------------------------------------------------*/
+
+/*---particle_sched_next------------------------------------------------------*/
+int particle_sched_next(particle_sched_t *s, enum sched_phase_e phase,
+    size_t thread_id, size_t *p_start, size_t *p_stop)
+{
+    sched_stats_t *st = &(s->stats[thread_id]);
+    struct timespec now;
+    size_t chunk;
+
+    if (!st->in_phase) {
+        st->in_phase = 1;
+        clock_gettime(CLOCK_MONOTONIC, &(st->phase_start));
+    }
+
+    /* own queue first, then walk the other threads' queues. */
+    for (size_t k = 0; k < s->num_threads; k++) {
+        size_t victim = (thread_id + k) % s->num_threads;
+        sched_queue_t *q = SCHED_QUEUE(s, phase, victim);
+
+        if (__atomic_load_n(&(q->next), __ATOMIC_RELAXED) >= q->stop) {
+            continue;
+        }
+
+        chunk = __atomic_fetch_add(&(q->next), 1, __ATOMIC_RELAXED);
+        if (chunk < q->stop) {
+            *p_start = chunk * s->grain;
+            *p_stop = *p_start + s->grain;
+            if (*p_stop > s->num_particles) {
+                *p_stop = s->num_particles;
+            }
+            st->chunks_run++;
+            if (victim != thread_id) {
+                st->chunks_stolen++;
+            }
+            return 1;
+        }
+    }
+
+    /* nothing left, count the phase as busy time. */
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    st->busy_time += (now.tv_sec - st->phase_start.tv_sec)
+        + 1e-9 * (now.tv_nsec - st->phase_start.tv_nsec);
+    st->in_phase = 0;
+
+    return 0;
+}
+/*----------------------------------------------------------------------------*/
+
+/*---particle_sched_report----------------------------------------------------*/
+void particle_sched_report(const particle_sched_t *s, FILE *fd,
+    double elapsed)
+{
+    fprintf(fd, "Particle scheduler: %zu chunks of %zu particles.\n",
+        s->num_chunks, s->grain);
+    for (size_t t = 0; t < s->num_threads; t++) {
+        fprintf(fd, "Thread %zu: busy %.3fs (%.1f%%), %zu chunks (%zu stolen).\n",
+            t, s->stats[t].busy_time,
+            (elapsed > 0) ? (100.0 * s->stats[t].busy_time / elapsed) : 0.0,
+            s->stats[t].chunks_run, s->stats[t].chunks_stolen);
+    }
+
+    return;
+}
+/*----------------------------------------------------------------------------*/
+
@@ -0,0 +1,95 @@
+/**
+    \file scheduler.h
+    \author Sachith Dunatunga
+    \date 17.10.2026
+
+    Chunked work-stealing scheduler for the particle loops of the threaded
+    explicit solvers.
+*/
+#ifndef __SCHEDULER_H__
+#define __SCHEDULER_H__
+#include <stdio.h>
+#include <time.h>
+
+#define SCHED_CACHE_LINE 64
+
+/*
+    Particle loops that are scheduled dynamically. Each phase has its own set
+    of queues so the queues for one phase can be refilled while another phase
+    is running.
+*/
+enum sched_phase_e {
+    SCHED_PHASE_PRE_P2G=0,
+    SCHED_PHASE_G2P,
+    SCHED_NUM_PHASES
+};
+
+/*
+    Queue of chunk indices [next, stop). The owner and thieves both take
+    chunks with an atomic increment of next.
+*/
+typedef struct sched_queue_s {
+    size_t next;
+    size_t stop;
+} __attribute__((aligned(SCHED_CACHE_LINE))) sched_queue_t;
+
+/* Per thread statistics, only written by the owning thread. */
+typedef struct sched_stats_s {
+    int in_phase;
+    struct timespec phase_start;
+    double busy_time;
+    size_t chunks_run;
+    size_t chunks_stolen;
+} __attribute__((aligned(SCHED_CACHE_LINE))) sched_stats_t;
+
+typedef struct particle_sched_s {
+    size_t num_threads;
+    size_t num_particles;
+
+    /* particles per chunk (requested_grain is 0 for a static split). */
+    size_t requested_grain;
+    size_t grain;
+    size_t num_chunks;
+
+    /* queues arranged [phase][thread]. */
+    sched_queue_t *queues;
+    sched_stats_t *stats;
+} particle_sched_t;
+
+/*
+    Split num_particles into chunks of grain particles. A grain of 0 gives
+    each thread a single chunk (a static split with no stealing). Returns 0
+    on success, -1 if an allocation failed.
+*/
+int particle_sched_init(particle_sched_t *s, size_t num_particles,
+    size_t num_threads, size_t grain);
+void particle_sched_free(particle_sched_t *s);
+
+/*
+    Change the number of particles to schedule, keeping the grain the
+    scheduler was created with. Queues must be reset afterwards.
+*/
+void particle_sched_resize(particle_sched_t *s, size_t num_particles);
+
+/*
+    Refill this thread's queue for the given phase. Must be called after every
+    thread has finished the phase and before any thread starts it again, with
+    a barrier in between.
+*/
+void particle_sched_reset(particle_sched_t *s, enum sched_phase_e phase,
+    size_t thread_id);
+
+/*
+    Get the next range of particles [*p_start, *p_stop) for this thread,
+    stealing from other threads once its own queue is empty. Returns 0 when
+    there is no work left in the phase.
+*/
+int particle_sched_next(particle_sched_t *s, enum sched_phase_e phase,
+    size_t thread_id, size_t *p_start, size_t *p_stop);
+
+/* Print time each thread spent working on scheduled particle loops. */
+void particle_sched_report(const particle_sched_t *s, FILE *fd,
+    double elapsed);
+
+#endif //__SCHEDULER_H__
+
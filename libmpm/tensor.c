@@ -13,6 +13,7 @@
 #include "particle.h"
 
 #include "tensor.h"
+#include "tensor3.h"
 #define NDEBUG
 #include <assert.h>
 
@@ -63,13 +64,8 @@ void tensor_trace(double* restrict trA, const double* restrict A, size_t dim)
 
 void tensor_trace3(double* restrict trA, const double* restrict A)
 {
-    size_t i;
+    tensor3_trace(trA, A);
 
-    *trA = 0;
-    for (i = 0; i < 3; i++) {
-        *trA += A[i * 3 + i];
-    }
-    
     return;
 }
 /*----------------------------------------------------------------------------*/
@@ -94,7 +90,7 @@ void tensor_add(double *C, const double *A, const double *B, size_t dim)
     assert(B != NULL);
 
     if (C != A) {
-        tensor_copy(C, A, dim*dim);
+        tensor_copy(C, A, dim);
     }
 
     for (i = 0; i < dim; i++) {
@@ -108,20 +104,11 @@ void tensor_add(double *C, const double *A, const double *B, size_t dim)
 
 void tensor_add3(double *C, const double *A, const double *B)
 {
-    size_t i, j;
     assert(C != NULL);
     assert(A != NULL);
     assert(B != NULL);
 
-    if (C != A) {
-        tensor_copy(C, A, 3*3);
-    }
-
-    for (i = 0; i < 3; i++) {
-        for (j = 0; j < 3; j++) {
-            C[i*3 + j] += B[i*3 + j];
-        }
-    }
+    tensor3_add(C, A, B);
 
     return;
 }
@@ -155,7 +142,6 @@ void tensor_copy(double* restrict C, const double* restrict A, size_t dim)
 
 void tensor_copy3(double* restrict C, const double* restrict A)
 {
-    size_t i, j;
     assert(C != NULL);
     assert(A != NULL);
 
@@ -163,11 +149,7 @@ void tensor_copy3(double* restrict C, const double* restrict A)
         return;
     }
 
-    for (i = 0; i < 3; i++) {
-        for (j = 0; j < 3; j++) {
-            C[i*3 + j] = A[i*3 + j];
-        }
-    }
+    tensor3_copy(C, A);
 
     return;
 }
@@ -204,21 +186,12 @@ void tensor_decompose(double* restrict A_0, double* restrict c, const double* re
 
 void tensor_decompose3(double* restrict A_0, double* restrict c, const double* restrict A)
 {
-    size_t i;
-    double trA;
     assert(A != NULL);
     assert(A_0 != NULL);
     assert(c != NULL);
     assert(A != A_0);
 
-
-    tensor_trace3(&trA, A);
-    *c = trA / 3.0;
-    
-    tensor_copy3(A_0, A);
-    for (i = 0; i < 3; i++) {
-        A_0[i*3 + i] = A_0[i*3 + i] - (*c);
-    }
+    tensor3_decompose(A_0, c, A);
 
     return;
 }
@@ -269,15 +242,7 @@ void tensor_multiply3(double* restrict C, const double* restrict A, const double
 
 void tensor_multiply3_helper(double* restrict C, const double* restrict A, const double* restrict B)
 {
-    size_t i, j;
-
-    for (i = 0; i < 3; i++) {
-        for (j = 0; j < 3; j++) {
-            C[i*3+j] = A[3*i+0] * B[3*0+j]
-                    + A[3*i+1] * B[3*1+j]
-                    + A[3*i+2] * B[3*2+j];
-        }
-    }
+    tensor3_multiply(C, A, B);
 
     return;
 }
@@ -305,14 +270,9 @@ void tensor_scale(double *A, double c, size_t dim)
 
 void tensor_scale3(double *A, double c)
 {
-    size_t i, j;
     assert(A != NULL);
 
-    for (i = 0; i < 3; i++) {
-        for (j = 0; j < 3; j++) {
-            A[i*3 + j] *= c;
-        }
-    }
+    tensor3_scale(A, c);
 
     return;
 }
@@ -342,16 +302,11 @@ void tensor_sym(double * restrict C, const double * restrict A, size_t dim)
 
 void tensor_sym3(double * restrict C, const double * restrict A)
 {
-    size_t i, j;
     assert(A != NULL);
     assert(C != NULL);
     assert(A != C);
 
-    for (i = 0; i < 3; i++) {
-        for (j = 0; j < 3; j++) {
-            C[i*3 + j] = 0.5 *(A[i*3 + j] + A[j*3 + i]);
-        }
-    }
+    tensor3_sym(C, A);
 
     return;
 }
@@ -381,16 +336,11 @@ void tensor_skw(double * restrict C, const double * restrict A, size_t dim)
 
 void tensor_skw3(double * restrict C, const double * restrict A)
 {
-    size_t i, j;
     assert(A != NULL);
     assert(C != NULL);
     assert(A != C);
 
-    for (i = 0; i < 3; i++) {
-        for (j = 0; j < 3; j++) {
-            C[i*3 + j] = 0.5 *(A[i*3 + j] - A[j*3 + i]);
-        }
-    }
+    tensor3_skw(C, A);
 
     return;
 }
@@ -421,17 +371,11 @@ void tensor_contraction(double *c, double *A, double *B, size_t dim)
 
 void tensor_contraction3(double *c, const double *A, const double *B)
 {
-    size_t i, j;
     assert(A != NULL);
     assert(B != NULL);
     assert(c != NULL);
-    
-    *c = 0;
-    for (i = 0; i < 3; i++) {
-        for (j = 0; j < 3; j++) {
-            (*c) += A[i*3 + j] * B[i*3 + j];
-        }
-    }
+
+    tensor3_contraction(c, A, B);
 
     return;
 }
@@ -4,6 +4,9 @@
     \date 04.06.12
 
     mpm_2d -- An implementation of the Material Point Method in 2D.
+
+    The 3x3 functions are wrappers around the inline versions in tensor3.h,
+    which materials should use in per particle loops.
 */
 #ifndef __TENSOR_H__
 #define __TENSOR_H__
@@ -0,0 +1,229 @@
+/**
+    \file tensor3.h
+    \author Sachith Dunatunga
+    \date 17.10.2026
+
+    Inline versions of the 3x3 tensor functions in tensor.h, for use inside
+    per particle loops of materials.
+
+    Tensors are 9 doubles in row major order (see XX, XY, ... in particle.h),
+    the same layout as the T and L blocks of the particle store. Every loop
+    has a fixed trip count, so the compiler unrolls them and keeps rows in
+    vector registers. The functions take the same arguments as their tensor.h
+    counterparts, e.g. tensor3_multiply(C, A, B) is tensor_multiply3(C, A, B),
+    and tensor.c implements those with these.
+
+    The _n forms apply the same operation to n tensors stored one after the
+    other (e.g. job->particles.T + p_start).
+*/
+#ifndef __TENSOR3_H__
+#define __TENSOR3_H__
+#include <stddef.h>
+
+static inline void tensor3_zero(double * restrict A)
+{
+    for (size_t k = 0; k < 9; k++) {
+        A[k] = 0;
+    }
+
+    return;
+}
+
+static inline void tensor3_trace(double * restrict trA,
+    const double * restrict A)
+{
+    *trA = A[0] + A[4] + A[8];
+
+    return;
+}
+
+/* C may be the same as A. */
+static inline void tensor3_copy(double *C, const double *A)
+{
+    double t[9];
+
+    for (size_t k = 0; k < 9; k++) {
+        t[k] = A[k];
+    }
+    for (size_t k = 0; k < 9; k++) {
+        C[k] = t[k];
+    }
+
+    return;
+}
+
+/* C = A + B, C may be the same as A or B. */
+static inline void tensor3_add(double *C, const double *A, const double *B)
+{
+    double t[9];
+
+    for (size_t k = 0; k < 9; k++) {
+        t[k] = A[k] + B[k];
+    }
+    for (size_t k = 0; k < 9; k++) {
+        C[k] = t[k];
+    }
+
+    return;
+}
+
+static inline void tensor3_scale(double *A, double c)
+{
+    for (size_t k = 0; k < 9; k++) {
+        A[k] *= c;
+    }
+
+    return;
+}
+
+/* deviator A_0 and spherical part c of A. */
+static inline void tensor3_decompose(double * restrict A_0,
+    double * restrict c, const double * restrict A)
+{
+    double trA;
+
+    tensor3_trace(&trA, A);
+    *c = trA / 3.0;
+
+    for (size_t k = 0; k < 9; k++) {
+        A_0[k] = A[k];
+    }
+    A_0[0] -= *c;
+    A_0[4] -= *c;
+    A_0[8] -= *c;
+
+    return;
+}
+
+/* C = A B, row by row: row i of C is sum_k A[i][k] (row k of B). */
+static inline void tensor3_multiply(double * restrict C,
+    const double * restrict A, const double * restrict B)
+{
+    for (size_t i = 0; i < 3; i++) {
+        for (size_t j = 0; j < 3; j++) {
+            C[3*i + j] = A[3*i + 0] * B[0 + j]
+                + A[3*i + 1] * B[3 + j]
+                + A[3*i + 2] * B[6 + j];
+        }
+    }
+
+    return;
+}
+
+static inline void tensor3_sym(double * restrict C, const double * restrict A)
+{
+    for (size_t i = 0; i < 3; i++) {
+        for (size_t j = 0; j < 3; j++) {
+            C[3*i + j] = 0.5 * (A[3*i + j] + A[3*j + i]);
+        }
+    }
+
+    return;
+}
+
+static inline void tensor3_skw(double * restrict C, const double * restrict A)
+{
+    for (size_t i = 0; i < 3; i++) {
+        for (size_t j = 0; j < 3; j++) {
+            C[3*i + j] = 0.5 * (A[3*i + j] - A[3*j + i]);
+        }
+    }
+
+    return;
+}
+
+static inline void tensor3_contraction(double * restrict c,
+    const double * restrict A, const double * restrict B)
+{
+    double s = 0;
+
+    for (size_t k = 0; k < 9; k++) {
+        s += A[k] * B[k];
+    }
+    *c = s;
+
+    return;
+}
+
+/*
+    Jaumann rate term W A - A W of A with spin W, the combination the
+    hypoelastic materials build from two products and a difference.
+*/
+static inline void tensor3_jaumann(double * restrict C,
+    const double * restrict W, const double * restrict A)
+{
+    double WA[9], AW[9];
+
+    tensor3_multiply(WA, W, A);
+    tensor3_multiply(AW, A, W);
+    for (size_t k = 0; k < 9; k++) {
+        C[k] = WA[k] - AW[k];
+    }
+
+    return;
+}
+
+/* Batch forms over n consecutive tensors. */
+static inline void tensor3_copy_n(double (* restrict C)[9],
+    const double (* restrict A)[9], size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        for (size_t k = 0; k < 9; k++) {
+            C[i][k] = A[i][k];
+        }
+    }
+
+    return;
+}
+
+static inline void tensor3_add_n(double (*C)[9], const double (*A)[9],
+    const double (*B)[9], size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        tensor3_add(C[i], A[i], B[i]);
+    }
+
+    return;
+}
+
+static inline void tensor3_scale_n(double (* restrict A)[9],
+    const double * restrict c, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        tensor3_scale(A[i], c[i]);
+    }
+
+    return;
+}
+
+static inline void tensor3_decompose_n(double (* restrict A_0)[9],
+    double * restrict c, const double (* restrict A)[9], size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        tensor3_decompose(A_0[i], &(c[i]), A[i]);
+    }
+
+    return;
+}
+
+static inline void tensor3_multiply_n(double (* restrict C)[9],
+    const double (* restrict A)[9], const double (* restrict B)[9], size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        tensor3_multiply(C[i], A[i], B[i]);
+    }
+
+    return;
+}
+
+static inline void tensor3_contraction_n(double * restrict c,
+    const double (* restrict A)[9], const double (* restrict B)[9], size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        tensor3_contraction(&(c[i]), A[i], B[i]);
+    }
+
+    return;
+}
+
+#endif // __TENSOR3_H__
@@ -0,0 +1,213 @@
+/**
+    \file tiles.c
+    \author Sachith Dunatunga
+    \date 17.10.2026
+
+    mpm_2d -- An implementation of the Material Point Method in 2D.
+*/
+#include <stdlib.h>
+#include <string.h>
+#include "tiles.h"
+
+/*---grid_tiles_init----------------------------------------------------------*/
+int grid_tiles_init(grid_tiles_t *t, size_t Nex, size_t Ney, size_t size)
+{
+    memset(t, 0, sizeof(grid_tiles_t));
+
+    t->Nex = Nex;
+    t->Ney = Ney;
+    t->size = size;
+    t->nx = (Nex + size - 1) / size;
+    t->ny = (Ney + size - 1) / size;
+    t->num_tiles = t->nx * t->ny;
+
+    t->touched = (unsigned char *)calloc(t->num_tiles, sizeof(unsigned char));
+    t->initialized = (unsigned char *)calloc(t->num_tiles, sizeof(unsigned char));
+    t->active = (unsigned char *)calloc(t->num_tiles, sizeof(unsigned char));
+    t->active_list = (size_t *)malloc(t->num_tiles * sizeof(size_t));
+    t->fresh_list = (size_t *)malloc(t->num_tiles * sizeof(size_t));
+
+    if (t->touched == NULL || t->initialized == NULL || t->active == NULL
+        || t->active_list == NULL || t->fresh_list == NULL) {
+        grid_tiles_free(t);
+        return -1;
+    }
+
+    return 0;
+}
+/*----------------------------------------------------------------------------*/
+
+/*---grid_tiles_free----------------------------------------------------------*/
+void grid_tiles_free(grid_tiles_t *t)
+{
+    free(t->touched);
+    free(t->initialized);
+    free(t->active);
+    free(t->active_list);
+    free(t->fresh_list);
+
+    t->touched = NULL;
+    t->initialized = NULL;
+    t->active = NULL;
+    t->active_list = NULL;
+    t->fresh_list = NULL;
+    t->num_active = 0;
+    t->num_fresh = 0;
+
+    return;
+}
+/*----------------------------------------------------------------------------*/
+
+/*---grid_tiles_update--------------------------------------------------------*/
+size_t grid_tiles_update(grid_tiles_t *t)
+{
+    size_t tx, ty, k, changed;
+    unsigned char a;
+    int dx, dy;
+    long x, y;
+
+    t->num_active = 0;
+    t->num_fresh = 0;
+    changed = 0;
+
+    for (ty = 0; ty < t->ny; ty++) {
+        for (tx = 0; tx < t->nx; tx++) {
+            a = 0;
+            for (dy = -1; dy <= 1 && !a; dy++) {
+                for (dx = -1; dx <= 1 && !a; dx++) {
+                    x = (long)tx + dx;
+                    y = (long)ty + dy;
+                    if (x >= 0 && y >= 0 && x < (long)t->nx && y < (long)t->ny) {
+                        a = t->touched[y * t->nx + x];
+                    }
+                }
+            }
+
+            k = ty * t->nx + tx;
+            if (a != t->active[k]) {
+                changed++;
+            }
+            t->active[k] = a;
+
+            if (a) {
+                t->active_list[t->num_active++] = k;
+                if (!t->initialized[k]) {
+                    t->initialized[k] = 1;
+                    t->fresh_list[t->num_fresh++] = k;
+                }
+            }
+        }
+    }
+
+    memset(t->touched, 0, t->num_tiles * sizeof(unsigned char));
+
+    return changed;
+}
+/*----------------------------------------------------------------------------*/
+
+/*---grid_tiles_range---------------------------------------------------------*/
+void grid_tiles_range(const grid_tiles_t *t, size_t thread_id,
+    size_t num_threads, size_t *start, size_t *stop)
+{
+    *start = (thread_id * t->num_active) / num_threads;
+    *stop = ((thread_id + 1) * t->num_active) / num_threads;
+
+    return;
+}
+/*----------------------------------------------------------------------------*/
+
+/*---grid_tile_elements-------------------------------------------------------*/
+void grid_tile_elements(const grid_tiles_t *t, size_t tile,
+    size_t *c0, size_t *c1, size_t *r0, size_t *r1)
+{
+    const size_t tx = tile % t->nx;
+    const size_t ty = tile / t->nx;
+
+    *c0 = tx * t->size;
+    *c1 = (tx + 1 < t->nx) ? (*c0 + t->size) : t->Nex;
+    *r0 = ty * t->size;
+    *r1 = (ty + 1 < t->ny) ? (*r0 + t->size) : t->Ney;
+
+    return;
+}
+/*----------------------------------------------------------------------------*/
+
+/*---grid_tile_nodes----------------------------------------------------------*/
+void grid_tile_nodes(const grid_tiles_t *t, size_t tile,
+    size_t *i0, size_t *i1, size_t *j0, size_t *j1)
+{
+    grid_tile_elements(t, tile, i0, i1, j0, j1);
+
+    /* the last tile in a row (column) owns the edge nodes too. */
+    if (*i1 == t->Nex) {
+        (*i1)++;
+    }
+    if (*j1 == t->Ney) {
+        (*j1)++;
+    }
+
+    return;
+}
+/*----------------------------------------------------------------------------*/
+
+/* first index of active_list holding a tile >= tile. */
+static size_t active_lower_bound(const grid_tiles_t *t, size_t tile)
+{
+    size_t lo = 0;
+    size_t hi = t->num_active;
+    size_t mid;
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (t->active_list[mid] < tile) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+/*---grid_tiles_index---------------------------------------------------------*/
+size_t grid_tiles_index(const grid_tiles_t *t, size_t tile)
+{
+    size_t k = active_lower_bound(t, tile);
+
+    if (k < t->num_active && t->active_list[k] == tile) {
+        return k;
+    }
+
+    return t->num_active;
+}
+/*----------------------------------------------------------------------------*/
+
+/*---grid_tiles_row-----------------------------------------------------------*/
+void grid_tiles_row(const grid_tiles_t *t, size_t ty, size_t *start,
+    size_t *stop)
+{
+    *start = active_lower_bound(t, ty * t->nx);
+    *stop = active_lower_bound(t, (ty + 1) * t->nx);
+
+    return;
+}
+/*----------------------------------------------------------------------------*/
+
+/*---grid_tiles_run-----------------------------------------------------------*/
+void grid_tiles_run(const grid_tiles_t *t, size_t *k, size_t k_stop,
+    size_t *first, size_t *last)
+{
+    *first = t->active_list[*k];
+    *last = *first;
+    (*k)++;
+
+    while (*k < k_stop && t->active_list[*k] == *last + 1
+        && (*last + 1) % t->nx != 0) {
+        *last = t->active_list[*k];
+        (*k)++;
+    }
+
+    return;
+}
+/*----------------------------------------------------------------------------*/
+
@@ -0,0 +1,112 @@
+/**
+    \file tiles.h
+    \author Sachith Dunatunga
+    \date 17.10.2026
+
+    Active tiles of the background grid.
+
+    The grid is split into square tiles of GRID_TILE_SIZE by GRID_TILE_SIZE
+    elements. A tile is active if it holds a particle or is next to a tile
+    that does; only active tiles are cleared and updated every step, and the
+    node and element records of a tile are set up the first time it becomes
+    active. Node and element arrays keep their dense numbering, but pages of
+    tiles that were never active are never written.
+
+    A tile owns its elements and the nodes at their bottom left corners. The
+    last column (row) of tiles also owns the rightmost (topmost) column (row)
+    of nodes, so every node belongs to exactly one tile.
+*/
+#ifndef __TILES_H__
+#define __TILES_H__
+#include <stddef.h>
+
+#define GRID_TILE_SIZE 16
+
+typedef struct grid_tiles_s {
+    /* elements per row and column of the grid, elements per side of a tile. */
+    size_t Nex;
+    size_t Ney;
+    size_t size;
+
+    /* tiles per row and column. */
+    size_t nx;
+    size_t ny;
+    size_t num_tiles;
+
+    /* tile holds a particle (set while mapping particles to elements). */
+    unsigned char *touched;
+
+    /* tile nodes and elements have been set up. */
+    unsigned char *initialized;
+
+    /* active tiles in ascending order. */
+    unsigned char *active;
+    size_t *active_list;
+    size_t num_active;
+
+    /* tiles activated for the first time by the last update. */
+    size_t *fresh_list;
+    size_t num_fresh;
+} grid_tiles_t;
+
+/*
+    Split a grid of Nex by Ney elements into tiles of size by size elements,
+    with no active tiles. Returns 0 on success, -1 if an allocation failed.
+*/
+int grid_tiles_init(grid_tiles_t *t, size_t Nex, size_t Ney, size_t size);
+void grid_tiles_free(grid_tiles_t *t);
+
+static inline size_t grid_tile_of_element(const grid_tiles_t *t, size_t e)
+{
+    return ((e / t->Nex) / t->size) * t->nx + (e % t->Nex) / t->size;
+}
+
+/* Safe to call from many threads at once. */
+static inline void grid_tiles_touch(grid_tiles_t *t, size_t e)
+{
+    __atomic_store_n(&(t->touched[grid_tile_of_element(t, e)]), 1,
+        __ATOMIC_RELAXED);
+    return;
+}
+
+/*
+    Make the touched tiles and their neighbors the active set and clear the
+    touched flags. Tiles that were never active before are listed in
+    fresh_list and marked initialized; the caller sets up their nodes and
+    elements. Serial. Returns the number of tiles that changed state.
+*/
+size_t grid_tiles_update(grid_tiles_t *t);
+
+/* Static split of the active list, [start, stop) are indices into it. */
+void grid_tiles_range(const grid_tiles_t *t, size_t thread_id,
+    size_t num_threads, size_t *start, size_t *stop);
+
+/* Position of tile in active_list, or num_active if it isn't active. */
+size_t grid_tiles_index(const grid_tiles_t *t, size_t tile);
+
+/*
+    Active tiles of tile row ty are active_list[start] up to (not including)
+    active_list[stop]; start == stop if there are none.
+*/
+void grid_tiles_row(const grid_tiles_t *t, size_t ty, size_t *start,
+    size_t *stop);
+
+/*
+    Longest run of side by side tiles in one tile row that starts at
+    active_list[*k] and ends before active_list[k_stop]; the tiles are first
+    to last and *k is moved past them. Their node (element) rows are
+    contiguous, so kernels can sweep a whole run at a time.
+*/
+void grid_tiles_run(const grid_tiles_t *t, size_t *k, size_t k_stop,
+    size_t *first, size_t *last);
+
+/* Element columns [c0, c1) and rows [r0, r1) of a tile. */
+void grid_tile_elements(const grid_tiles_t *t, size_t tile,
+    size_t *c0, size_t *c1, size_t *r0, size_t *r1);
+
+/* Node columns [i0, i1) and rows [j0, j1) owned by a tile. */
+void grid_tile_nodes(const grid_tiles_t *t, size_t tile,
+    size_t *i0, size_t *i1, size_t *j0, size_t *j1);
+
+#endif //__TILES_H__
+
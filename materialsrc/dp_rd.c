@@ -17,7 +17,7 @@
 
 #define signum(x) ((int)((0 < x) - (x < 0)))
 
-#define jp(x) job->particles[i].x
+#define jp(x) job->particles.x[i]
 
 #define mu0     0.2f
 #define hmu     360.0f
@@ -45,17 +45,17 @@
 #define GRAINS_RHO 3000
 #define GRAINS_D 0.01
 
-#define Epxx jp(state[0])
-#define Epxy jp(state[1])
-#define Epyy jp(state[2])
-#define gf jp(state[3])
-#define eta jp(state[4])
-#define beta jp(state[5])
-#define gammap jp(state[9])
-#define Ef_mag jp(state[10])
-#define Etxx jp(state[6])
-#define Etxy jp(state[7])
-#define Etyy jp(state[8])
+#define Epxx jp(state)[0]
+#define Epxy jp(state)[1]
+#define Epyy jp(state)[2]
+#define gf jp(state)[3]
+#define eta jp(state)[4]
+#define beta jp(state)[5]
+#define gammap jp(state)[9]
+#define Ef_mag jp(state)[10]
+#define Etxx jp(state)[6]
+#define Etxy jp(state)[7]
+#define Etyy jp(state)[8]
 
 /*----------------------------------------------------------------------------*/
 void material_init(job_t *job)
@@ -64,7 +64,7 @@ void material_init(job_t *job)
 
     for (i = 0; i < job->num_particles; i++) {
         for (j = 0; j < DEPVAR; j++) {
-            job->particles[i].state[j] = 0;
+            job->particles.state[i][j] = 0;
         }
     }
 
@@ -111,26 +111,22 @@ void calculate_stress(job_t *job)
     double const c = 1e-2;
     int i;
 
-    for (i = 0; i < job->num_particles; i++) {
-        if (job->active[i] == 0) {
-            continue;
-        }
-
-        dsjxx = job->dt * (EMOD / (1 - NUMOD*NUMOD)) * ((job->particles[i].exx_t) + NUMOD * (job->particles[i].eyy_t));
-        dsjxy = job->dt * (EMOD / (2 *(1 + NUMOD))) * (job->particles[i].exy_t);
-        dsjyy = job->dt * (EMOD / (1 - NUMOD*NUMOD)) * ((job->particles[i].eyy_t) + NUMOD * (job->particles[i].exx_t));
+    for (i = 0; i < job->num_active; i++) {
+        dsjxx = job->dt * (EMOD / (1 - NUMOD*NUMOD)) * ((job->particles.exx_t[i]) + NUMOD * (job->particles.eyy_t[i]));
+        dsjxy = job->dt * (EMOD / (2 *(1 + NUMOD))) * (job->particles.exy_t[i]);
+        dsjyy = job->dt * (EMOD / (1 - NUMOD*NUMOD)) * ((job->particles.eyy_t[i]) + NUMOD * (job->particles.exx_t[i]));
 
-        dsjxx -= 2 * job->dt * job->particles[i].wxy_t * job->particles[i].sxy;
-        dsjxy += job->dt * job->particles[i].wxy_t * (job->particles[i].sxx - job->particles[i].syy);
-        dsjyy += 2 * job->dt * job->particles[i].wxy_t * job->particles[i].sxy;
+        dsjxx -= 2 * job->dt * job->particles.wxy_t[i] * job->particles.sxy[i];
+        dsjxy += job->dt * job->particles.wxy_t[i] * (job->particles.sxx[i] - job->particles.syy[i]);
+        dsjyy += 2 * job->dt * job->particles.wxy_t[i] * job->particles.sxy[i];
 
-/*        dsjxx -= 2 * job->dt * job->particles[i].wxy_t * job->particles[i].real_sxy;*/
-/*        dsjxy += job->dt * job->particles[i].wxy_t * (job->particles[i].real_sxx - job->particles[i].real_syy);*/
-/*        dsjyy += 2 * job->dt * job->particles[i].wxy_t * job->particles[i].real_sxy;*/
+/*        dsjxx -= 2 * job->dt * job->particles.wxy_t[i] * job->particles.real_sxy[i];*/
+/*        dsjxy += job->dt * job->particles.wxy_t[i] * (job->particles.real_sxx[i] - job->particles.real_syy[i]);*/
+/*        dsjyy += 2 * job->dt * job->particles.wxy_t[i] * job->particles.real_sxy[i];*/
 
-        txx = job->particles[i].sxx + dsjxx;
-        txy = job->particles[i].sxy + dsjxy;
-        tyy = job->particles[i].syy + dsjyy;
+        txx = job->particles.sxx[i] + dsjxx;
+        txy = job->particles.sxy[i] + dsjxy;
+        tyy = job->particles.syy[i] + dsjyy;
         pm = -0.5f*(txx + tyy);
         t0xx = txx + pm;
         t0xy = txy;
@@ -140,34 +136,34 @@ void calculate_stress(job_t *job)
 
         f = qm - m*pm - c;
 
-        if(job->particles[i].material == M_RIGID) {
-            job->particles[i].sxx = txx;
-            job->particles[i].sxy = txy;
-            job->particles[i].syy = tyy;
+        if(job->particles.material[i] == M_RIGID) {
+            job->particles.sxx[i] = txx;
+            job->particles.sxy[i] = txy;
+            job->particles.syy[i] = tyy;
             continue;
         }
 
-        if ((job->particles[i].m / job->particles[i].v) < 1485.0f) {
+        if ((job->particles.m[i] / job->particles.v[i]) < 1485.0f) {
             density_flag = 1;
         } else {
             density_flag = 0;
         }
 
         if (density_flag) {
-            job->particles[i].sxx = 0;
-            job->particles[i].sxy = 0;
-            job->particles[i].syy = 0;
+            job->particles.sxx[i] = 0;
+            job->particles.sxy[i] = 0;
+            job->particles.syy[i] = 0;
         } else if (f < 0) {
-            job->particles[i].sxx = txx;
-            job->particles[i].sxy = txy;
-            job->particles[i].syy = tyy;
+            job->particles.sxx[i] = txx;
+            job->particles.sxy[i] = txy;
+            job->particles.syy[i] = tyy;
         } else {
             dp_xx = 1e-1 * f * t0xx / qm;
             dp_xy = 1e-1 * f * t0xy / qm;
             dp_yy = 1e-1 * f * t0yy / qm;
-            job->particles[i].sxx = txx - job->dt * (EMOD / (1 - NUMOD*NUMOD)) * ((dp_xx) + NUMOD * (dp_yy));
-            job->particles[i].sxy = txy - job->dt * (EMOD / (2 *(1 + NUMOD))) * (dp_xy);
-            job->particles[i].syy = tyy - job->dt * (EMOD / (1 - NUMOD*NUMOD)) * ((dp_yy) + NUMOD * (dp_xx));
+            job->particles.sxx[i] = txx - job->dt * (EMOD / (1 - NUMOD*NUMOD)) * ((dp_xx) + NUMOD * (dp_yy));
+            job->particles.sxy[i] = txy - job->dt * (EMOD / (2 *(1 + NUMOD))) * (dp_xy);
+            job->particles.syy[i] = tyy - job->dt * (EMOD / (1 - NUMOD*NUMOD)) * ((dp_yy) + NUMOD * (dp_xx));
             Epxx = Epxx + dp_xx * job->dt;
             Epxy = Epxy + dp_xy * job->dt;
             Epyy = Epyy + dp_yy * job->dt;
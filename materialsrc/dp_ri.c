@@ -17,7 +17,7 @@
 
 #define signum(x) ((int)((0 < x) - (x < 0)))
 
-#define jp(x) job->particles[i].x
+#define jp(x) job->particles.x[i]
 #define SVISC 1e3
 #define SYIELD 1e2
 
@@ -43,18 +43,18 @@
 #define PI 3.1415926535897932384626433
 #define PHI (30.0*PI/180.0)
 
-#define Epxx jp(state[0])
-#define Epxy jp(state[1])
-#define Epyy jp(state[2])
-#define mu jp(state[3])
-#define eta jp(state[4])
-#define beta jp(state[5])
-/*#define Exx jp(state[6])*/
-/*#define Exy jp(state[7])*/
-/*#define Eyy jp(state[8])*/
-#define gammap jp(state[9])
-#define Ef_mag jp(state[10])
-#define gf jp(state[6])
+#define Epxx jp(state)[0]
+#define Epxy jp(state)[1]
+#define Epyy jp(state)[2]
+#define mu jp(state)[3]
+#define eta jp(state)[4]
+#define beta jp(state)[5]
+/*#define Exx jp(state)[6]*/
+/*#define Exy jp(state)[7]*/
+/*#define Eyy jp(state)[8]*/
+#define gammap jp(state)[9]
+#define Ef_mag jp(state)[10]
+#define gf jp(state)[6]
 
 /*----------------------------------------------------------------------------*/
 void material_init(job_t *job)
@@ -63,7 +63,7 @@ void material_init(job_t *job)
 
     for (i = 0; i < job->num_particles; i++) {
         for (j = 0; j < DEPVAR; j++) {
-            job->particles[i].state[j] = 0;
+            job->particles.state[i][j] = 0;
         }
     }
 
@@ -107,29 +107,25 @@ void calculate_stress(job_t *job)
     double const c = 1e-2;
     int i;
 
-    for (i = 0; i < job->num_particles; i++) {
-        if (job->active[i] == 0) {
-            continue;
-        }
-
-        dsjxx = job->dt * (EMOD / (1 - NUMOD*NUMOD)) * ((job->particles[i].exx_t) + NUMOD * (job->particles[i].eyy_t));
-        dsjxy = job->dt * (EMOD / (2 *(1 + NUMOD))) * (job->particles[i].exy_t);
-        dsjyy = job->dt * (EMOD / (1 - NUMOD*NUMOD)) * ((job->particles[i].eyy_t) + NUMOD * (job->particles[i].exx_t));
+    for (i = 0; i < job->num_active; i++) {
+        dsjxx = job->dt * (EMOD / (1 - NUMOD*NUMOD)) * ((job->particles.exx_t[i]) + NUMOD * (job->particles.eyy_t[i]));
+        dsjxy = job->dt * (EMOD / (2 *(1 + NUMOD))) * (job->particles.exy_t[i]);
+        dsjyy = job->dt * (EMOD / (1 - NUMOD*NUMOD)) * ((job->particles.eyy_t[i]) + NUMOD * (job->particles.exx_t[i]));
 
-        dsjxx -= 2 * job->dt * job->particles[i].wxy_t * job->particles[i].sxy;
-        dsjxy += job->dt * job->particles[i].wxy_t * (job->particles[i].sxx - job->particles[i].syy);
-        dsjyy += 2 * job->dt * job->particles[i].wxy_t * job->particles[i].sxy;
+        dsjxx -= 2 * job->dt * job->particles.wxy_t[i] * job->particles.sxy[i];
+        dsjxy += job->dt * job->particles.wxy_t[i] * (job->particles.sxx[i] - job->particles.syy[i]);
+        dsjyy += 2 * job->dt * job->particles.wxy_t[i] * job->particles.sxy[i];
 
-/*        dsjxx += 2 * job->dt * job->particles[i].wxy_t * job->particles[i].sxy;*/
-/*        dsjxy -= job->dt * job->particles[i].wxy_t * (job->particles[i].sxx - job->particles[i].syy);*/
-/*        dsjyy -= 2 * job->dt * job->particles[i].wxy_t * job->particles[i].sxy;*/
+/*        dsjxx += 2 * job->dt * job->particles.wxy_t[i] * job->particles.sxy[i];*/
+/*        dsjxy -= job->dt * job->particles.wxy_t[i] * (job->particles.sxx[i] - job->particles.syy[i]);*/
+/*        dsjyy -= 2 * job->dt * job->particles.wxy_t[i] * job->particles.sxy[i];*/
 
 /*        dsjxx += 1e2 * (jp(exx_t) + jp(eyy_t));*/
 /*        dsjyy += 1e2 * (jp(eyy_t) + jp(exx_t));*/
 
-        txx = job->particles[i].sxx + dsjxx;
-        txy = job->particles[i].sxy + dsjxy;
-        tyy = job->particles[i].syy + dsjyy;
+        txx = job->particles.sxx[i] + dsjxx;
+        txy = job->particles.sxy[i] + dsjxy;
+        tyy = job->particles.syy[i] + dsjyy;
         pm = -0.5f*(txx + tyy);
         t0xx = txx + pm;
         t0xy = txy;
@@ -139,45 +135,45 @@ void calculate_stress(job_t *job)
 
         f = qm - m*pm - c;
 
-        if(job->particles[i].material == M_RIGID) {
-            job->particles[i].sxx = txx;
-            job->particles[i].sxy = txy;
-            job->particles[i].syy = tyy;
+        if(job->particles.material[i] == M_RIGID) {
+            job->particles.sxx[i] = txx;
+            job->particles.sxy[i] = txy;
+            job->particles.syy[i] = tyy;
 /*            printf("particle %d is rigid.\n", i);*/
             continue;
         }
 
-        if ((job->particles[i].m / job->particles[i].v) < 1485.0f) {
+        if ((job->particles.m[i] / job->particles.v[i]) < 1485.0f) {
             density_flag = 1;
-/*            printf("%4d: density %lf\n", i, (job->particles[i].m / job->particles[i].v));*/
+/*            printf("%4d: density %lf\n", i, (job->particles.m[i] / job->particles.v[i]));*/
         } else {
             density_flag = 0;
         }
 
         if (density_flag) {
-            job->particles[i].sxx = 0;
-            job->particles[i].sxy = 0;
-            job->particles[i].syy = 0;
+            job->particles.sxx[i] = 0;
+            job->particles.sxy[i] = 0;
+            job->particles.syy[i] = 0;
         } else if (f < 0) {
-            job->particles[i].sxx = txx;
-            job->particles[i].sxy = txy;
-            job->particles[i].syy = tyy;
-            job->particles[i].color = 1;
+            job->particles.sxx[i] = txx;
+            job->particles.sxy[i] = txy;
+            job->particles.syy[i] = tyy;
+            job->particles.color[i] = 1;
         } else if (f >= 0 && pm > -c/m) {
             Epxx += (f / qm) * t0xx / (2 * G);
             Epxy += (f / qm) * t0xy / (2 * G);
             Epyy += (f / qm) * t0yy / (2 * G);
             q_adj = m*pm + c;
-            job->particles[i].sxx = (q_adj / qm) * t0xx - pm;
-            job->particles[i].sxy = (q_adj / qm) * t0xy;
-            job->particles[i].syy = (q_adj / qm) * t0yy - pm;
-            job->particles[i].color = 2;
+            job->particles.sxx[i] = (q_adj / qm) * t0xx - pm;
+            job->particles.sxy[i] = (q_adj / qm) * t0xy;
+            job->particles.syy[i] = (q_adj / qm) * t0yy - pm;
+            job->particles.color[i] = 2;
             gammap = sqrt(Epxx*Epxx + 2*Epxy*Epxy + Epyy*Epyy);
         } else if (pm <= -c/m) {
-            job->particles[i].sxx = -0.5 * c / m;
-            job->particles[i].sxy = 0;
-            job->particles[i].syy = -0.5 * c / m;
-            job->particles[i].color = 3;
+            job->particles.sxx[i] = -0.5 * c / m;
+            job->particles.sxy[i] = 0;
+            job->particles.syy[i] = -0.5 * c / m;
+            job->particles.color[i] = 3;
         } else {
             fprintf(stderr, "u");
         }
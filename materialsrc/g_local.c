@@ -17,7 +17,7 @@
 
 #define signum(x) ((int)((0 < x) - (x < 0)))
 
-#define jp(x) job->particles[i].x
+#define jp(x) job->particles.x[i]
 
 #define mu0     0.2f
 #define hmu     360.0f
@@ -52,17 +52,17 @@
 */
 #define GRAINS_D (0.01 * 5)
 
-#define Epxx jp(state[0])
-#define Epxy jp(state[1])
-#define Epyy jp(state[2])
-#define gf jp(state[3])
-#define eta jp(state[4])
-#define beta jp(state[5])
-#define gammap jp(state[9])
-#define Ef_mag jp(state[10])
-#define Exx jp(state[6])
-#define Exy jp(state[7])
-#define Eyy jp(state[8])
+#define Epxx jp(state)[0]
+#define Epxy jp(state)[1]
+#define Epyy jp(state)[2]
+#define gf jp(state)[3]
+#define eta jp(state)[4]
+#define beta jp(state)[5]
+#define gammap jp(state)[9]
+#define Ef_mag jp(state)[10]
+#define Exx jp(state)[6]
+#define Exy jp(state)[7]
+#define Eyy jp(state)[8]
 
 /*----------------------------------------------------------------------------*/
 void material_init(job_t *job)
@@ -71,7 +71,7 @@ void material_init(job_t *job)
 
     for (i = 0; i < job->num_particles; i++) {
         for (j = 0; j < DEPVAR; j++) {
-            job->particles[i].state[j] = 0;
+            job->particles.state[i][j] = 0;
         }
     }
 
@@ -121,24 +121,20 @@ void calculate_stress(job_t *job)
     double const c = 1e-4;
     int i;
 
-    for (i = 0; i < job->num_particles; i++) {
-        if (job->active[i] == 0) {
-            continue;
-        }
-
+    for (i = 0; i < job->num_active; i++) {
         /* check if the density allows for supporting any stress */
-        if ((job->particles[i].m / job->particles[i].v) < 1485.0f) {
-            job->particles[i].sxx = 0;
-            job->particles[i].sxy = 0;
-            job->particles[i].syy = 0;
+        if ((job->particles.m[i] / job->particles.v[i]) < 1485.0f) {
+            job->particles.sxx[i] = 0;
+            job->particles.sxy[i] = 0;
+            job->particles.syy[i] = 0;
             continue;
         }
 
         /* Calculate tau, p, and mu at beginning of timestep. */
-        p_t = -0.5 * (job->particles[i].sxx + job->particles[i].syy);
-        t0xx = job->particles[i].sxx + p_t;
-        t0xy = job->particles[i].sxy;
-        t0yy = job->particles[i].syy + p_t;
+        p_t = -0.5 * (job->particles.sxx[i] + job->particles.syy[i]);
+        t0xx = job->particles.sxx[i] + p_t;
+        t0xy = job->particles.sxy[i];
+        t0yy = job->particles.syy[i] + p_t;
         tau_t = sqrt(0.5f*(t0xx*t0xx + 2*t0xy*t0xy + t0yy*t0yy));
         if (p_t > c) {
             eta = B * GRAINS_D * sqrt (GRAINS_RHO * p_t);
@@ -170,26 +166,26 @@ void calculate_stress(job_t *job)
         }
 
 /*        if (p_t < c) {*/
-/*            dpxx = job->particles[i].exx_t;*/
-/*            dpxy = job->particles[i].exy_t;*/
-/*            dpyy = job->particles[i].eyy_t;*/
-/*            job->particles[i].sxx = -c;*/
-/*            job->particles[i].sxy = 0;*/
-/*            job->particles[i].syy = -c;*/
+/*            dpxx = job->particles.exx_t[i];*/
+/*            dpxy = job->particles.exy_t[i];*/
+/*            dpyy = job->particles.eyy_t[i];*/
+/*            job->particles.sxx[i] = -c;*/
+/*            job->particles.sxy[i] = 0;*/
+/*            job->particles.syy[i] = -c;*/
 /*            continue;*/
 /*        }*/
 
         /* use strain rate to calculate stress increment */
-        dsjxx = job->dt * (EMOD / (1 - NUMOD*NUMOD)) * ((job->particles[i].exx_t - dpxx) + NUMOD * (job->particles[i].eyy_t - dpyy));
-        dsjxy = job->dt * (EMOD / (2 *(1 + NUMOD))) * (job->particles[i].exy_t - dpxy);
-        dsjyy = job->dt * (EMOD / (1 - NUMOD*NUMOD)) * ((job->particles[i].eyy_t - dpyy) + NUMOD * (job->particles[i].exx_t - dpxx));
-        dsjxx -= 2 * job->dt * job->particles[i].wxy_t * job->particles[i].sxy;
-        dsjxy += job->dt * job->particles[i].wxy_t * (job->particles[i].sxx - job->particles[i].syy);
-        dsjyy += 2 * job->dt * job->particles[i].wxy_t * job->particles[i].sxy;
-
-        job->particles[i].sxx += dsjxx;
-        job->particles[i].sxy += dsjxy;
-        job->particles[i].syy += dsjyy;
+        dsjxx = job->dt * (EMOD / (1 - NUMOD*NUMOD)) * ((job->particles.exx_t[i] - dpxx) + NUMOD * (job->particles.eyy_t[i] - dpyy));
+        dsjxy = job->dt * (EMOD / (2 *(1 + NUMOD))) * (job->particles.exy_t[i] - dpxy);
+        dsjyy = job->dt * (EMOD / (1 - NUMOD*NUMOD)) * ((job->particles.eyy_t[i] - dpyy) + NUMOD * (job->particles.exx_t[i] - dpxx));
+        dsjxx -= 2 * job->dt * job->particles.wxy_t[i] * job->particles.sxy[i];
+        dsjxy += job->dt * job->particles.wxy_t[i] * (job->particles.sxx[i] - job->particles.syy[i]);
+        dsjyy += 2 * job->dt * job->particles.wxy_t[i] * job->particles.sxy[i];
+
+        job->particles.sxx[i] += dsjxx;
+        job->particles.sxy[i] += dsjxy;
+        job->particles.syy[i] += dsjyy;
 
         gammap += nup_tau * job->dt;
     }
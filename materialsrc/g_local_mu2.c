@@ -13,12 +13,13 @@
 #include "particle.h"
 #include "node.h"
 #include "process.h"
+#include "process_usl.h"
 #include "material.h"
 #include "exitcodes.h"
 
-#include "tensor.h"
+#include "tensor3.h"
 
-#define jp(x) job->particles[i].x
+#define bp(x) b->x[i]
 
 #undef EMOD
 #undef NUMOD
@@ -40,22 +41,23 @@
 */
 #define GRAINS_D (0.001 * 5)
 
-#define mu_y jp(state[0])
-/*#define Epxy jp(state[1])*/
-/*#define Epyy jp(state[2])*/
-#define gf jp(state[3])
-#define eta jp(state[4])
-#define beta jp(state[5])
-#define gammap jp(state[9])
-#define gammadotp jp(state[10])
-#define sxx_e jp(state[6])
-#define sxy_e jp(state[7])
-#define syy_e jp(state[8])
+#define mu_y bp(state)[0]
+/*#define Epxy bp(state)[1]*/
+/*#define Epyy bp(state)[2]*/
+#define gf bp(state)[3]
+#define eta bp(state)[4]
+#define beta bp(state)[5]
+#define gammap bp(state)[9]
+#define gammadotp bp(state)[10]
+#define sxx_e bp(state)[6]
+#define sxy_e bp(state)[7]
+#define syy_e bp(state)[8]
 
 #define MAT_VERSION_STRING "1.0 " __DATE__ " " __TIME__
 
 void calculate_stress(job_t *job);
 void calculate_stress_threaded(threadtask_t *task);
+void calculate_stress_batch(material_batch_t *b);
 
 /*
     The Young's Modulus (E) and Poisson ratio (nu), set in the material init
@@ -105,29 +107,17 @@ void material_init(job_t *job)
 
     for (i = 0; i < job->num_particles; i++) {
         for (j = 0; j < DEPVAR; j++) {
-            job->particles[i].state[j] = 0;
+            job->particles.state[i][j] = 0;
         }
-        job->particles[i].T[XX] = job->particles[i].sxx;
-        job->particles[i].T[XY] = job->particles[i].sxy;
-        job->particles[i].T[XZ] = 0;
-        job->particles[i].T[YX] = job->particles[i].sxy;
-        job->particles[i].T[YY] = job->particles[i].syy;
-        job->particles[i].T[YZ] = 0;
-        job->particles[i].T[ZX] = 0;
-        job->particles[i].T[ZY] = 0;
-        job->particles[i].T[ZZ] = 0;
-    }
-
-    for (i = 0; i < job->num_particles; i++) {
-        mu_y = 0;
-        sxx_e = 0;
-        sxy_e = 0;
-        syy_e = 0;
-        eta = 0;
-        beta = 0;
-        gammap = 0;
-        gammadotp = 0;
-        gf = 0;
+        job->particles.T[i][XX] = job->particles.sxx[i];
+        job->particles.T[i][XY] = job->particles.sxy[i];
+        job->particles.T[i][XZ] = 0;
+        job->particles.T[i][YX] = job->particles.sxy[i];
+        job->particles.T[i][YY] = job->particles.syy[i];
+        job->particles.T[i][YZ] = 0;
+        job->particles.T[i][ZX] = 0;
+        job->particles.T[i][ZY] = 0;
+        job->particles.T[i][ZZ] = 0;
     }
 
     if (job->material.num_fp64_props < 2) {
@@ -156,7 +146,7 @@ void calculate_stress(job_t *job)
     threadtask_t t;
     t.job = job;
     t.offset = 0;
-    t.blocksize = job->num_particles;
+    t.blocksize = job->num_active;
     calculate_stress_threaded(&t);
     return;
 }
@@ -164,12 +154,20 @@ void calculate_stress(job_t *job)
 /*----------------------------------------------------------------------------*/
 void calculate_stress_threaded(threadtask_t *task)
 {
-    job_t *job = task->job;
+    material_batch_t b;
 
     /* Since this is local, we can split the particles among the threads. */
-    size_t p_start = task->offset;
-    size_t p_stop = task->offset + task->blocksize;
+    material_batch_range(task->job, &b, task->offset,
+        task->offset + task->blocksize);
+    calculate_stress_batch(&b);
+
+    return;
+}
+/*----------------------------------------------------------------------------*/
 
+/*----------------------------------------------------------------------------*/
+void calculate_stress_batch(material_batch_t *b)
+{
     /* value at end of timestep */
     double tau_tau;
     double scale_factor;
@@ -192,80 +190,70 @@ void calculate_stress_threaded(threadtask_t *task)
     double B, H;
     double alpha;
 
-/*    fprintf(stderr, "processing particle ids [%zu %zu].\n", p_start, p_stop);*/
-
-    for (i = p_start; i < p_stop; i++) {
-        if (job->active[i] == 0) {
-            continue;
-        }
-
+    for (i = 0; i < b->n; i++) {
         double T0[9], Ttr[9]; /* deviator and trial */
         double JS[9]; /* Jaumann spin term. */
         double W[9], D[9]; /* spin and stretching */
-        double temp[9];
 
         /* 3D velocity gradient (plane strain). */
-        job->particles[i].L[XX] = job->particles[i].exx_t;
-        job->particles[i].L[XY] = job->particles[i].exy_t + job->particles[i].wxy_t;
-        job->particles[i].L[XZ] = 0;
-        job->particles[i].L[YX] = job->particles[i].exy_t - job->particles[i].wxy_t;
-        job->particles[i].L[YY] = job->particles[i].eyy_t;
-        job->particles[i].L[YZ] = 0;
-        job->particles[i].L[ZX] = 0;
-        job->particles[i].L[ZY] = 0;
-        job->particles[i].L[ZZ] = 0;
+        b->L[i][XX] = b->exx_t[i];
+        b->L[i][XY] = b->exy_t[i] + b->wxy_t[i];
+        b->L[i][XZ] = 0;
+        b->L[i][YX] = b->exy_t[i] - b->wxy_t[i];
+        b->L[i][YY] = b->eyy_t[i];
+        b->L[i][YZ] = 0;
+        b->L[i][ZX] = 0;
+        b->L[i][ZY] = 0;
+        b->L[i][ZZ] = 0;
 
         /* Construct stretching and spin terms. */
-        tensor_skw3(W, job->particles[i].L);
-        tensor_sym3(D, job->particles[i].L);
+        tensor3_skw(W, b->L[i]);
+        tensor3_sym(D, b->L[i]);
 
         /* Copy stretching to the trial while in cache and get trace.*/
-        tensor_copy3(Ttr, D);
-        tensor_trace3(&trD, D);
+        tensor3_copy(Ttr, D);
+        tensor3_trace(&trD, D);
 
         /* construct jaumman spin term */        
-        tensor_multiply3(JS, W, job->particles[i].T);
-        tensor_multiply3(temp, job->particles[i].T, W);
-        tensor_scale3(temp, -1.0);
-        tensor_add3(JS, JS, temp);
+        tensor3_jaumann(JS, W, b->T[i]);
 
         /* construct trial stress (assume Ttr has a copy of stretching D). */
-        tensor_scale3(Ttr, 2.0 * G);
+        tensor3_scale(Ttr, 2.0 * G);
         Ttr[XX] += lambda * trD;
         Ttr[YY] += lambda * trD;
         Ttr[ZZ] += lambda * trD;
-        tensor_add3(Ttr, Ttr, JS);
-        tensor_scale3(Ttr, job->dt);
-        tensor_add3(Ttr, Ttr, job->particles[i].T);
+        tensor3_add(Ttr, Ttr, JS);
+        tensor3_scale(Ttr, b->dt);
+        tensor3_add(Ttr, Ttr, b->T[i]);
 
         /* Calculate tau and p trial values. */
-        tensor_decompose3(T0, &p_tr, Ttr);
-        tensor_contraction3(&tau_tr, T0, T0);
+        tensor3_decompose(T0, &p_tr, Ttr);
+        tensor3_contraction(&tau_tr, T0, T0);
         tau_tr = sqrt(0.5 * tau_tr);
         p_tr *= -1.0;
 
-        if ((job->particles[i].m / job->particles[i].v) < 1485.0f) {
+        if ((b->m[i] / b->v[i]) < 1485.0f) {
             density_flag = 1;
         } else {
             density_flag = 0;
         }
 
         if (density_flag || p_tr <= c) {
-            // nup_tau = (tau_tr) / (G * job->dt);
+            // nup_tau = (tau_tr) / (G * b->dt);
 
             // setting plastic strain rate to zero is probably more consistent
             // with reality, since particles would move as a rigid body.
             nup_tau = 0;
 
-            job->particles[i].T[XX] = 0;
-            job->particles[i].T[XY] = 0;
-            job->particles[i].T[XZ] = 0;
-            job->particles[i].T[YX] = 0;
-            job->particles[i].T[YY] = 0;
-            job->particles[i].T[YZ] = 0;
-            job->particles[i].T[ZX] = 0;
-            job->particles[i].T[ZY] = 0;
-            job->particles[i].T[ZZ] = 0;
+            b->T[i][XX] = 0;
+            b->T[i][XY] = 0;
+            b->T[i][XZ] = 0;
+            b->T[i][YX] = 0;
+            b->T[i][YY] = 0;
+            b->T[i][YZ] = 0;
+            b->T[i][ZX] = 0;
+            b->T[i][ZY] = 0;
+            b->T[i][ZZ] = 0;
         } else if (p_tr > c) {
             S0 = MU_S * p_tr;
             if (tau_tr <= S0) {
@@ -273,23 +261,23 @@ void calculate_stress_threaded(threadtask_t *task)
                 scale_factor = 1.0;
             } else {
                 S2 = MU_2 * p_tr;
-                alpha = G * I_0 * job->dt * sqrt(p_tr / GRAINS_RHO) / GRAINS_D;
+                alpha = G * I_0 * b->dt * sqrt(p_tr / GRAINS_RHO) / GRAINS_D;
                 B = -(S2 + tau_tr + alpha);
                 H = S2 * tau_tr + S0 * alpha;
                 tau_tau = negative_root(1.0, B, H);
                 scale_factor = (tau_tau / tau_tr);
             }
 
-            nup_tau = ((tau_tr - tau_tau) / G) / job->dt;
+            nup_tau = ((tau_tr - tau_tau) / G) / b->dt;
 
-            tensor_scale3(T0, scale_factor);
-            tensor_copy3(job->particles[i].T, T0);
-            job->particles[i].T[XX] -= p_tr;
-            job->particles[i].T[YY] -= p_tr;
-            job->particles[i].T[ZZ] -= p_tr;
-            /* job->particles[i].sxx = scale_factor * t0xx_tr - p_tr;
-            job->particles[i].sxy = scale_factor * t0xy_tr;
-            job->particles[i].syy = scale_factor * t0yy_tr - p_tr; */
+            tensor3_scale(T0, scale_factor);
+            tensor3_copy(b->T[i], T0);
+            b->T[i][XX] -= p_tr;
+            b->T[i][YY] -= p_tr;
+            b->T[i][ZZ] -= p_tr;
+            /* b->sxx[i] = scale_factor * t0xx_tr - p_tr;
+            b->sxy[i] = scale_factor * t0xy_tr;
+            b->syy[i] = scale_factor * t0yy_tr - p_tr; */
         } else {
 /*            fprintf(stderr, "u %zu %3.3g %3.3g %d ", i, f, p_tr, density_flag);*/
             fprintf(stderr, "u"); 
@@ -297,12 +285,12 @@ void calculate_stress_threaded(threadtask_t *task)
         }
 
         /* Copy relevant stress entries. */
-        job->particles[i].sxx = job->particles[i].T[XX];
-        job->particles[i].sxy = job->particles[i].T[XY];
-        job->particles[i].syy = job->particles[i].T[YY];
+        b->sxx[i] = b->T[i][XX];
+        b->sxy[i] = b->T[i][XY];
+        b->syy[i] = b->T[i][YY];
         
         /* use strain rate to calculate stress increment */
-        gammap += nup_tau * job->dt;
+        gammap += nup_tau * b->dt;
         gammadotp = nup_tau;
     }
 
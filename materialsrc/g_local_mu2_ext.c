@@ -20,7 +20,7 @@
 
 #define signum(x) ((int)((0 < x) - (x < 0)))
 
-#define jp(x) job->particles[i].x
+#define jp(x) job->particles.x[i]
 
 #define PI 3.1415926535897932384626433
 #define PHI (30.0*PI/180.0)
@@ -44,17 +44,17 @@
 */
 #define GRAINS_D (0.01 * 5)
 
-#define mu_t jp(state[0])
-/*#define Epxy jp(state[1])*/
-/*#define Epyy jp(state[2])*/
-#define gf jp(state[3])
-#define gflocal jp(state[4])
-#define beta jp(state[5])
-#define gammap jp(state[9])
-#define gammadotp jp(state[10])
-#define sxx_e jp(state[6])
-#define sxy_e jp(state[7])
-#define syy_e jp(state[8])
+#define mu_t jp(state)[0]
+/*#define Epxy jp(state)[1]*/
+/*#define Epyy jp(state)[2]*/
+#define gf jp(state)[3]
+#define gflocal jp(state)[4]
+#define beta jp(state)[5]
+#define gammap jp(state)[9]
+#define gammadotp jp(state)[10]
+#define sxx_e jp(state)[6]
+#define sxy_e jp(state)[7]
+#define syy_e jp(state)[8]
 
 #define GFLOCAL_IDX 4
 
@@ -74,11 +74,11 @@ static double nu;
 static double G;
 static double K;
 
-/* granular fluidity at nodes. */
-static double *gf_nodes;
-
-/* laplacian of granular fluidity at nodes. */
-static double *d2_gf_nodes;
+/*
+    laplacian of granular fluidity at nodes, mapped from gflocal by the
+    stepper along with the mass and momentum.
+*/
+static int d2_gf_field;
 
 inline double mu_from_gammadot(double gammadot, double p,
     double dsqrtrhos, double mu_s, double mu_2, double inum_0);
@@ -110,7 +110,7 @@ void material_init(job_t *job)
 
     for (i = 0; i < job->num_particles; i++) {
         for (j = 0; j < DEPVAR; j++) {
-            job->particles[i].state[j] = 0;
+            job->particles.state[i][j] = 0;
         }
     }
 
@@ -140,10 +140,19 @@ void material_init(job_t *job)
             __FILE__, __func__, E, nu, G , K);
     }
 
-    gf_nodes = (double *)malloc(job->num_nodes * sizeof(double));
-    d2_gf_nodes = (double *)malloc(job->num_nodes * sizeof(double));
-    assert(gf_nodes != NULL);
-    assert(d2_gf_nodes != NULL);
+    /* reuse the field if the material was initialized before. */
+    d2_gf_field = nodal_field_find(&(job->nodal_fields), "d2_gf");
+    if (d2_gf_field < 0) {
+        d2_gf_field = nodal_field_register(&(job->nodal_fields),
+            job->num_nodes, "d2_gf", NODAL_FIELD_GRAD_SQ,
+            NODAL_FIELD_WEIGHT_VOLUME, GFLOCAL_IDX, -1.0, -1);
+    }
+    if (d2_gf_field < 0) {
+        fprintf(stderr, "%s:%s: Unable to register nodal field 'd2_gf'.\n",
+            __FILE__, __func__);
+        job->material.init_error = 1;
+        return;
+    }
 
     printf("%s:%s: (material version %s) done initializing material.\n",
         __FILE__,  __func__, MAT_VERSION_STRING);
@@ -157,7 +166,7 @@ void calculate_stress(job_t *job)
     threadtask_t t;
     t.job = job;
     t.offset = 0;
-    t.blocksize = job->num_particles;
+    t.blocksize = job->num_active;
     calculate_stress_threaded(&t);
     return;
 }
@@ -171,8 +180,9 @@ void calculate_stress_threaded(threadtask_t *task)
     size_t p_start = task->offset;
     size_t p_stop = task->offset + task->blocksize;
 
-    size_t n_start = task->n_offset;
-    size_t n_stop = task->n_offset + task->n_blocksize;
+    /* sum of -v gflocal |grad N|^2 at each node. */
+    const double *d2_gf_nodes = nodal_field_values(&(job->nodal_fields),
+        d2_gf_field);
 
     /* values from previous timestep */
     double p_t;
@@ -199,72 +209,14 @@ void calculate_stress_threaded(threadtask_t *task)
     int density_flag;
     
     size_t i, j, p;
-    size_t cc, p_idx, tc_idx;
-
-    double s[4];
 
 /*    fprintf(stderr, "processing particle ids [%zu %zu].\n", p_start, p_stop);*/
 
-    /* clear node-level values */
-    for (i = n_start; i < n_stop; i++) {
-        d2_gf_nodes[i] = 0;
-    }
-
+    /*
+        gflocal (set at the end of the last step) was mapped to the nodes
+        with the rest of the grid, so every particle can be done at once.
+    */
     for (i = p_start; i < p_stop; i++) {
-        if (job->active[i] == 0) {
-            continue;
-        }
-
-        /* Calculate p at beginning of timestep. */
-        p_t = -0.5 * (job->particles[i].sxx + job->particles[i].syy);
-
-        if (gammadotp == 0) {
-            gflocal = 0;
-        } else {
-            mu_t = mu_from_gammadot(gammadotp, p_t,
-                GRAINS_D * sqrt(GRAINS_RHO), MU_S, MU_2, I_0);
-            
-            gflocal = gammadotp / mu_t;
-        }
-    }
-    pthread_barrier_wait(job->serialize_barrier);
-
-    for (cc = 0; cc < job->num_colors; cc++) {
-        tc_idx = task->id * job->num_colors + cc;
-        for (i = 0; i < job->particle_by_element_color_lengths[tc_idx]; i++) {
-            p_idx = job->particle_by_element_color_lists[tc_idx][i];
-
-            /*
-                Note: We don't need to check if the particle is active since
-                the list assembly already checks for this condition.
-            */
-
-            p = job->in_element[p_idx];
-
-            s[0] = job->b11[p_idx] * job->b11[p_idx] + job->b21[p_idx] * job->b21[p_idx];
-            s[1] = job->b12[p_idx] * job->b12[p_idx] + job->b22[p_idx] * job->b22[p_idx];
-            s[2] = job->b13[p_idx] * job->b13[p_idx] + job->b23[p_idx] * job->b23[p_idx];
-            s[3] = job->b14[p_idx] * job->b14[p_idx] + job->b24[p_idx] * job->b24[p_idx];
-
-            for (j = 0; j < 4; j++) {
-                d2_gf_nodes[job->elements[p].nodes[j]] +=
-                    -job->particles[p_idx].v * job->particles[p_idx].state[GFLOCAL_IDX] * s[j];
-            }
-        }
-
-        /*
-            Each color can be done simultaneously, but we have to sync between
-            colors.
-        */
-        pthread_barrier_wait(job->serialize_barrier);
-    }
-/*    pthread_barrier_wait(job->serialize_barrier);*/
-
-    for (i = p_start; i < p_stop; i++) {
-        if (job->active[i] == 0) {
-            continue;
-        }
-
         gf = 0;
 
         p = job->in_element[i];
@@ -283,28 +235,21 @@ void calculate_stress_threaded(threadtask_t *task)
         }
     }
 
-
-    pthread_barrier_wait(job->serialize_barrier);
-
     for (i = p_start; i < p_stop; i++) {
-        if (job->active[i] == 0) {
-            continue;
-        }
-
         /* Calculate p at beginning of timestep. */
-        p_t = -0.5 * (job->particles[i].sxx + job->particles[i].syy);
+        p_t = -0.5 * (job->particles.sxx[i] + job->particles.syy[i]);
 
         /* Calculate tau and p trial values. */
-        dsjxx = job->dt * (E / (1 - nu*nu)) * ((job->particles[i].exx_t) + nu * (job->particles[i].eyy_t));
-        dsjxy = job->dt * (E / (2 *(1 + nu))) * (job->particles[i].exy_t);
-        dsjyy = job->dt * (E / (1 - nu*nu)) * ((job->particles[i].eyy_t) + nu * (job->particles[i].exx_t));
-        dsjxx -= 2 * job->dt * job->particles[i].wxy_t * job->particles[i].sxy;
-        dsjxy += job->dt * job->particles[i].wxy_t * (job->particles[i].sxx - job->particles[i].syy);
-        dsjyy += 2 * job->dt * job->particles[i].wxy_t * job->particles[i].sxy;
+        dsjxx = job->dt * (E / (1 - nu*nu)) * ((job->particles.exx_t[i]) + nu * (job->particles.eyy_t[i]));
+        dsjxy = job->dt * (E / (2 *(1 + nu))) * (job->particles.exy_t[i]);
+        dsjyy = job->dt * (E / (1 - nu*nu)) * ((job->particles.eyy_t[i]) + nu * (job->particles.exx_t[i]));
+        dsjxx -= 2 * job->dt * job->particles.wxy_t[i] * job->particles.sxy[i];
+        dsjxy += job->dt * job->particles.wxy_t[i] * (job->particles.sxx[i] - job->particles.syy[i]);
+        dsjyy += 2 * job->dt * job->particles.wxy_t[i] * job->particles.sxy[i];
 
-        sxx_tr = job->particles[i].sxx + dsjxx;
-        sxy_tr = job->particles[i].sxy + dsjxy;
-        syy_tr = job->particles[i].syy + dsjyy;
+        sxx_tr = job->particles.sxx[i] + dsjxx;
+        sxy_tr = job->particles.sxy[i] + dsjxy;
+        syy_tr = job->particles.syy[i] + dsjyy;
 
         p_tr = -0.5 * (sxx_tr + syy_tr);
         t0xx_tr = sxx_tr + p_tr;
@@ -318,9 +263,9 @@ void calculate_stress_threaded(threadtask_t *task)
         tau_tau = mu_t*(p_tr + c);
         f = tau_tr - tau_tau;
 
-        if ((job->particles[i].m / job->particles[i].v) < 1485.0f) {
+        if ((job->particles.m[i] / job->particles.v[i]) < 1485.0f) {
             density_flag = 1;
-/*            printf("%4d: density %lf\n", i, (job->particles[i].m / job->particles[i].v));*/
+/*            printf("%4d: density %lf\n", i, (job->particles.m[i] / job->particles.v[i]));*/
         } else {
             density_flag = 0;
         }
@@ -329,31 +274,31 @@ void calculate_stress_threaded(threadtask_t *task)
             nup_tau = (tau_tr) / (G * job->dt);
             beta = -p_tr / (K * job->dt);
 
-            job->particles[i].sxx = 0;
-            job->particles[i].sxy = 0;
-            job->particles[i].syy = 0;
+            job->particles.sxx[i] = 0;
+            job->particles.sxy[i] = 0;
+            job->particles.syy[i] = 0;
         } else if (f < 0) {
             nup_tau = 0;
             beta = 0;
 
-            job->particles[i].sxx = t0xx_tr - p_tr;
-            job->particles[i].sxy = t0xy_tr;
-            job->particles[i].syy = t0yy_tr - p_tr;
+            job->particles.sxx[i] = t0xx_tr - p_tr;
+            job->particles.sxy[i] = t0xy_tr;
+            job->particles.syy[i] = t0yy_tr - p_tr;
         } else if (f >= 0 && p_tr > -c/mu_t) {
             nup_tau = (tau_tr - tau_tau) / (G * job->dt);
             beta = 0;
 
             scale_factor = (tau_tau / tau_tr);
-            job->particles[i].sxx = scale_factor * t0xx_tr - p_tr;
-            job->particles[i].sxy = scale_factor * t0xy_tr;
-            job->particles[i].syy = scale_factor * t0yy_tr - p_tr;
+            job->particles.sxx[i] = scale_factor * t0xx_tr - p_tr;
+            job->particles.sxy[i] = scale_factor * t0xy_tr;
+            job->particles.syy[i] = scale_factor * t0yy_tr - p_tr;
         } else if (p_tr <= -c/mu_t) {
             nup_tau = tau_tr / (G * job->dt);
             beta = ((c/mu_t) - p_tr) / (K * job->dt);
 
-            job->particles[i].sxx = 0;
-            job->particles[i].sxy = 0;
-            job->particles[i].syy = 0;
+            job->particles.sxx[i] = 0;
+            job->particles.sxy[i] = 0;
+            job->particles.syy[i] = 0;
         } else {
             fprintf(stderr, "u %zu %3.3g %3.3g %d ", i, f, p_tr, density_flag);
 /*            fprintf(stderr, "u"); */
@@ -363,6 +308,18 @@ void calculate_stress_threaded(threadtask_t *task)
         /* use strain rate to calculate stress increment */
         gammap += nup_tau * job->dt;
         gammadotp = nup_tau;
+
+        /* local fluidity at the start of the next step. */
+        p_t = -0.5 * (job->particles.sxx[i] + job->particles.syy[i]);
+
+        if (gammadotp == 0) {
+            gflocal = 0;
+        } else {
+            mu_t = mu_from_gammadot(gammadotp, p_t,
+                GRAINS_D * sqrt(GRAINS_RHO), MU_S, MU_2, I_0);
+
+            gflocal = gammadotp / mu_t;
+        }
     }
 
     return;
@@ -16,7 +16,7 @@
 #include "material.h"
 #include "exitcodes.h"
 
-#define jp(x) job->particles[i].x
+#define jp(x) job->particles.x[i]
 
 #undef EMOD
 #undef NUMOD
@@ -38,17 +38,17 @@
 */
 #define GRAINS_D (0.01 * 5)
 
-#define mu_y jp(state[0])
-/*#define Epxy jp(state[1])*/
-/*#define Epyy jp(state[2])*/
-#define gf jp(state[3])
-#define eta jp(state[4])
-#define beta jp(state[5])
-#define gammap jp(state[9])
-#define gammadotp jp(state[10])
-#define sxx_e jp(state[6])
-#define sxy_e jp(state[7])
-#define syy_e jp(state[8])
+#define mu_y jp(state)[0]
+/*#define Epxy jp(state)[1]*/
+/*#define Epyy jp(state)[2]*/
+#define gf jp(state)[3]
+#define eta jp(state)[4]
+#define beta jp(state)[5]
+#define gammap jp(state)[9]
+#define gammadotp jp(state)[10]
+#define sxx_e jp(state)[6]
+#define sxy_e jp(state)[7]
+#define syy_e jp(state)[8]
 
 #define MAT_VERSION_STRING "1.0 " __DATE__ " " __TIME__
 
@@ -103,7 +103,7 @@ void material_init(job_t *job)
 
     for (i = 0; i < job->num_particles; i++) {
         for (j = 0; j < DEPVAR; j++) {
-            job->particles[i].state[j] = 0;
+            job->particles.state[i][j] = 0;
         }
     }
 
@@ -145,7 +145,7 @@ void calculate_stress(job_t *job)
     threadtask_t t;
     t.job = job;
     t.offset = 0;
-    t.blocksize = job->num_particles;
+    t.blocksize = job->num_active;
     calculate_stress_threaded(&t);
     return;
 }
@@ -189,22 +189,18 @@ void calculate_stress_threaded(threadtask_t *task)
 /*    fprintf(stderr, "processing particle ids [%zu %zu].\n", p_start, p_stop);*/
 
     for (i = p_start; i < p_stop; i++) {
-        if (job->active[i] == 0) {
-            continue;
-        }
-
         /* Calculate tau and p trial values. */
-        trD = job->particles[i].exx_t + job->particles[i].eyy_t;
-        dsjxx = lambda * trD + 2.0 * G * job->particles[i].exx_t;
-        dsjxy = 2.0 * G * job->particles[i].exy_t;
-        dsjyy = lambda * trD + 2.0 * G * job->particles[i].eyy_t;
-        dsjxx += 2 * job->particles[i].wxy_t * job->particles[i].sxy;
-        dsjxy -= job->particles[i].wxy_t * (job->particles[i].sxx - job->particles[i].syy);
-        dsjyy -= 2 * job->particles[i].wxy_t * job->particles[i].sxy;
-
-        sxx_tr = job->particles[i].sxx + job->dt * dsjxx;
-        sxy_tr = job->particles[i].sxy + job->dt * dsjxy;
-        syy_tr = job->particles[i].syy + job->dt * dsjyy;
+        trD = job->particles.exx_t[i] + job->particles.eyy_t[i];
+        dsjxx = lambda * trD + 2.0 * G * job->particles.exx_t[i];
+        dsjxy = 2.0 * G * job->particles.exy_t[i];
+        dsjyy = lambda * trD + 2.0 * G * job->particles.eyy_t[i];
+        dsjxx += 2 * job->particles.wxy_t[i] * job->particles.sxy[i];
+        dsjxy -= job->particles.wxy_t[i] * (job->particles.sxx[i] - job->particles.syy[i]);
+        dsjyy -= 2 * job->particles.wxy_t[i] * job->particles.sxy[i];
+
+        sxx_tr = job->particles.sxx[i] + job->dt * dsjxx;
+        sxy_tr = job->particles.sxy[i] + job->dt * dsjxy;
+        syy_tr = job->particles.syy[i] + job->dt * dsjyy;
 
         p_tr = -0.5 * (sxx_tr + syy_tr);
         t0xx_tr = sxx_tr + p_tr;
@@ -212,9 +208,9 @@ void calculate_stress_threaded(threadtask_t *task)
         t0yy_tr = syy_tr + p_tr;
         tau_tr = sqrt(0.5*(t0xx_tr*t0xx_tr + 2*t0xy_tr*t0xy_tr + t0yy_tr*t0yy_tr));
 
-        if ((job->particles[i].m / job->particles[i].v) < 1485.0f) {
+        if ((job->particles.m[i] / job->particles.v[i]) < 1485.0f) {
             density_flag = 1;
-/*            printf("%4d: density %lf\n", i, (job->particles[i].m / job->particles[i].v));*/
+/*            printf("%4d: density %lf\n", i, (job->particles.m[i] / job->particles.v[i]));*/
         } else {
             density_flag = 0;
         }
@@ -223,9 +219,9 @@ void calculate_stress_threaded(threadtask_t *task)
             nup_tau = (tau_tr) / (G * job->dt);
             beta = -p_tr / (K * job->dt);
 
-            job->particles[i].sxx = 0;
-            job->particles[i].sxy = 0;
-            job->particles[i].syy = 0;
+            job->particles.sxx[i] = 0;
+            job->particles.sxy[i] = 0;
+            job->particles.syy[i] = 0;
         } else if (p_tr > c) {
             S0 = MU_S * p_tr;
             if (tau_tr <= S0) {
@@ -243,9 +239,9 @@ void calculate_stress_threaded(threadtask_t *task)
             nup_tau = ((tau_tr - tau_tau) / G) / job->dt;
             beta = 0;
 
-            job->particles[i].sxx = scale_factor * t0xx_tr - p_tr;
-            job->particles[i].sxy = scale_factor * t0xy_tr;
-            job->particles[i].syy = scale_factor * t0yy_tr - p_tr;
+            job->particles.sxx[i] = scale_factor * t0xx_tr - p_tr;
+            job->particles.sxy[i] = scale_factor * t0xy_tr;
+            job->particles.syy[i] = scale_factor * t0yy_tr - p_tr;
         } else {
 /*            fprintf(stderr, "u %zu %3.3g %3.3g %d ", i, f, p_tr, density_flag);*/
             fprintf(stderr, "u"); 
@@ -18,12 +18,13 @@
 /* we need the nodal DOFs to use the node number array */
 #include "element.h"
 #include "exitcodes.h"
+#include "nonlocal.h"
 
 #include <assert.h>
 
 #define signum(x) ((int)((0 < x) - (x < 0)))
 
-#define jp(x) job->particles[i].x
+#define jp(x) job->particles.x[i]
 
 #undef EMOD
 #undef NUMOD
@@ -47,17 +48,17 @@
 #define GRAINS_D (0.01 * 5)
 
 
-#define Epxx jp(state[0])
-#define Epxy jp(state[1])
-#define Epyy jp(state[2])
-#define gf jp(state[3])
-#define eta jp(state[4])
-#define gf_bulk jp(state[5])
-#define gammap jp(state[9])
-#define xisq_inv jp(state[10])
-#define Etxx jp(state[6])
-#define Etxy jp(state[7])
-#define Etyy jp(state[8])
+#define Epxx jp(state)[0]
+#define Epxy jp(state)[1]
+#define Epyy jp(state)[2]
+#define gf jp(state)[3]
+#define eta jp(state)[4]
+#define gf_bulk jp(state)[5]
+#define gammap jp(state)[9]
+#define xisq_inv jp(state)[10]
+#define Etxx jp(state)[6]
+#define Etxy jp(state)[7]
+#define Etyy jp(state)[8]
 
 #define TOL 1e-10
 
@@ -66,6 +67,9 @@
 void calculate_bulk_granular_fluidity(job_t *job);
 void solve_diffusion_part(job_t *job);
 
+/* fluidity solver state kept between steps. */
+static nonlocal_ws_t ws;
+
 /*----------------------------------------------------------------------------*/
 void material_init(job_t *job)
 {
@@ -73,7 +77,7 @@ void material_init(job_t *job)
 
     for (i = 0; i < job->num_particles; i++) {
         for (j = 0; j < DEPVAR; j++) {
-            job->particles[i].state[j] = 0;
+            job->particles.state[i][j] = 0;
         }
     }
 
@@ -91,6 +95,9 @@ void material_init(job_t *job)
         xisq_inv = 0;
     }
 
+    /* no fluidity solution to start from or reuse. */
+    nonlocal_ws_free(&ws);
+
     printf("%s:%s: (material version %s) done initializing material.\n",
         __FILE__,  __func__, MAT_VERSION_STRING);
     return;
@@ -146,33 +153,33 @@ void calculate_stress(job_t *job)
     solve_diffusion_part(job);
 
     /* use g_nonlocal to update stress state (in gf variable) */
-    for (i = 0; i < job->num_particles; i++) {
-        p_t = -0.5 * (job->particles[i].sxx + job->particles[i].syy);
-        sxx_t0 = job->particles[i].sxx + p_t;
-        sxy_t0 = job->particles[i].sxy;
-        syy_t0 = job->particles[i].syy + p_t;
+    for (i = 0; i < job->num_active; i++) {
+        p_t = -0.5 * (job->particles.sxx[i] + job->particles.syy[i]);
+        sxx_t0 = job->particles.sxx[i] + p_t;
+        sxy_t0 = job->particles.sxy[i];
+        syy_t0 = job->particles.syy[i] + p_t;
         tau_t = sqrt(0.5*(sxx_t0*sxx_t0 + 2*sxy_t0*sxy_t0 + syy_t0*syy_t0));
 
         /* calculate trial elastic strain */
-        dsjxx = job->dt * (EMOD / (1 - NUMOD*NUMOD)) * ((job->particles[i].exx_t) + NUMOD * (job->particles[i].eyy_t));
-        dsjxy = job->dt * (EMOD / (2 *(1 + NUMOD))) * (job->particles[i].exy_t);
-        dsjyy = job->dt * (EMOD / (1 - NUMOD*NUMOD)) * ((job->particles[i].eyy_t) + NUMOD * (job->particles[i].exx_t));
+        dsjxx = job->dt * (EMOD / (1 - NUMOD*NUMOD)) * ((job->particles.exx_t[i]) + NUMOD * (job->particles.eyy_t[i]));
+        dsjxy = job->dt * (EMOD / (2 *(1 + NUMOD))) * (job->particles.exy_t[i]);
+        dsjyy = job->dt * (EMOD / (1 - NUMOD*NUMOD)) * ((job->particles.eyy_t[i]) + NUMOD * (job->particles.exx_t[i]));
 
         /* Jaumann spin terms */
-        dsjxx -= 2 * job->dt * job->particles[i].wxy_t * job->particles[i].sxy;
-        dsjxy += job->dt * job->particles[i].wxy_t * (job->particles[i].sxx - job->particles[i].syy);
-        dsjyy += 2 * job->dt * job->particles[i].wxy_t * job->particles[i].sxy;
+        dsjxx -= 2 * job->dt * job->particles.wxy_t[i] * job->particles.sxy[i];
+        dsjxy += job->dt * job->particles.wxy_t[i] * (job->particles.sxx[i] - job->particles.syy[i]);
+        dsjyy += 2 * job->dt * job->particles.wxy_t[i] * job->particles.sxy[i];
 
-        sxx_tr = job->particles[i].sxx + dsjxx;
-        sxy_tr = job->particles[i].sxy + dsjxy;
-        syy_tr = job->particles[i].syy + dsjyy;
+        sxx_tr = job->particles.sxx[i] + dsjxx;
+        sxy_tr = job->particles.sxy[i] + dsjxy;
+        syy_tr = job->particles.syy[i] + dsjyy;
 
         p_tr = -0.5 * (sxx_tr + syy_tr);
 
         if (p_tr < c) {
-            job->particles[i].sxx = 0.5 * c / MU_S;
-            job->particles[i].sxy = 0;
-            job->particles[i].syy = 0.5 * c / MU_S;
+            job->particles.sxx[i] = 0.5 * c / MU_S;
+            job->particles.sxy[i] = 0;
+            job->particles.syy[i] = 0.5 * c / MU_S;
 /*            printf("%s:%s: Particle %zu pressure less than cohesion, results may be inaccurate.\n", __FILE__, __func__, i);*/
             continue;
         }
@@ -223,9 +230,9 @@ void calculate_stress(job_t *job)
 /*        tau_tau = tau_tr - G * nup_tau * job->dt;*/
 
         /* adjust stress */
-/*        job->particles[i].sxx = sxx_tr - sqrt(2.0) * (tau_tr - tau_tau) * Npxx_tau;*/
-/*        job->particles[i].sxy = sxy_tr - sqrt(2.0) * (tau_tr - tau_tau) * Npxy_tau;*/
-/*        job->particles[i].syy = syy_tr - sqrt(2.0) * (tau_tr - tau_tau) * Npyy_tau;*/
+/*        job->particles.sxx[i] = sxx_tr - sqrt(2.0) * (tau_tr - tau_tau) * Npxx_tau;*/
+/*        job->particles.sxy[i] = sxy_tr - sqrt(2.0) * (tau_tr - tau_tau) * Npxy_tau;*/
+/*        job->particles.syy[i] = syy_tr - sqrt(2.0) * (tau_tr - tau_tau) * Npyy_tau;*/
 
         /*
         --
@@ -233,17 +240,17 @@ void calculate_stress(job_t *job)
         --
         */
 #if 1
-        p_t = -0.5 * (job->particles[i].sxx + job->particles[i].syy);
-        sxx_t0 = job->particles[i].sxx + p_t;
-        sxy_t0 = job->particles[i].sxy;
-        syy_t0 = job->particles[i].syy + p_t;
+        p_t = -0.5 * (job->particles.sxx[i] + job->particles.syy[i]);
+        sxx_t0 = job->particles.sxx[i] + p_t;
+        sxy_t0 = job->particles.sxy[i];
+        syy_t0 = job->particles.syy[i] + p_t;
         tau_t = sqrt(0.5*(sxx_t0*sxx_t0 + 2*sxy_t0*sxy_t0 + syy_t0*syy_t0));
         Npxx_tau = sqrt(0.5) * sxx_t0 / tau_t;
         Npxy_tau = sqrt(0.5) * sxy_t0 / tau_t;
         Npyy_tau = sqrt(0.5) * syy_t0 / tau_t;
-        dxx0 = 0.5 * (job->particles[i].exx_t - job->particles[i].eyy_t);
-        dxy0 = job->particles[i].exy_t;
-        dyy0 = 0.5 * (job->particles[i].eyy_t - job->particles[i].exx_t);
+        dxx0 = 0.5 * (job->particles.exx_t[i] - job->particles.eyy_t[i]);
+        dxy0 = job->particles.exy_t[i];
+        dyy0 = 0.5 * (job->particles.eyy_t[i] - job->particles.exx_t[i]);
         gammadot = sqrt(2 * (dxx0*dxx0 + 2*dxy0*dxy0 + dyy0*dyy0));
         
         if (p_t > c && gf > 0) {
@@ -281,17 +288,17 @@ void calculate_stress(job_t *job)
             dpyy = 0;
         }
 
-        dsjxx = job->dt * (EMOD / (1 - NUMOD*NUMOD)) * ((job->particles[i].exx_t - dpxx) + NUMOD * (job->particles[i].eyy_t - dpyy));
-        dsjxy = job->dt * (EMOD / (2 *(1 + NUMOD))) * (job->particles[i].exy_t - dpxy);
-        dsjyy = job->dt * (EMOD / (1 - NUMOD*NUMOD)) * ((job->particles[i].eyy_t - dpyy) + NUMOD * (job->particles[i].exx_t - dpxx));
-        dsjxx -= 2 * job->dt * job->particles[i].wxy_t * job->particles[i].sxy;
-        dsjxy += job->dt * job->particles[i].wxy_t * (job->particles[i].sxx - job->particles[i].syy);
-        dsjyy += 2 * job->dt * job->particles[i].wxy_t * job->particles[i].sxy;
+        dsjxx = job->dt * (EMOD / (1 - NUMOD*NUMOD)) * ((job->particles.exx_t[i] - dpxx) + NUMOD * (job->particles.eyy_t[i] - dpyy));
+        dsjxy = job->dt * (EMOD / (2 *(1 + NUMOD))) * (job->particles.exy_t[i] - dpxy);
+        dsjyy = job->dt * (EMOD / (1 - NUMOD*NUMOD)) * ((job->particles.eyy_t[i] - dpyy) + NUMOD * (job->particles.exx_t[i] - dpxx));
+        dsjxx -= 2 * job->dt * job->particles.wxy_t[i] * job->particles.sxy[i];
+        dsjxy += job->dt * job->particles.wxy_t[i] * (job->particles.sxx[i] - job->particles.syy[i]);
+        dsjyy += 2 * job->dt * job->particles.wxy_t[i] * job->particles.sxy[i];
 
         gammap += nup_tau * job->dt;
-        job->particles[i].sxx += dsjxx;
-        job->particles[i].sxy += dsjxy;
-        job->particles[i].syy += dsjyy;
+        job->particles.sxx[i] += dsjxx;
+        job->particles.sxy[i] += dsjxy;
+        job->particles.syy[i] += dsjyy;
 #endif
 
     }
@@ -315,22 +322,22 @@ void calculate_bulk_granular_fluidity(job_t *job)
 
     double const p_cap = 1e-2;
 
-    for (i = 0; i < job->num_particles; i++) {
+    for (i = 0; i < job->num_active; i++) {
 
         /* Calculate pressure at beginning of step. */
-        p_t = -0.5 * (job->particles[i].sxx + job->particles[i].syy);
+        p_t = -0.5 * (job->particles.sxx[i] + job->particles.syy[i]);
 
-        sxx_tr0 = job->particles[i].sxx + p_t;
-        sxy_tr0 = job->particles[i].sxy;
-        syy_tr0 = job->particles[i].syy + p_t;
+        sxx_tr0 = job->particles.sxx[i] + p_t;
+        sxy_tr0 = job->particles.sxy[i];
+        syy_tr0 = job->particles.syy[i] + p_t;
 
         /* Calculate equivalent shear at beginning of step. */
         tau_t = sqrt(0.5*(sxx_tr0*sxx_tr0 + 2*sxy_tr0*sxy_tr0 + syy_tr0*syy_tr0));
 
         if (p_t < p_cap) {
-/*            job->particles[i].sxx = -0.5 * p_cap;*/
-/*            job->particles[i].sxy = 0;*/
-/*            job->particles[i].syy = -0.5 * p_cap;*/
+/*            job->particles.sxx[i] = -0.5 * p_cap;*/
+/*            job->particles.sxy[i] = 0;*/
+/*            job->particles.syy[i] = -0.5 * p_cap;*/
             p_t = p_cap;
 /*            printf("%s:%s: Particle %zu pressure less than cohesion, results may be inaccurate.\n", __FILE__, __func__, i);*/
 /*            continue;*/
@@ -354,94 +361,28 @@ void calculate_bulk_granular_fluidity(job_t *job)
 /*----------------------------------------------------------------------------*/
 void solve_diffusion_part(job_t *job)
 {
-    size_t i, j;
-    size_t i_new, j_new;
+    size_t i;
+    size_t i_new;
     size_t ei, ej;
-    size_t gi, gj;
-    size_t sgi, sgj;
-
-    size_t *node_map;
-    size_t *inv_node_map;
-
-    size_t slda;
-    size_t nnz;
-
-    cs *triplets;
-    cs *smat;
+    size_t gi;
+    size_t sgi;
 
     double *gf_nodes;
-    double *m_total_nodes;
-
     double *f;
 
     double s[4];
     double grad_s[4][2];
 
-/*    double m_frac;*/
-
     int p;
     int *nn;
 
-    /* initialize node level fluidity arrays */
-    gf_nodes = (double *)malloc(job->num_nodes * sizeof(double));
-    for (i = 0; i < job->num_nodes; i++) {
-        gf_nodes[i] = 0;
-    }
-
-    /* get number of dofs and initialize mapping arrays */
-    node_map = (size_t *)malloc(job->num_nodes * sizeof(size_t));
-    inv_node_map = (size_t *)malloc(job->num_nodes * sizeof(size_t));
-    slda = 0;
-    for (i = 0; i < job->num_nodes; i++) {
-        node_map[i] = -1;
-        inv_node_map[i] = -1;
-    }
-    for (i = 0; i < job->num_nodes; i++) {
-        i_new = (job->node_number_override[NODAL_DOF * i + 0 ] - 0) / NODAL_DOF;
-
-        if (node_map[i_new] != -1) {
-            continue;
-        }
-
-        if (job->nodes[i_new].m > TOL) {
-            node_map[i_new] = slda;
-            inv_node_map[slda] = i_new;
-            slda++;
-        }
-    }
-
-    if (slda <= 0) {
-        fprintf(stderr, "%s:%s: Invalid size, slda = %zu.\n",
-            __FILE__, __func__, slda);
-        exit(-1);
-    }
-
-    m_total_nodes = (double *)malloc(slda * sizeof(double));
-    f = (double *)malloc(slda * sizeof(double));
-    for (i = 0; i < slda; i++) {
-        m_total_nodes[i] = 0;
-        f[i] = 0;
-    }
-
-    /*  calculate number of nonzero elements (before summing duplicates). */
-    nnz = 0;
-    for (i = 0; i < job->num_elements; i++) {
-        if (job->elements[i].filled != 0) {
-            nnz += (NODES_PER_ELEMENT * NODES_PER_ELEMENT) * 1;
-        }
-    }
-
-    /* slda contains degrees of freedom of new matrix */
-    triplets = cs_spalloc(slda, slda, nnz, 1, 1);
-/*    fprintf(stderr, "%s:%s: slda = %zu, nnz = %zu.\n",*/
-/*        __FILE__, __func__, slda, nnz);*/
+    /* get number of dofs and map nodes to them */
+    nonlocal_ws_begin(&ws, job, TOL);
+    f = ws.f;
+    gf_nodes = ws.gf_nodes;
 
     /* project xi and g_local onto background grid (volume-weighted) */
-    for (i = 0; i < job->num_particles; i++) {
-        if (job->active[i] == 0) {
-            continue;
-        }
-
+    for (i = 0; i < job->num_active; i++) {
         p = job->in_element[i];
         if (p == -1) {
             continue;
@@ -453,80 +394,68 @@ void solve_diffusion_part(job_t *job)
         s[3] = job->h4[i];
 
         nn = job->elements[p].nodes;
+        nonlocal_ws_use_element(&ws, p);
+        if (gf_bulk * xisq_inv != 0) {
+            nonlocal_ws_mark_source(&ws, p);
+        }
 
         for (ei = 0; ei < NODES_PER_ELEMENT; ei++) {
             gi = nn[ei];
             gi = (job->node_number_override[NODAL_DOF * gi + 0 ] - 0) / NODAL_DOF;
-            sgi = node_map[gi];
+            sgi = ws.node_map[gi];
 
-            m_total_nodes[sgi] += job->particles[i].m * s[ei];
-/*            f[sgi] += job->particles[i].m * gf_bulk * xisq_inv * s[ei];*/
-            f[sgi] += (job->particles[i].v) * gf_bulk * xisq_inv * s[ei];
+/*            f[sgi] += job->particles.m[i] * gf_bulk * xisq_inv * s[ei];*/
+            f[sgi] += (job->particles.v[i]) * gf_bulk * xisq_inv * s[ei];
         }
     }
 
-    /* unweight load f */
-/*    for (i = 0; i < slda; i++) {*/
-/*        f[i] = f[i] / m_total_nodes[i];*/
-/*    }*/
-
-    /* create stiffness matrix. */
-    for (i = 0; i < job->num_particles; i++) {
-        if (job->active[i] == 0) {
-            continue;
-        }
-
-        p = job->in_element[i];
-        if (p == -1) {
-            continue;
-        }
-
-        s[0] = job->h1[i];
-        s[1] = job->h2[i];
-        s[2] = job->h3[i];
-        s[3] = job->h4[i];
-
-        grad_s[0][0] = job->b11[i];
-        grad_s[1][0] = job->b12[i];
-        grad_s[2][0] = job->b13[i];
-        grad_s[3][0] = job->b14[i];
-
-        grad_s[0][1] = job->b21[i];
-        grad_s[1][1] = job->b22[i];
-        grad_s[2][1] = job->b23[i];
-        grad_s[3][1] = job->b24[i];
-
-        nn = job->elements[p].nodes;
-
-        for (ei = 0; ei < NODES_PER_ELEMENT; ei++) {
-            for (ej = 0; ej < NODES_PER_ELEMENT; ej++) {
-                gi = nn[ei];
-                gj = nn[ej];
-
-                gi = (job->node_number_override[NODAL_DOF * gi + 0] - 0) / NODAL_DOF;
-                gj = (job->node_number_override[NODAL_DOF * gj + 0] - 0) / NODAL_DOF;
+    /* between solves the nodal fluidity of the last one is kept. */
+    if (!nonlocal_ws_solve_due(&ws, job)) {
+        goto _map_fluidity;
+    }
 
-                sgi = node_map[gi];
-                sgj = node_map[gj];
+    /* only the support of the particles above yield is solved for. */
+    if (nonlocal_ws_pattern(&ws, job) != 0) {
+        fprintf(stderr, "%s:%s: Unable to build sparsity pattern.\n",
+            __FILE__, __func__);
+        exit(-1);
+    }
 
-/*                m_frac = (job->particles[i].m * job->particles[i].m) / (m_total_nodes[sgi] * m_total_nodes[sgj]);*/
+    /* no dofs left when nothing is above yield, the fluidity is zero. */
+    if (ws.slda != 0) {
+        /* create stiffness matrix. */
+        for (i = 0; i < job->num_active; i++) {
+            p = job->in_element[i];
+            if (p == -1) {
+                continue;
+            }
 
-                cs_entry(triplets, sgi, sgj,
-                    job->particles[i].v * (xisq_inv * s[ei] * s[ej] + 
-                        (grad_s[ei][0]*grad_s[ej][0] + grad_s[ei][1]*grad_s[ej][1]))
-                );
+            s[0] = job->h1[i];
+            s[1] = job->h2[i];
+            s[2] = job->h3[i];
+            s[3] = job->h4[i];
+
+            grad_s[0][0] = job->b11[i];
+            grad_s[1][0] = job->b12[i];
+            grad_s[2][0] = job->b13[i];
+            grad_s[3][0] = job->b14[i];
+
+            grad_s[0][1] = job->b21[i];
+            grad_s[1][1] = job->b22[i];
+            grad_s[2][1] = job->b23[i];
+            grad_s[3][1] = job->b24[i];
+
+            for (ei = 0; ei < NODES_PER_ELEMENT; ei++) {
+                for (ej = 0; ej < NODES_PER_ELEMENT; ej++) {
+                    nonlocal_ws_add(&ws, p, ei, ej,
+                        job->particles.v[i] * (xisq_inv * s[ei] * s[ej] + 
+                            (grad_s[ei][0]*grad_s[ej][0] + grad_s[ei][1]*grad_s[ej][1]))
+                    );
+                }
             }
         }
-    }
-
-    /* create compressed sparse matrix */
-    smat = cs_compress(triplets);
-    cs_dupl(smat);
 
-    if (!cs_lusol(1, smat, f, 1e-12)) {
-        fprintf(stderr, "lusol error!\n");
-        if (cs_qrsol(1, smat, f)) {
-            fprintf(stderr, "qrsol error!\n");
+        if (nonlocal_ws_solve(&ws, job) != 0) {
             exit(EXIT_ERROR_CS_SOL);
         }
     }
@@ -534,8 +463,10 @@ void solve_diffusion_part(job_t *job)
     for (i = 0; i < job->num_nodes; i++) {
         i_new = (job->node_number_override[NODAL_DOF * i + 0] - 0) / NODAL_DOF;
 
-        if (node_map[i_new] != -1) {
-            gf_nodes[i] = f[node_map[i_new]];
+        if (ws.node_map[i_new] != NONLOCAL_UNMAPPED) {
+            gf_nodes[i] = f[ws.node_map[i_new]];
+        } else {
+            gf_nodes[i] = 0;
         }
     }
 
@@ -548,12 +479,9 @@ void solve_diffusion_part(job_t *job)
         }
     }
 
+_map_fluidity:
     /* map nodal g_nonlocal back to particles */
-    for (i = 0; i < job->num_particles; i++) {
-        if (job->active[i] == 0) {
-            continue;
-        }
-
+    for (i = 0; i < job->num_active; i++) {
         p = job->in_element[i];
         if (p == -1) {
             continue;
@@ -570,7 +498,6 @@ void solve_diffusion_part(job_t *job)
         for (ei = 0; ei < NODES_PER_ELEMENT; ei++) {
             gi = nn[ei];
             gi = (job->node_number_override[NODAL_DOF * gi + 0] - 0) / NODAL_DOF;
-            sgi = node_map[gi];
 
 /*            gf += gf_nodes[gi] * s[ei];*/
 
@@ -579,35 +506,6 @@ void solve_diffusion_part(job_t *job)
         }
     }
 
-    cs_spfree(triplets);
-    cs_spfree(smat);
-
-    free(node_map);
-    free(inv_node_map);
-
-    free(gf_nodes);
-
-    free(m_total_nodes);
-    free(f);
-
-    return;
-}
-/*----------------------------------------------------------------------------*/
-
-/*----------------------------------------------------------------------------*/
-void BiCGSTAB(double *x, cs *Amat, double *b, double tol, int lenx)
-{
-    int i;
-    double *r;
-    double rho;
-
-    r = (double *)malloc(sizeof(double) * lenx);
-    for (i = 0; i < lenx; i++) {
-        r[i] = -b[i];
-    }
-    rho = 1.0;
-    cs_gaxpy(Amat, x, r);
-    free(r);
     return;
 }
 /*----------------------------------------------------------------------------*/
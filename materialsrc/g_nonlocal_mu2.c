@@ -18,12 +18,13 @@
 /* we need the nodal DOFs to use the node number array */
 #include "element.h"
 #include "exitcodes.h"
+#include "nonlocal.h"
 
 #include <assert.h>
 
 #define signum(x) ((int)((0 < x) - (x < 0)))
 
-#define jp(x) job->particles[i].x
+#define jp(x) job->particles.x[i]
 
 #undef EMOD
 #undef NUMOD
@@ -43,27 +44,32 @@
 /* parameter */
 #define RHO_CRITICAL 1485.0
 
-#define dense jp(state[0])
-#define gf jp(state[3])
-#define eta jp(state[4])
-#define gf_local jp(state[5])
-#define xisq_inv jp(state[6])
-/*#define Etxy jp(state[7])*/
-/*#define Etyy jp(state[8])*/
-#define gammap jp(state[9])
-#define gammadotp jp(state[10])
+#define dense jp(state)[0]
+#define gf jp(state)[3]
+#define eta jp(state)[4]
+#define gf_local jp(state)[5]
+#define xisq_inv jp(state)[6]
+/*#define Etxy jp(state)[7]*/
+/*#define Etyy jp(state)[8]*/
+#define gammap jp(state)[9]
+#define gammadotp jp(state)[10]
 
 #define TOL 0
 
 #define MAT_VERSION_STRING "1.0 " __DATE__ " " __TIME__
 
 void calculate_stress(job_t *job);
-void calculate_bulk_granular_fluidity(job_t *job);
-void solve_diffusion_part(job_t *job);
+void calculate_bulk_granular_fluidity(job_t *job, size_t p_start, size_t p_stop);
+void solve_diffusion_part(job_t *job, size_t thread_id, size_t num_threads);
+void map_fluidity_to_particles(job_t *job, size_t p_start, size_t p_stop);
+void update_stress(job_t *job, size_t p_start, size_t p_stop);
 void calculate_stress_threaded(threadtask_t *task);
 
 static double E, nu, G, K;
 
+/* fluidity solver state kept between steps. */
+static nonlocal_ws_t ws;
+
 /*----------------------------------------------------------------------------*/
 void material_init(job_t *job)
 {
@@ -71,12 +77,12 @@ void material_init(job_t *job)
 
     for (i = 0; i < job->num_particles; i++) {
         for (j = 0; j < DEPVAR; j++) {
-            job->particles[i].state[j] = 0;
+            job->particles.state[i][j] = 0;
         }
     }
 
     for (i = 0; i < job->num_particles; i++) {
-        if ((job->particles[i].m / job->particles[i].v) > RHO_CRITICAL) {
+        if ((job->particles.m[i] / job->particles.v[i]) > RHO_CRITICAL) {
             dense = 1;
         } else {
             dense = 0;
@@ -103,27 +109,53 @@ void material_init(job_t *job)
             __FILE__, __func__, E, nu, G , K);
     }
 
+    /* no fluidity solution to start from or reuse. */
+    nonlocal_ws_free(&ws);
+
     printf("%s:%s: (material version %s) done initializing material.\n",
         __FILE__,  __func__, MAT_VERSION_STRING);
     return;
 }
 /*----------------------------------------------------------------------------*/
 
-/* nonlocal granular fluidity model. */
+/*
+    nonlocal granular fluidity model. Every thread computes the bulk
+    fluidity of its particles, assembles one element color at a time, takes
+    its share of the solve and updates the stress of its particles.
+*/
 void calculate_stress_threaded(threadtask_t *task)
 {
     job_t *job = task->job;
+    size_t p_start = task->offset;
+    size_t p_stop = task->offset + task->blocksize;
 
-    /* Only one of the threads can compute the nonlocal solution. */
-    if (task->id == 0) {
-        calculate_stress(job);
-    }
+    /* solve for g_local */
+    calculate_bulk_granular_fluidity(job, p_start, p_stop);
+
+    /* build FEM diffusion array/load vector and solve for g_nonlocal */
+    solve_diffusion_part(job, task->id, job->num_threads);
+
+    map_fluidity_to_particles(job, p_start, p_stop);
+    update_stress(job, p_start, p_stop);
 
     return;
 }
+/*----------------------------------------------------------------------------*/
 
 /*----------------------------------------------------------------------------*/
 void calculate_stress(job_t *job)
+{
+    calculate_bulk_granular_fluidity(job, 0, job->num_active);
+    solve_diffusion_part(job, 0, 1);
+    map_fluidity_to_particles(job, 0, job->num_active);
+    update_stress(job, 0, job->num_active);
+
+    return;
+}
+/*----------------------------------------------------------------------------*/
+
+/*----------------------------------------------------------------------------*/
+void update_stress(job_t *job, size_t p_start, size_t p_stop)
 {
     /* values from previous timestep */
     double p_t, mu_t;
@@ -151,31 +183,22 @@ void calculate_stress(job_t *job)
 
     double inertial_num;
     
-    double trD, lambda;
-
-    /* solve for g_local */
-    calculate_bulk_granular_fluidity(job);
-
-    /* build FEM diffusion array/load vector and solve for g_nonlocal */
-    solve_diffusion_part(job);
-
-    for (i = 0; i < job->num_particles; i++) {
-        if (job->active[i] == 0) {
-            continue;
-        }
+    double trD;
+    const double lambda = K - 2.0 * G / 3.0;
 
+    for (i = p_start; i < p_stop; i++) {
         /* Calculate tau and p trial values. */
-        trD = job->particles[i].exx_t + job->particles[i].eyy_t;
-        dsjxx = lambda * trD + 2.0 * G * job->particles[i].exx_t;
-        dsjxy = 2.0 * G * job->particles[i].exy_t;
-        dsjyy = lambda * trD + 2.0 * G * job->particles[i].eyy_t;
-        dsjxx += 2 * job->particles[i].wxy_t * job->particles[i].sxy;
-        dsjxy -= job->particles[i].wxy_t * (job->particles[i].sxx - job->particles[i].syy);
-        dsjyy -= 2 * job->particles[i].wxy_t * job->particles[i].sxy;
-
-        sxx_tr = job->particles[i].sxx + job->dt * dsjxx;
-        sxy_tr = job->particles[i].sxy + job->dt * dsjxy;
-        syy_tr = job->particles[i].syy + job->dt * dsjyy;
+        trD = job->particles.exx_t[i] + job->particles.eyy_t[i];
+        dsjxx = lambda * trD + 2.0 * G * job->particles.exx_t[i];
+        dsjxy = 2.0 * G * job->particles.exy_t[i];
+        dsjyy = lambda * trD + 2.0 * G * job->particles.eyy_t[i];
+        dsjxx += 2 * job->particles.wxy_t[i] * job->particles.sxy[i];
+        dsjxy -= job->particles.wxy_t[i] * (job->particles.sxx[i] - job->particles.syy[i]);
+        dsjyy -= 2 * job->particles.wxy_t[i] * job->particles.sxy[i];
+
+        sxx_tr = job->particles.sxx[i] + job->dt * dsjxx;
+        sxy_tr = job->particles.sxy[i] + job->dt * dsjxy;
+        syy_tr = job->particles.syy[i] + job->dt * dsjyy;
 
         p_tr = -0.5 * (sxx_tr + syy_tr);
         t0xx_tr = sxx_tr + p_tr;
@@ -184,9 +207,9 @@ void calculate_stress(job_t *job)
         tau_tr = sqrt(0.5*(t0xx_tr*t0xx_tr + 2*t0xy_tr*t0xy_tr + t0yy_tr*t0yy_tr));
 
 #if 0
-        if ((job->particles[i].m / job->particles[i].v) < RHO_CRITICAL) {
+        if ((job->particles.m[i] / job->particles.v[i]) < RHO_CRITICAL) {
             dense = 0;
-/*            printf("%4d: density %lf\n", i, (job->particles[i].m / job->particles[i].v));*/
+/*            printf("%4d: density %lf\n", i, (job->particles.m[i] / job->particles.v[i]));*/
         } else {
             dense = 1;
         }
@@ -194,18 +217,18 @@ void calculate_stress(job_t *job)
 
         if (dense == 0 || p_tr <= c) {
             nup_tau = 0;
-            job->particles[i].sxx = 0;
-            job->particles[i].sxy = 0;
-            job->particles[i].syy = 0;
+            job->particles.sxx[i] = 0;
+            job->particles.sxy[i] = 0;
+            job->particles.syy[i] = 0;
         } else if (p_tr > c) {
             scale_factor = p_tr / (G * job->dt * gf + p_tr);
             tau_tau = tau_tr * scale_factor;
 
             nup_tau = ((tau_tr - tau_tau) / G) / job->dt;
 
-            job->particles[i].sxx = scale_factor * t0xx_tr - p_tr;
-            job->particles[i].sxy = scale_factor * t0xy_tr;
-            job->particles[i].syy = scale_factor * t0yy_tr - p_tr;
+            job->particles.sxx[i] = scale_factor * t0xx_tr - p_tr;
+            job->particles.sxy[i] = scale_factor * t0xy_tr;
+            job->particles.syy[i] = scale_factor * t0yy_tr - p_tr;
         } else {
 /*            fprintf(stderr, "u %zu %3.3g %3.3g %d ", i, f, p_tr, density_flag);*/
             fprintf(stderr, "u"); 
@@ -235,7 +258,7 @@ double negative_root(double a, double b, double c)
 }
 
 /*----------------------------------------------------------------------------*/
-void calculate_bulk_granular_fluidity(job_t *job)
+void calculate_bulk_granular_fluidity(job_t *job, size_t p_start, size_t p_stop)
 {
     /* value at end of timestep */
     double tau_tau;
@@ -260,23 +283,19 @@ void calculate_bulk_granular_fluidity(job_t *job)
     double B, H;
     double alpha;
 
-    for (i = 0; i < job->num_particles; i++) {
-        if (job->active[i] == 0) {
-            continue;
-        }
-
+    for (i = p_start; i < p_stop; i++) {
         /* Calculate tau and p trial values. */
-        trD = job->particles[i].exx_t + job->particles[i].eyy_t;
-        dsjxx = lambda * trD + 2.0 * G * job->particles[i].exx_t;
-        dsjxy = 2.0 * G * job->particles[i].exy_t;
-        dsjyy = lambda * trD + 2.0 * G * job->particles[i].eyy_t;
-        dsjxx += 2 * job->particles[i].wxy_t * job->particles[i].sxy;
-        dsjxy -= job->particles[i].wxy_t * (job->particles[i].sxx - job->particles[i].syy);
-        dsjyy -= 2 * job->particles[i].wxy_t * job->particles[i].sxy;
-
-        sxx_tr = job->particles[i].sxx + job->dt * dsjxx;
-        sxy_tr = job->particles[i].sxy + job->dt * dsjxy;
-        syy_tr = job->particles[i].syy + job->dt * dsjyy;
+        trD = job->particles.exx_t[i] + job->particles.eyy_t[i];
+        dsjxx = lambda * trD + 2.0 * G * job->particles.exx_t[i];
+        dsjxy = 2.0 * G * job->particles.exy_t[i];
+        dsjyy = lambda * trD + 2.0 * G * job->particles.eyy_t[i];
+        dsjxx += 2 * job->particles.wxy_t[i] * job->particles.sxy[i];
+        dsjxy -= job->particles.wxy_t[i] * (job->particles.sxx[i] - job->particles.syy[i]);
+        dsjyy -= 2 * job->particles.wxy_t[i] * job->particles.sxy[i];
+
+        sxx_tr = job->particles.sxx[i] + job->dt * dsjxx;
+        sxy_tr = job->particles.sxy[i] + job->dt * dsjxy;
+        syy_tr = job->particles.syy[i] + job->dt * dsjyy;
 
         p_tr = -0.5 * (sxx_tr + syy_tr);
         t0xx_tr = sxx_tr + p_tr;
@@ -284,9 +303,9 @@ void calculate_bulk_granular_fluidity(job_t *job)
         t0yy_tr = syy_tr + p_tr;
         tau_tr = sqrt(0.5*(t0xx_tr*t0xx_tr + 2*t0xy_tr*t0xy_tr + t0yy_tr*t0yy_tr));
 
-        if ((job->particles[i].m / job->particles[i].v) < RHO_CRITICAL || p_tr < 0) {
+        if ((job->particles.m[i] / job->particles.v[i]) < RHO_CRITICAL || p_tr < 0) {
             dense = 0;
-/*            printf("%4d: density %lf\n", i, (job->particles[i].m / job->particles[i].v));*/
+/*            printf("%4d: density %lf\n", i, (job->particles.m[i] / job->particles.v[i]));*/
         } else {
             dense = 1;
         }
@@ -322,225 +341,196 @@ void calculate_bulk_granular_fluidity(job_t *job)
 /*----------------------------------------------------------------------------*/
 
 /*----------------------------------------------------------------------------*/
-void solve_diffusion_part(job_t *job)
+/* add the stiffness contribution of particle i. */
+static void add_particle(job_t *job, size_t i)
 {
-    size_t i, j;
-    size_t i_new, j_new;
     size_t ei, ej;
-    size_t gi, gj;
-    size_t sgi, sgj;
-
-    size_t *node_map;
-    size_t *inv_node_map;
-
-    size_t slda;
-    size_t nnz;
-
-    cs *triplets;
-    cs *smat;
-
-    double *gf_nodes;
-    double *m_total_nodes;
-
-    double *f;
 
     double s[4];
     double grad_s[4][2];
 
-/*    double m_frac;*/
-
     int p;
-    int *nn;
 
-    /* initialize node level fluidity arrays */
-    gf_nodes = (double *)malloc(job->num_nodes * sizeof(double));
-    for (i = 0; i < job->num_nodes; i++) {
-        gf_nodes[i] = 0;
+    if (dense == 0) {
+        return; // don't add stiffness contribution if not dense.
     }
 
-    /* get number of dofs and initialize mapping arrays */
-    node_map = (size_t *)malloc(job->num_nodes * sizeof(size_t));
-    inv_node_map = (size_t *)malloc(job->num_nodes * sizeof(size_t));
-    slda = 0;
-    for (i = 0; i < job->num_nodes; i++) {
-        node_map[i] = -1;
-        inv_node_map[i] = -1;
+    p = job->in_element[i];
+    if (p == -1) {
+        return;
     }
-    for (i = 0; i < job->num_nodes; i++) {
-        i_new = (job->node_number_override[NODAL_DOF * i + 0 ] - 0) / NODAL_DOF;
 
-        if (node_map[i_new] != -1) {
-            continue;
-        }
+    s[0] = job->h1[i];
+    s[1] = job->h2[i];
+    s[2] = job->h3[i];
+    s[3] = job->h4[i];
 
-        if (job->nodes[i_new].m > TOL) {
-            node_map[i_new] = slda;
-            inv_node_map[slda] = i_new;
-            slda++;
-        }
-    }
+    grad_s[0][0] = job->b11[i];
+    grad_s[1][0] = job->b12[i];
+    grad_s[2][0] = job->b13[i];
+    grad_s[3][0] = job->b14[i];
 
-    if (slda == 0) {
-        fprintf(stderr, "%s:%s: Invalid size, slda = %zu.\n",
-            __FILE__, __func__, slda);
-        exit(-1);
-    }
+    grad_s[0][1] = job->b21[i];
+    grad_s[1][1] = job->b22[i];
+    grad_s[2][1] = job->b23[i];
+    grad_s[3][1] = job->b24[i];
 
-    m_total_nodes = (double *)malloc(slda * sizeof(double));
-    f = (double *)malloc(slda * sizeof(double));
-    for (i = 0; i < slda; i++) {
-        m_total_nodes[i] = 0;
-        f[i] = 0;
-    }
+    assert(isfinite(xisq_inv));
 
-    /*  calculate number of nonzero elements (before summing duplicates). */
-    nnz = 0;
-    for (i = 0; i < job->num_particles; i++) {
-        if (dense) {
-            nnz += (NODES_PER_ELEMENT * NODES_PER_ELEMENT) * 1;
-        }
-    }
-    nnz += slda;
-    /*
-    for (i = 0; i < job->num_elements; i++) {
-        if (job->elements[i].filled != 0) {
-            nnz += (NODES_PER_ELEMENT * NODES_PER_ELEMENT) * 1;
+    /* create stiffness matrix. */
+    for (ei = 0; ei < NODES_PER_ELEMENT; ei++) {
+        for (ej = 0; ej < NODES_PER_ELEMENT; ej++) {
+            nonlocal_ws_add(&ws, p, ei, ej,
+                job->particles.v[i] * (xisq_inv * s[ei] * s[ej] +
+                    (grad_s[ei][0]*grad_s[ej][0] + grad_s[ei][1]*grad_s[ej][1]))
+            );
         }
     }
-    */
 
-    /* slda contains degrees of freedom of new matrix */
-    triplets = cs_spalloc(slda, slda, nnz, 1, 1);
-/*    fprintf(stderr, "%s:%s: slda = %zu, nnz = %zu.\n",*/
-/*        __FILE__, __func__, slda, nnz);*/
-
-    /* project xi and g_local onto background grid (volume-weighted) */
-    for (i = 0; i < job->num_particles; i++) {
-        if (job->active[i] == 0) {
-            continue;
-        }
-
-        if (dense == 0) {
-            continue; // don't add stiffness contribution if not dense.
-        }
+    return;
+}
+/*----------------------------------------------------------------------------*/
 
-        p = job->in_element[i];
-        if (p == -1) {
-            continue;
-        }
+/*----------------------------------------------------------------------------*/
+void solve_diffusion_part(job_t *job, size_t thread_id, size_t num_threads)
+{
+    size_t i;
+    size_t i_new;
+    size_t c, k, tc_idx;
+    size_t n_start, n_stop;
+    size_t ei;
+    size_t gi;
+    size_t sgi;
 
-        s[0] = job->h1[i];
-        s[1] = job->h2[i];
-        s[2] = job->h3[i];
-        s[3] = job->h4[i];
+    double s[4];
 
-        nn = job->elements[p].nodes;
+    int p;
+    int *nn;
 
-        assert(isfinite(gf_local));
-        assert(isfinite(xisq_inv));
-        
-        for (ei = 0; ei < NODES_PER_ELEMENT; ei++) {
-            gi = nn[ei];
-            gi = (job->node_number_override[NODAL_DOF * gi + 0 ] - 0) / NODAL_DOF;
-            sgi = node_map[gi];
-            
-            assert(sgi != -1);
+    if (nonlocal_sync_threads(job, num_threads)) {
+        /* get number of dofs and map nodes to them */
+        nonlocal_ws_begin(&ws, job, TOL);
 
-            m_total_nodes[sgi] += job->particles[i].m * s[ei];
-            f[sgi] += (job->particles[i].v) * gf_local * xisq_inv * s[ei];
-        }
-    }
-    
-    /* create stiffness matrix. */
-    for (i = 0; i < job->num_particles; i++) {
-        if (job->active[i] == 0) {
-            continue;
-        }
-        
-        if (dense == 0) {
-            continue; // don't add stiffness contribution if not dense.
-        }
+        /* project xi and g_local onto background grid (volume-weighted) */
+        for (i = 0; i < job->num_active; i++) {
+            p = job->in_element[i];
+            if (dense == 0 || p == -1) {
+                continue;
+            }
 
-        p = job->in_element[i];
-        if (p == -1) {
-            continue;
-        }
+            nonlocal_ws_use_element(&ws, p);
+            assert(isfinite(gf_local));
+            if (gf_local * xisq_inv == 0) {
+                continue;
+            }
+            nonlocal_ws_mark_source(&ws, p);
 
-        s[0] = job->h1[i];
-        s[1] = job->h2[i];
-        s[2] = job->h3[i];
-        s[3] = job->h4[i];
+            s[0] = job->h1[i];
+            s[1] = job->h2[i];
+            s[2] = job->h3[i];
+            s[3] = job->h4[i];
 
-        grad_s[0][0] = job->b11[i];
-        grad_s[1][0] = job->b12[i];
-        grad_s[2][0] = job->b13[i];
-        grad_s[3][0] = job->b14[i];
+            nn = job->elements[p].nodes;
+            for (ei = 0; ei < NODES_PER_ELEMENT; ei++) {
+                gi = nn[ei];
+                gi = (job->node_number_override[NODAL_DOF * gi + 0 ] - 0) / NODAL_DOF;
+                sgi = ws.node_map[gi];
 
-        grad_s[0][1] = job->b21[i];
-        grad_s[1][1] = job->b22[i];
-        grad_s[2][1] = job->b23[i];
-        grad_s[3][1] = job->b24[i];
+                ws.f[sgi] += (job->particles.v[i]) * gf_local * xisq_inv * s[ei];
+            }
+        }
 
-        nn = job->elements[p].nodes;
+        /* only the support of the particles above yield is solved for. */
+        if (nonlocal_ws_solve_due(&ws, job)) {
+            if (nonlocal_ws_pattern(&ws, job) != 0) {
+                fprintf(stderr, "%s:%s: Unable to build sparsity pattern.\n",
+                    __FILE__, __func__);
+                exit(-1);
+            }
 
-        for (ei = 0; ei < NODES_PER_ELEMENT; ei++) {
-            for (ej = 0; ej < NODES_PER_ELEMENT; ej++) {
-                gi = nn[ei];
-                gj = nn[ej];
-
-                gi = (job->node_number_override[NODAL_DOF * gi + 0] - 0) / NODAL_DOF;
-                gj = (job->node_number_override[NODAL_DOF * gj + 0] - 0) / NODAL_DOF;
-
-                sgi = node_map[gi];
-                sgj = node_map[gj];
-                
-                cs_entry(triplets, sgi, sgj,
-                    job->particles[i].v * (xisq_inv * s[ei] * s[ej] + 
-                        (grad_s[ei][0]*grad_s[ej][0] + grad_s[ei][1]*grad_s[ej][1]))
-                );
+            if (ws.slda != 0) {
+                nonlocal_ws_add_diagonal(&ws, 1e-10);
             }
         }
     }
+    nonlocal_sync_threads(job, num_threads);
 
-    for (i = 0; i < slda; i++) {
-        cs_entry(triplets, i, i, 1e-10);
+    /* between solves the nodal fluidity of the last one is kept. */
+    if (!ws.due) {
+        return;
     }
 
-    /* create compressed sparse matrix */
-    smat = cs_compress(triplets);
-    cs_dupl(smat);
+    /* no dofs left when nothing is above yield, the fluidity is zero. */
+    if (ws.slda == 0) {
+        goto _map_nodes;
+    }
 
-    if (!cs_lusol(1, smat, f, 1e-12)) {
-        fprintf(stderr, "lusol error!\n");
-        if (cs_qrsol(1, smat, f)) {
-            fprintf(stderr, "qrsol error!\n");
-            exit(EXIT_ERROR_CS_SOL);
+    /*
+        Elements of one color share no nodes and each element's particles
+        are in a single (thread, color) list, so the threads can assemble a
+        color at a time like the particle to grid map.
+    */
+    if (num_threads == 1) {
+        for (i = 0; i < job->num_active; i++) {
+            add_particle(job, i);
+        }
+    } else {
+        for (c = 0; c < job->num_colors; c++) {
+            tc_idx = thread_id * job->num_colors + c;
+            for (k = job->particle_by_element_color_offsets[tc_idx];
+                k < job->particle_by_element_color_offsets[tc_idx + 1]; k++) {
+                add_particle(job, job->particle_by_element_color_list[k]);
+            }
+            nonlocal_sync_threads(job, num_threads);
         }
     }
 
-    for (i = 0; i < job->num_nodes; i++) {
+    if (nonlocal_ws_solve_threaded(&ws, job, thread_id, num_threads) != 0) {
+        exit(EXIT_ERROR_CS_SOL);
+    }
+
+_map_nodes:
+    n_start = (thread_id * job->num_nodes) / num_threads;
+    n_stop = ((thread_id + 1) * job->num_nodes) / num_threads;
+
+    for (i = n_start; i < n_stop; i++) {
         i_new = (job->node_number_override[NODAL_DOF * i + 0] - 0) / NODAL_DOF;
 
-        if (node_map[i_new] != -1) {
-            gf_nodes[i] = f[node_map[i_new]];
+        if (ws.node_map[i_new] != NONLOCAL_UNMAPPED) {
+            ws.gf_nodes[i] = ws.f[ws.node_map[i_new]];
+        } else {
+            ws.gf_nodes[i] = 0;
         }
     }
+    nonlocal_sync_threads(job, num_threads);
 
     /* ensure periodic BCs ok */
-    for (i = 0; i < job->num_nodes; i++) {
+    for (i = n_start; i < n_stop; i++) {
         i_new = (job->node_number_override[NODAL_DOF * i + 0] - 0) / NODAL_DOF;
 
         if (i != i_new) {
-            assert(gf_nodes[i] == gf_nodes[i_new]);
+            assert(ws.gf_nodes[i] == ws.gf_nodes[i_new]);
         }
     }
 
-    /* map nodal g_nonlocal back to particles */
-    for (i = 0; i < job->num_particles; i++) {
-        if (job->active[i] == 0) {
-            continue;
-        }
+    return;
+}
+/*----------------------------------------------------------------------------*/
+
+/*----------------------------------------------------------------------------*/
+/* map nodal g_nonlocal back to particles */
+void map_fluidity_to_particles(job_t *job, size_t p_start, size_t p_stop)
+{
+    size_t i;
+    size_t ei;
+    size_t gi;
+
+    double s[4];
 
+    int p;
+    int *nn;
+
+    for (i = p_start; i < p_stop; i++) {
         p = job->in_element[i];
         if (p == -1) {
             continue;
@@ -557,25 +547,12 @@ void solve_diffusion_part(job_t *job)
         for (ei = 0; ei < NODES_PER_ELEMENT; ei++) {
             gi = nn[ei];
             gi = (job->node_number_override[NODAL_DOF * gi + 0] - 0) / NODAL_DOF;
-            sgi = node_map[gi];
 
-            gf += gf_nodes[gi] * s[ei];
+            gf += ws.gf_nodes[gi] * s[ei];
         }
     }
 
-    cs_spfree(triplets);
-    cs_spfree(smat);
-
-    free(node_map);
-    free(inv_node_map);
-
-    free(gf_nodes);
-
-    free(m_total_nodes);
-    free(f);
-
     return;
 }
 /*----------------------------------------------------------------------------*/
 
-
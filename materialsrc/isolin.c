@@ -13,6 +13,7 @@
 #include "particle.h"
 #include "node.h"
 #include "process.h"
+#include "process_usl.h"
 #include "material.h"
 
 #include "exitcodes.h"
@@ -26,6 +27,7 @@ double lambda;
 void material_init(job_t *job);
 void calculate_stress_threaded(threadtask_t *task);
 void calculate_stress(job_t *job);
+void calculate_stress_batch(material_batch_t *b);
 
 /*----------------------------------------------------------------------------*/
 void material_init(job_t *job)
@@ -34,7 +36,7 @@ void material_init(job_t *job)
 
     for (i = 0; i < job->num_particles; i++) {
         for (j = 0; j < DEPVAR; j++) {
-            job->particles[i].state[j] = 0;
+            job->particles.state[i][j] = 0;
         }
     }
 
@@ -65,7 +67,7 @@ void calculate_stress(job_t *job)
     threadtask_t t;
     t.job = job;
     t.offset = 0;
-    t.blocksize = job->num_particles;
+    t.blocksize = job->num_active;
     calculate_stress_threaded(&t);
     return;
 }
@@ -74,42 +76,45 @@ void calculate_stress(job_t *job)
 /*----------------------------------------------------------------------------*/
 void calculate_stress_threaded(threadtask_t *task)
 {
-    job_t *job = task->job;
+    material_batch_t b;
 
     /* Since this is local, we can split the particles among the threads. */
-    size_t p_start = task->offset;
-    size_t p_stop = task->offset + task->blocksize;
+    material_batch_range(task->job, &b, task->offset,
+        task->offset + task->blocksize);
+    calculate_stress_batch(&b);
 
+    return;
+}
+/*----------------------------------------------------------------------------*/
+
+/*----------------------------------------------------------------------------*/
+void calculate_stress_batch(material_batch_t *b)
+{
     double dsjxx;
     double dsjxy;
     double dsjyy;
-    double evoldot;
     double trD;
     size_t i;
 
-    for (i = p_start; i < p_stop; i++) {
-        if (job->active[i] == 0) {
-            continue;
-        }
-
-        trD = job->particles[i].exx_t + job->particles[i].eyy_t;
-        dsjxx = lambda * trD + 2.0 * G * job->particles[i].exx_t;
-        dsjxy = 2.0 * G * job->particles[i].exy_t;
-        dsjyy = lambda * trD + 2.0 * G * job->particles[i].eyy_t;
+    for (i = 0; i < b->n; i++) {
+        trD = b->exx_t[i] + b->eyy_t[i];
+        dsjxx = lambda * trD + 2.0 * G * b->exx_t[i];
+        dsjxy = 2.0 * G * b->exy_t[i];
+        dsjyy = lambda * trD + 2.0 * G * b->eyy_t[i];
 
-        dsjxx += 2 * job->particles[i].wxy_t * job->particles[i].sxy;
-        dsjxy -= job->particles[i].wxy_t * (job->particles[i].sxx - job->particles[i].syy);
-        dsjyy -= 2 * job->particles[i].wxy_t * job->particles[i].sxy;
+        dsjxx += 2 * b->wxy_t[i] * b->sxy[i];
+        dsjxy -= b->wxy_t[i] * (b->sxx[i] - b->syy[i]);
+        dsjyy -= 2 * b->wxy_t[i] * b->sxy[i];
 
 /*
-        evoldot = (job->particles[i].exx_t + job->particles[i].eyy_t);
+        evoldot = (b->exx_t[i] + b->eyy_t[i]);
         dsjxx += 1e-4 * K * evoldot;
         dsjyy += 1e-4 * K * evoldot;
 */
 
-        job->particles[i].sxx += job->dt * dsjxx;
-        job->particles[i].sxy += job->dt * dsjxy;
-        job->particles[i].syy += job->dt * dsjyy;
+        b->sxx[i] += b->dt * dsjxx;
+        b->sxy[i] += b->dt * dsjxy;
+        b->syy[i] += b->dt * dsjyy;
     }
 
     return;
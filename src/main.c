@@ -141,6 +141,68 @@ int set_solver_type(cfg_t *cfg, cfg_opt_t *opt, const char *value, void *result)
 }
 /*----------------------------------------------------------------------------*/
 
+/*----------------------------------------------------------------------------*/
+int set_p2g_engine(cfg_t *cfg, cfg_opt_t *opt, const char *value, void *result)
+{
+    if (strcmp(value, "colored") == 0) {
+        *(enum p2g_engine_e *)result = P2G_COLORED;
+    } else if (strcmp(value, "banded") == 0) {
+        *(enum p2g_engine_e *)result = P2G_BANDED;
+    } else {
+        cfg_error(cfg, "Invalid value for option '%s': %s", opt->name, value);
+        return -1;
+    }
+    return 0;
+}
+/*----------------------------------------------------------------------------*/
+
+/*----------------------------------------------------------------------------*/
+int set_g2p_engine(cfg_t *cfg, cfg_opt_t *opt, const char *value, void *result)
+{
+    if (strcmp(value, "split") == 0) {
+        *(enum g2p_engine_e *)result = G2P_SPLIT;
+    } else if (strcmp(value, "fused") == 0) {
+        *(enum g2p_engine_e *)result = G2P_FUSED;
+    } else {
+        cfg_error(cfg, "Invalid value for option '%s': %s", opt->name, value);
+        return -1;
+    }
+    return 0;
+}
+/*----------------------------------------------------------------------------*/
+
+/*----------------------------------------------------------------------------*/
+int set_nonlocal_solver(cfg_t *cfg, cfg_opt_t *opt, const char *value, void *result)
+{
+    if (strcmp(value, "lu") == 0) {
+        *(enum nonlocal_solver_e *)result = NONLOCAL_SOLVER_LU;
+    } else if (strcmp(value, "pcg") == 0) {
+        *(enum nonlocal_solver_e *)result = NONLOCAL_SOLVER_PCG;
+    } else {
+        cfg_error(cfg, "Invalid value for option '%s': %s", opt->name, value);
+        return -1;
+    }
+    return 0;
+}
+/*----------------------------------------------------------------------------*/
+
+/*----------------------------------------------------------------------------*/
+int set_nonlocal_preconditioner(cfg_t *cfg, cfg_opt_t *opt, const char *value, void *result)
+{
+    if (strcmp(value, "jacobi") == 0) {
+        *(enum nonlocal_precond_e *)result = NONLOCAL_PRECOND_JACOBI;
+    } else if (strcmp(value, "ic0") == 0) {
+        *(enum nonlocal_precond_e *)result = NONLOCAL_PRECOND_IC0;
+    } else if (strcmp(value, "mg") == 0) {
+        *(enum nonlocal_precond_e *)result = NONLOCAL_PRECOND_MG;
+    } else {
+        cfg_error(cfg, "Invalid value for option '%s': %s", opt->name, value);
+        return -1;
+    }
+    return 0;
+}
+/*----------------------------------------------------------------------------*/
+
 /*----------------------------------------------------------------------------*/
 void usage(char *program_name)
 {
@@ -179,6 +241,8 @@ int main(int argc, char **argv)
     cfg_opt_t solver_opts[] =
     {
         CFG_INT_CB("solver-type", IMPLICIT_SOLVER, CFGF_NONE, &set_solver_type),
+        CFG_INT_CB("p2g-engine", P2G_COLORED, CFGF_NONE, &set_p2g_engine),
+        CFG_INT_CB("g2p-engine", G2P_SPLIT, CFGF_NONE, &set_g2p_engine),
         CFG_END()
     };
     cfg_opt_t implicit_opts[] =
@@ -191,6 +255,8 @@ int main(int argc, char **argv)
     };
     cfg_opt_t explicit_opts[] =
     {
+        CFG_INT("reorder-interval", 0, CFGF_NONE),
+        CFG_INT("particle-grain", 1024, CFGF_NONE),
         CFG_END()
     };
     cfg_opt_t output_opts[] =
@@ -210,6 +276,10 @@ int main(int argc, char **argv)
         CFG_INT("trap-terminate-interrupt", 1, CFGF_NONE),
         CFG_INT("save-state-on-terminate", 1, CFGF_NONE),
         CFG_STR("log-file", "job.log", CFGF_NONE),
+        CFG_INT("retire-inactive", 0, CFGF_NONE),
+        CFG_STR("retired-file", "retired_particles.txt", CFGF_NONE),
+        CFG_INT("profile", 0, CFGF_NONE),
+        CFG_INT("profile-per-frame", 0, CFGF_NONE),
         CFG_INT("log-level", 1, CFGF_NONE),
         CFG_FLOAT("sample-rate", DEFAULT_SAMPLE_HZ, CFGF_NONE),
         CFG_END()
@@ -226,6 +296,14 @@ int main(int argc, char **argv)
         CFG_INT("use-builtin", 1, CFGF_NONE),
         CFG_FLOAT_LIST("properties", "{}", CFGF_NONE),
         CFG_INT_LIST("integer-properties", "{}", CFGF_NONE),
+        CFG_INT_CB("nonlocal-solver", NONLOCAL_SOLVER_LU, CFGF_NONE, &set_nonlocal_solver),
+        CFG_INT_CB("nonlocal-preconditioner", NONLOCAL_PRECOND_IC0, CFGF_NONE, &set_nonlocal_preconditioner),
+        CFG_FLOAT("nonlocal-tolerance", 1e-8, CFGF_NONE),
+        CFG_INT("nonlocal-max-iterations", 1000, CFGF_NONE),
+        CFG_FLOAT("nonlocal-support-radius", 0, CFGF_NONE),
+        CFG_INT("nonlocal-solve-interval", 1, CFGF_NONE),
+        CFG_FLOAT("nonlocal-solve-tolerance", 0, CFGF_NONE),
+        CFG_INT("nonlocal-log-iterations", 0, CFGF_NONE),
         CFG_END()
     };
     cfg_opt_t boundary_opts[] =
@@ -253,6 +331,7 @@ int main(int argc, char **argv)
     cfg_t *cfg_solver = NULL;
     cfg_t *cfg_timestep = NULL;
     cfg_t *cfg_implicit = NULL;
+    cfg_t *cfg_explicit = NULL;
     cfg_t *cfg_output = NULL;
     cfg_t *cfg_input = NULL;
     cfg_t *cfg_material = NULL;
@@ -265,12 +344,35 @@ int main(int argc, char **argv)
         "N/A"
     };
 
+    const char *p2g_engine_names[] = {
+        "Colored element lists",
+        "Banded element rows",
+        "N/A"
+    };
+
+    const char *g2p_engine_names[] = {
+        "Split passes",
+        "Fused pass",
+        "N/A"
+    };
+
+    const char *nonlocal_solver_names[] = {
+        "Sparse LU",
+        "Preconditioned CG",
+        "N/A"
+    };
+
+    const char *nonlocal_preconditioner_names[] = {
+        "Jacobi",
+        "IC(0)",
+        "Geometric multigrid V-cycle",
+        "N/A"
+    };
+
     size_t num_threads = 1;
     char *s;
     char *s_dlerror;
 
-    double h;
-    int N;
     int j;
     int len;
     double t_stop;
@@ -296,6 +398,7 @@ int main(int argc, char **argv)
     pthread_t *threads = NULL;
 
     size_t psplit, nsplit, esplit;
+    size_t particle_grain = 0;
 
     /* set default command line state */
     g_state.outputdir = NULL;
@@ -407,16 +510,19 @@ int main(int argc, char **argv)
         t_stop = 1;
     }
 
-    N = g.N;
-    h = g.len / (N-1);
+    printf("Grid parameters: Nx = %d, Ny = %d, h = %g, origin = (%g, %g).\n",
+        g.Nx, g.Ny, g.lx / (g.Nx - 1), g.x0, g.y0);
 
-    printf("Grid parameters: N = %d, h = %g.\n", N, h);
+    job = mpm_init(g.Nx, g.Ny, g.x0, g.y0, g.lx, g.ly, pdata, plen, t_stop);
+    JUMP_IF_NULL(job, _fatal_error, "Error initializing job.\n");
 
-    job = mpm_init(N, h, pdata, plen, t_stop);
+    /* particle data has been copied into the job's particle store. */
+    FREE_AND_NULL(pdata);
 
     /* section for material options */
     cfg_material = cfg_getsec(cfg, "material");
     job->material.calculate_stress_threaded = NULL;
+    job->material.calculate_stress_batch = NULL;
     if (g_state.materialso != NULL) {
         job->material.use_builtin = 0;
         job->material.material_filename = g_state.materialso;
@@ -453,6 +559,13 @@ int main(int argc, char **argv)
                 s_dlerror);
             exit(EXIT_ERROR_MATERIAL_FILE);
         }
+
+        /* optional, used instead of calculate_stress_threaded if present. */
+        *(void **)(&(job->material.calculate_stress_batch)) =
+            dlsym(material_so_handle, "calculate_stress_batch");
+        if (dlerror() != NULL) {
+            job->material.calculate_stress_batch = NULL;
+        }
     }
 
     job->material.num_fp64_props = cfg_size(cfg_material, "properties");
@@ -469,6 +582,8 @@ int main(int argc, char **argv)
     fprintf(stderr, "\nMaterial options set:\n");
     fprintf(stderr, "material_filename: %s\n", (job->material.use_builtin)?"builtin":job->material.material_filename);
     fprintf(stderr, "use_builtin: %d\n", job->material.use_builtin);
+    fprintf(stderr, "calculate_stress_batch: %s\n",
+        (job->material.calculate_stress_batch != NULL) ? "yes" : "no");
     fprintf(stderr, "num_fp64_props: %zu\n", job->material.num_fp64_props);
     fprintf(stderr, "num_int_props: %zu\n", job->material.num_int_props);
 
@@ -483,6 +598,29 @@ int main(int argc, char **argv)
     }
     fprintf(stderr, "}\n");
 
+    job->material.nonlocal.solver = cfg_getint(cfg_material, "nonlocal-solver");
+    job->material.nonlocal.preconditioner = cfg_getint(cfg_material, "nonlocal-preconditioner");
+    job->material.nonlocal.tolerance = cfg_getfloat(cfg_material, "nonlocal-tolerance");
+    job->material.nonlocal.max_iterations = cfg_getint(cfg_material, "nonlocal-max-iterations");
+    job->material.nonlocal.support_radius = cfg_getfloat(cfg_material, "nonlocal-support-radius");
+    job->material.nonlocal.solve_interval = cfg_getint(cfg_material, "nonlocal-solve-interval");
+    job->material.nonlocal.solve_tolerance = cfg_getfloat(cfg_material, "nonlocal-solve-tolerance");
+    job->material.nonlocal.log_iterations = cfg_getint(cfg_material, "nonlocal-log-iterations");
+    fprintf(stderr, "nonlocal_solver: %d (%s)\n", job->material.nonlocal.solver,
+        nonlocal_solver_names[(int)job->material.nonlocal.solver]);
+    fprintf(stderr, "nonlocal_support_radius: %g\n", job->material.nonlocal.support_radius);
+    fprintf(stderr, "nonlocal_solve_interval: %d (tolerance %g)\n",
+        job->material.nonlocal.solve_interval,
+        job->material.nonlocal.solve_tolerance);
+    if (job->material.nonlocal.solver == NONLOCAL_SOLVER_PCG) {
+        fprintf(stderr, "nonlocal_preconditioner: %d (%s)\n",
+            job->material.nonlocal.preconditioner,
+            nonlocal_preconditioner_names[(int)job->material.nonlocal.preconditioner]);
+        fprintf(stderr, "nonlocal_tolerance: %g\n", job->material.nonlocal.tolerance);
+        fprintf(stderr, "nonlocal_max_iterations: %d\n", job->material.nonlocal.max_iterations);
+        fprintf(stderr, "nonlocal_log_iterations: %d\n", job->material.nonlocal.log_iterations);
+    }
+
     /* section for boundary condition options */
     cfg_boundary = cfg_getsec(cfg, "boundary-conditions");
     job->boundary.bc_init = NULL;
@@ -490,6 +628,8 @@ int main(int argc, char **argv)
     job->boundary.bc_time_varying = NULL;
     job->boundary.bc_momentum = NULL;
     job->boundary.bc_force = NULL;
+    job->boundary.bc_momentum_threaded = NULL;
+    job->boundary.bc_force_threaded = NULL;
     if (g_state.bcso != NULL) {
         job->boundary.use_builtin = 0;
         job->boundary.bc_filename = g_state.bcso;
@@ -540,6 +680,21 @@ int main(int argc, char **argv)
                 s_dlerror);
             goto _fatal_error;
         }
+
+        /* optional, the serial versions are used if either is missing. */
+        *(void **)(&(job->boundary.bc_momentum_threaded)) =
+            dlsym(bc_so_handle, "bc_momentum_threaded");
+        *(void **)(&(job->boundary.bc_force_threaded)) =
+            dlsym(bc_so_handle, "bc_force_threaded");
+        dlerror();
+        if (job->boundary.bc_momentum_threaded == NULL
+            || job->boundary.bc_force_threaded == NULL) {
+            fprintf(stderr, "No threaded boundary conditions in '%s', "
+                "using serial bc_momentum and bc_force.\n",
+                job->boundary.bc_filename);
+            job->boundary.bc_momentum_threaded = NULL;
+            job->boundary.bc_force_threaded = NULL;
+        }
     }
 
     if (job->boundary.bc_init == NULL) {
@@ -592,6 +747,14 @@ int main(int argc, char **argv)
         exit(-1);
     }
 
+    job->p2g_engine = cfg_getint(cfg_solver, "p2g-engine");
+    fprintf(stderr, "p2g_engine: %d (%s)\n",
+        job->p2g_engine, p2g_engine_names[(int)job->p2g_engine]);
+
+    job->g2p_engine = cfg_getint(cfg_solver, "g2p-engine");
+    fprintf(stderr, "g2p_engine: %d (%s)\n",
+        job->g2p_engine, g2p_engine_names[(int)job->g2p_engine]);
+
     /* section for timestep */
     cfg_timestep = cfg_getsec(cfg, "timestep");
 
@@ -637,6 +800,34 @@ int main(int argc, char **argv)
         fprintf(stderr, "q_norm_ratio: %e\n", job->implicit.q_norm_ratio);
         fprintf(stderr, "du_norm_converged: %e\n", job->implicit.du_norm_converged);
         fprintf(stderr, "unstable_iteration_count: %d\n", job->implicit.unstable_iteration_count);
+
+        /* held stress/state is only needed by the implicit solver. */
+        JUMP_IF(particle_store_alloc_implicit(&(job->particles)) != 0,
+            _fatal_error, "Error allocating implicit particle storage.\n");
+        JUMP_IF(element_implicit_alloc(job) != 0,
+            _fatal_error, "Error allocating implicit element storage.\n");
+    }
+
+    /* section for explicit solver */
+    if (job->solver != IMPLICIT_SOLVER) {
+        cfg_explicit = cfg_getsec(cfg, "explicit");
+
+        job->reorder_interval = cfg_getint(cfg_explicit, "reorder-interval");
+        if (job->reorder_interval < 0) {
+            job->reorder_interval = 0;
+        }
+
+        /* sort particles when the element lists are first built. */
+        job->steps_since_reorder = job->reorder_interval;
+
+        fprintf(stderr, "\nExplicit options set:\n");
+        fprintf(stderr, "reorder_interval: %d\n", job->reorder_interval);
+
+        /* 0 splits particles statically between threads. */
+        if (cfg_getint(cfg_explicit, "particle-grain") > 0) {
+            particle_grain = cfg_getint(cfg_explicit, "particle-grain");
+        }
+        fprintf(stderr, "particle_grain: %zu\n", particle_grain);
     }
 
     /* section for output */
@@ -656,6 +847,10 @@ int main(int argc, char **argv)
     job->output.element_filename = cfg_getstr(cfg_output, "element-file");
     job->output.state_filename = cfg_getstr(cfg_output, "state-file");
     job->output.log_filename = cfg_getstr(cfg_output, "log-file");
+    job->output.retire_inactive = cfg_getint(cfg_output, "retire-inactive");
+    job->output.retired_filename = cfg_getstr(cfg_output, "retired-file");
+    job->output.profile = cfg_getint(cfg_output, "profile");
+    job->output.profile_per_frame = cfg_getint(cfg_output, "profile-per-frame");
 
     /*
         Modify the output directory to add a trailing slash if it doesn't
@@ -687,6 +882,10 @@ int main(int argc, char **argv)
     job->output.log_filename_fullpath = (char *)malloc(len);
     snprintf(job->output.log_filename_fullpath, len, "%s%s",
         job->output.directory, job->output.log_filename);
+    len = strlen(job->output.directory) + strlen(job->output.retired_filename) + 1;
+    job->output.retired_filename_fullpath = (char *)malloc(len);
+    snprintf(job->output.retired_filename_fullpath, len, "%s%s",
+        job->output.directory, job->output.retired_filename);
 
     char ss[16384];
     snprintf(ss, sizeof(ss), "%s%s", job->output.directory, "info.txt");
@@ -697,6 +896,8 @@ int main(int argc, char **argv)
     job->output.element_fd = NULL;
     job->output.state_fd = NULL;
     job->output.log_fd = NULL;
+    job->output.retired_fd = NULL;
+    job->output.profile_fd = NULL;
 
     job->output.info_fd = fopen(ss, "w");
         JUMP_IF_NULL(job->output.info_fd, _close_files,
@@ -714,6 +915,25 @@ int main(int argc, char **argv)
         JUMP_IF_NULL(job->output.particle_fd, _close_files,
             "Can't open log file for output.\n");
 
+    /*
+        Particles that are already off the grid are retired on the first step,
+        so start the mark past every particle.
+    */
+    job->output.retired_mark = job->num_particles;
+    if (job->output.retire_inactive) {
+        job->output.retired_fd = fopen(job->output.retired_filename_fullpath, "w");
+            JUMP_IF_NULL(job->output.retired_fd, _close_files,
+                "Can't open retired particle file for output.\n");
+    }
+
+    if (job->output.profile && job->output.profile_per_frame) {
+        snprintf(ss, sizeof(ss), "%s%s", job->output.directory,
+            "profile_frames.csv");
+        job->output.profile_fd = fopen(ss, "w");
+            JUMP_IF_NULL(job->output.profile_fd, _close_files,
+                "Can't open per frame profile file for output.\n");
+    }
+
     /* sampling rate */
     job->output.sample_rate_hz = cfg_getfloat(cfg_output, "sample-rate");
     if (job->output.sample_rate_hz < 0) {
@@ -735,6 +955,10 @@ int main(int argc, char **argv)
         job->output.state_filename_fullpath);
     fprintf(stderr, "log_filename_fullpath: %s\n",
         job->output.log_filename_fullpath);
+    if (job->output.retire_inactive) {
+        fprintf(stderr, "retired_filename_fullpath: %s\n",
+            job->output.retired_filename_fullpath);
+    }
 
     fprintf(stderr, "sample_rate_hz: %5.4f\n", job->output.sample_rate_hz);
 /*    exit(0);*/
@@ -742,7 +966,8 @@ int main(int argc, char **argv)
     job->dt = job->timestep.dt;
 job_start:
     fprintf(stderr, "\nRunning Simulation to %g seconds.\n", job->t_stop);
-    fprintf(stderr, "Grid size is (%zu, %zu); spacing is %g.\n", job->N, job->N, job->h);
+    fprintf(stderr, "Grid size is (%zu, %zu); spacing is %g.\n", job->Nx, job->Ny, job->h);
+    report_element_storage(job, stderr);
 
     tasks = (threadtask_t *)malloc(sizeof(threadtask_t) * num_threads);
     job->step_barrier = (pthread_barrier_t *)malloc(sizeof(pthread_barrier_t));
@@ -786,6 +1011,17 @@ job_start:
         exit(EXIT_ERROR_THREADING);
     }
 
+    JUMP_IF(particle_sched_init(&(job->sched), job->num_active,
+        job->num_threads, particle_grain) != 0,
+        _fatal_error, "Error creating particle scheduler.\n");
+
+    JUMP_IF(prof_init(&(job->profile), job->num_threads, job->num_colors,
+        job->output.profile, job->output.profile_per_frame) != 0,
+        _fatal_error, "Error creating step profiler.\n");
+    if (job->output.profile_fd != NULL) {
+        prof_write_frame_header(&(job->profile), job->output.profile_fd);
+    }
+
     /* create element color lists on first step. */
     job->update_elementlists = (int *)malloc(sizeof(int) * job->num_threads);
     for (size_t i = 0; i < job->num_threads; i++) {
@@ -793,26 +1029,33 @@ job_start:
     }
 
     /* Create structure to sort particle ids for easier parallel mapping. */
-/*    job->particle_by_element_color_offsets = (size_t *)malloc(sizeof(size_t) * job->num_colors * job->num_threads);*/
-/*    job->particle_by_element_color_lengths = (size_t *)malloc(sizeof(size_t) * job->num_colors * job->num_threads);*/
-/*    job->particle_by_element_color_list = (size_t *)malloc(sizeof(size_t) * job->num_particles);*/
-
-    job->particle_by_element_color_lengths = (size_t *)malloc(sizeof(size_t) * job->num_colors * job->num_threads);
-    job->particle_by_element_color_lists = (size_t **)malloc(sizeof(size_t *) * job->num_colors * job->num_threads);
-    for (size_t i = 0; i < (job->num_colors * job->num_threads); i++) {
-        job->particle_by_element_color_lists[i] = (size_t *)malloc(sizeof(size_t) * job->num_particles);
+    job->particle_by_element_color_offsets = (size_t *)malloc(sizeof(size_t) * (job->num_colors * job->num_threads + 1));
+    job->particle_by_element_color_list = (size_t *)malloc(sizeof(size_t) * job->num_particles);
+
+    /* Per thread counts used when the lists are rebuilt in parallel. */
+    job->element_color_counts = (size_t *)malloc(sizeof(size_t) * job->num_colors * job->num_threads);
+    job->particle_color_counts = (size_t *)malloc(sizeof(size_t) * job->num_colors * job->num_threads * job->num_threads);
+
+    /* Element buckets and row split for the banded particle to grid map. */
+    if (job->p2g_engine == P2G_BANDED) {
+        job->element_particle_offsets = (size_t *)malloc(sizeof(size_t) * (job->num_elements + 1));
+        job->element_particle_list = (size_t *)malloc(sizeof(size_t) * job->num_particles);
+        job->p2g_row_bounds = (size_t *)malloc(sizeof(size_t) * (job->num_threads + 1));
     }
 
     /* Actually find filled elements for creating parallel list. */
-    for (size_t i = 0; i < job->num_elements; i++) {
-        job->elements[i].filled = 0;
-        job->elements[i].n = 0;
-        job->elements[i].m = 0;
+    for (size_t i = 0; i < job->num_threads; i++) {
+        clear_grid_tiles_split(job, i);
     }
     find_filled_elements(job);
 
     initial_loads(job);
+    job->material.init_error = 0;
     (*(job->material.material_init))(job);
+    if (job->material.init_error != 0) {
+        fprintf(stderr, "Error initializing material.\n");
+        goto _fatal_error;
+    }
 
     j = floor(job->t * job->output.sample_rate_hz);
     job->frame = j;
@@ -842,6 +1085,31 @@ job_start:
     clock_gettime(CLOCK_REALTIME, &wallstop);
     ns = 1E9 * (wallstop.tv_sec - wallstart.tv_sec) + (wallstop.tv_nsec - wallstart.tv_nsec);
     printf("Elapsed Time: %.3fs\n", ns / 1E9);
+    particle_sched_report(&(job->sched), stdout, ns / 1E9);
+
+    if (job->output.profile) {
+        FILE *prof_fd;
+
+        prof_report(&(job->profile), stdout, ns / 1E9);
+
+        snprintf(ss, sizeof(ss), "%s%s", job->output.directory, "profile.csv");
+        prof_fd = fopen(ss, "w");
+        if (prof_fd != NULL) {
+            prof_write_csv(&(job->profile), prof_fd, ns / 1E9);
+            fclose(prof_fd);
+        } else {
+            fprintf(stderr, "Can't open %s for output.\n", ss);
+        }
+
+        snprintf(ss, sizeof(ss), "%s%s", job->output.directory, "profile.json");
+        prof_fd = fopen(ss, "w");
+        if (prof_fd != NULL) {
+            prof_write_json(&(job->profile), prof_fd, ns / 1E9);
+            fclose(prof_fd);
+        } else {
+            fprintf(stderr, "Can't open %s for output.\n", ss);
+        }
+    }
 
     /* dump state to file */
     write_state(job->output.state_fd, job);
@@ -865,6 +1133,12 @@ _close_files:
         if (job->output.particle_fd != NULL) {
             fclose(job->output.particle_fd);
         }
+        if (job->output.retired_fd != NULL) {
+            fclose(job->output.retired_fd);
+        }
+        if (job->output.profile_fd != NULL) {
+            fclose(job->output.profile_fd);
+        }
     }
 
     printf("\n");
@@ -881,6 +1155,7 @@ _close_files:
         FREE_AND_NULL(job->output.element_filename_fullpath);
         FREE_AND_NULL(job->output.state_filename_fullpath);
         FREE_AND_NULL(job->output.log_filename_fullpath);
+        FREE_AND_NULL(job->output.retired_filename_fullpath);
         mpm_cleanup(job);
     }
 
@@ -894,15 +1169,16 @@ _cfgfile_error:
     FREE_AND_NULL(threads);
 
     if (job != NULL) {
-        if (job->particle_by_element_color_lists != NULL) {
-            for (size_t i = 0; i < (job->num_colors * job->num_threads); i++) {
-                FREE_AND_NULL(job->particle_by_element_color_lists[i]);
-            }
-        }
-
         FREE_AND_NULL(job->update_elementlists);
-        FREE_AND_NULL(job->particle_by_element_color_lengths);
-        FREE_AND_NULL(job->particle_by_element_color_lists);
+        FREE_AND_NULL(job->particle_by_element_color_offsets);
+        FREE_AND_NULL(job->particle_by_element_color_list);
+        particle_sched_free(&(job->sched));
+        prof_free(&(job->profile));
+        FREE_AND_NULL(job->element_color_counts);
+        FREE_AND_NULL(job->particle_color_counts);
+        FREE_AND_NULL(job->element_particle_offsets);
+        FREE_AND_NULL(job->element_particle_list);
+        FREE_AND_NULL(job->p2g_row_bounds);
 
         FREE_AND_NULL(job->material.fp64_props);
         FREE_AND_NULL(job->material.int_props);
@@ -952,9 +1228,19 @@ void *mpm_run_until(void *_task)
         if (rc == PTHREAD_BARRIER_SERIAL_THREAD) {
             job->stepcount++;
 
+            /* archive particles that left the grid during this step. */
+            if (job->output.retired_fd != NULL
+                && job->output.retired_mark > job->num_active) {
+                write_retired_particles(job->output.retired_fd, job->t, job);
+            }
+
             if (job->t >= (job->frame / job->output.sample_rate_hz)) {
                 // v2_write_frame(job->output.directory, job->output.info_fd, job, v2_write_particle, NULL);
                 write_frame(job->output.particle_fd, job->frame, job->t, job);
+                if (job->output.profile_fd != NULL) {
+                    prof_write_frame(&(job->profile), job->output.profile_fd,
+                        job->frame, job->t);
+                }
                 // write_element_frame(job->output.element_fd, job->frame, job->t, job);
 
                 job->frame++;
@@ -8,29 +8,60 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 
 #include "reader.h"
 #include "writer.h"
 #include "process.h"
+#include "process_usl.h"
 
 /*---read_grid_params---------------------------------------------------------*/
 int read_grid_params(grid_t *grid, const char *fname)
 {
     int r;
     FILE *fp;
+    double v[6];
+    double hx, hy;
 
     fp = fopen(fname, "r");
     if (fp == NULL) {
         return -1;
     }
-    r = fscanf(fp, "%d", &(grid->N));
-    r += fscanf(fp, "%lg", &(grid->len));
-    if (r != 2) {
+    for (r = 0; r < 6 && fscanf(fp, "%lg", &(v[r])) == 1; r++);
+    fclose(fp);
+
+    if (r == 2) {
+        /* square grid at the origin. */
+        grid->Nx = (int)v[0];
+        grid->Ny = (int)v[0];
+        grid->x0 = 0;
+        grid->y0 = 0;
+        grid->lx = v[1];
+        grid->ly = v[1];
+    } else if (r == 6) {
+        grid->Nx = (int)v[0];
+        grid->Ny = (int)v[1];
+        grid->x0 = v[2];
+        grid->y0 = v[3];
+        grid->lx = v[4];
+        grid->ly = v[5];
+    } else {
         printf("error reading grid!\n");
         exit(-1);
     }
 
-    fclose(fp);
+    if (grid->Nx < 2 || grid->Ny < 2 || grid->lx <= 0 || grid->ly <= 0) {
+        printf("grid needs at least 2 nodes and a positive length per side!\n");
+        exit(-1);
+    }
+
+    hx = grid->lx / (grid->Nx - 1);
+    hy = grid->ly / (grid->Ny - 1);
+    if (fabs(hx - hy) > 1e-9 * hx) {
+        printf("grid spacing differs in x (%g) and y (%g), elements must be square!\n",
+            hx, hy);
+        exit(-1);
+    }
 
     return 0;
 }
@@ -122,27 +153,77 @@ int read_particles(particle_t **particles, size_t *num_particles, const char *fn
 /*---read_state---------------------------------------------------------------*/
 job_t *read_state(FILE *fd)
 {
-    int dep;
+    int dep, n;
     job_t *job;
+    char grid_line[256];
+    double v[4];
 
     job = calloc(1, sizeof(job_t));
 
     int r = fscanf(fd, "%lg %lg %lg", &(job->t), &(job->dt), &(job->t_stop));
     r += fscanf(fd, "%zu %zu %zu", &(job->num_particles), &(job->num_nodes), &(job->num_elements));
-    r += fscanf(fd, "%zu %lg", &(job->N), &(job->h));
 
-    if (r != 8) {
+    /*
+        The grid line is "Nx Ny h" followed by a "x0 y0 x1 y1" line, or
+        "N h" in state files written before rectangular grids (a square grid
+        at the origin).
+    */
+    if (fgets(grid_line, sizeof(grid_line), fd) == NULL
+        || fgets(grid_line, sizeof(grid_line), fd) == NULL) {
+        printf("Error reading state header!\n");
+        exit(-1);
+    }
+    n = sscanf(grid_line, "%lg %lg %lg %lg", &(v[0]), &(v[1]), &(v[2]), &(v[3]));
+    if (n == 3) {
+        job->Nx = (size_t)v[0];
+        job->Ny = (size_t)v[1];
+        job->h = v[2];
+        r += 3;
+        r += fscanf(fd, "%lg %lg %lg %lg", &(job->x0), &(job->y0), &(job->x1), &(job->y1));
+    } else if (n == 2) {
+        job->Nx = (size_t)v[0];
+        job->Ny = job->Nx;
+        job->h = v[1];
+        job->x0 = 0;
+        job->y0 = 0;
+        job->x1 = (job->Nx - 1) * job->h;
+        job->y1 = job->x1;
+        r += 7;
+        printf("Reading state with a square grid header (N h).\n");
+    } else {
+        printf("Error reading state header: expected \"Nx Ny h\" and "
+            "\"x0 y0 x1 y1\" lines, or \"N h\" from older state files!\n");
+        exit(-1);
+    }
+
+    if (r != 13) {
         printf("Error reading state header!\n");
         exit(-1);
     }
 
-    job->particles = calloc(job->num_particles, sizeof(particle_t));
-    job->nodes = calloc(job->num_nodes, sizeof(node_t));
+    if (particle_store_alloc(&(job->particles), job->num_particles) != 0) {
+        printf("Error allocating particle storage!\n");
+        exit(-1);
+    }
+    if (node_store_alloc(&(job->nodes), job->num_nodes) != 0) {
+        printf("Error allocating node storage!\n");
+        exit(-1);
+    }
     job->elements = calloc(job->num_elements, sizeof(element_t));
 
     /* Allocate space for tracking element->particle map. */
     job->in_element =  (int *)malloc(job->num_particles * sizeof(int));
 
+    /* Allocate space for map of active particles. */
+    job->active = (int *)malloc(job->num_particles * sizeof(int));
+
+    /* State files are written in id order. */
+    job->particle_index = (size_t *)malloc(job->num_particles * sizeof(size_t));
+    for (size_t i = 0; i < job->num_particles; i++) {
+        job->particles.id[i] = i;
+        job->particle_index[i] = i;
+    }
+
     /* Allocate space for interpolation functions. */
     job->h1 = calloc(sizeof(double), job->num_particles);
     job->h2 = calloc(sizeof(double), job->num_particles);
@@ -161,54 +242,54 @@ job_t *read_state(FILE *fd)
 
     for (size_t i = 0; i < job->num_particles; i++) {
         /* Position */
-        r = fscanf(fd, "%lg %lg", &(job->particles[i].x), &(job->particles[i].y));
+        r = fscanf(fd, "%lg %lg", &(job->particles.x[i]), &(job->particles.y[i]));
 
         /* Local Coordinates */
-        r += fscanf(fd, "%lg %lg", &(job->particles[i].xl), &(job->particles[i].yl));
+        r += fscanf(fd, "%lg %lg", &(job->particles.xl[i]), &(job->particles.yl[i]));
 
         /* Velocity */
-        r += fscanf(fd, "%lg %lg", &(job->particles[i].x_t), &(job->particles[i].y_t));
+        r += fscanf(fd, "%lg %lg", &(job->particles.x_t[i]), &(job->particles.y_t[i]));
 
         /* Mass */
-        r += fscanf(fd, "%lg", &(job->particles[i].m));
+        r += fscanf(fd, "%lg", &(job->particles.m[i]));
 
         /* Volume */
-        r += fscanf(fd, "%lg", &(job->particles[i].v));
+        r += fscanf(fd, "%lg", &(job->particles.v[i]));
 
         /* Initial volume */
-        r += fscanf(fd, "%lg", &(job->particles[i].v0));
+        r += fscanf(fd, "%lg", &(job->particles.v0[i]));
 
         /* Stress */
         r += fscanf(fd, "%lg %lg %lg",
-            &(job->particles[i].sxx),
-            &(job->particles[i].sxy),
-            &(job->particles[i].syy));
+            &(job->particles.sxx[i]),
+            &(job->particles.sxy[i]),
+            &(job->particles.syy[i]));
 
         /* Strain rate */
         r += fscanf(fd, "%lg %lg %lg %lg",
-            &(job->particles[i].exx_t),
-            &(job->particles[i].exy_t),
-            &(job->particles[i].eyy_t),
-            &(job->particles[i].wxy_t));
+            &(job->particles.exx_t[i]),
+            &(job->particles.exy_t[i]),
+            &(job->particles.eyy_t[i]),
+            &(job->particles.wxy_t[i]));
 
         /* Body forces */
-        r += fscanf(fd, "%lg %lg", &(job->particles[i].bx), &(job->particles[i].by));
+        r += fscanf(fd, "%lg %lg", &(job->particles.bx[i]), &(job->particles.by[i]));
 
         /* Deformation gradient tensor */
         r += fscanf(fd, "%lg %lg %lg %lg",
-            &(job->particles[i].Fxx), &(job->particles[i].Fxy),
-            &(job->particles[i].Fyx), &(job->particles[i].Fyy));
+            &(job->particles.Fxx[i]), &(job->particles.Fxy[i]),
+            &(job->particles.Fyx[i]), &(job->particles.Fyy[i]));
 
         /* Displacements */
-        r += fscanf(fd, "%lg %lg", &(job->particles[i].ux), &(job->particles[i].uy));
+        r += fscanf(fd, "%lg %lg", &(job->particles.ux[i]), &(job->particles.uy[i]));
 
         /* Color used by splot visualization */
-        r += fscanf(fd, "%lg", &(job->particles[i].color));
+        r += fscanf(fd, "%lg", &(job->particles.color[i]));
 
         /* State Variables (for constitutive law) */
         r += fscanf(fd, "%d", &dep);
         for (int j = 0; j < dep; j++) {
-            r += fscanf(fd, "%lg", &(job->particles[i].state[j]));
+            r += fscanf(fd, "%lg", &(job->particles.state[i][j]));
         }
 
         /* Flag particle as active or not (used for discharge problems). */
@@ -219,24 +300,40 @@ job_t *read_state(FILE *fd)
         }
     }
 
+    /*
+        Node coordinates and element connectivity are regenerated when tiles
+        are activated (cartesian grid only), so these are only checked.
+    */
     for (size_t i = 0; i < job->num_nodes; i++) {
-        int r = fscanf(fd, "%lg %lg", &(job->nodes[i].x), &(job->nodes[i].y));
+        double x, y;
+        int r = fscanf(fd, "%lg %lg", &x, &y);
         if (r != 2) {
             printf("error reading state of node %zu\n", i);
         }
     }
 
     for (size_t i = 0; i < job->num_elements; i++) {
+        int nodes[4];
         int r = fscanf(fd, "%d %d %d %d",
-            &(job->elements[i].nodes[0]),
-            &(job->elements[i].nodes[1]),
-            &(job->elements[i].nodes[2]),
-            &(job->elements[i].nodes[3]));
+            &(nodes[0]), &(nodes[1]), &(nodes[2]), &(nodes[3]));
         if (r != 4) {
             printf("error reading state of element %zu\n", i);
         }
     }
 
+    /* Move particles saved as inactive out of the active range. */
+    job->num_active = job->num_particles;
+    job->num_deactivated = 0;
+    compact_active_particles(job);
+
+    /* Activate the tiles holding particles. */
+    if (grid_tiles_init(&(job->tiles), job->Nx - 1, job->Ny - 1,
+            GRID_TILE_SIZE) != 0) {
+        printf("Error allocating grid tiles!\n");
+        exit(-1);
+    }
+    activate_particle_tiles(job);
+
     printf("Done loading state.\n");
 
     return job;
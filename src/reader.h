@@ -13,12 +13,23 @@
 #include "particle.h"
 
 /*
-    Read the grid in as NxN nodes spanning the domain from 0 to len in both x
-    and y directions.
+    Read the grid in as Nx by Ny nodes spanning [x0, x0 + lx] by [y0, y0 + ly].
+    The grid file holds either
+
+        Nx Ny
+        x0 y0
+        lx ly
+
+    or, for a square grid at the origin, just N and len. Elements must be
+    square, i.e. lx / (Nx - 1) == ly / (Ny - 1).
 */
 typedef struct grid_s {
-    int N;
-    double len;
+    int Nx;
+    int Ny;
+    double x0;
+    double y0;
+    double lx;
+    double ly;
 } grid_t;
 
 int read_grid_params(grid_t *grid, const char *fname);
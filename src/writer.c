@@ -121,10 +121,13 @@ size_t v2_write_frame(const char *directory, FILE *metafd, job_t *job,
             }
             bytes_out += fprintf(fp, "\n");
 
-            /* Write particle data from simulation. */
+            /* Write particle data from simulation (in id order). */
             for (i = 0; i < job->num_particles; i++) {
-                if (job->active[i]) {
-                    bytes_out += (*particle_output_fn)(fp, &(job->particles[i]));
+                const size_t k = job->particle_index[i];
+                if (job->active[k]) {
+                    particle_t p;
+                    particle_store_get(&(job->particles), k, &p);
+                    bytes_out += (*particle_output_fn)(fp, &p);
                     particles_written++;
                 }
             }
@@ -166,18 +169,21 @@ size_t v2_write_particle(FILE *fd, particle_t *p)
 /*----------------------------------------------------------------------------*/
 
 /*---write_particle-----------------------------------------------------------*/
-void write_particle(FILE *fd, particle_t p, double active)
+void write_particle(FILE *fd, const particle_store_t *ps, size_t i, double active)
 {
-    int i, j;
+    int j, k;
     fprintf(fd, "%lg %lg %lg %lg %lg %lg ",
-        p.m, p.v, p.x, p.y, p.x_t, p.y_t);
+        ps->m[i], ps->v[i], ps->x[i], ps->y[i], ps->x_t[i], ps->y_t[i]);
     fprintf(fd, "%lg %lg %lg %lg %lg %lg %lg %lg %lg",
-        p.sxx, p.sxy, p.syy, p.ux, p.uy, p.state[9], p.color, p.state[10],
+        ps->sxx[i], ps->sxy[i], ps->syy[i], ps->ux[i], ps->uy[i],
+        ps->state[i][9], ps->color[i], ps->state[i][10],
         (double)active);
 
-    for (i = 0; i < 4; i++) {
-        for (j = 0; j < 2; j++) {
-            fprintf(fd, " %lg", p.corners[i][j]);
+    /* Corners are only tracked with CPDI, write zeros otherwise. */
+    for (j = 0; j < 4; j++) {
+        for (k = 0; k < 2; k++) {
+            fprintf(fd, " %lg",
+                (ps->corners != NULL) ? ps->corners[i][j][k] : 0.0);
         }
     }
     fprintf(fd, "\n");
@@ -189,9 +195,18 @@ void write_particle(FILE *fd, particle_t p, double active)
 /*---write_frame--------------------------------------------------------------*/
 void write_frame(FILE *fd, size_t frame, double time, job_t *job)
 {
-    fprintf(fd, "%zu %lg %zu\n", frame, time, job->num_particles);
-    for (size_t i = 0; i < job->num_particles; i++) {
-        write_particle(fd, job->particles[i], (double)(job->active[i]));
+    const int retire = job->output.retire_inactive;
+
+    fprintf(fd, "%zu %lg %zu\n", frame, time,
+        retire ? job->num_active : job->num_particles);
+
+    /* particles may have been reordered, write them in id order. */
+    for (size_t k = 0; k < job->num_particles; k++) {
+        const size_t i = job->particle_index[k];
+        if (retire && job->active[i] == 0) {
+            continue;
+        }
+        write_particle(fd, &(job->particles), i, (double)(job->active[i]));
     }
 
     /* dump the entire frame to disk (or wherever) */
@@ -201,6 +216,26 @@ void write_frame(FILE *fd, size_t frame, double time, job_t *job)
 }
 /*----------------------------------------------------------------------------*/
 
+/*---write_retired_particles--------------------------------------------------*/
+/*
+    Append particles that left the grid since the last call to the retired
+    particle file, tagged with the particle id and the current time. Compaction keeps them in
+    [num_active, retired_mark) until then.
+*/
+void write_retired_particles(FILE *fd, double time, job_t *job)
+{
+    for (size_t i = job->num_active; i < job->output.retired_mark; i++) {
+        fprintf(fd, "%zu %lg ", job->particles.id[i], time);
+        write_particle(fd, &(job->particles), i, (double)(job->active[i]));
+    }
+    job->output.retired_mark = job->num_active;
+
+    fflush(fd);
+
+    return;
+}
+/*----------------------------------------------------------------------------*/
+
 /*---write_element_frame------------------------------------------------------*/
 void write_element_frame(FILE *fd, size_t frame, double time, job_t *job)
 {
@@ -212,6 +247,7 @@ void write_element_frame(FILE *fd, size_t frame, double time, job_t *job)
 
     double x;
     double y;
+    int nodes[4];
 
     sxx_acc = (double *)malloc(sizeof(double) * job->num_elements);
     sxy_acc = (double *)malloc(sizeof(double) * job->num_elements);
@@ -225,27 +261,25 @@ void write_element_frame(FILE *fd, size_t frame, double time, job_t *job)
         v_acc[i] = 0.0f;
     }
 
-    for (size_t i = 0; i < job->num_particles; i++) {
-        if (job->active[i] == 0) {
-            continue;
-        }
+    for (size_t i = 0; i < job->num_active; i++) {
         e = job->in_element[i];
-        sxx_acc[e] += job->particles[i].v * job->particles[i].sxx;
-        sxy_acc[e] += job->particles[i].v * job->particles[i].sxy;
-        syy_acc[e] += job->particles[i].v * job->particles[i].syy;
-        v_acc[e] += job->particles[i].v;
+        sxx_acc[e] += job->particles.v[i] * job->particles.sxx[i];
+        sxy_acc[e] += job->particles.v[i] * job->particles.sxy[i];
+        syy_acc[e] += job->particles.v[i] * job->particles.syy[i];
+        v_acc[e] += job->particles.v[i];
     }
 
     fprintf(fd, "%zu %lg %zu\n", frame, time, job->num_elements);
 
     for (size_t i = 0; i < job->num_elements; i++) {
-        node_number_to_coords(&x, &y, job->elements[i].nodes[0], job->N, job->h);
+        element_node_numbers(nodes, i, job->Nx);
+        node_number_to_coords(&x, &y, nodes[0], job->Nx, job->x0, job->y0, job->h);
         fprintf(fd, "%lg %lg ", x, y);
-        node_number_to_coords(&x, &y, job->elements[i].nodes[1], job->N, job->h);
+        node_number_to_coords(&x, &y, nodes[1], job->Nx, job->x0, job->y0, job->h);
         fprintf(fd, "%lg %lg ", x, y);
-        node_number_to_coords(&x, &y, job->elements[i].nodes[2], job->N, job->h);
+        node_number_to_coords(&x, &y, nodes[2], job->Nx, job->x0, job->y0, job->h);
         fprintf(fd, "%lg %lg ", x, y);
-        node_number_to_coords(&x, &y, job->elements[i].nodes[3], job->N, job->h);
+        node_number_to_coords(&x, &y, nodes[3], job->Nx, job->x0, job->y0, job->h);
         fprintf(fd, "%lg %lg ", x, y);
         fprintf(fd, "%lg %lg %lg\n",
             (v_acc[i] > 0) ? (sxx_acc[i] / v_acc[i]) : 0.0f,
@@ -267,113 +301,118 @@ void write_state(FILE *fd, job_t *job)
 {
     fprintf(fd, "%lg %lg %lg\n", job->t, job->dt, job->t_stop);
     fprintf(fd, "%zu %zu %zu\n", job->num_particles, job->num_nodes, job->num_elements);
-    fprintf(fd, "%zu %lg\n", job->N, job->h);
+    fprintf(fd, "%zu %zu %lg\n", job->Nx, job->Ny, job->h);
+    fprintf(fd, "%lg %lg %lg %lg\n", job->x0, job->y0, job->x1, job->y1);
+
+    /* particles may have been reordered, write them in id order. */
+    for (size_t k = 0; k < job->num_particles; k++) {
+        const size_t i = job->particle_index[k];
 
-    for (size_t i = 0; i < job->num_particles; i++) {
         /* Position */
-        fprintf(fd, "%lg %lg\n", job->particles[i].x, job->particles[i].y);
+        fprintf(fd, "%lg %lg\n", job->particles.x[i], job->particles.y[i]);
 
         /* Local Coordinates */
-        fprintf(fd, "%lg %lg\n", job->particles[i].xl, job->particles[i].yl);
+        fprintf(fd, "%lg %lg\n", job->particles.xl[i], job->particles.yl[i]);
 
         /* Velocity */
-        fprintf(fd, "%lg %lg\n", job->particles[i].x_t, job->particles[i].y_t);
+        fprintf(fd, "%lg %lg\n", job->particles.x_t[i], job->particles.y_t[i]);
 
         /* Mass */
-        fprintf(fd, "%lg\n", job->particles[i].m);
+        fprintf(fd, "%lg\n", job->particles.m[i]);
 
         /* Volume */
-        fprintf(fd, "%lg\n", job->particles[i].v);
+        fprintf(fd, "%lg\n", job->particles.v[i]);
 
         /* Initial volume */
-        fprintf(fd, "%lg\n", job->particles[i].v0);
+        fprintf(fd, "%lg\n", job->particles.v0[i]);
 
         /* Stress */
         fprintf(fd, "%lg %lg %lg\n",
-            job->particles[i].sxx,
-            job->particles[i].sxy,
-            job->particles[i].syy);
+            job->particles.sxx[i],
+            job->particles.sxy[i],
+            job->particles.syy[i]);
 
         /* Stress rate */
 /*        fprintf(fd, "%lg %lg %lg\n",*/
-/*            job->particles[i].sxx_t,*/
-/*            job->particles[i].sxy_t,*/
-/*            job->particles[i].syy_t);*/
+/*            job->particles.sxx_t[i],*/
+/*            job->particles.sxy_t[i],*/
+/*            job->particles.syy_t[i]);*/
 
         /* Strain rate */
         fprintf(fd, "%lg %lg %lg %lg\n",
-            job->particles[i].exx_t,
-            job->particles[i].exy_t,
-            job->particles[i].eyy_t,
-            job->particles[i].wxy_t);
+            job->particles.exx_t[i],
+            job->particles.exy_t[i],
+            job->particles.eyy_t[i],
+            job->particles.wxy_t[i]);
 
         /* Jaumann stress increment */
 /*        fprintf(fd, "%lg %lg %lg\n",*/
-/*            job->particles[i].dsjxx,*/
-/*            job->particles[i].dsjxy,*/
-/*            job->particles[i].dsjyy);*/
+/*            job->particles.dsjxx[i],*/
+/*            job->particles.dsjxy[i],*/
+/*            job->particles.dsjyy[i]);*/
 
         /* Elastic and plastic strain increments */
 /*        fprintf(fd, "%lg %lg %lg\n",*/
-/*            job->particles[i].deexx,*/
-/*            job->particles[i].deexy,*/
-/*            job->particles[i].deeyy);*/
+/*            job->particles.deexx[i],*/
+/*            job->particles.deexy[i],*/
+/*            job->particles.deeyy[i]);*/
 /*        fprintf(fd, "%lg %lg %lg\n",*/
-/*            job->particles[i].depxx,*/
-/*            job->particles[i].depxy,*/
-/*            job->particles[i].depyy);*/
+/*            job->particles.depxx[i],*/
+/*            job->particles.depxy[i],*/
+/*            job->particles.depyy[i]);*/
 
         /* Body forces */
-        fprintf(fd, "%lg %lg\n", job->particles[i].bx, job->particles[i].by);
+        fprintf(fd, "%lg %lg\n", job->particles.bx[i], job->particles.by[i]);
 
         /* Deformation gradient tensor */
         fprintf(fd, "%lg %lg %lg %lg\n",
-            job->particles[i].Fxx, job->particles[i].Fxy,
-            job->particles[i].Fyx, job->particles[i].Fyy);
+            job->particles.Fxx[i], job->particles.Fxy[i],
+            job->particles.Fyx[i], job->particles.Fyy[i]);
 
         /* Initial particle domain vectors */
 /*        fprintf(fd, "%lg %lg %lg %lg\n",*/
-/*            job->particles[i].r1x0, job->particles[i].r1y0,*/
-/*            job->particles[i].r2x0, job->particles[i].r2y0);*/
+/*            job->particles.r1x0[i], job->particles.r1y0[i],*/
+/*            job->particles.r2x0[i], job->particles.r2y0[i]);*/
 
         /* Updated particle domain vectors */
 /*        fprintf(fd, "%lg %lg %lg %lg\n",*/
-/*            job->particles[i].r1xn, job->particles[i].r1yn,*/
-/*            job->particles[i].r2xn, job->particles[i].r2yn);*/
+/*            job->particles.r1xn[i], job->particles.r1yn[i],*/
+/*            job->particles.r2xn[i], job->particles.r2yn[i]);*/
 
         /* Corner positions */
 /*        fprintf(fd, "%lg %lg %lg %lg %lg %lg %lg %lg\n",*/
-/*            job->particles[i].c1x, job->particles[i].c1y,*/
-/*            job->particles[i].c2x, job->particles[i].c2y,*/
-/*            job->particles[i].c3x, job->particles[i].c3y,*/
-/*            job->particles[i].c4x, job->particles[i].c4y);*/
+/*            job->particles.c1x[i], job->particles.c1y[i],*/
+/*            job->particles.c2x[i], job->particles.c2y[i],*/
+/*            job->particles.c3x[i], job->particles.c3y[i],*/
+/*            job->particles.c4x[i], job->particles.c4y[i]);*/
 
         /* Displacements */
-        fprintf(fd, "%lg %lg\n", job->particles[i].ux, job->particles[i].uy);
+        fprintf(fd, "%lg %lg\n", job->particles.ux[i], job->particles.uy[i]);
 
         /* Color used by splot visualization */
-        fprintf(fd, "%lg\n", job->particles[i].color);
+        fprintf(fd, "%lg\n", job->particles.color[i]);
 
         /* State Variables (for constitutive law) */
         fprintf(fd, "%d\n", DEPVAR);
         for (size_t j = 0; j < DEPVAR; j++) {
-            fprintf(fd, "%lg\n", job->particles[i].state[j]);
+            fprintf(fd, "%lg\n", job->particles.state[i][j]);
         }
 
         /* Flag particle as active or not (used for discharge problems). */
         fprintf(fd, "%d\n", job->active[i]);
     }
 
+    /* Nodes and elements of tiles that were never active aren't set up. */
     for (size_t i = 0; i < job->num_nodes; i++) {
-        fprintf(fd, "%lg %lg\n", job->nodes[i].x, job->nodes[i].y);
+        double x, y;
+        node_number_to_coords(&x, &y, i, job->Nx, job->x0, job->y0, job->h);
+        fprintf(fd, "%lg %lg\n", x, y);
     }
 
     for (size_t i = 0; i < job->num_elements; i++) {
-         fprintf(fd, "%d %d %d %d\n",
-            job->elements[i].nodes[0],
-            job->elements[i].nodes[1],
-            job->elements[i].nodes[2],
-            job->elements[i].nodes[3]);
+        int nodes[4];
+        element_node_numbers(nodes, i, job->Nx);
+        fprintf(fd, "%d %d %d %d\n", nodes[0], nodes[1], nodes[2], nodes[3]);
     }
 
     return;
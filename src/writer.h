@@ -19,6 +19,7 @@ size_t v2_write_frame(const char *directory, FILE *metafd, job_t *job,
 size_t v2_write_particle(FILE *fd, particle_t *p);
 
 void write_frame(FILE *fd, size_t frame, double time, job_t *job);
+void write_retired_particles(FILE *fd, double time, job_t *job);
 void write_element_frame(FILE *fd, size_t frame, double time, job_t *job);
 void write_state(FILE *fd, job_t *job);
 
@@ -0,0 +1,207 @@
+/**
+    \file g_local_mu2_ext_fields.c
+    \author Sachith Dunatunga
+    \date 17.10.2026
+
+    Checks the timing of the nodal laplacian of the fluidity in
+    g_local_mu2_ext. The material leaves gflocal at the end of its stress
+    update for the stepper to map at the start of the next step; it used to
+    compute gflocal and map it itself at the start of the stress update.
+    Both must put the same values on the nodes.
+
+    Every step, the fluidity each particle had at the start of the old
+    stress update (from its plastic shear rate and pressure at that point)
+    is projected here by hand and compared to what the registered field
+    gets from the state the material left behind.
+
+    usage: g_local_mu2_ext_fields [STEPS]
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "particle.h"
+#include "node.h"
+#include "process.h"
+
+void material_init(job_t *job);
+void calculate_stress(job_t *job);
+
+/* constants and mu(I) of g_local_mu2_ext.c. */
+#define MU_S 0.3819
+#define GRAINS_RHO 2450
+#define MU_2 0.6435
+#define I_0 (0.278 / 1.0)
+#define GRAINS_D (0.01 * 5)
+
+#define GAMMADOTP_IDX 10
+
+/* 2 by 2 unit elements, 4 particles in each. */
+#define NE 2
+#define NN (NE + 1)
+#define NP (4 * NE * NE)
+
+static double mu_from_gammadot(double gammadot, double p)
+{
+    double inum;
+
+    if (p <= 0) {
+        return MU_2;
+    }
+    inum = GRAINS_D * sqrt(GRAINS_RHO) * gammadot / sqrt(p);
+    if (inum <= 0) {
+        return MU_S;
+    }
+    return MU_S + (MU_2 - MU_S) / ((I_0 / inum) + 1.0);
+}
+
+/* gflocal as computed at the start of the stress update before. */
+static double old_gflocal(const particle_store_t *ps, size_t i)
+{
+    double p = -0.5 * (ps->sxx[i] + ps->syy[i]);
+    double gammadotp = ps->state[i][GAMMADOTP_IDX];
+
+    if (gammadotp == 0) {
+        return 0;
+    }
+    return gammadotp / mu_from_gammadot(gammadotp, p);
+}
+
+int main(int argc, char **argv)
+{
+    job_t job;
+    particle_store_t *ps = &(job.particles);
+    element_t elements[NE * NE];
+    int in_element[NP];
+    double s[NP][4], b1[NP][4], b2[NP][4];
+    double props[2] = { 1e6, 0.3 };
+    double ref[NN * NN];
+    const double *d2_gf;
+    double diff, scale, max_scale = 0;
+    double xl, yl;
+    size_t e, i, k, n;
+    int field, step, num_steps = 50;
+
+    if (argc > 1) {
+        num_steps = atoi(argv[1]);
+    }
+
+    memset(&job, 0, sizeof(job_t));
+    if (particle_store_alloc(ps, NP) != 0) {
+        fprintf(stderr, "error allocating particles.\n");
+        return EXIT_FAILURE;
+    }
+
+    job.num_nodes = NN * NN;
+    job.num_elements = NE * NE;
+    job.num_particles = NP;
+    job.num_active = NP;
+    job.elements = elements;
+    job.in_element = in_element;
+    job.material.fp64_props = props;
+    job.material.num_fp64_props = 2;
+    job.dt = 1e-3;
+
+    for (e = 0; e < NE * NE; e++) {
+        n = (e / NE) * NN + (e % NE);
+        elements[e].nodes[0] = n;
+        elements[e].nodes[1] = n + 1;
+        elements[e].nodes[2] = n + NN + 1;
+        elements[e].nodes[3] = n + NN;
+    }
+
+    /*
+        sheared and compressed at different rates so the fluidity and the
+        pressure vary between particles and steps.
+    */
+    for (i = 0; i < NP; i++) {
+        in_element[i] = i / 4;
+        xl = (i % 2) ? 0.75 : 0.25;
+        yl = ((i / 2) % 2) ? 0.75 : 0.25;
+        s[i][0] = (1 - xl) * (1 - yl);
+        s[i][1] = xl * (1 - yl);
+        s[i][2] = xl * yl;
+        s[i][3] = (1 - xl) * yl;
+        b1[i][0] = -(1 - yl);
+        b1[i][1] = (1 - yl);
+        b1[i][2] = yl;
+        b1[i][3] = -yl;
+        b2[i][0] = -(1 - xl);
+        b2[i][1] = -xl;
+        b2[i][2] = xl;
+        b2[i][3] = (1 - xl);
+
+        ps->m[i] = 2450;
+        ps->v[i] = 1;
+        ps->sxx[i] = -1000 - 50 * i;
+        ps->syy[i] = ps->sxx[i];
+        ps->sxy[i] = 0;
+        ps->exy_t[i] = 0.05 * (1 + i);
+        ps->exx_t[i] = -0.01 * (i % 3);
+        ps->eyy_t[i] = ps->exx_t[i];
+    }
+
+    material_init(&job);
+    if (job.material.init_error != 0) {
+        fprintf(stderr, "error initializing material.\n");
+        return EXIT_FAILURE;
+    }
+    field = nodal_field_find(&(job.nodal_fields), "d2_gf");
+    if (field < 0) {
+        fprintf(stderr, "material did not register 'd2_gf'.\n");
+        return EXIT_FAILURE;
+    }
+
+    /* a second init (e.g. after a restart) reuses the field. */
+    material_init(&job);
+    if (job.material.init_error != 0 || job.nodal_fields.num_fields != 1) {
+        fprintf(stderr, "second init left %zu nodal fields.\n",
+            job.nodal_fields.num_fields);
+        return EXIT_FAILURE;
+    }
+    d2_gf = nodal_field_values(&(job.nodal_fields), field);
+
+    for (step = 0; step < num_steps; step++) {
+        memset(ref, 0, sizeof(ref));
+        nodal_field_clear(&(job.nodal_fields), 0, job.num_nodes);
+        for (i = 0; i < NP; i++) {
+            nodal_field_accumulate(&(job.nodal_fields), ps, i,
+                elements[in_element[i]].nodes, s[i], b1[i], b2[i]);
+            for (k = 0; k < 4; k++) {
+                ref[elements[in_element[i]].nodes[k]] -= ps->v[i]
+                    * old_gflocal(ps, i)
+                    * (b1[i][k] * b1[i][k] + b2[i][k] * b2[i][k]);
+            }
+        }
+
+        diff = 0;
+        scale = 0;
+        for (n = 0; n < NN * NN; n++) {
+            diff = fmax(diff, fabs(d2_gf[n] - ref[n]));
+            scale = fmax(scale, fabs(ref[n]));
+        }
+        if (diff > 1e-12 * scale) {
+            fprintf(stderr, "step %d: nodal laplacian differs by %g (of %g).\n",
+                step, diff, scale);
+            return EXIT_FAILURE;
+        }
+        max_scale = fmax(max_scale, scale);
+
+        calculate_stress(&job);
+    }
+
+    nodal_field_free(&(job.nodal_fields));
+    particle_store_free(ps);
+
+    /* the particles have to yield for the check to mean anything. */
+    if (max_scale == 0) {
+        fprintf(stderr, "fluidity stayed zero.\n");
+        return EXIT_FAILURE;
+    }
+
+    printf("%d steps, nodal laplacian of the fluidity up to %g.\n",
+        num_steps, max_scale);
+
+    return EXIT_SUCCESS;
+}
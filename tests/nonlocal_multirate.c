@@ -0,0 +1,191 @@
+/**
+    \file nonlocal_multirate.c
+    \author Sachith Dunatunga
+    \date 17.10.2026
+
+    Runs the g_nonlocal material on the particles and grid of the silo
+    example, once solving for the fluidity every step and once every
+    INTERVAL steps (or earlier once the nodal load changed by more than
+    LOAD_TOLERANCE), and checks that the stresses stay within TOLERANCE
+    (relative to the largest stress) of each other.
+
+    The particles are given a lithostatic stress and a shear band over the
+    orifice that is above yield, and are sheared at a constant rate there.
+    They do not move, so only the material is exercised.
+
+    usage: nonlocal_multirate DIRECTORY [INTERVAL] [STEPS] [TOLERANCE]
+        [LOAD_TOLERANCE]
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "reader.h"
+#include "particle.h"
+#include "node.h"
+#include "process.h"
+#include "process_usl.h"
+
+void material_init(job_t *job);
+void calculate_stress(job_t *job);
+
+/* friction coefficient of the sheared band and of the rest of the silo. */
+#define MU_BAND 0.45
+#define MU_REST 0.2
+
+static job_t *setup(const grid_t *g, particle_t *pdata, size_t plen,
+    int interval, double load_tolerance)
+{
+    job_t *job;
+    size_t i, k;
+    int *nn;
+    double s[4];
+    double y_top = 0;
+    double p, mu;
+
+    job = mpm_init(g->Nx, g->Ny, g->x0, g->y0, g->lx, g->ly, pdata, plen, 1);
+    if (job == NULL) {
+        exit(EXIT_FAILURE);
+    }
+    job->material.nonlocal.solve_interval = interval;
+    job->material.nonlocal.solve_tolerance = load_tolerance;
+
+    /* time step of the silo example. */
+    job->dt = 3e-6;
+
+    for (i = 0; i < job->num_nodes * NODAL_DOF; i++) {
+        job->node_number_override[i] = i;
+    }
+
+    calculate_shapefunctions_split(job, 0, job->num_active);
+
+    for (i = 0; i < job->num_active; i++) {
+        if (job->particles.y[i] > y_top) {
+            y_top = job->particles.y[i];
+        }
+    }
+
+    for (i = 0; i < job->num_active; i++) {
+        s[0] = job->h1[i];
+        s[1] = job->h2[i];
+        s[2] = job->h3[i];
+        s[3] = job->h4[i];
+        nn = job->elements[job->in_element[i]].nodes;
+        for (k = 0; k < NODES_PER_ELEMENT; k++) {
+            job->nodes.m[nn[k]] += job->particles.m[i] * s[k];
+        }
+
+        p = 10 + 9.81 * (job->particles.m[i] / job->particles.v[i])
+            * (y_top - job->particles.y[i]);
+        mu = MU_REST;
+        if (job->particles.x[i] < 0.15 && job->particles.y[i] < 0.4) {
+            mu = MU_BAND;
+            job->particles.exy_t[i] = 0.5;
+        }
+        job->particles.sxx[i] = -p;
+        job->particles.syy[i] = -p;
+        job->particles.sxy[i] = mu * p;
+    }
+
+    material_init(job);
+
+    return job;
+}
+
+static void run(job_t *job, int num_steps)
+{
+    for (int step = 0; step < num_steps; step++) {
+        calculate_stress(job);
+        job->t += job->dt;
+        job->step_number++;
+    }
+
+    return;
+}
+
+int main(int argc, char **argv)
+{
+    grid_t g;
+    particle_t *pdata = NULL;
+    size_t plen = 0;
+    char fname[4096];
+    int interval = 4;
+    int num_steps = 40;
+    double tolerance = 1e-2;
+    double load_tolerance = 0;
+
+    job_t *job;
+    double *ref;
+    double diff, scale;
+    size_t i, n;
+
+    if (argc <= 1) {
+        printf("%s usage: %s DIRECTORY [INTERVAL] [STEPS] [TOLERANCE] "
+            "[LOAD_TOLERANCE]\n", argv[0], argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    if (argc > 2) {
+        interval = atoi(argv[2]);
+    }
+    if (argc > 3) {
+        num_steps = atoi(argv[3]);
+    }
+    if (argc > 4) {
+        tolerance = atof(argv[4]);
+    }
+    if (argc > 5) {
+        load_tolerance = atof(argv[5]);
+    }
+
+    snprintf(fname, sizeof(fname), "%s/silo.grid", argv[1]);
+    if (read_grid_params(&g, fname) != 0) {
+        fprintf(stderr, "error reading grid file '%s'.\n", fname);
+        exit(EXIT_FAILURE);
+    }
+    snprintf(fname, sizeof(fname), "%s/silo.particles", argv[1]);
+    if (read_particles(&pdata, &plen, fname) != 0) {
+        fprintf(stderr, "error reading particle file '%s'.\n", fname);
+        exit(EXIT_FAILURE);
+    }
+
+    /* reference: solve every step. */
+    job = setup(&g, pdata, plen, 1, 0);
+    run(job, num_steps);
+    n = job->num_active;
+    ref = (double *)malloc(3 * n * sizeof(double));
+    scale = 0;
+    for (i = 0; i < n; i++) {
+        ref[3 * i + 0] = job->particles.sxx[i];
+        ref[3 * i + 1] = job->particles.sxy[i];
+        ref[3 * i + 2] = job->particles.syy[i];
+        for (size_t j = 0; j < 3; j++) {
+            scale = fmax(scale, fabs(ref[3 * i + j]));
+        }
+    }
+    mpm_cleanup(job);
+
+    job = setup(&g, pdata, plen, interval, load_tolerance);
+    run(job, num_steps);
+    diff = 0;
+    for (i = 0; i < n; i++) {
+        diff = fmax(diff, fabs(job->particles.sxx[i] - ref[3 * i + 0]));
+        diff = fmax(diff, fabs(job->particles.sxy[i] - ref[3 * i + 1]));
+        diff = fmax(diff, fabs(job->particles.syy[i] - ref[3 * i + 2]));
+    }
+    mpm_cleanup(job);
+
+    printf("%zu particles, %d steps, interval %d: max stress difference %g "
+        "(%g of max stress %g).\n", n, num_steps, interval, diff,
+        diff / scale, scale);
+
+    free(ref);
+    free(pdata);
+
+    if (!(diff <= tolerance * scale)) {
+        fprintf(stderr, "stress differs by more than %g.\n", tolerance);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,145 @@
+/**
+    \file shapefunction_batch.c
+    \author Sachith Dunatunga
+    \date 17.10.2026
+
+    Checks the shape function batch kernels against global_to_local_coords,
+    tent and grad_tent, and times each of them.
+
+    usage: shapefunction_batch [num_points] [repeats]
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "interpolate.h"
+#include "particle.h"
+
+#define NUM_FIELDS 14
+
+static double elapsed(const struct timespec *tic, const struct timespec *toc)
+{
+    return (toc->tv_sec - tic->tv_sec) + 1e-9 * (toc->tv_nsec - tic->tv_nsec);
+}
+
+static void set_fields(tent_batch_out_t *out, double *buf, size_t n)
+{
+    double **f[NUM_FIELDS] = {
+        &out->xl, &out->yl,
+        &out->h1, &out->h2, &out->h3, &out->h4,
+        &out->b11, &out->b12, &out->b13, &out->b14,
+        &out->b21, &out->b22, &out->b23, &out->b24
+    };
+
+    for (size_t j = 0; j < NUM_FIELDS; j++) {
+        *(f[j]) = buf + j * n;
+    }
+
+    return;
+}
+
+/* The path calculate_shapefunctions_split used before the batch kernel. */
+static void reference_path(const double *x, const double *y,
+    const double *xn, const double *yn, double h, size_t n,
+    const tent_batch_out_t *out)
+{
+    for (size_t i = 0; i < n; i++) {
+        global_to_local_coords(&(out->xl[i]), &(out->yl[i]),
+            x[i], y[i], xn[i], yn[i], h);
+        tent(&(out->h1[i]), &(out->h2[i]), &(out->h3[i]), &(out->h4[i]),
+            out->xl[i], out->yl[i]);
+        grad_tent(
+            &(out->b11[i]), &(out->b12[i]), &(out->b13[i]), &(out->b14[i]),
+            &(out->b21[i]), &(out->b22[i]), &(out->b23[i]), &(out->b24[i]),
+            out->xl[i], out->yl[i], h);
+    }
+
+    return;
+}
+
+int main(int argc, char **argv)
+{
+    size_t n = 100003;
+    int repeats = 50;
+    const double h = 1.0 / 80.0;
+    int failed = 0;
+
+    double *x, *y, *xn, *yn, *ref, *buf;
+    tent_batch_out_t ref_out, out;
+    struct timespec tic, toc;
+    double t_ref;
+
+    if (argc > 1) {
+        n = strtoul(argv[1], NULL, 10);
+    }
+    if (argc > 2) {
+        repeats = atoi(argv[2]);
+    }
+
+    x = (double *)malloc(n * sizeof(double));
+    y = (double *)malloc(n * sizeof(double));
+    xn = (double *)malloc(n * sizeof(double));
+    yn = (double *)malloc(n * sizeof(double));
+    ref = (double *)malloc(NUM_FIELDS * n * sizeof(double));
+    buf = (double *)malloc(NUM_FIELDS * n * sizeof(double));
+    if (x == NULL || y == NULL || xn == NULL || yn == NULL
+        || ref == NULL || buf == NULL) {
+        fprintf(stderr, "Can't allocate %zu points.\n", n);
+        return EXIT_FAILURE;
+    }
+
+    /* points inside their element, some just past the edge to be snapped. */
+    srand(1234);
+    for (size_t i = 0; i < n; i++) {
+        xn[i] = h * (rand() % 80);
+        yn[i] = h * (rand() % 80);
+        x[i] = xn[i] + h * ((double)rand() / RAND_MAX);
+        y[i] = yn[i] + h * ((double)rand() / RAND_MAX);
+        if (i % 97 == 0) {
+            x[i] = xn[i] + h * (1.0 + 1e-12);
+        }
+    }
+
+    set_fields(&ref_out, ref, n);
+    clock_gettime(CLOCK_MONOTONIC, &tic);
+    for (int r = 0; r < repeats; r++) {
+        reference_path(x, y, xn, yn, h, n, &ref_out);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &toc);
+    t_ref = elapsed(&tic, &toc);
+    printf("%-8s %10.3f ns/point\n", "current", 1e9 * t_ref / (repeats * n));
+
+    set_fields(&out, buf, n);
+    for (int isa = TENT_BATCH_SCALAR; isa < TENT_BATCH_NUM_ISA; isa++) {
+        if (tent_batch_set_isa((enum tent_batch_isa_e)isa) != 0) {
+            continue;
+        }
+
+        memset(buf, 0, NUM_FIELDS * n * sizeof(double));
+        clock_gettime(CLOCK_MONOTONIC, &tic);
+        for (int r = 0; r < repeats; r++) {
+            tent_batch(x, y, xn, yn, h, n, &out);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &toc);
+
+        printf("%-8s %10.3f ns/point (%.2fx)", tent_batch_isa_name(),
+            1e9 * elapsed(&tic, &toc) / (repeats * n),
+            t_ref / elapsed(&tic, &toc));
+
+        if (memcmp(buf, ref, NUM_FIELDS * n * sizeof(double)) != 0) {
+            printf(" MISMATCH");
+            failed = 1;
+        }
+        printf("\n");
+    }
+
+    free(x);
+    free(y);
+    free(xn);
+    free(yn);
+    free(ref);
+    free(buf);
+
+    return (failed ? EXIT_FAILURE : EXIT_SUCCESS);
+}
@@ -19,12 +19,12 @@
 void material_init(job_t *job);
 void calculate_stress(job_t *job);
 
-double mu(particle_t *p)
+double mu(const particle_store_t *ps, size_t i)
 {
-    double pr = -0.5 * (p->sxx + p->syy);
-    double s0xx = p->sxx + pr;
-    double s0xy = p->sxy;
-    double s0yy = p->syy + pr;
+    double pr = -0.5 * (ps->sxx[i] + ps->syy[i]);
+    double s0xx = ps->sxx[i] + pr;
+    double s0xy = ps->sxy[i];
+    double s0yy = ps->syy[i] + pr;
     double tau = sqrt(0.5*(s0xx*s0xx + 2*s0xy*s0xy + s0yy*s0yy));
 
     if (pr <= 0) {
@@ -33,11 +33,11 @@ double mu(particle_t *p)
     return tau/pr;
 }
 
-void set_velocity_gradient(particle_t *p, double t)
+void set_velocity_gradient(particle_store_t *ps, size_t i, double t)
 {
     double sh = 0.5;
     double L[4] = { 0, 0, 0, 0 };
-    int i;
+    int j;
 
     if (t >= 0 && t < 0.25) {
         L[0] = 0;
@@ -68,21 +68,42 @@ void set_velocity_gradient(particle_t *p, double t)
         L[3] = 0;
     }
 
-    for (i = 0; i < 4; i++) {
-        L[i] *= 1e-1;
+    for (j = 0; j < 4; j++) {
+        L[j] *= 1e-1;
     }
 
-    p->exx_t = L[0];
-    p->exy_t = 0.5 * (L[1] + L[2]);
-    p->wxy_t = 0.5 * (L[1] - L[2]);
-    p->eyy_t = L[3];
+    ps->exx_t[i] = L[0];
+    ps->exy_t[i] = 0.5 * (L[1] + L[2]);
+    ps->wxy_t[i] = 0.5 * (L[1] - L[2]);
+    ps->eyy_t[i] = L[3];
 
     return;
 }
 
-void update_density(particle_t *p, double dt)
+void update_density(particle_store_t *ps, size_t i, double dt)
 {
-    p->v *= exp (dt * (p->exx_t + p->eyy_t));
+    ps->v[i] *= exp (dt * (ps->exx_t[i] + ps->eyy_t[i]));
+    return;
+}
+
+/*
+    What the stepper does with the nodal fields the material registered: the
+    particle sits in the middle of a unit element.
+*/
+void map_nodal_fields(job_t *job)
+{
+    const double s[4] = { 0.25, 0.25, 0.25, 0.25 };
+    const double b1[4] = { -0.5, 0.5, 0.5, -0.5 };
+    const double b2[4] = { -0.5, -0.5, 0.5, 0.5 };
+    const double inv_m[4] = { 1, 1, 1, 1 };
+    const int *nodes = job->elements[job->in_element[0]].nodes;
+
+    nodal_field_clear(&(job->nodal_fields), 0, job->num_nodes);
+    nodal_field_accumulate(&(job->nodal_fields), &(job->particles), 0, nodes,
+        s, b1, b2);
+    nodal_field_interpolate(&(job->nodal_fields), &(job->particles), 0,
+        nodes, s, inv_m);
+
     return;
 }
 
@@ -131,19 +152,32 @@ int main(int argc, char **argv)
 
     job_t testjob;
     int a[1] = {1};
+    int in_element[1] = {0};
+    element_t element = { .nodes = {0, 1, 2, 3} };
     double t_stop = 1.25;
-    particle_t p;
-    memset(&p, 0, sizeof(particle_t));
+    particle_store_t *ps = &(testjob.particles);
 
-    p.sxx = -1;
-    p.sxy = 0;
-    p.syy = -1;
-    p.m = 2450;
-    p.v = 1;
+    /* also leaves the nodal field registry empty. */
+    memset(&testjob, 0, sizeof(job_t));
+
+    if (particle_store_alloc(ps, 1) != 0) {
+        fprintf(stderr, "error allocating particle.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    ps->sxx[0] = -1;
+    ps->sxy[0] = 0;
+    ps->syy[0] = -1;
+    ps->m[0] = 2450;
+    ps->v[0] = 1;
 
     testjob.num_particles = 1;
+    testjob.num_active = 1;
     testjob.active = a;
-    testjob.particles = &p;
+    testjob.num_nodes = 4;
+    testjob.num_elements = 1;
+    testjob.elements = &element;
+    testjob.in_element = in_element;
     testjob.material.num_fp64_props = num_lines - 2;
     testjob.material.fp64_props = testprops;
     testjob.t = 0;
@@ -158,39 +192,47 @@ int main(int argc, char **argv)
     }
     
     material_init(&testjob);
+    if (testjob.material.init_error != 0) {
+        fprintf(stderr, "error initializing material.\n");
+        exit(EXIT_FAILURE);
+    }
     fprintf(fp, "%a,%a,%a,%a,%a,%a,%a,%a,%a,%a\n",
         testjob.t,
-        p.exx_t, p.exy_t + p.wxy_t, p.exy_t - p.wxy_t, p.eyy_t,
-        p.sxx, p.sxy, p.syy, mu(&p),
-        p.state[10] /* gammadotp */
+        ps->exx_t[0], ps->exy_t[0] + ps->wxy_t[0], ps->exy_t[0] - ps->wxy_t[0], ps->eyy_t[0],
+        ps->sxx[0], ps->sxy[0], ps->syy[0], mu(ps, 0),
+        ps->state[0][10] /* gammadotp */
     );
     fprintf(fpd, "%g,%g,%g,%g,%g,%g,%g,%g,%g,%g\n",
         testjob.t,
-        p.exx_t, p.exy_t + p.wxy_t, p.exy_t - p.wxy_t, p.eyy_t,
-        p.sxx, p.sxy, p.syy, mu(&p),
-        p.state[10] /* gammadotp */
+        ps->exx_t[0], ps->exy_t[0] + ps->wxy_t[0], ps->exy_t[0] - ps->wxy_t[0], ps->eyy_t[0],
+        ps->sxx[0], ps->sxy[0], ps->syy[0], mu(ps, 0),
+        ps->state[0][10] /* gammadotp */
     );
     while(testjob.t < t_stop) {
-        set_velocity_gradient(&p, testjob.t);
+        set_velocity_gradient(ps, 0, testjob.t);
+        map_nodal_fields(&testjob);
         calculate_stress(&testjob);
-        update_density(&p, testjob.dt);
+        update_density(ps, 0, testjob.dt);
         testjob.t += testjob.dt;
         fprintf(fp, "%a,%a,%a,%a,%a,%a,%a,%a,%a,%a\n",
             testjob.t,
-            p.exx_t, p.exy_t + p.wxy_t, p.exy_t - p.wxy_t, p.eyy_t,
-            p.sxx, p.sxy, p.syy, mu(&p),
-            p.state[10] /* gammadotp */
+            ps->exx_t[0], ps->exy_t[0] + ps->wxy_t[0], ps->exy_t[0] - ps->wxy_t[0], ps->eyy_t[0],
+            ps->sxx[0], ps->sxy[0], ps->syy[0], mu(ps, 0),
+            ps->state[0][10] /* gammadotp */
         );
         fprintf(fpd, "%g,%g,%g,%g,%g,%g,%g,%g,%g,%g\n",
             testjob.t,
-            p.exx_t, p.exy_t + p.wxy_t, p.exy_t - p.wxy_t, p.eyy_t,
-            p.sxx, p.sxy, p.syy, mu(&p),
-            p.state[10] /* gammadotp */
+            ps->exx_t[0], ps->exy_t[0] + ps->wxy_t[0], ps->exy_t[0] - ps->wxy_t[0], ps->eyy_t[0],
+            ps->sxx[0], ps->sxy[0], ps->syy[0], mu(ps, 0),
+            ps->state[0][10] /* gammadotp */
         );
     }
 
     fclose(fp);
 
+    nodal_field_free(&(testjob.nodal_fields));
+    particle_store_free(ps);
+
     return 0;
 }
 